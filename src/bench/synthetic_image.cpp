@@ -0,0 +1,54 @@
+#include "synthetic_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+using namespace bench;
+
+cv::Mat bench::make_synthetic_image(const cv::Size& size, uint64_t seed, SyntheticTruth* truth) {
+  cv::RNG rng(seed);
+  // mid-gray background with gaussian noise (randn saturates into 8U)
+  cv::Mat img(size, CV_8UC3);
+  cv::randn(img, cv::Scalar::all(96), cv::Scalar::all(6));
+
+  // roughly one feature of each kind per 40k pixels, at least a few
+  const int count = std::max(4, static_cast<int>(static_cast<double>(size.area()) / 40000.0));
+  const int min_side = std::min(size.width, size.height);
+  const int max_len = std::max(40, min_side / 4);
+
+  for (int i = 0; i < count; ++i) {
+    const cv::Point p1(rng.uniform(0, size.width), rng.uniform(0, size.height));
+    const double a = rng.uniform(0.0, CV_PI);
+    const double len = rng.uniform(30.0, static_cast<double>(max_len));
+    const cv::Point p2(cvRound(p1.x + std::cos(a) * len), cvRound(p1.y + std::sin(a) * len));
+    cv::line(img, p1, p2, cv::Scalar(230, 230, 230), 2, cv::LINE_8);
+    if (truth) truth->lines.push_back(cv::Vec4i(p1.x, p1.y, p2.x, p2.y));
+  }
+  for (int i = 0; i < count / 2; ++i) {
+    const int r = rng.uniform(10, std::max(11, std::min(120, min_side / 8)));
+    const cv::Point c(rng.uniform(r, std::max(r + 1, size.width - r)), rng.uniform(r, std::max(r + 1, size.height - r)));
+    cv::circle(img, c, r, cv::Scalar(20, 20, 20), 3, cv::LINE_8);
+    if (truth) truth->circles.push_back(cv::Vec3f(static_cast<float>(c.x), static_cast<float>(c.y), static_cast<float>(r)));
+  }
+  for (int i = 0; i < count / 2; ++i) {
+    const int w = rng.uniform(12, 80), h = rng.uniform(12, 80);
+    const cv::Point tl(rng.uniform(0, std::max(1, size.width - w)), rng.uniform(0, std::max(1, size.height - h)));
+    cv::rectangle(img, cv::Rect(tl.x, tl.y, w, h), cv::Scalar(250, 250, 250), cv::FILLED);
+    if (truth) {
+      truth->corners.push_back(cv::Point2f(static_cast<float>(tl.x), static_cast<float>(tl.y)));
+      truth->corners.push_back(cv::Point2f(static_cast<float>(tl.x + w - 1), static_cast<float>(tl.y)));
+      truth->corners.push_back(cv::Point2f(static_cast<float>(tl.x), static_cast<float>(tl.y + h - 1)));
+      truth->corners.push_back(cv::Point2f(static_cast<float>(tl.x + w - 1), static_cast<float>(tl.y + h - 1)));
+    }
+  }
+  return img;
+}
+
+cv::Rect bench::centered_roi(const cv::Size& size, double fraction) {
+  if (fraction >= 1.0) return cv::Rect(0, 0, size.width, size.height);
+  const double s = std::sqrt(std::max(0.0, fraction));
+  const int w = std::max(1, static_cast<int>(size.width * s));
+  const int h = std::max(1, static_cast<int>(size.height * s));
+  return cv::Rect((size.width - w) / 2, (size.height - h) / 2, w, h);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace bench {
+
+// Ground truth of a synthetic image.
+struct SyntheticTruth {
+  std::vector<cv::Vec4i> lines;
+  std::vector<cv::Vec3f> circles;
+  std::vector<cv::Point2f> corners;
+};
+
+// 8UC3 BGR image with known lines, circles and rectangle corners on a
+// noisy background. Feature count scales with the area; same seed, same image.
+cv::Mat make_synthetic_image(const cv::Size& size, uint64_t seed, SyntheticTruth* truth = nullptr);
+
+// ROI covering `fraction` of the image area, centered.
+cv::Rect centered_roi(const cv::Size& size, double fraction);
+
+} // namespace bench
@@ -0,0 +1,518 @@
+// Micro-benchmarks for the detection tools and their stages on synthetic
+// images (1 MP .. 50 MP, several ROI fractions).
+//
+//   tool_bench [--sizes 1,5,20,50] [--roi 0.1,0.25,1] [--reps 5]
+//              [--save results.jsonl] [--baseline base.jsonl] [--tolerance 0.10]
+//              [--match-tolerance 2] [--match-ratio 0.9]
+//
+// Every result is one JSONL line on stdout (and in --save). With --baseline
+// each case is compared against the saved median; the exit code is 1 if any
+// case got slower than the tolerance allows.
+//
+// allocs_per_run counts operator new calls of the whole process per
+// repetition. mat_bytes_per_run counts the bytes of the cv::Mat buffers
+// allocated per repetition (through a counting cv::MatAllocator): every such
+// plane is written and read again, so it is a floor of the plane traffic of
+// the case, and mat_gb_per_s is that floor over the median time.
+//
+// Accuracy checks ({"check":...} lines) compare fast paths with the
+// reference path they stand in for; a failed check also sets exit code 1.
+
+#include "bench/synthetic_image.h"
+#include "tools/caliper_tool.h"
+#include "tools/circle_fit_tool.h"
+#include "tools/circle_tool.h"
+#include "tools/frame_ring.h"
+#include "tools/image_document.h"
+#include "tools/line_tool.h"
+#include "tools/pipeline.h"
+#include "tools/point_tool.h"
+#include "tools/preprocess.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+std::atomic<unsigned long long> g_allocations{0};
+std::atomic<unsigned long long> g_mat_bytes{0};
+
+// Default cv::Mat allocator of the bench: OpenCV's own, plus a count of
+// the bytes of every buffer it hands out. Buffers keep the standard
+// allocator as their owner, so they are freed as usual.
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+  cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                         cv::AccessFlag flags, cv::UMatUsageFlag usage) const override {
+    cv::UMatData* u = std_->allocate(dims, sizes, type, data, step, flags, usage);
+    if (u && !data) g_mat_bytes.fetch_add(u->size, std::memory_order_relaxed);
+    return u;
+  }
+  bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlag usage) const override {
+    return std_->allocate(u, flags, usage);
+  }
+  void deallocate(cv::UMatData* u) const override { std_->deallocate(u); }
+
+private:
+  cv::MatAllocator* std_ = cv::Mat::getStdAllocator();
+};
+
+} // namespace
+
+void* operator new(std::size_t n) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Options {
+  std::vector<double> megapixels{ 1, 5, 20, 50 };
+  std::vector<double> roi_fractions{ 0.1, 0.25, 1.0 };
+  int reps = 5;
+  std::string save;
+  std::string baseline;
+  double tolerance = 0.10;
+  // pyramid results must lie within this many pixels of a full-resolution
+  // result, for at least match_ratio of them
+  double match_tolerance = 2.0;
+  double match_ratio = 0.9;
+};
+
+struct Sample {
+  std::string key;   // "<stage>/<MP>MP/roi<fraction>"
+  double median_ms = 0.0;
+  double min_ms = 0.0;
+  long long pixels = 0;
+  double allocs = 0.0;  // heap allocations per repetition
+  double mat_bytes = 0.0;  // cv::Mat buffer bytes allocated per repetition
+};
+
+// whole-string numbers only: "5x" or "0.1abc" are errors, not 5 and 0.1
+bool to_double(const std::string& text, double& out) {
+  try {
+    size_t used = 0;
+    out = std::stod(text, &used);
+    return used == text.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+bool to_int(const std::string& text, int& out) {
+  try {
+    size_t used = 0;
+    out = std::stoi(text, &used);
+    return used == text.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+bool parse_list(const std::string& text, std::vector<double>& out) {
+  std::vector<double> values;
+  std::stringstream ss(text);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    double v = 0.0;
+    if (!to_double(item, v)) return false;
+    values.push_back(v);
+  }
+  out = std::move(values);
+  return true;
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    const std::string value = argv[++i];
+    bool ok = true;
+    if (arg == "--sizes") ok = parse_list(value, opt.megapixels);
+    else if (arg == "--roi") ok = parse_list(value, opt.roi_fractions);
+    else if (arg == "--reps") ok = to_int(value, opt.reps) && opt.reps > 0;
+    else if (arg == "--save") opt.save = value;
+    else if (arg == "--baseline") opt.baseline = value;
+    else if (arg == "--tolerance") ok = to_double(value, opt.tolerance);
+    else if (arg == "--match-tolerance") ok = to_double(value, opt.match_tolerance);
+    else if (arg == "--match-ratio") ok = to_double(value, opt.match_ratio);
+    else return false;
+    if (!ok) return false;
+  }
+  return true;
+}
+
+// 4:3 image with about `mp` megapixels
+cv::Size size_for(double mp) {
+  const double px = mp * 1e6;
+  const int w = static_cast<int>(std::sqrt(px * 4.0 / 3.0));
+  return cv::Size(w, static_cast<int>(px / w));
+}
+
+std::string format_key(const char* stage, double mp, double fraction) {
+  char buf[128];
+  std::snprintf(buf, sizeof(buf), "%s/%gMP/roi%g", stage, mp, fraction);
+  return buf;
+}
+
+Sample measure(const std::string& key, long long pixels, int reps, const std::function<void()>& fn) {
+  fn(); // warm-up (allocations, lazy init)
+  std::vector<double> ms;
+  ms.reserve(reps);
+  const unsigned long long allocs0 = g_allocations.load();
+  const unsigned long long mat_bytes0 = g_mat_bytes.load();
+  for (int i = 0; i < reps; ++i) {
+    const auto t0 = std::chrono::steady_clock::now();
+    fn();
+    ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+  }
+  const unsigned long long allocs = g_allocations.load() - allocs0;
+  const unsigned long long mat_bytes = g_mat_bytes.load() - mat_bytes0;
+  std::sort(ms.begin(), ms.end());
+  Sample s;
+  s.key = key;
+  s.median_ms = ms[ms.size() / 2];
+  s.min_ms = ms.front();
+  s.pixels = pixels;
+  s.allocs = static_cast<double>(allocs) / reps;
+  s.mat_bytes = static_cast<double>(mat_bytes) / reps;
+  return s;
+}
+
+std::string to_jsonl(const Sample& s) {
+  char buf[384];
+  int n = std::snprintf(buf, sizeof(buf),
+                        "{\"key\":\"%s\",\"median_ms\":%.4f,\"min_ms\":%.4f,\"pixels\":%lld,\"mpix_per_s\":%.2f,\"allocs_per_run\":%.1f,"
+                        "\"mat_bytes_per_run\":%.0f,\"mat_gb_per_s\":%.2f}",
+                        s.key.c_str(), s.median_ms, s.min_ms, s.pixels,
+                        s.median_ms > 0 ? s.pixels / (s.median_ms * 1000.0) : 0.0, s.allocs,
+                        s.mat_bytes, s.median_ms > 0 ? s.mat_bytes / (s.median_ms * 1e6) : 0.0);
+  return n > 0 ? std::string(buf) : std::string();
+}
+
+// Fast path against reference: how many results of the fast path lie within
+// the tolerance of some reference result, and the worst deviation.
+struct Check {
+  std::string key;
+  size_t count = 0;
+  size_t within = 0;
+  double max_px = 0.0;
+  bool ok = false;
+};
+
+std::string to_jsonl(const Check& c) {
+  char buf[256];
+  std::snprintf(buf, sizeof(buf), "{\"check\":\"%s\",\"count\":%zu,\"within\":%zu,\"max_px\":%.3f,\"ok\":%s}",
+                c.key.c_str(), c.count, c.within, c.max_px, c.ok ? "true" : "false");
+  return buf;
+}
+
+double point_segment_distance(const cv::Point2f& p, const cv::Vec4i& s) {
+  const cv::Point2f a(static_cast<float>(s[0]), static_cast<float>(s[1]));
+  const cv::Point2f b(static_cast<float>(s[2]), static_cast<float>(s[3]));
+  const cv::Point2f ab = b - a;
+  const float len2 = ab.dot(ab);
+  const float t = len2 > 0 ? std::min(1.f, std::max(0.f, (p - a).dot(ab) / len2)) : 0.f;
+  const cv::Point2f d = p - (a + t * ab);
+  return std::sqrt(d.dot(d));
+}
+
+// Each test segment is judged by its end points' distance to the nearest
+// reference segment: Hough fragments differ between the paths, the geometry
+// should not.
+Check compare_lines(const std::string& key, const std::vector<cv::Vec4i>& reference,
+                    const std::vector<cv::Vec4i>& test, const Options& opt) {
+  Check c;
+  c.key = key;
+  c.count = test.size();
+  for (const cv::Vec4i& l : test) {
+    double worst = 0.0;
+    for (const cv::Point2f p : { cv::Point2f(static_cast<float>(l[0]), static_cast<float>(l[1])),
+                                 cv::Point2f(static_cast<float>(l[2]), static_cast<float>(l[3])) }) {
+      double best = HUGE_VAL;
+      for (const cv::Vec4i& r : reference) best = std::min(best, point_segment_distance(p, r));
+      worst = std::max(worst, best);
+    }
+    if (worst <= opt.match_tolerance) ++c.within;
+    c.max_px = std::max(c.max_px, worst);
+  }
+  c.ok = c.count == 0 ? reference.empty() : c.within >= opt.match_ratio * c.count;
+  return c;
+}
+
+// Deviation of a circle: center distance plus radius difference to the
+// closest reference circle.
+Check compare_circles(const std::string& key, const std::vector<cv::Vec3f>& reference,
+                      const std::vector<cv::Vec3f>& test, const Options& opt) {
+  Check c;
+  c.key = key;
+  c.count = test.size();
+  for (const cv::Vec3f& t : test) {
+    double best = HUGE_VAL;
+    for (const cv::Vec3f& r : reference) {
+      best = std::min(best, static_cast<double>(std::hypot(t[0] - r[0], t[1] - r[1]) + std::abs(t[2] - r[2])));
+    }
+    if (best <= opt.match_tolerance) ++c.within;
+    c.max_px = std::max(c.max_px, best);
+  }
+  c.ok = c.count == 0 ? reference.empty() : c.within >= opt.match_ratio * c.count;
+  return c;
+}
+
+// Binary planes (edges of the fused and the OpenCV front end, rendered
+// corners): count is the pixels set in either, within those set in both,
+// and max_px the farthest a differing pixel lies from the other plane's set
+// pixels. `exact` demands identical planes.
+Check compare_edges(const std::string& key, const cv::Mat& reference, const cv::Mat& test, bool exact,
+                    const Options& opt) {
+  Check c;
+  c.key = key;
+  if (reference.size() != test.size()) return c;
+  cv::Mat either, both;
+  cv::bitwise_or(reference, test, either);
+  cv::bitwise_and(reference, test, both);
+  c.count = static_cast<size_t>(cv::countNonZero(either));
+  c.within = static_cast<size_t>(cv::countNonZero(both));
+  if (c.within < c.count) {
+    cv::Mat no_ref, no_test, dist_ref, dist_test;
+    cv::compare(reference, 0, no_ref, cv::CMP_EQ);
+    cv::compare(test, 0, no_test, cv::CMP_EQ);
+    cv::distanceTransform(no_ref, dist_ref, cv::DIST_L2, 3);
+    cv::distanceTransform(no_test, dist_test, cv::DIST_L2, 3);
+    double to_ref = 0.0, to_test = 0.0;
+    cv::minMaxLoc(dist_ref, nullptr, &to_ref, nullptr, nullptr, test);
+    cv::minMaxLoc(dist_test, nullptr, &to_test, nullptr, nullptr, reference);
+    c.max_px = std::max(to_ref, to_test);
+  }
+  c.ok = exact ? c.within == c.count : c.within >= opt.match_ratio * c.count;
+  return c;
+}
+
+// Integer corners of a tool result as a plane over the ROI, for compare_edges.
+cv::Mat point_plane(const std::vector<cv::Point2f>& points, const cv::Rect& roi) {
+  cv::Mat plane = cv::Mat::zeros(roi.size(), CV_8UC1);
+  for (const cv::Point2f& p : points) {
+    const cv::Point q(cvRound(p.x) - roi.x, cvRound(p.y) - roi.y);
+    if (q.x >= 0 && q.y >= 0 && q.x < plane.cols && q.y < plane.rows) plane.at<uchar>(q) = 255;
+  }
+  return plane;
+}
+
+// Reads the "key" and "median_ms" fields written by to_jsonl.
+std::map<std::string, double> load_baseline(const std::string& path) {
+  std::map<std::string, double> base;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t k = line.find("\"key\":\"");
+    const size_t m = line.find("\"median_ms\":");
+    if (k == std::string::npos || m == std::string::npos) continue;
+    const size_t ks = k + 7;
+    const size_t ke = line.find('"', ks);
+    if (ke == std::string::npos) continue;
+    base[line.substr(ks, ke - ks)] = std::atof(line.c_str() + m + 12);
+  }
+  return base;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  if (!parse_args(argc, argv, opt)) {
+    std::fprintf(stderr, "usage: tool_bench [--sizes 1,5,20,50] [--roi 0.1,0.25,1] [--reps N]\n"
+                         "                  [--save FILE] [--baseline FILE] [--tolerance 0.10]\n"
+                         "                  [--match-tolerance 2] [--match-ratio 0.9]\n");
+    return 2;
+  }
+  static CountingMatAllocator mat_allocator;
+  cv::Mat::setDefaultAllocator(&mat_allocator);
+
+  std::vector<Sample> samples;
+  auto record = [&](const Sample& s) {
+    samples.push_back(s);
+    std::cout << to_jsonl(s) << std::endl;
+  };
+  int failed_checks = 0;
+  auto check = [&](const Check& c) {
+    if (!c.ok) ++failed_checks;
+    std::cout << to_jsonl(c) << std::endl;
+  };
+
+  for (double mp : opt.megapixels) {
+    const cv::Size size = size_for(mp);
+    const cv::Mat bgr = bench::make_synthetic_image(size, 42);
+    const long long full_px = static_cast<long long>(size.area());
+
+    // decode side: BGR -> gray plane of the image document (once per image in the GUI)
+    record(measure(format_key("document_gray", mp, 1.0), full_px, opt.reps, [&]() {
+      auto doc = tools::ImageDocument::from_mat(bgr);
+      doc->gray();
+    }));
+    // result cache key: content hash of the gray plane (once per image, on the first cached run)
+    {
+      auto doc = tools::ImageDocument::from_mat(bgr);
+      doc->gray();
+      record(measure(format_key("document_hash", mp, 1.0), full_px, opt.reps, [&]() {
+        tools::ImageDocument::from_mat(doc->gray())->content_hash();
+      }));
+    }
+
+    cv::Mat gray;
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+
+    // frame hand-off from an acquisition process: PNG encode + decode (the
+    // file path minus the disk) against the shared-memory ring (one copy in
+    // the producer, none in the reader); plain memory stands in for the segment
+    {
+      record(measure(format_key("ingest.png", mp, 1.0), full_px, opt.reps, [&]() {
+        std::vector<uchar> encoded;
+        cv::imencode(".png", gray, encoded);
+        tools::ImageDocument::decode(encoded.data(), encoded.size());
+      }));
+      const size_t frame_bytes = gray.total();
+      std::vector<uchar> segment(tools::frame_ring_bytes(4, frame_bytes));
+      tools::FrameRingWriter writer(segment.data(), segment.size(), 4, frame_bytes);
+      auto reader = tools::FrameRingSource::open(segment.data(), segment.size(), nullptr, "bench");
+      record(measure(format_key("ingest.ring", mp, 1.0), full_px, opt.reps, [&]() {
+        writer.write(gray);
+        tools::Frame frame;
+        reader->read(frame);
+        tools::ImageDocument::from_mat(std::move(frame.pixels), std::move(frame.owner));
+      }));
+    }
+
+    for (double fraction : opt.roi_fractions) {
+      const cv::Rect roi = bench::centered_roi(size, fraction);
+      const long long px = static_cast<long long>(roi.area());
+
+      // individual stages (no stage cache: every repetition recomputes)
+      record(measure(format_key("stage.gaussian3", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::gaussian(gray, roi, cv::Size(3, 3), 0, nullptr);
+      }));
+      record(measure(format_key("stage.gaussian9", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::gaussian(gray, roi, cv::Size(9, 9), 2, nullptr);
+      }));
+      record(measure(format_key("stage.canny", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::canny(gray, roi, cv::Size(3, 3), 0, 50, 150, 3, nullptr);
+      }));
+      record(measure(format_key("stage.canny_fused", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::fused_canny(gray, roi, 50, 150, nullptr);
+      }));
+      // front end from the decoded BGR frame (stream / batch input): OpenCV
+      // materializes gray, blurred, the edges and Canny's own map and Sobel
+      // strips, the fused path only the edge map it returns (1 B/px in
+      // mat_bytes_per_run)
+      record(measure(format_key("frontend.bgr_opencv", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::canny(bgr, roi, cv::Size(3, 3), 0, 50, 150, 3, nullptr);
+      }));
+      record(measure(format_key("frontend.bgr_fused", mp, fraction), px, opt.reps, [&]() {
+        tools::stages::fused_canny(bgr, roi, 50, 150, nullptr);
+      }));
+      // same edges (fused_canny's contract); inside a partial ROI the OpenCV
+      // blur also reads pixels outside it, so edges along the border may differ
+      check(compare_edges(format_key("edges_fused_vs_opencv", mp, fraction),
+                          tools::stages::canny(bgr, roi, cv::Size(3, 3), 0, 50, 150, 3, nullptr),
+                          tools::stages::fused_canny(bgr, roi, 50, 150, nullptr), roi.area() == full_px, opt));
+      const cv::Mat edges = tools::stages::canny(gray, roi, cv::Size(3, 3), 0, 50, 150, 3, nullptr);
+      record(measure(format_key("stage.hough_lines", mp, fraction), px, opt.reps, [&]() {
+        std::vector<cv::Vec4i> lines;
+        cv::HoughLinesP(edges, lines, 1.0, CV_PI / 180.0, 50, 20.0, 10.0);
+      }));
+
+      // whole tools with default parameters, as the GUI runs them
+      tools::LineTool line_tool;
+      record(measure(format_key("tool.line", mp, fraction), px, opt.reps, [&]() { line_tool.run(gray, roi); }));
+      tools::LineTool line_fused;
+      line_fused.params.fused = true;
+      record(measure(format_key("tool.line_fused", mp, fraction), px, opt.reps, [&]() { line_fused.run(gray, roi); }));
+      tools::PointTool point_tool;
+      record(measure(format_key("tool.point", mp, fraction), px, opt.reps, [&]() { point_tool.run(gray, roi); }));
+      tools::CircleTool circle_tool;
+      record(measure(format_key("tool.circle", mp, fraction), px, opt.reps, [&]() { circle_tool.run(gray, roi); }));
+      // coarse-to-fine: Hough two pyramid levels down, candidates refined at full resolution
+      tools::LineTool line_pyramid;
+      line_pyramid.params.pyramid_levels = 2;
+      record(measure(format_key("tool.line_pyramid", mp, fraction), px, opt.reps, [&]() { line_pyramid.run(gray, roi); }));
+      tools::CircleTool circle_pyramid;
+      circle_pyramid.params.pyramid_levels = 2;
+      record(measure(format_key("tool.circle_pyramid", mp, fraction), px, opt.reps, [&]() { circle_pyramid.run(gray, roi); }));
+      check(compare_lines(format_key("line_pyramid_vs_full", mp, fraction), line_tool.run(gray, roi).lines,
+                          line_pyramid.run(gray, roi).lines, opt));
+      check(compare_circles(format_key("circle_pyramid_vs_full", mp, fraction), circle_tool.run(gray, roi).circles,
+                            circle_pyramid.run(gray, roi).circles, opt));
+      // dense corners (50k+ on large ROIs): goodFeaturesToTrack against the grid engine
+      tools::PointTool dense_points;
+      dense_points.params.max_corners = 100000;
+      dense_points.params.min_distance = 5.0;
+      record(measure(format_key("tool.point_dense", mp, fraction), px, opt.reps, [&]() { dense_points.run(gray, roi); }));
+      tools::PointTool grid_points = dense_points;
+      grid_points.params.grid = true;
+      record(measure(format_key("tool.point_dense_grid", mp, fraction), px, opt.reps, [&]() { grid_points.run(gray, roi); }));
+      // without a quota the grid engine keeps exactly goodFeaturesToTrack's corners
+      check(compare_edges(format_key("point_grid_vs_gftt", mp, fraction),
+                          point_plane(dense_points.run(gray, roi).points, roi),
+                          point_plane(grid_points.run(gray, roi).points, roi), true, opt));
+      // cost follows calipers x search length, not the ROI area
+      tools::CaliperTool caliper_tool;
+      record(measure(format_key("tool.caliper", mp, fraction), px, opt.reps, [&]() { caliper_tool.run(gray, roi); }));
+      // edge-point circle fit on the same ROI, for comparison with tool.circle
+      tools::CircleFitTool circle_fit_tool;
+      record(measure(format_key("tool.circle_fit", mp, fraction), px, opt.reps, [&]() { circle_fit_tool.run(gray, roi); }));
+
+      // chained recipe: circles -> box around them -> lines there -> their
+      // intersections, next to a point search on the same ROI (parallel branch)
+      tools::Pipeline pipeline;
+      const auto area = pipeline.add_fixed_roi(roi);
+      const auto circles = pipeline.add_tool(std::make_shared<tools::CircleTool>(), pipeline.input(), area);
+      const auto around = pipeline.add_roi(circles, [](const tools::DetectionResult& r, const cv::Size&) {
+        return tools::result_bounds(r, 16);
+      });
+      const auto lines = pipeline.add_tool(std::make_shared<tools::LineTool>(), pipeline.input(), around);
+      pipeline.add_line_intersections(lines);
+      pipeline.add_tool(std::make_shared<tools::PointTool>(), pipeline.input(), area);
+      record(measure(format_key("pipeline.circle_lines", mp, fraction), px, opt.reps, [&]() { pipeline.run(gray); }));
+    }
+  }
+
+  if (!opt.save.empty()) {
+    std::ofstream out(opt.save);
+    for (const auto& s : samples) out << to_jsonl(s) << '\n';
+  }
+
+  if (failed_checks) std::fprintf(stderr, "%d accuracy check(s) failed\n", failed_checks);
+  if (opt.baseline.empty()) return failed_checks == 0 ? 0 : 1;
+
+  const std::map<std::string, double> base = load_baseline(opt.baseline);
+  int regressions = 0;
+  std::fprintf(stderr, "%-40s %10s %10s %8s\n", "case", "base ms", "now ms", "ratio");
+  for (const auto& s : samples) {
+    auto it = base.find(s.key);
+    if (it == base.end() || it->second <= 0) continue;
+    const double ratio = s.median_ms / it->second;
+    const bool slower = ratio > 1.0 + opt.tolerance;
+    if (slower) ++regressions;
+    std::fprintf(stderr, "%-40s %10.3f %10.3f %7.2fx%s\n", s.key.c_str(), it->second, s.median_ms, ratio, slower ? "  REGRESSION" : "");
+  }
+  std::fprintf(stderr, "%d regression(s) above %.0f%% tolerance\n", regressions, opt.tolerance * 100.0);
+  return regressions == 0 && failed_checks == 0 ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// Headless batch inspection: runs one recipe over every image in a directory
+// with the same tools:: classes as the GUI. Decoding and detection run as two
+// pipelined stages connected by a bounded queue; results stream to CSV/JSONL.
+//
+//   batch_inspect --recipe line.recipe --input D:/images [--output out.csv|out.jsonl]
+//                 [--format csv|jsonl] [--recursive] [--decoders N] [--workers N]
+
+#include "tools/bounded_queue.h"
+#include "tools/image_files.h"
+#include "tools/oriented_roi.h"
+#include "tools/result_io.h"
+#include "tools/tool_spec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+  std::string recipe;
+  std::string input;
+  std::string output;      // empty = stdout
+  std::string format;      // csv / jsonl, default from the output extension
+  bool recursive = false;
+  unsigned decoders = 0;    // 0 = from the core count
+  unsigned workers = 0;
+};
+
+constexpr unsigned kMaxThreads = 1024;
+
+struct DecodedImage {
+  std::string name;
+  cv::Mat gray;
+  std::string error;
+};
+
+struct InspectedImage {
+  std::string name;
+  tools::DetectionResult result;
+  double detect_ms = 0.0;
+  std::string error;
+};
+
+using Clock = std::chrono::steady_clock;
+
+void print_usage() {
+  std::fprintf(stderr,
+    "usage: batch_inspect --recipe FILE --input DIR [--output FILE] [--format csv|jsonl]\n"
+    "                     [--recursive] [--decoders N] [--workers N]   (N <= 1024, 0 = auto)\n");
+}
+
+// A whole decimal number in [0, kMaxThreads]: no sign, no trailing text.
+bool parse_count(const std::string& text, unsigned& out) {
+  unsigned v = 0;
+  const char* end = text.data() + text.size();
+  const auto r = std::from_chars(text.data(), end, v);
+  if (r.ec != std::errc() || r.ptr != end || v > kMaxThreads) return false;
+  out = v;
+  return true;
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&](std::string& out) {
+      if (i + 1 >= argc) return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string n;
+    if (arg == "--recipe") { if (!value(opt.recipe)) return false; }
+    else if (arg == "--input") { if (!value(opt.input)) return false; }
+    else if (arg == "--output") { if (!value(opt.output)) return false; }
+    else if (arg == "--format") { if (!value(opt.format)) return false; }
+    else if (arg == "--recursive") { opt.recursive = true; }
+    else if (arg == "--decoders") { if (!value(n) || !parse_count(n, opt.decoders)) return false; }
+    else if (arg == "--workers") { if (!value(n) || !parse_count(n, opt.workers)) return false; }
+    else return false;
+  }
+  if (opt.format.empty()) {
+    opt.format = fs::path(opt.output).extension() == ".jsonl" ? "jsonl" : "csv";
+  }
+  return !opt.recipe.empty() && !opt.input.empty() && (opt.format == "csv" || opt.format == "jsonl");
+}
+
+// Reads through fs::path so non-ASCII file names work on Windows, and decodes
+// straight to gray: the tools never need the color planes.
+cv::Mat decode_gray(const fs::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return cv::Mat();
+  std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (bytes.empty()) return cv::Mat();
+  return cv::imdecode(bytes, cv::IMREAD_GRAYSCALE);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options opt;
+  if (!parse_args(argc, argv, opt)) {
+    print_usage();
+    return 2;
+  }
+
+  tools::Recipe recipe;
+  std::string error;
+  if (!tools::load_recipe(opt.recipe, recipe, &error)) {
+    std::fprintf(stderr, "batch_inspect: %s\n", error.c_str());
+    return 2;
+  }
+
+  std::error_code ec;
+  const std::vector<fs::path> files = tools::list_image_files(opt.input, opt.recursive, ec);
+  if (ec) {
+    std::fprintf(stderr, "batch_inspect: %s: %s\n", opt.input.c_str(), ec.message().c_str());
+    return 2;
+  }
+
+  std::ofstream file_out;
+  if (!opt.output.empty()) {
+    file_out.open(opt.output, std::ios::binary);
+    if (!file_out) {
+      std::fprintf(stderr, "batch_inspect: cannot write %s\n", opt.output.c_str());
+      return 2;
+    }
+  }
+  std::ostream& out = opt.output.empty() ? std::cout : file_out;
+
+  const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned workers = opt.workers ? opt.workers : hw;
+  const unsigned decoders = opt.decoders ? opt.decoders : std::max(1u, hw / 2);
+
+  // decode -> detect -> write, each hand-off bounded so memory stays flat
+  tools::BoundedQueue<DecodedImage> decoded(workers * 2);
+  tools::BoundedQueue<InspectedImage> inspected(workers * 4);
+  std::atomic<size_t> next_file{0};
+
+  const auto t0 = Clock::now();
+
+  std::vector<std::thread> decode_threads;
+  for (unsigned i = 0; i < decoders; ++i) {
+    decode_threads.emplace_back([&]() {
+      for (;;) {
+        const size_t idx = next_file.fetch_add(1);
+        if (idx >= files.size()) return;
+        DecodedImage img;
+        img.name = files[idx].u8string();
+        try {
+          img.gray = decode_gray(files[idx]);
+          if (img.gray.empty()) img.error = "decode failed";
+        } catch (const std::exception& e) {
+          img.error = e.what();
+        }
+        if (!decoded.push(std::move(img))) return;
+      }
+    });
+  }
+
+  std::vector<std::thread> detect_threads;
+  for (unsigned i = 0; i < workers; ++i) {
+    detect_threads.emplace_back([&]() {
+      // one tool object per worker, reused for every image
+      std::shared_ptr<tools::ITool> tool = tools::make_tool(recipe.tool);
+      const bool oriented = recipe.roi_angle != 0.0 && !recipe.roi.empty();
+      const cv::RotatedRect region = tools::oriented_region(recipe.roi, recipe.roi_angle);
+      while (auto img = decoded.pop()) {
+        InspectedImage res;
+        res.name = std::move(img->name);
+        res.error = std::move(img->error);
+        if (res.error.empty()) {
+          const auto s = Clock::now();
+          try {
+            res.result = oriented ? tool->run_oriented(img->gray, region) : tool->run(img->gray, recipe.roi);
+          } catch (const std::exception& e) {
+            res.error = e.what();
+          }
+          res.detect_ms = std::chrono::duration<double, std::milli>(Clock::now() - s).count();
+        }
+        inspected.push(std::move(res));
+      }
+    });
+  }
+
+  // stage shutdown: decoders done -> close decoded; detectors done -> close inspected
+  std::thread closer([&]() {
+    for (auto& t : decode_threads) t.join();
+    decoded.close();
+    for (auto& t : detect_threads) t.join();
+    inspected.close();
+  });
+
+  // writer runs on the main thread, in completion order
+  if (opt.format == "csv") tools::write_csv_header(out);
+  size_t images = 0, failed = 0, detections = 0;
+  while (auto res = inspected.pop()) {
+    ++images;
+    if (!res->error.empty()) {
+      ++failed;
+      std::fprintf(stderr, "batch_inspect: %s: %s\n", res->name.c_str(), res->error.c_str());
+      continue;
+    }
+    detections += res->result.lines.size() + res->result.points.size() + res->result.circles.size();
+    if (opt.format == "csv") tools::write_csv(out, res->name, res->result);
+    else tools::write_jsonl(out, res->name, res->result, res->detect_ms);
+  }
+  closer.join();
+  out.flush();
+
+  const double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+  std::fprintf(stderr, "%zu images (%zu failed), %zu detections in %.2f s: %.1f images/s [%u decoders, %u workers]\n",
+               images, failed, detections, seconds, seconds > 0 ? images / seconds : 0.0, decoders, workers);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Frame producer for the shared-memory frame ring: stands in for (or shows
+// how to write) an acquisition process. Frames of a video or an image
+// directory are written into a QSharedMemory segment that the GUI opens with
+// "打开共享内存帧" and reads without copying.
+//
+//   frame_producer --source D:/frames [--key camera] [--fps 25] [--slots 8] [--loop]
+//
+// A real camera process only needs the segment setup below and one
+// FrameRingWriter::write() per frame.
+
+#include "tools/frame_ring.h"
+#include "tools/frame_source.h"
+
+#include <QCoreApplication>
+#include <QSharedMemory>
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct Options {
+  std::string source;
+  std::string key = "camera";
+  double fps = -1.0;  // < 0 = source rate (25 if it has none), 0 = as fast as possible
+  int slots = 8;      // a reader pins up to ~6 frames (queues, detection, display)
+  bool loop = false;
+};
+
+using Clock = std::chrono::steady_clock;
+
+void print_usage() {
+  std::fprintf(stderr,
+    "usage: frame_producer --source VIDEO|DIR [--key NAME] [--fps F] [--slots N] [--loop]\n");
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&](std::string& out) {
+      if (i + 1 >= argc) return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string v;
+    if (arg == "--source") { if (!value(opt.source)) return false; }
+    else if (arg == "--key") { if (!value(opt.key)) return false; }
+    else if (arg == "--fps") { if (!value(v)) return false; opt.fps = std::stod(v); }
+    else if (arg == "--slots") { if (!value(v)) return false; opt.slots = std::stoi(v); }
+    else if (arg == "--loop") { opt.loop = true; }
+    else return false;
+  }
+  return !opt.source.empty() && !opt.key.empty() && opt.slots >= 2;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  Options opt;
+  try {
+    if (!parse_args(argc, argv, opt)) {
+      print_usage();
+      return 2;
+    }
+  } catch (const std::exception&) {
+    print_usage();
+    return 2;
+  }
+
+  std::string error;
+  std::unique_ptr<tools::FrameSource> source = tools::open_frame_source(opt.source, &error);
+  if (!source) {
+    std::fprintf(stderr, "cannot open %s: %s\n", opt.source.c_str(), error.c_str());
+    return 1;
+  }
+  // slots are sized for the first frame; larger frames later are dropped
+  tools::Frame frame;
+  if (!source->read(frame)) {
+    std::fprintf(stderr, "no frames in %s\n", opt.source.c_str());
+    return 1;
+  }
+  const double fps = opt.fps >= 0 ? opt.fps : (source->fps() > 0 ? source->fps() : 25.0);
+  const size_t frame_bytes = frame.pixels.total() * frame.pixels.elemSize();
+
+  QSharedMemory segment(QString::fromStdString(opt.key));
+  if (!segment.create(static_cast<int>(tools::frame_ring_bytes(opt.slots, frame_bytes)))) {
+    std::fprintf(stderr, "cannot create shared memory %s: %s\n", opt.key.c_str(),
+                 segment.errorString().toLocal8Bit().constData());
+    return 1;
+  }
+  tools::FrameRingWriter ring(segment.data(), static_cast<size_t>(segment.size()), opt.slots, frame_bytes, fps);
+  std::fprintf(stderr, "writing %dx%d frames to '%s' (%d slots, %.1f fps)\n", frame.pixels.cols,
+               frame.pixels.rows, opt.key.c_str(), opt.slots, fps);
+
+  const auto period = fps > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps))
+                              : Clock::duration::zero();
+  Clock::time_point next = Clock::now();
+  Clock::time_point last_report = next;
+  for (;;) {
+    if (fps > 0) {
+      std::this_thread::sleep_until(next);
+      next += period;
+    }
+    ring.write(frame.pixels);
+
+    if (Clock::now() - last_report >= std::chrono::seconds(1)) {
+      last_report = Clock::now();
+      std::fprintf(stderr, "written %llu, dropped %llu, expired readers %llu\n",
+                   static_cast<unsigned long long>(ring.written()), static_cast<unsigned long long>(ring.dropped()),
+                   static_cast<unsigned long long>(ring.expired()));
+    }
+    if (source->read(frame)) continue;
+    if (!opt.loop) break;
+    source = tools::open_frame_source(opt.source, &error);
+    if (!source || !source->read(frame)) break;
+  }
+  ring.close();
+  std::fprintf(stderr, "done: written %llu, dropped %llu\n", static_cast<unsigned long long>(ring.written()),
+               static_cast<unsigned long long>(ring.dropped()));
+  // keep the segment (and the last frames) around for readers that lag behind
+  std::this_thread::sleep_for(std::chrono::seconds(2));
+  return 0;
+}
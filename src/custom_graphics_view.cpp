@@ -1,63 +1,211 @@
 ﻿#include "custom_graphics_view.h"
 #include <QGraphicsRectItem>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsSimpleTextItem>
 #include <QPen>
 #include <QBrush>
 #include <QPainter>
+#include <QApplication>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
+#include <cmath>
 
 CustomGraphicsView::CustomGraphicsView(QWidget* parent)
-  : QGraphicsView(parent), drawing_rect_(nullptr), pixmap_item_(nullptr) {
+  : QGraphicsView(parent), image_item_(nullptr),
+    roi_(QPen(Qt::red, 2), QBrush(QColor(255, 0, 0, 50)), true), // 50是透明度（0-255）
+    band_(QPen(Qt::blue, 1, Qt::DashLine), QBrush(QColor(0, 0, 255, 30)), false) {
   // 视图基础配置（抗锯齿、平移模式）
   setRenderHint(QPainter::Antialiasing);
   setDragMode(QGraphicsView::ScrollHandDrag);
   setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+  // 未按键时也接收移动事件，用于悬停高亮
+  setMouseTracking(true);
+
+  // 拖动ROI时每个显示帧最多重绘一次
+  const QScreen* screen = QGuiApplication::primaryScreen();
+  const qreal hz = screen && screen->refreshRate() > 1 ? screen->refreshRate() : 60.0;
+  frame_interval_ms_ = qMax(1, static_cast<int>(1000.0 / hz));
+  frame_timer_ = new QTimer(this);
+  frame_timer_->setSingleShot(true);
+  frame_timer_->setTimerType(Qt::PreciseTimer);
+  connect(frame_timer_, &QTimer::timeout, this, &CustomGraphicsView::flush_pending);
 }
 
-// 设置当前图片项（供MainWindow调用）
+// 设置当前图片项（供MainWindow调用）。换图后旧ROI失效
 void CustomGraphicsView::SetPixmapItem(QGraphicsPixmapItem* pixmap_item) {
-  pixmap_item_ = pixmap_item;
+  SetImageItem(pixmap_item);
+}
+
+void CustomGraphicsView::SetImageItem(QGraphicsItem* image_item) {
+  image_item_ = image_item;
+  ClearRoi();
+  ClearRois();
+}
+
+// 保存ROI：独立的矩形图元（橙色），左上角显示编号
+int CustomGraphicsView::AddRoi(const QRectF& rect) {
+  const int id = next_roi_id_++;
+  QGraphicsRectItem* item = new QGraphicsRectItem(rect);
+  item->setPen(QPen(QColor(255, 140, 0), 2));
+  item->setBrush(QBrush(QColor(255, 140, 0, 40)));
+  item->setZValue(2.0);
+  QGraphicsSimpleTextItem* label = new QGraphicsSimpleTextItem(QString::number(id), item);
+  label->setBrush(QColor(255, 140, 0));
+  label->setPos(rect.topLeft() + QPointF(2, 2));
+  label->setFlag(QGraphicsItem::ItemIgnoresTransformations); // 缩放时编号大小不变
+  scene()->addItem(item);
+  rois_.insert(id, item);
+  emit RoisChanged();
+  return id;
+}
+
+void CustomGraphicsView::RemoveRoi(int id) {
+  QGraphicsRectItem* item = rois_.take(id);
+  if (!item) return;
+  scene()->removeItem(item);
+  delete item;
+  emit RoisChanged();
+}
+
+void CustomGraphicsView::ClearRois() {
+  if (rois_.isEmpty()) return;
+  for (QGraphicsRectItem* item : rois_) {
+    scene()->removeItem(item);
+    delete item;
+  }
+  rois_.clear();
+  emit RoisChanged();
+}
+
+QMap<int, QRectF> CustomGraphicsView::Rois() const {
+  QMap<int, QRectF> out;
+  for (auto it = rois_.begin(); it != rois_.end(); ++it) out.insert(it.key(), it.value()->rect());
+  return out;
+}
+
+// 清除ROI
+void CustomGraphicsView::ClearRoi() {
+  last_draw_rect_ = QRectF();
+  is_drawing_ = false;
+  frame_timer_->stop();
+  pending_editor_ = nullptr;
+  apply_shape(&roi_, RoiShape(), false);
+  apply_shape(&band_, RoiShape(), false);
+}
+
+qreal CustomGraphicsView::view_scale() const {
+  return qMax<qreal>(std::abs(transform().m11()), 1e-6);
+}
+
+// 悬停在ROI手柄上时提示可做的操作
+void CustomGraphicsView::update_cursor(const QPointF& scene_pos) {
+  switch (roi_.HitTest(scene_pos, view_scale())) {
+  case RoiEditor::Handle::None: viewport()->setCursor(Qt::OpenHandCursor); break;
+  case RoiEditor::Handle::Move: viewport()->setCursor(Qt::SizeAllCursor); break;
+  case RoiEditor::Handle::Rotate: viewport()->setCursor(Qt::PointingHandCursor); break;
+  default: viewport()->setCursor(Qt::CrossCursor); break;
+  }
 }
 
-// 鼠标按下：开始绘制矩形
+// 立即设置几何，只重绘新旧几何覆盖不同的视口区域
+void CustomGraphicsView::apply_shape(RoiEditor* editor, const RoiShape& shape, bool visible) {
+  const QRegion dirty = editor->Apply(shape, visible, viewportTransform());
+  if (!dirty.isEmpty()) viewport()->update(dirty);
+}
+
+// 距上次重绘已满一帧则立即重绘，否则等到下一帧；期间的移动事件只保留最新几何
+void CustomGraphicsView::queue_shape(RoiEditor* editor, const RoiShape& shape) {
+  pending_editor_ = editor;
+  pending_shape_ = shape;
+  if (!input_clock_.isValid()) input_clock_.start();
+  const qint64 since = frame_clock_.isValid() ? frame_clock_.elapsed() : frame_interval_ms_;
+  if (since >= frame_interval_ms_) {
+    flush_pending();
+  } else if (!frame_timer_->isActive()) {
+    frame_timer_->start(static_cast<int>(frame_interval_ms_ - since));
+  }
+}
+
+void CustomGraphicsView::flush_pending() {
+  frame_timer_->stop();
+  if (!pending_editor_) return;
+  RoiEditor* editor = pending_editor_;
+  pending_editor_ = nullptr;
+  const QRegion dirty = editor->Apply(pending_shape_, true, viewportTransform());
+  frame_clock_.start();
+  if (dirty.isEmpty()) {
+    input_clock_.invalidate();
+    return;
+  }
+  viewport()->update(dirty);
+}
+
+void CustomGraphicsView::drawForeground(QPainter* painter, const QRectF& rect) {
+  QGraphicsView::drawForeground(painter, rect);
+  const qreal scale = view_scale();
+  roi_.Paint(painter, scale);
+  band_.Paint(painter, scale);
+  // 输入到绘制的延迟：从最早一个未绘制的鼠标事件算起
+  if (input_clock_.isValid()) {
+    const double ms = input_clock_.nsecsElapsed() / 1e6;
+    input_clock_.invalidate();
+    ++latency_.frames;
+    latency_.last_ms = ms;
+    latency_.max_ms = qMax(latency_.max_ms, ms);
+    latency_.total_ms += ms;
+  }
+}
+
+// 鼠标按下：在手柄上开始移动/缩放/旋转，否则开始新建ROI；Shift开始框选
 void CustomGraphicsView::mousePressEvent(QMouseEvent* event) {
   // 仅处理左键，且已加载图片时才允许绘制
-  if (event->button() != Qt::LeftButton || !pixmap_item_) {
+  if (event->button() != Qt::LeftButton || !image_item_) {
     // 未满足条件时，执行父类逻辑（保证平移等功能正常）
     QGraphicsView::mousePressEvent(event);
     return;
   }
 
   is_drawing_ = true;
+  is_selecting_ = event->modifiers().testFlag(Qt::ShiftModifier);
+  press_view_pos_ = event->pos();
   // 将视图坐标转换为场景坐标（关键：确保矩形画在图片对应位置）
-  start_scene_pos_ = mapToScene(event->pos());
+  const QPointF scene_pos = mapToScene(event->pos());
+  roi_before_press_ = roi_.Shape();
+  roi_visible_before_press_ = roi_.IsVisible();
+  latency_ = EditLatency();
+  latency_.frame_ms = frame_interval_ms_;
+  frame_clock_.invalidate();
 
-  // 创建绘制中的矩形图元（红色边框+半透明红色填充）
-  drawing_rect_ = new QGraphicsRectItem();
-  drawing_rect_->setPen(QPen(Qt::red, 2));
-  drawing_rect_->setBrush(QBrush(QColor(255, 0, 0, 50))); // 50是透明度（0-255）
-  scene()->addItem(drawing_rect_);
+  if (is_selecting_) {
+    band_.BeginDrag(RoiEditor::Handle::None, scene_pos);
+  } else {
+    roi_.BeginDrag(roi_.HitTest(scene_pos, view_scale()), scene_pos);
+  }
 }
 
-// 鼠标移动：实时更新矩形大小
+// 鼠标移动：按当前拖动方式计算新几何，按帧合并重绘
 void CustomGraphicsView::mouseMoveEvent(QMouseEvent* event) {
-  if (!is_drawing_ || !drawing_rect_) {
+  if (!is_drawing_) {
+    if (event->buttons() == Qt::NoButton) {
+      const QPointF scene_pos = mapToScene(event->pos());
+      if (image_item_) update_cursor(scene_pos);
+      emit HoverMoved(scene_pos);
+    }
     // 未绘制时，执行父类逻辑（保证平移等功能正常）
     QGraphicsView::mouseMoveEvent(event);
     return;
   }
+  // 单击的微小抖动不改变ROI
+  if ((event->pos() - press_view_pos_).manhattanLength() < QApplication::startDragDistance()) return;
 
-  // 获取当前鼠标的场景坐标
-  QPointF current_scene_pos = mapToScene(event->pos());
-  // 计算矩形的左上角、宽高（保证矩形坐标为正）
-  qreal x = qMin(start_scene_pos_.x(), current_scene_pos.x());
-  qreal y = qMin(start_scene_pos_.y(), current_scene_pos.y());
-  qreal width = qAbs(current_scene_pos.x() - start_scene_pos_.x());
-  qreal height = qAbs(current_scene_pos.y() - start_scene_pos_.y());
-
-  // 更新矩形图元的位置和大小
-  drawing_rect_->setRect(x, y, width, height);
+  const QPointF scene_pos = mapToScene(event->pos());
+  const bool snap = event->modifiers().testFlag(Qt::ControlModifier);
+  RoiEditor* editor = is_selecting_ ? &band_ : &roi_;
+  queue_shape(editor, editor->Dragged(scene_pos, snap));
 }
 
-// 鼠标释放：结束绘制（保留矩形图元）
+// 鼠标释放：提交最终几何（不等下一帧）
 void CustomGraphicsView::mouseReleaseEvent(QMouseEvent* event) {
   if (event->button() != Qt::LeftButton || !is_drawing_) {
     QGraphicsView::mouseReleaseEvent(event);
@@ -65,13 +213,29 @@ void CustomGraphicsView::mouseReleaseEvent(QMouseEvent* event) {
   }
 
   is_drawing_ = false;
+  frame_timer_->stop();
+  pending_editor_ = nullptr;
+  const QPointF scene_pos = mapToScene(event->pos());
+  // 几乎没有移动：当作单击（选择结果元素），保留原来的ROI
+  if ((event->pos() - press_view_pos_).manhattanLength() < QApplication::startDragDistance()) {
+    apply_shape(&roi_, roi_before_press_, roi_visible_before_press_);
+    input_clock_.invalidate();
+    emit Clicked(scene_pos, event->modifiers());
+    return;
+  }
+  const bool snap = event->modifiers().testFlag(Qt::ControlModifier);
+  if (is_selecting_) {
+    const QRectF rect = band_.Dragged(scene_pos, snap).BoundingRect();
+    apply_shape(&band_, RoiShape(), false);
+    input_clock_.invalidate();
+    emit SelectionRectDrawn(rect);
+    return;
+  }
   // 新增：计算并保存最后一次绘制的矩形坐标（场景坐标）
-  QPointF current_scene_pos = mapToScene(event->pos());
-  qreal x = qMin(start_scene_pos_.x(), current_scene_pos.x());
-  qreal y = qMin(start_scene_pos_.y(), current_scene_pos.y());
-  qreal width = qAbs(current_scene_pos.x() - start_scene_pos_.x());
-  qreal height = qAbs(current_scene_pos.y() - start_scene_pos_.y());
-  last_draw_rect_ = QRectF(x, y, width, height); // 保存矩形
-
-  drawing_rect_ = nullptr;
-}
\ No newline at end of file
+  const RoiShape shape = roi_.Dragged(scene_pos, snap);
+  if (!input_clock_.isValid()) input_clock_.start();
+  apply_shape(&roi_, shape, true);
+  last_draw_rect_ = roi_.IsVisible() ? shape.BoundingRect() : QRectF(); // 保存矩形
+  update_cursor(scene_pos);
+  emit RoiChanged(last_draw_rect_);
+}
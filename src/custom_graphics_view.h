@@ -4,9 +4,15 @@
 #include <QPointF>
 #include <QMouseEvent>
 #include <QRectF> // 新增：用于保存矩形坐标
+#include <QMap>
+#include <QElapsedTimer>
+#include "roi_editor.h"
+
+class QTimer;
 
 class QGraphicsRectItem;
 class QGraphicsPixmapItem;
+class QGraphicsItem;
 
 class CustomGraphicsView : public QGraphicsView {
   Q_OBJECT
@@ -14,23 +20,84 @@ class CustomGraphicsView : public QGraphicsView {
 public:
   explicit CustomGraphicsView(QWidget* parent = nullptr);
   void SetPixmapItem(QGraphicsPixmapItem* pixmap_item);
+  // 任意图像图元（如分块大图），ROI绘制只要求已有图像
+  void SetImageItem(QGraphicsItem* image_item);
 
-  // 新增：获取最后一次绘制的矩形坐标（场景坐标）
+  // 新增：获取最后一次绘制的矩形坐标（场景坐标）；ROI旋转时为其外接矩形
   QRectF GetLastDrawRect() const { return last_draw_rect_; }
+  // 当前ROI的完整几何（含旋转角）
+  RoiShape GetRoi() const { return roi_.Shape(); }
   // 新增：判断是否绘制了有效矩形
   bool HasValidRect() const { return !last_draw_rect_.isEmpty() && last_draw_rect_.width() > 0 && last_draw_rect_.height() > 0; }
+  // 清除当前ROI
+  void ClearRoi();
+
+  // ROI编辑的输入到绘制延迟（鼠标事件到该几何第一次绘制），每次按下时重置
+  struct EditLatency {
+    int frames = 0;
+    double last_ms = 0.0;
+    double max_ms = 0.0;
+    double total_ms = 0.0;
+    double frame_ms = 0.0;  // 显示刷新间隔
+    double MeanMs() const { return frames ? total_ms / frames : 0.0; }
+  };
+  const EditLatency& LastEditLatency() const { return latency_; }
+
+  // 多ROI：把矩形保存为编号ROI（橙色框+编号），返回ROI编号
+  int AddRoi(const QRectF& rect);
+  void RemoveRoi(int id);
+  void ClearRois();
+  // 所有已保存的ROI（编号 -> 场景坐标矩形）
+  QMap<int, QRectF> Rois() const;
+
+signals:
+  // ROI绘制完成（场景坐标）
+  void RoiChanged(const QRectF& rect);
+  void RoisChanged();
+  // 鼠标悬停（场景坐标，未按键时持续发出）
+  void HoverMoved(const QPointF& scene_pos);
+  // 左键单击（按下与释放位置几乎相同），不改变当前ROI
+  void Clicked(const QPointF& scene_pos, Qt::KeyboardModifiers modifiers);
+  // Shift+拖动画出的选择框（场景坐标），不改变当前ROI
+  void SelectionRectDrawn(const QRectF& rect);
 
 protected:
   void mousePressEvent(QMouseEvent* event) override;
   void mouseMoveEvent(QMouseEvent* event) override;
   void mouseReleaseEvent(QMouseEvent* event) override;
+  // ROI与框选框画在前景层，不进入场景索引
+  void drawForeground(QPainter* painter, const QRectF& rect) override;
 
 private:
+  qreal view_scale() const;
+  void update_cursor(const QPointF& scene_pos);
+  // 拖动中的几何先暂存，按显示刷新节拍合并后只重绘变化区域
+  void queue_shape(RoiEditor* editor, const RoiShape& shape);
+  void flush_pending();
+  void apply_shape(RoiEditor* editor, const RoiShape& shape, bool visible);
+
   bool is_drawing_ = false;
-  QPointF start_scene_pos_;
-  QGraphicsRectItem* drawing_rect_;
-  QGraphicsPixmapItem* pixmap_item_;
+  bool is_selecting_ = false;       // Shift+拖动：框选而不是绘制ROI
+  QPoint press_view_pos_;           // 用于区分单击与拖动
+  QGraphicsItem* image_item_;
+
+  RoiEditor roi_;                   // 当前ROI（红色，可移动/缩放/旋转）
+  RoiEditor band_;                  // 框选框（蓝色虚线）
+  RoiShape roi_before_press_;       // 单击时恢复
+  bool roi_visible_before_press_ = false;
+
+  RoiEditor* pending_editor_ = nullptr;
+  RoiShape pending_shape_;
+  QTimer* frame_timer_ = nullptr;
+  int frame_interval_ms_ = 16;
+  QElapsedTimer frame_clock_;       // 上次重绘请求
+  QElapsedTimer input_clock_;       // 最早一个尚未绘制的输入
+  EditLatency latency_;
 
   // 新增：保存最后一次绘制的矩形坐标
   QRectF last_draw_rect_;
+
+  // 已保存的ROI图元（编号 -> 矩形图元）
+  QMap<int, QGraphicsRectItem*> rois_;
+  int next_roi_id_ = 1;
 };
\ No newline at end of file
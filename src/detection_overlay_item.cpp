@@ -0,0 +1,237 @@
+﻿#include "detection_overlay_item.h"
+#include "tools/detection_result.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+
+namespace {
+// 点的显示直径（场景坐标，与旧的 6x6 椭圆图元一致）
+const qreal kPointSize = 6.0;
+// 高亮/选中的线宽，点画成外圈
+const qreal kMarkWidth = 3.0;
+const qreal kMarkRadius = kPointSize;
+
+const std::vector<cv::Vec4i> kNoLines;
+const std::vector<cv::Point2f> kNoPoints;
+const std::vector<cv::Vec3f> kNoCircles;
+}
+
+DetectionOverlayItem::DetectionOverlayItem(QGraphicsItem* parent)
+  : QGraphicsItem(parent),
+    line_pen_(Qt::green, 2),
+    point_pen_(Qt::red, kPointSize, Qt::SolidLine, Qt::RoundCap),
+    circle_pen_(Qt::yellow),
+    highlight_pen_(Qt::cyan, kMarkWidth),
+    selection_pen_(Qt::magenta, kMarkWidth) {
+  // 需要 exposedRect 做裁剪
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+}
+
+void DetectionOverlayItem::SetResult(const tools::DetectionResult& result) {
+  assign(&result.lines, &result.points, &result.circles);
+}
+
+void DetectionOverlayItem::SetLines(const std::vector<cv::Vec4i>& lines) {
+  assign(&lines, nullptr, nullptr);
+}
+
+void DetectionOverlayItem::SetPoints(const std::vector<cv::Point2f>& points) {
+  assign(nullptr, &points, nullptr);
+}
+
+void DetectionOverlayItem::SetCircles(const std::vector<cv::Vec3f>& circles) {
+  assign(nullptr, nullptr, &circles);
+}
+
+// 复制到连续数组（QVector 保留容量，重复设置时不会重新分配）
+void DetectionOverlayItem::assign(const std::vector<cv::Vec4i>* lines,
+                                  const std::vector<cv::Point2f>* points,
+                                  const std::vector<cv::Vec3f>* circles) {
+  prepareGeometryChange();
+  lines_.resize(0);
+  points_.resize(0);
+  circles_.resize(0);
+  ++revision_;
+  highlight_ = tools::ResultIndex::Element();
+  selection_.clear();
+  index_.build(lines ? *lines : kNoLines, points ? *points : kNoPoints, circles ? *circles : kNoCircles);
+  if (lines) {
+    lines_.reserve(static_cast<int>(lines->size()));
+    for (const auto& l : *lines) lines_.append(QLine(l[0], l[1], l[2], l[3]));
+  }
+  if (points) {
+    points_.reserve(static_cast<int>(points->size()));
+    for (const auto& p : *points) points_.append(QPointF(p.x, p.y));
+  }
+  if (circles) {
+    circles_.reserve(static_cast<int>(circles->size()));
+    for (const auto& c : *circles) circles_.append(QRectF(c[0] - c[2], c[1] - c[2], c[2] * 2, c[2] * 2));
+  }
+  update_bounds();
+}
+
+void DetectionOverlayItem::Clear() {
+  prepareGeometryChange();
+  lines_.resize(0);
+  points_.resize(0);
+  circles_.resize(0);
+  bounds_ = QRectF();
+  ++revision_;
+  index_.clear();
+  highlight_ = tools::ResultIndex::Element();
+  selection_.clear();
+}
+
+bool DetectionOverlayItem::HitTest(const QPointF& scene_pos, qreal radius, tools::ResultIndex::Hit* hit) const {
+  if (index_.empty()) return false;
+  const QPointF p = mapFromScene(scene_pos);
+  tools::ResultIndex::Hit found;
+  if (!index_.nearest(cv::Point2f(static_cast<float>(p.x()), static_cast<float>(p.y())), radius, found)) return false;
+  if (hit) *hit = found;
+  return true;
+}
+
+std::vector<tools::ResultIndex::Element> DetectionOverlayItem::ElementsIn(const QRectF& scene_rect) const {
+  if (index_.empty()) return {};
+  const QRectF r = mapRectFromScene(scene_rect).normalized();
+  return index_.query(cv::Rect2f(static_cast<float>(r.x()), static_cast<float>(r.y()),
+                                 static_cast<float>(r.width()), static_cast<float>(r.height())));
+}
+
+// 只重绘新旧元素所在区域
+void DetectionOverlayItem::SetHighlight(const tools::ResultIndex::Element& element) {
+  if (element == highlight_) return;
+  if (highlight_.valid()) update(element_rect(highlight_));
+  highlight_ = element;
+  if (highlight_.valid()) update(element_rect(highlight_));
+}
+
+void DetectionOverlayItem::SetSelection(const std::vector<tools::ResultIndex::Element>& elements) {
+  for (const auto& e : selection_) update(element_rect(e));
+  selection_ = elements;
+  for (const auto& e : selection_) update(element_rect(e));
+}
+
+QRectF DetectionOverlayItem::element_rect(const tools::ResultIndex::Element& element) const {
+  const qreal m = kMarkRadius + kMarkWidth;
+  switch (element.type) {
+  case tools::ResultIndex::Type::Line: {
+    const cv::Vec4f& l = index_.line(element.index);
+    return QRectF(QPointF(l[0], l[1]), QPointF(l[2], l[3])).normalized().adjusted(-m, -m, m, m);
+  }
+  case tools::ResultIndex::Type::Point: {
+    const cv::Point2f& p = index_.point(element.index);
+    return QRectF(p.x - m, p.y - m, 2 * m, 2 * m);
+  }
+  case tools::ResultIndex::Type::Circle: {
+    const cv::Vec3f& c = index_.circle(element.index);
+    return QRectF(c[0] - c[2], c[1] - c[2], c[2] * 2, c[2] * 2).adjusted(-m, -m, m, m);
+  }
+  }
+  return QRectF();
+}
+
+void DetectionOverlayItem::draw_element(QPainter* painter, const tools::ResultIndex::Element& element) const {
+  switch (element.type) {
+  case tools::ResultIndex::Type::Line: {
+    const cv::Vec4f& l = index_.line(element.index);
+    painter->drawLine(QPointF(l[0], l[1]), QPointF(l[2], l[3]));
+    break;
+  }
+  case tools::ResultIndex::Type::Point: {
+    const cv::Point2f& p = index_.point(element.index);
+    painter->drawEllipse(QPointF(p.x, p.y), kMarkRadius, kMarkRadius);
+    break;
+  }
+  case tools::ResultIndex::Type::Circle: {
+    const cv::Vec3f& c = index_.circle(element.index);
+    painter->drawEllipse(QPointF(c[0], c[1]), c[2], c[2]);
+    break;
+  }
+  }
+}
+
+// 一次性计算所有元素的外接矩形（包含画笔宽度）
+void DetectionOverlayItem::update_bounds() {
+  if (lines_.isEmpty() && points_.isEmpty() && circles_.isEmpty()) {
+    bounds_ = QRectF();
+    update();
+    return;
+  }
+  qreal min_x = 1e300, min_y = 1e300, max_x = -1e300, max_y = -1e300;
+  auto grow = [&](qreal x, qreal y) {
+    min_x = std::min(min_x, x); min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x); max_y = std::max(max_y, y);
+  };
+  for (const auto& l : lines_) { grow(l.x1(), l.y1()); grow(l.x2(), l.y2()); }
+  for (const auto& p : points_) grow(p.x(), p.y());
+  for (const auto& r : circles_) { grow(r.left(), r.top()); grow(r.right(), r.bottom()); }
+  // 点的高亮外圈比点本身大
+  const qreal margin = std::max({ line_pen_.widthF(), point_pen_.widthF(), circle_pen_.widthF(), kMarkRadius + kMarkWidth });
+  bounds_ = QRectF(QPointF(min_x, min_y), QPointF(max_x, max_y)).adjusted(-margin, -margin, margin, margin);
+  update();
+}
+
+QRectF DetectionOverlayItem::boundingRect() const {
+  return bounds_;
+}
+
+void DetectionOverlayItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+  Q_UNUSED(widget);
+  const QRectF exposed = option ? option->exposedRect : bounds_;
+
+  // 直线：按线段外接矩形裁剪，然后一次 drawLines
+  if (!lines_.isEmpty()) {
+    const qreal m = line_pen_.widthF();
+    const QRectF clip = exposed.adjusted(-m, -m, m, m);
+    visible_lines_.resize(0);
+    for (const auto& l : lines_) {
+      const QRectF lb = QRectF(QPointF(l.x1(), l.y1()), QPointF(l.x2(), l.y2())).normalized();
+      // 水平/竖直线的外接矩形宽或高为0，intersects 会返回 false，这里手动比较
+      if (lb.right() >= clip.left() && lb.left() <= clip.right() &&
+          lb.bottom() >= clip.top() && lb.top() <= clip.bottom()) {
+        visible_lines_.append(l);
+      }
+    }
+    if (!visible_lines_.isEmpty()) {
+      painter->setPen(line_pen_);
+      painter->drawLines(visible_lines_);
+    }
+  }
+
+  // 点：圆头宽画笔，一次 drawPoints
+  if (!points_.isEmpty()) {
+    const qreal m = kPointSize;
+    const QRectF clip = exposed.adjusted(-m, -m, m, m);
+    visible_points_.resize(0);
+    for (const auto& p : points_) {
+      if (clip.contains(p)) visible_points_.append(p);
+    }
+    if (!visible_points_.isEmpty()) {
+      painter->setPen(point_pen_);
+      painter->drawPoints(visible_points_.constData(), visible_points_.size());
+    }
+  }
+
+  // 圆：椭圆没有批量接口，只绘制与暴露区域相交的部分
+  if (!circles_.isEmpty()) {
+    painter->setPen(circle_pen_);
+    painter->setBrush(Qt::NoBrush);
+    const qreal m = circle_pen_.widthF();
+    const QRectF clip = exposed.adjusted(-m, -m, m, m);
+    for (const auto& r : circles_) {
+      if (clip.intersects(r)) painter->drawEllipse(r);
+    }
+  }
+
+  // 选中与悬停元素画在最上层
+  if (!selection_.empty() || highlight_.valid()) {
+    painter->setBrush(Qt::NoBrush);
+    painter->setPen(selection_pen_);
+    for (const auto& e : selection_) draw_element(painter, e);
+    if (highlight_.valid()) {
+      painter->setPen(highlight_pen_);
+      draw_element(painter, highlight_);
+    }
+  }
+}
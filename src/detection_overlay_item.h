@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <QGraphicsItem>
+#include <QLine>
+#include <QPen>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include <opencv2/core.hpp>
+#include <vector>
+#include "tools/result_index.h"
+
+// 一组检测结果对应一个图元：几何数据存放在连续数组中，
+// 绘制时按暴露区域裁剪，并以一次 drawLines/drawPoints 批量绘制。
+// 设置结果时同时建立网格索引，悬停/点选/框选直接查询索引，不经过场景的逐图元查找
+class DetectionOverlayItem : public QGraphicsItem {
+public:
+  explicit DetectionOverlayItem(QGraphicsItem* parent = nullptr);
+
+  // 设置整组结果（替换已有数据）
+  void SetResult(const tools::DetectionResult& result);
+  void SetLines(const std::vector<cv::Vec4i>& lines);
+  void SetPoints(const std::vector<cv::Point2f>& points);
+  void SetCircles(const std::vector<cv::Vec3f>& circles);
+  void Clear();
+  // 当前保存的几何元素总数
+  int Count() const { return lines_.size() + points_.size() + circles_.size(); }
+  // 内容版本号：每次设置或清除结果时递增，用于判断外部保存的元素编号是否过期
+  quint64 Revision() const { return revision_; }
+
+  // 命中测试（场景坐标）：radius 内距离最近的元素
+  bool HitTest(const QPointF& scene_pos, qreal radius, tools::ResultIndex::Hit* hit) const;
+  // 与矩形（场景坐标）相交的所有元素
+  std::vector<tools::ResultIndex::Element> ElementsIn(const QRectF& scene_rect) const;
+  // 悬停高亮与选中显示（无效元素 / 空列表表示清除）
+  void SetHighlight(const tools::ResultIndex::Element& element);
+  void SetSelection(const std::vector<tools::ResultIndex::Element>& elements);
+  // 元素几何（测量用）
+  const tools::ResultIndex& Index() const { return index_; }
+
+  QRectF boundingRect() const override;
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+  void assign(const std::vector<cv::Vec4i>* lines,
+              const std::vector<cv::Point2f>* points,
+              const std::vector<cv::Vec3f>* circles);
+  void update_bounds();
+  QRectF element_rect(const tools::ResultIndex::Element& element) const;
+  void draw_element(QPainter* painter, const tools::ResultIndex::Element& element) const;
+
+  QVector<QLine> lines_;
+  QVector<QPointF> points_;
+  QVector<QRectF> circles_; // 圆的外接矩形，裁剪与绘制共用
+  QRectF bounds_;
+  tools::ResultIndex index_;
+  quint64 revision_ = 0;
+  tools::ResultIndex::Element highlight_;
+  std::vector<tools::ResultIndex::Element> selection_;
+
+  QPen line_pen_;
+  QPen point_pen_;
+  QPen circle_pen_;
+  QPen highlight_pen_;
+  QPen selection_pen_;
+
+  // 绘制时的裁剪结果缓冲，重复使用避免每帧分配
+  QVector<QLine> visible_lines_;
+  QVector<QPointF> visible_points_;
+};
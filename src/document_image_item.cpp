@@ -0,0 +1,41 @@
+﻿#include "document_image_item.h"
+#include "tools/image_document.h"
+#include "tools/trace.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+namespace {
+// cv::Mat 包装为只读 QImage（不拷贝），与文档同生命周期
+QImage wrap_pixels(const cv::Mat& m) {
+  const QImage::Format fmt = m.channels() == 1 ? QImage::Format_Grayscale8 : QImage::Format_BGR888;
+  return QImage(static_cast<const uchar*>(m.data), m.cols, m.rows, static_cast<int>(m.step), fmt);
+}
+}
+
+DocumentImageItem::DocumentImageItem(std::shared_ptr<const tools::ImageDocument> doc, QGraphicsItem* parent)
+  : QGraphicsItem(parent) {
+  // 需要 exposedRect 只绘制可见部分
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+  SetDocument(std::move(doc));
+}
+
+void DocumentImageItem::SetDocument(std::shared_ptr<const tools::ImageDocument> doc) {
+  QImage image = doc ? wrap_pixels(doc->pixels()) : QImage();
+  if (image.size() != image_.size()) prepareGeometryChange();
+  // 先换 QImage 再释放旧文档：QImage 引用的像素属于文档
+  image_ = std::move(image);
+  doc_ = std::move(doc);
+  update();
+}
+
+QRectF DocumentImageItem::boundingRect() const {
+  return QRectF(QPointF(0, 0), image_.size());
+}
+
+void DocumentImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+  Q_UNUSED(widget);
+  const QRectF exposed = option->exposedRect & boundingRect();
+  if (exposed.isEmpty()) return;
+  TRACE_SCOPE("DocumentImageItem::paint");
+  painter->drawImage(exposed, image_, exposed);
+}
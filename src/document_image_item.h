@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <QGraphicsItem>
+#include <QImage>
+#include <QRectF>
+#include <memory>
+
+namespace tools {
+  class ImageDocument;
+}
+
+// 文档图像图元：直接绘制 ImageDocument 的像素（QImage 包装 cv::Mat，不拷贝），
+// 只绘制可见区域。图元持有文档，显示期间像素一直有效（共享内存帧保持其槽位）
+class DocumentImageItem : public QGraphicsItem {
+public:
+  explicit DocumentImageItem(std::shared_ptr<const tools::ImageDocument> doc, QGraphicsItem* parent = nullptr);
+
+  // 换图（如视频的下一帧），尺寸变化时更新边界
+  void SetDocument(std::shared_ptr<const tools::ImageDocument> doc);
+  const std::shared_ptr<const tools::ImageDocument>& Document() const { return doc_; }
+
+  QRectF boundingRect() const override;
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+  std::shared_ptr<const tools::ImageDocument> doc_;
+  QImage image_;  // 包装 doc_ 的像素
+};
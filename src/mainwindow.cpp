@@ -2,16 +2,18 @@
 
 #include "mainwindow.h"
 #include "custom_graphics_view.h"
+#include "detection_overlay_item.h"
+#include "document_image_item.h"
+#include "overlay_layer_manager.h"
+#include "tiled_image_item.h"
 // Qt 头文件
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QFileDialog>
 #include <QGraphicsRectItem>
-#include <QGraphicsPixmapItem>
 #include <QMenuBar>
 #include <QPainter>
 #include <QPen>
-#include <QPixmap>
 #include <QTextCodec>
 #include <QSplitter>
 #include <QVBoxLayout>
@@ -26,30 +28,61 @@
 #include <QGraphicsLineItem>
 #include <QTabWidget>
 #include <QStackedWidget>
+#include <QFile>
+#include <QProgressBar>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QTimer>
+#include <QListWidget>
+#include <QFontDatabase>
+#include <QStatusBar>
+#include <QStandardPaths>
+#include <QInputDialog>
+#include <QSharedMemory>
 // tools
+#include "tools/image_document.h"
 #include "tools/line_tool.h"
 #include "tools/point_tool.h"
+#include "tools/result_cache.h"
 #include "tools/circle_tool.h"
+#include "tools/frame_ring.h"
+#include "tools/stage_cache.h"
+#include "tools/stream_pipeline.h"
+#include "tools/thread_pool.h"
+#include "tools/tile_store.h"
+#include "tools/tool_executor.h"
+#include "tools/tool_spec.h"
 // 新增：OpenCV 头文件
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
-MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
+#include <cmath>
+
+MainWindow::MainWindow(QWidget* parent)
+  : QMainWindow(parent), executor_(std::make_unique<tools::ToolExecutor>(tools::ThreadPool::global(), &tools::StageCache::global(),
+                                                                    &tools::ResultCache::global())) {
   init_ui();
 }
 
+// 实时预览：参数停止变化后的防抖间隔，以及单次运行的延迟目标
+static const int kPreviewDebounceMs = 30;
+static const double kPreviewLatencyTargetMs = 50.0;
+// 超大图上单次运行读取的ROI上限（像素）
+static const double kMaxTiledRoiPixels = 256e6;
+// 悬停/单击的命中半径（屏幕像素）
+static const qreal kPickRadiusPx = 6.0;
+
 void MainWindow::draw_points_to_scene(const std::vector<cv::Point2f>& points) {
   if (points.empty()) {
     QMessageBox::information(this, tr(u8"提示"), tr(u8"未检测到点！"));
     return;
   }
-  QPen ppen(Qt::red);
-  for (const auto& pt : points) {
-    QGraphicsEllipseItem* it = new QGraphicsEllipseItem(pt.x-3, pt.y-3, 6, 6);
-    it->setPen(ppen);
-    it->setBrush(QBrush(Qt::red));
-    scene_->addItem(it);
+  {
+    TRACE_SCOPE("draw_points_to_scene");
+    // 整组点只用一个图元
+    DetectionOverlayItem* overlay = overlays_->NewRunLayer();
+    overlay->SetPoints(points);
   }
   QMessageBox::information(this, tr(u8"完成"), tr(u8"共检测到 %1 个点！").arg(points.size()));
 }
@@ -59,32 +92,107 @@ void MainWindow::draw_circles_to_scene(const std::vector<cv::Vec3f>& circles) {
     QMessageBox::information(this, tr(u8"提示"), tr(u8"未检测到圆！"));
     return;
   }
-  QPen cpen(Qt::yellow);
-  for (const auto& c : circles) {
-    float x = c[0], y = c[1], r = c[2];
-    QGraphicsEllipseItem* it = new QGraphicsEllipseItem(x-r, y-r, r*2, r*2);
-    it->setPen(cpen);
-    it->setBrush(Qt::NoBrush);
-    scene_->addItem(it);
+  {
+    TRACE_SCOPE("draw_circles_to_scene");
+    // 整组圆只用一个图元
+    DetectionOverlayItem* overlay = overlays_->NewRunLayer();
+    overlay->SetCircles(circles);
   }
   QMessageBox::information(this, tr(u8"完成"), tr(u8"共检测到 %1 个圆！").arg(circles.size()));
 }
 
-MainWindow::~MainWindow() = default;
+// 卡尺找线：拟合直线与各卡尺的边缘点画在同一图层，提示亚像素结果与拟合质量
+void MainWindow::draw_caliper_result(const tools::DetectionResult& result) {
+  if (result.subpixel_lines.empty()) {
+    QMessageBox::information(this, tr(u8"提示"), tr(u8"未检测到直线（找到 %1 个边缘点）！").arg(result.points.size()));
+    return;
+  }
+  {
+    TRACE_SCOPE("draw_caliper_result");
+    overlays_->NewRunLayer()->SetResult(result);
+  }
+  const cv::Vec4f& l = result.subpixel_lines.front();
+  const tools::ShapeFit& fit = result.line_fits.front();
+  const double angle = std::atan2(l[3] - l[1], l[2] - l[0]) * 180.0 / CV_PI;
+  QMessageBox::information(this, tr(u8"完成"),
+    tr(u8"直线 (%1, %2) - (%3, %4)\n角度 %5°，内点 %6/%7，残差RMS %8 px")
+      .arg(l[0], 0, 'f', 3).arg(l[1], 0, 'f', 3).arg(l[2], 0, 'f', 3).arg(l[3], 0, 'f', 3)
+      .arg(angle, 0, 'f', 3).arg(fit.inliers).arg(fit.samples).arg(fit.rms, 0, 'f', 3));
+}
+
+// 拟合找圆：圆与各射线的边缘点画在同一图层，提示亚像素圆心/半径与残差
+void MainWindow::draw_circle_fit_result(const tools::DetectionResult& result) {
+  if (result.circles.empty()) {
+    QMessageBox::information(this, tr(u8"提示"), tr(u8"未检测到圆（找到 %1 个边缘点）！").arg(result.points.size()));
+    return;
+  }
+  {
+    TRACE_SCOPE("draw_circle_fit_result");
+    overlays_->NewRunLayer()->SetResult(result);
+  }
+  const cv::Vec3f& c = result.circles.front();
+  const tools::ShapeFit& fit = result.circle_fits.front();
+  QMessageBox::information(this, tr(u8"完成"),
+    tr(u8"圆心 (%1, %2)，半径 %3\n内点 %4/%5，残差RMS %6 px")
+      .arg(c[0], 0, 'f', 3).arg(c[1], 0, 'f', 3).arg(c[2], 0, 'f', 3)
+      .arg(fit.inliers).arg(fit.samples).arg(fit.rms, 0, 'f', 3));
+}
+
+// executor_ 析构时取消并等待仍在运行的工具；stream_ 析构时停止流水线线程
+MainWindow::~MainWindow() {
+  // 正在生成的金字塔引用了本窗口，等它结束
+  if (pyramid_build_.valid()) pyramid_build_.wait();
+}
 
 void MainWindow::init_ui() {
   // 1. 菜单栏
   QMenu* file_menu = menuBar()->addMenu(tr(u8"文件"));
   QAction* open_action = file_menu->addAction(tr(u8"打开图片"));
   connect(open_action, &QAction::triggered, this, &MainWindow::open_image_file);
+  QAction* open_video_action = file_menu->addAction(tr(u8"打开视频"));
+  connect(open_video_action, &QAction::triggered, this, &MainWindow::open_video_file);
+  QAction* open_sequence_action = file_menu->addAction(tr(u8"打开图像序列"));
+  connect(open_sequence_action, &QAction::triggered, this, &MainWindow::open_image_sequence);
+  QAction* open_shared_action = file_menu->addAction(tr(u8"打开共享内存帧"));
+  connect(open_shared_action, &QAction::triggered, this, &MainWindow::open_shared_frames);
+  QAction* open_pyramid_action = file_menu->addAction(tr(u8"打开大图（金字塔目录）"));
+  connect(open_pyramid_action, &QAction::triggered, this, &MainWindow::open_pyramid);
+  QAction* build_pyramid_action = file_menu->addAction(tr(u8"生成图像金字塔"));
+  connect(build_pyramid_action, &QAction::triggered, this, &MainWindow::build_pyramid);
+  stop_stream_action_ = file_menu->addAction(tr(u8"停止播放"));
+  stop_stream_action_->setEnabled(false);
+  connect(stop_stream_action_, &QAction::triggered, this, &MainWindow::stop_stream);
+  // 流模式渲染节拍（约60Hz），每次只显示最新的检测结果
+  stream_timer_ = new QTimer(this);
+  stream_timer_->setInterval(16);
+  connect(stream_timer_, &QTimer::timeout, this, &MainWindow::on_stream_tick);
 
   // 2. 创建场景
   scene_ = new QGraphicsScene(this);
   scene_->setSceneRect(0, 0, 800, 600);
+  // 结果图层管理（按运行保存，超出历史深度自动淘汰）
+  overlays_ = std::make_unique<OverlayLayerManager>(scene_);
 
   // 3. 创建自定义视图
   view_ = new CustomGraphicsView(this);
   view_->setScene(scene_);
+  // ROI变化也触发实时预览
+  connect(view_, &CustomGraphicsView::RoiChanged, this, &MainWindow::on_tool_param_changed);
+  connect(view_, &CustomGraphicsView::RoisChanged, this, &MainWindow::refresh_roi_list);
+  // ROI编辑结束：显示几何与输入到绘制的延迟（目标是一帧以内）
+  connect(view_, &CustomGraphicsView::RoiChanged, this, [this]() {
+    const CustomGraphicsView::EditLatency& latency = view_->LastEditLatency();
+    if (latency.frames == 0 || !view_->HasValidRect()) return;
+    const RoiShape roi = view_->GetRoi();
+    statusBar()->showMessage(tr(u8"ROI %1 x %2  角度 %3°  |  编辑延迟 平均 %4 ms，最大 %5 ms（帧间隔 %6 ms，%7 帧）")
+      .arg(roi.size.width(), 0, 'f', 1).arg(roi.size.height(), 0, 'f', 1).arg(roi.angle, 0, 'f', 1)
+      .arg(latency.MeanMs(), 0, 'f', 2).arg(latency.max_ms, 0, 'f', 2).arg(latency.frame_ms, 0, 'f', 1)
+      .arg(latency.frames));
+  });
+  // 结果元素的悬停、选择与测量（查询各图层的网格索引）
+  connect(view_, &CustomGraphicsView::HoverMoved, this, &MainWindow::on_view_hover);
+  connect(view_, &CustomGraphicsView::Clicked, this, &MainWindow::on_view_clicked);
+  connect(view_, &CustomGraphicsView::SelectionRectDrawn, this, &MainWindow::on_selection_rect);
 
   // 左右分栏布局
   QSplitter* main_splitter = new QSplitter(Qt::Horizontal, this);
@@ -194,6 +302,18 @@ QWidget* MainWindow::create_tool_panel() {
   find_circle_btn->setMinimumHeight(40);
   connect(find_circle_btn, &QPushButton::clicked, this, &MainWindow::on_circle_tool_clicked);
   list_layout->addWidget(find_circle_btn);
+
+  // 卡尺找线按钮：已知边缘大致位置与方向时的快速亚像素找线
+  QPushButton* caliper_btn = new QPushButton(tr(u8"卡尺找线"), element_list_page);
+  caliper_btn->setMinimumHeight(40);
+  connect(caliper_btn, &QPushButton::clicked, this, &MainWindow::on_caliper_tool_clicked);
+  list_layout->addWidget(caliper_btn);
+
+  // 拟合找圆按钮：已知名义圆心与半径时，沿径向找边缘点再拟合圆
+  QPushButton* circle_fit_btn = new QPushButton(tr(u8"拟合找圆"), element_list_page);
+  circle_fit_btn->setMinimumHeight(40);
+  connect(circle_fit_btn, &QPushButton::clicked, this, &MainWindow::on_circle_fit_tool_clicked);
+  list_layout->addWidget(circle_fit_btn);
   list_layout->addStretch();
 
   // ========== 新增：找线参数配置页（栈内页面） ==========
@@ -259,6 +379,24 @@ QWidget* MainWindow::create_tool_panel() {
   max_gap_layout->addWidget(max_line_gap_spin_);
   line_param_layout->addLayout(max_gap_layout);
 
+  // 6. 分块并行：大ROI切成重叠的块在线程池上检测，再合并接缝处的线段
+  line_tiled_check_ = new QCheckBox(tr(u8"分块并行检测（大ROI）"));
+  line_param_layout->addWidget(line_tiled_check_);
+
+  // 7. 金字塔：在缩小的图上检测候选，再在原分辨率下逐个细化（大ROI）
+  QHBoxLayout* line_pyramid_layout = new QHBoxLayout();
+  line_pyramid_layout->addWidget(new QLabel(tr(u8"金字塔层数:")));
+  line_pyramid_spin_ = new QSpinBox();
+  line_pyramid_spin_->setRange(0, 4);
+  line_pyramid_spin_->setValue(0);
+  line_pyramid_spin_->setSpecialValueText(tr(u8"关闭"));
+  line_pyramid_layout->addWidget(line_pyramid_spin_);
+  line_param_layout->addLayout(line_pyramid_layout);
+
+  // 8. 单遍前端：灰度+模糊+梯度一次流式完成，不生成中间整图（彩色图/大ROI更快）
+  line_fused_check_ = new QCheckBox(tr(u8"单遍边缘前端"));
+  line_param_layout->addWidget(line_fused_check_);
+
   // 为每个工具准备独立的参数区域（Line uses existing controls above）
   // Point tool params
   QWidget* point_param_widget = new QWidget(param_panel);
@@ -267,7 +405,7 @@ QWidget* MainWindow::create_tool_panel() {
   QHBoxLayout* maxcorners_layout = new QHBoxLayout();
   maxcorners_layout->addWidget(new QLabel(tr(u8"最大角点数:")));
   point_max_corners_spin_ = new QSpinBox();
-  point_max_corners_spin_->setRange(1, 5000);
+  point_max_corners_spin_->setRange(1, 1000000);
   point_max_corners_spin_->setValue(500);
   maxcorners_layout->addWidget(point_max_corners_spin_);
   point_param_layout->addLayout(maxcorners_layout);
@@ -288,6 +426,28 @@ QWidget* MainWindow::create_tool_panel() {
   point_min_distance_spin_->setValue(10.0);
   mindist_layout->addWidget(point_min_distance_spin_);
   point_param_layout->addLayout(mindist_layout);
+  // 网格引擎：响应只算一次，网格内抑制；可限制每格点数使分布均匀，可亚像素细化
+  point_grid_check_ = new QCheckBox(tr(u8"网格引擎（大量角点）"));
+  point_param_layout->addWidget(point_grid_check_);
+  QHBoxLayout* cell_layout = new QHBoxLayout();
+  cell_layout->addWidget(new QLabel(tr(u8"网格大小:")));
+  point_cell_size_spin_ = new QSpinBox();
+  point_cell_size_spin_->setRange(4, 1024);
+  point_cell_size_spin_->setValue(32);
+  cell_layout->addWidget(point_cell_size_spin_);
+  cell_layout->addWidget(new QLabel(tr(u8"每格上限:")));
+  point_per_cell_spin_ = new QSpinBox();
+  point_per_cell_spin_->setRange(0, 10000);
+  point_per_cell_spin_->setValue(0);
+  point_per_cell_spin_->setSpecialValueText(tr(u8"不限"));
+  cell_layout->addWidget(point_per_cell_spin_);
+  point_param_layout->addLayout(cell_layout);
+  point_subpix_check_ = new QCheckBox(tr(u8"亚像素细化"));
+  point_param_layout->addWidget(point_subpix_check_);
+  for (QWidget* w : std::initializer_list<QWidget*>{ point_cell_size_spin_, point_per_cell_spin_, point_subpix_check_ }) {
+    w->setEnabled(false);
+    connect(point_grid_check_, &QCheckBox::toggled, w, &QWidget::setEnabled);
+  }
 
   // Circle tool params
   QWidget* circle_param_widget = new QWidget(param_panel);
@@ -341,6 +501,92 @@ QWidget* MainWindow::create_tool_panel() {
   radius2_layout->addWidget(circle_max_radius_spin_);
   circle_param_layout->addLayout(radius2_layout);
 
+  QHBoxLayout* circle_pyramid_layout = new QHBoxLayout();
+  circle_pyramid_layout->addWidget(new QLabel(tr(u8"金字塔层数:")));
+  circle_pyramid_spin_ = new QSpinBox();
+  circle_pyramid_spin_->setRange(0, 4);
+  circle_pyramid_spin_->setValue(0);
+  circle_pyramid_spin_->setSpecialValueText(tr(u8"关闭"));
+  circle_pyramid_layout->addWidget(circle_pyramid_spin_);
+  circle_param_layout->addLayout(circle_pyramid_layout);
+
+  // 卡尺找线参数：ROI 为搜索区域，角度为边缘方向
+  QWidget* caliper_param_widget = new QWidget(param_panel);
+  QVBoxLayout* caliper_param_layout = new QVBoxLayout(caliper_param_widget);
+  caliper_param_layout->setContentsMargins(0,0,0,0);
+  auto add_caliper_row = [caliper_param_layout](const QString& label, QWidget* field) {
+    QHBoxLayout* row = new QHBoxLayout();
+    row->addWidget(new QLabel(label));
+    row->addWidget(field);
+    caliper_param_layout->addLayout(row);
+  };
+  caliper_angle_spin_ = new QDoubleSpinBox();
+  caliper_angle_spin_->setRange(-180.0, 180.0);
+  caliper_angle_spin_->setValue(0.0);
+  add_caliper_row(tr(u8"边缘方向(度):"), caliper_angle_spin_);
+  caliper_count_spin_ = new QSpinBox();
+  caliper_count_spin_->setRange(2, 200);
+  caliper_count_spin_->setValue(10);
+  add_caliper_row(tr(u8"卡尺数量:"), caliper_count_spin_);
+  caliper_width_spin_ = new QSpinBox();
+  caliper_width_spin_->setRange(1, 100);
+  caliper_width_spin_->setValue(5);
+  add_caliper_row(tr(u8"卡尺宽度:"), caliper_width_spin_);
+  caliper_sigma_spin_ = new QDoubleSpinBox();
+  caliper_sigma_spin_->setRange(0.0, 10.0);
+  caliper_sigma_spin_->setValue(1.0);
+  add_caliper_row(tr(u8"平滑σ:"), caliper_sigma_spin_);
+  caliper_min_gradient_spin_ = new QDoubleSpinBox();
+  caliper_min_gradient_spin_->setRange(0.0, 255.0);
+  caliper_min_gradient_spin_->setValue(10.0);
+  add_caliper_row(tr(u8"最小梯度:"), caliper_min_gradient_spin_);
+  caliper_polarity_combo_ = new QComboBox();
+  caliper_polarity_combo_->addItem(tr(u8"任意"), 0);
+  caliper_polarity_combo_->addItem(tr(u8"暗到亮"), 1);
+  caliper_polarity_combo_->addItem(tr(u8"亮到暗"), -1);
+  add_caliper_row(tr(u8"极性:"), caliper_polarity_combo_);
+  caliper_inlier_spin_ = new QDoubleSpinBox();
+  caliper_inlier_spin_->setRange(0.1, 50.0);
+  caliper_inlier_spin_->setValue(1.5);
+  add_caliper_row(tr(u8"内点距离:"), caliper_inlier_spin_);
+
+  // 拟合找圆参数：ROI 中心为名义圆心，在名义半径附近的圆环内搜索
+  QWidget* circle_fit_param_widget = new QWidget(param_panel);
+  QVBoxLayout* circle_fit_param_layout = new QVBoxLayout(circle_fit_param_widget);
+  circle_fit_param_layout->setContentsMargins(0,0,0,0);
+  auto add_circle_fit_row = [circle_fit_param_layout](const QString& label, QWidget* field) {
+    QHBoxLayout* row = new QHBoxLayout();
+    row->addWidget(new QLabel(label));
+    row->addWidget(field);
+    circle_fit_param_layout->addLayout(row);
+  };
+  circle_fit_radius_spin_ = new QDoubleSpinBox();
+  circle_fit_radius_spin_->setRange(0.0, 10000.0);
+  circle_fit_radius_spin_->setValue(0.0);
+  circle_fit_radius_spin_->setSpecialValueText(tr(u8"自动（ROI内切圆）"));
+  add_circle_fit_row(tr(u8"名义半径:"), circle_fit_radius_spin_);
+  circle_fit_search_spin_ = new QDoubleSpinBox();
+  circle_fit_search_spin_->setRange(2.0, 1000.0);
+  circle_fit_search_spin_->setValue(20.0);
+  add_circle_fit_row(tr(u8"搜索宽度:"), circle_fit_search_spin_);
+  circle_fit_rays_spin_ = new QSpinBox();
+  circle_fit_rays_spin_->setRange(3, 720);
+  circle_fit_rays_spin_->setValue(36);
+  add_circle_fit_row(tr(u8"射线数量:"), circle_fit_rays_spin_);
+  circle_fit_min_gradient_spin_ = new QDoubleSpinBox();
+  circle_fit_min_gradient_spin_->setRange(0.0, 255.0);
+  circle_fit_min_gradient_spin_->setValue(10.0);
+  add_circle_fit_row(tr(u8"最小梯度:"), circle_fit_min_gradient_spin_);
+  circle_fit_polarity_combo_ = new QComboBox();
+  circle_fit_polarity_combo_->addItem(tr(u8"任意"), 0);
+  circle_fit_polarity_combo_->addItem(tr(u8"由内向外 暗到亮"), 1);
+  circle_fit_polarity_combo_->addItem(tr(u8"由内向外 亮到暗"), -1);
+  add_circle_fit_row(tr(u8"极性:"), circle_fit_polarity_combo_);
+  circle_fit_inlier_spin_ = new QDoubleSpinBox();
+  circle_fit_inlier_spin_->setRange(0.1, 50.0);
+  circle_fit_inlier_spin_->setValue(1.5);
+  add_circle_fit_row(tr(u8"内点距离:"), circle_fit_inlier_spin_);
+
   // 执行工具按钮（统一）
   QPushButton* execute_btn = new QPushButton(tr(u8"执行找线"));
   execute_btn->setStyleSheet(R"(
@@ -361,15 +607,126 @@ QWidget* MainWindow::create_tool_panel() {
   )");
   connect(execute_btn, &QPushButton::clicked, this, &MainWindow::on_execute_tool_clicked);
   param_layout->addWidget(execute_btn);
+
+  // 运行状态：进度条 + 取消按钮 + 状态文字（工具在后台线程运行）
+  QHBoxLayout* run_state_layout = new QHBoxLayout();
+  progress_bar_ = new QProgressBar(param_panel);
+  progress_bar_->setRange(0, 100);
+  progress_bar_->setTextVisible(false);
+  progress_bar_->setMaximumHeight(12);
+  progress_bar_->setVisible(false);
+  cancel_run_btn_ = new QPushButton(tr(u8"取消运行"), param_panel);
+  cancel_run_btn_->setEnabled(false);
+  connect(cancel_run_btn_, &QPushButton::clicked, this, &MainWindow::on_cancel_run_clicked);
+  run_status_label_ = new QLabel(param_panel);
+  run_state_layout->addWidget(progress_bar_, 1);
+  run_state_layout->addWidget(run_status_label_);
+  run_state_layout->addWidget(cancel_run_btn_);
+  param_layout->addLayout(run_state_layout);
+
+  // 实时预览：参数变化后自动在后台重新检测（防抖 + 只运行最新请求）
+  live_preview_check_ = new QCheckBox(tr(u8"实时预览"), param_panel);
+  connect(live_preview_check_, &QCheckBox::toggled, this, &MainWindow::on_live_preview_toggled);
+  param_layout->addWidget(live_preview_check_);
+  result_cache_check_ = new QCheckBox(tr(u8"结果缓存存盘"), param_panel);
+  result_cache_check_->setToolTip(tr(u8"相同图像、ROI与参数直接返回已有结果；存盘后重启程序仍然有效"));
+  connect(result_cache_check_, &QCheckBox::toggled, this, [](bool on) {
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/results");
+    tools::ResultCache::global().set_directory(on ? dir.toUtf8().toStdString() : std::string());
+  });
+  // 默认关闭：结果文件写入用户缓存目录，需用户明确开启（目录有容量上限，超出删除最旧的结果）
+  param_layout->addWidget(result_cache_check_);
+  preview_timer_ = new QTimer(this);
+  preview_timer_->setSingleShot(true);
+  preview_timer_->setInterval(kPreviewDebounceMs);
+  connect(preview_timer_, &QTimer::timeout, this, [this]() { submit_current_tool(true); });
+  for (QDoubleSpinBox* spin : { rho_spin_, theta_spin_, min_line_len_spin_, max_line_gap_spin_,
+                                point_quality_spin_, point_min_distance_spin_,
+                                circle_dp_spin_, circle_min_dist_spin_, circle_param1_spin_, circle_param2_spin_,
+                                caliper_angle_spin_, caliper_sigma_spin_, caliper_min_gradient_spin_, caliper_inlier_spin_,
+                                circle_fit_radius_spin_, circle_fit_search_spin_, circle_fit_min_gradient_spin_, circle_fit_inlier_spin_ }) {
+    connect(spin, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &MainWindow::on_tool_param_changed);
+  }
+  for (QSpinBox* spin : { threshold_spin_, line_pyramid_spin_, point_max_corners_spin_, point_cell_size_spin_, point_per_cell_spin_,
+                          circle_min_radius_spin_, circle_max_radius_spin_, circle_pyramid_spin_,
+                          caliper_count_spin_, caliper_width_spin_, circle_fit_rays_spin_ }) {
+    connect(spin, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::on_tool_param_changed);
+  }
+  for (QComboBox* combo : { caliper_polarity_combo_, circle_fit_polarity_combo_ }) {
+    connect(combo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::on_tool_param_changed);
+  }
+  for (QCheckBox* check : { line_tiled_check_, line_fused_check_, point_grid_check_, point_subpix_check_ }) {
+    connect(check, &QCheckBox::toggled, this, &MainWindow::on_tool_param_changed);
+  }
+
+  // 结果图层：保留最近N次运行结果，可一键清除
+  QHBoxLayout* overlay_layout = new QHBoxLayout();
+  overlay_layout->addWidget(new QLabel(tr(u8"保留结果次数:")));
+  QSpinBox* history_spin = new QSpinBox(param_panel);
+  history_spin->setRange(1, 50);
+  history_spin->setValue(overlays_->HistoryDepth());
+  connect(history_spin, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int depth) {
+    overlays_->SetHistoryDepth(depth);
+  });
+  overlay_layout->addWidget(history_spin);
+  QPushButton* clear_overlay_btn = new QPushButton(tr(u8"清除结果"), param_panel);
+  connect(clear_overlay_btn, &QPushButton::clicked, this, [this]() { overlays_->ClearAll(); });
+  overlay_layout->addWidget(clear_overlay_btn);
+  param_layout->addLayout(overlay_layout);
+
+  // 多ROI：每个ROI保存自己的工具与参数，"执行全部ROI"在一次批量运行中并行处理
+  param_layout->addWidget(new QLabel(tr(u8"ROI列表:")));
+  roi_list_ = new QListWidget(param_panel);
+  roi_list_->setMaximumHeight(100);
+  param_layout->addWidget(roi_list_);
+  QHBoxLayout* roi_btn_layout = new QHBoxLayout();
+  QPushButton* add_roi_btn = new QPushButton(tr(u8"添加ROI"), param_panel);
+  QPushButton* apply_roi_btn = new QPushButton(tr(u8"应用参数"), param_panel);
+  QPushButton* remove_roi_btn = new QPushButton(tr(u8"删除ROI"), param_panel);
+  QPushButton* run_rois_btn = new QPushButton(tr(u8"执行全部ROI"), param_panel);
+  connect(add_roi_btn, &QPushButton::clicked, this, &MainWindow::on_add_roi_clicked);
+  connect(apply_roi_btn, &QPushButton::clicked, this, &MainWindow::on_apply_roi_params_clicked);
+  connect(remove_roi_btn, &QPushButton::clicked, this, &MainWindow::on_remove_roi_clicked);
+  connect(run_rois_btn, &QPushButton::clicked, this, &MainWindow::on_run_all_rois_clicked);
+  roi_btn_layout->addWidget(add_roi_btn);
+  roi_btn_layout->addWidget(apply_roi_btn);
+  roi_btn_layout->addWidget(remove_roi_btn);
+  roi_btn_layout->addWidget(run_rois_btn);
+  param_layout->addLayout(roi_btn_layout);
+
+  // 性能追踪：记录各阶段耗时/线程/像素数，运行后显示汇总，可导出 Chrome trace
+  QHBoxLayout* trace_layout = new QHBoxLayout();
+  trace_check_ = new QCheckBox(tr(u8"性能追踪"), param_panel);
+  connect(trace_check_, &QCheckBox::toggled, this, [this](bool on) {
+    tools::trace::set_enabled(on);
+    trace_label_->setVisible(on);
+  });
+  QPushButton* export_trace_btn = new QPushButton(tr(u8"导出追踪"), param_panel);
+  connect(export_trace_btn, &QPushButton::clicked, this, &MainWindow::on_export_trace_clicked);
+  trace_layout->addWidget(trace_check_);
+  trace_layout->addStretch();
+  trace_layout->addWidget(export_trace_btn);
+  param_layout->addLayout(trace_layout);
+  trace_label_ = new QLabel(param_panel);
+  trace_label_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  trace_label_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+  trace_label_->setVisible(false);
+  param_layout->addWidget(trace_label_);
   // 把参数组添加到 param_layout, 初始仅显示线工具参数
   param_layout->addWidget(line_param_widget);
   param_layout->addWidget(point_param_widget);
   param_layout->addWidget(circle_param_widget);
+  param_layout->addWidget(caliper_param_widget);
+  param_layout->addWidget(circle_fit_param_widget);
   line_param_widget_->setVisible(true);
   point_param_widget_ = point_param_widget;
   circle_param_widget_ = circle_param_widget;
   point_param_widget_->setVisible(false);
   circle_param_widget_->setVisible(false);
+  caliper_param_widget_ = caliper_param_widget;
+  caliper_param_widget_->setVisible(false);
+  circle_fit_param_widget_ = circle_fit_param_widget;
+  circle_fit_param_widget_->setVisible(false);
 
   // 底部三按钮：确认、取消、应用（暂时确认/取消返回上一级页面，应用暂不实现）
   QHBoxLayout* bottom_btns = new QHBoxLayout();
@@ -426,12 +783,16 @@ void MainWindow::show_param_for_tool(ToolType t) {
   if (line_param_widget_) line_param_widget_->setVisible(t == ToolType::Line);
   if (point_param_widget_) point_param_widget_->setVisible(t == ToolType::Point);
   if (circle_param_widget_) circle_param_widget_->setVisible(t == ToolType::Circle);
+  if (caliper_param_widget_) caliper_param_widget_->setVisible(t == ToolType::Caliper);
+  if (circle_fit_param_widget_) circle_fit_param_widget_->setVisible(t == ToolType::CircleFit);
 
   // update execute button text
   if (execute_btn_) {
     if (t == ToolType::Line) execute_btn_->setText(tr(u8"执行找线"));
     else if (t == ToolType::Point) execute_btn_->setText(tr(u8"执行找点"));
     else if (t == ToolType::Circle) execute_btn_->setText(tr(u8"执行找圆"));
+    else if (t == ToolType::Caliper) execute_btn_->setText(tr(u8"执行卡尺找线"));
+    else if (t == ToolType::CircleFit) execute_btn_->setText(tr(u8"执行拟合找圆"));
   }
 }
 
@@ -443,6 +804,7 @@ void MainWindow::on_find_line_tool_clicked() {
     element_stack_->setCurrentWidget(param_panel_);
     current_tool_ = ToolType::Line;
     show_param_for_tool(current_tool_);
+    on_tool_param_changed();
   } else if (param_panel_) {
     // 兼容：若未使用 tabs，仍然显示面板
     param_panel_->setVisible(true);
@@ -455,6 +817,7 @@ void MainWindow::on_point_tool_clicked() {
     element_stack_->setCurrentWidget(param_panel_);
     current_tool_ = ToolType::Point;
     show_param_for_tool(current_tool_);
+    on_tool_param_changed();
   }
 }
 
@@ -464,17 +827,100 @@ void MainWindow::on_circle_tool_clicked() {
     element_stack_->setCurrentWidget(param_panel_);
     current_tool_ = ToolType::Circle;
     show_param_for_tool(current_tool_);
+    on_tool_param_changed();
+  }
+}
+
+void MainWindow::on_caliper_tool_clicked() {
+  if (tabs_ && element_tab_ && element_stack_ && param_panel_) {
+    tabs_->setCurrentWidget(element_tab_);
+    element_stack_->setCurrentWidget(param_panel_);
+    current_tool_ = ToolType::Caliper;
+    show_param_for_tool(current_tool_);
+    on_tool_param_changed();
+  }
+}
+
+void MainWindow::on_circle_fit_tool_clicked() {
+  if (tabs_ && element_tab_ && element_stack_ && param_panel_) {
+    tabs_->setCurrentWidget(element_tab_);
+    element_stack_->setCurrentWidget(param_panel_);
+    current_tool_ = ToolType::CircleFit;
+    show_param_for_tool(current_tool_);
+    on_tool_param_changed();
   }
 }
 
 void MainWindow::on_execute_tool_clicked() {
-  if (!pixmap_item_) {
+  if (!document_ && !tile_store_) {
     QMessageBox::warning(this, tr(u8"警告"), tr(u8"请先加载图片再执行工具！"));
     return;
   }
+  submit_current_tool(false);
+}
+
+// 从参数面板读取当前工具的类型与参数（与命令行配方共用 ToolSpec）
+tools::ToolSpec MainWindow::current_tool_spec() const {
+  tools::ToolSpec spec;
+  if (current_tool_ == ToolType::Point) spec.kind = tools::ToolKind::Point;
+  else if (current_tool_ == ToolType::Circle) spec.kind = tools::ToolKind::Circle;
+  else if (current_tool_ == ToolType::Caliper) spec.kind = tools::ToolKind::Caliper;
+  else if (current_tool_ == ToolType::CircleFit) spec.kind = tools::ToolKind::CircleFit;
+  else spec.kind = tools::ToolKind::Line;
+
+  spec.line.rho = rho_spin_->value();
+  spec.line.theta = theta_spin_->value();
+  spec.line.threshold = threshold_spin_->value();
+  spec.line.minLineLength = min_line_len_spin_->value();
+  spec.line.maxLineGap = max_line_gap_spin_->value();
+  spec.line.tiled = line_tiled_check_->isChecked();
+  spec.line.fused = line_fused_check_->isChecked();
+  spec.line.pyramid_levels = line_pyramid_spin_->value();
+
+  spec.point.max_corners = point_max_corners_spin_->value();
+  spec.point.quality_level = point_quality_spin_->value();
+  spec.point.min_distance = point_min_distance_spin_->value();
+  spec.point.grid = point_grid_check_->isChecked();
+  spec.point.cell_size = point_cell_size_spin_->value();
+  spec.point.per_cell = point_per_cell_spin_->value();
+  spec.point.subpix = point_subpix_check_->isChecked();
+
+  spec.circle.dp = circle_dp_spin_->value();
+  spec.circle.minDist = circle_min_dist_spin_->value();
+  spec.circle.param1 = circle_param1_spin_->value();
+  spec.circle.param2 = circle_param2_spin_->value();
+  spec.circle.minRadius = circle_min_radius_spin_->value();
+  spec.circle.maxRadius = circle_max_radius_spin_->value();
+  spec.circle.pyramid_levels = circle_pyramid_spin_->value();
+
+  spec.caliper.angle = caliper_angle_spin_->value();
+  spec.caliper.calipers = caliper_count_spin_->value();
+  spec.caliper.width = caliper_width_spin_->value();
+  spec.caliper.sigma = caliper_sigma_spin_->value();
+  spec.caliper.min_gradient = caliper_min_gradient_spin_->value();
+  spec.caliper.polarity = caliper_polarity_combo_->currentData().toInt();
+  spec.caliper.inlier_distance = caliper_inlier_spin_->value();
+
+  spec.circle_fit.radius = circle_fit_radius_spin_->value();
+  spec.circle_fit.search = circle_fit_search_spin_->value();
+  spec.circle_fit.rays = circle_fit_rays_spin_->value();
+  spec.circle_fit.min_gradient = circle_fit_min_gradient_spin_->value();
+  spec.circle_fit.polarity = circle_fit_polarity_combo_->currentData().toInt();
+  spec.circle_fit.inlier_distance = circle_fit_inlier_spin_->value();
+  return spec;
+}
+
+// 根据当前工具创建工具对象（参数在GUI线程读取，运行在工作线程）
+std::shared_ptr<tools::ITool> MainWindow::make_current_tool() const {
+  if (current_tool_ == ToolType::None) return nullptr;
+  return tools::make_tool(current_tool_spec());
+}
 
-  cv::Mat src = qpixmap_to_cvmat(pixmap_item_->pixmap());
-  if (src.empty()) return;
+// 提交当前工具到后台执行。live=true 为实时预览：结果原地更新到预览图层，不弹窗
+void MainWindow::submit_current_tool(bool live) {
+  if (!document_ && !tile_store_) return;
+  std::shared_ptr<tools::ITool> tool = make_current_tool();
+  if (!tool) return;
 
   // 如果有ROI，获取并传给工具
   cv::Rect cv_roi;
@@ -482,35 +928,304 @@ void MainWindow::on_execute_tool_clicked() {
     QRectF qt_roi = view_->GetLastDrawRect();
     cv_roi = cv::Rect(static_cast<int>(qt_roi.x()), static_cast<int>(qt_roi.y()), static_cast<int>(qt_roi.width()), static_cast<int>(qt_roi.height()));
   }
+  // 旋转ROI：只处理旋转区域内的像素（cv_roi为其外接矩形）。场景坐标的像素中心在 +0.5 处
+  const RoiShape shape = view_->GetRoi();
+  const bool oriented = view_->HasValidRect() && shape.IsRotated();
+  const cv::RotatedRect region(cv::Point2f(static_cast<float>(shape.center.x() - 0.5), static_cast<float>(shape.center.y() - 0.5)),
+                               cv::Size2f(static_cast<float>(shape.size.width()), static_cast<float>(shape.size.height())),
+                               static_cast<float>(shape.angle));
+
+  // 异步执行：新的运行会取消仍在进行的旧运行；回调在工作线程触发，转发回GUI线程处理
+  progress_bar_->setValue(0);
+  progress_bar_->setVisible(true);
+  cancel_run_btn_->setEnabled(true);
+  run_status_label_->setText(tr(u8"运行中..."));
+  // 结果按提交时的工具绘制：运行期间切换工具不影响这次结果的显示方式
+  const ToolType kind = current_tool_;
+  auto on_progress = [this](uint64_t id, int percent) {
+    QMetaObject::invokeMethod(this, [this, id, percent]() {
+      if (id == executor_->latest_id()) progress_bar_->setValue(percent);
+    }, Qt::QueuedConnection);
+  };
+
+  if (!document_) {
+    // 超大图：只读取ROI覆盖的瓦片（在工作线程），结果从ROI坐标平移回全图坐标
+    const tools::PyramidInfo& info = tile_store_->info();
+    cv_roi &= cv::Rect(0, 0, info.width, info.height);
+    if (cv_roi.empty() || static_cast<double>(cv_roi.area()) > kMaxTiledRoiPixels) {
+      progress_bar_->setVisible(false);
+      cancel_run_btn_->setEnabled(false);
+      run_status_label_->setText(QString());
+      if (!live) QMessageBox::warning(this, tr(u8"警告"), tr(u8"大图请先绘制ROI（不超过 %1 MP）！").arg(kMaxTiledRoiPixels / 1e6));
+      return;
+    }
+    std::shared_ptr<tools::TileStore> store = tile_store_;
+    const cv::Point offset = cv_roi.tl();
+    auto load = [store, cv_roi]() { return tools::ImageDocument::from_mat(store->read_region(cv_roi)); };
+    auto on_done = [this, live, offset, kind](const tools::RunOutcome& outcome) {
+      tools::RunOutcome shifted = outcome;
+      tools::translate(shifted.result, offset);
+      QMetaObject::invokeMethod(this, [this, shifted, live, kind]() {
+        handle_run_outcome(shifted, live, kind);
+        update_trace_summary();
+      }, Qt::QueuedConnection);
+    };
+    if (oriented) {
+      // 读入的是外接矩形，区域中心换到它的坐标系
+      cv::RotatedRect local = region;
+      local.center -= cv::Point2f(static_cast<float>(offset.x), static_cast<float>(offset.y));
+      executor_->submit_lazy(tool, load, local, on_done, on_progress);
+    } else {
+      executor_->submit_lazy(tool, load, cv::Rect(), on_done, on_progress);
+    }
+    return;
+  }
+
+  auto on_done = [this, live, kind](const tools::RunOutcome& outcome) {
+    QMetaObject::invokeMethod(this, [this, outcome, live, kind]() {
+      handle_run_outcome(outcome, live, kind);
+      update_trace_summary();
+    }, Qt::QueuedConnection);
+  };
+  // 参数的规范文本作为结果缓存键的一部分
+  std::string cache_params = tools::to_string(current_tool_spec());
+  if (oriented) {
+    executor_->submit(tool, document_, region, on_done, on_progress, std::move(cache_params));
+  } else {
+    executor_->submit(tool, document_, cv_roi, on_done, on_progress, std::move(cache_params));
+  }
+}
+
+// 参数变化：实时预览打开时重新计时，停止变化一小段时间后只运行最新的一次
+void MainWindow::on_tool_param_changed() {
+  if (!live_preview_check_ || !live_preview_check_->isChecked() || !document_) return;
+  if (!preview_timer_->isActive()) preview_latency_.start(); // 从第一次变化开始计端到端延迟
+  preview_timer_->start();
+}
+
+// 关闭实时预览时移除预览图层
+void MainWindow::on_live_preview_toggled(bool enabled) {
+  if (enabled) {
+    on_tool_param_changed();
+  } else {
+    preview_timer_->stop();
+    overlays_->RemoveLayer(QStringLiteral("preview"));
+  }
+}
+
+// 取消当前运行（工具在阶段之间检查取消标志）
+void MainWindow::on_cancel_run_clicked() {
+  if (executor_) executor_->cancel_all();
+}
 
-  // 根据当前工具创建并运行
-  if (current_tool_ == ToolType::Line) {
-    tools::LineTool tool;
-    tool.params.rho = rho_spin_->value();
-    tool.params.theta = theta_spin_->value();
-    tool.params.threshold = threshold_spin_->value();
-    tool.params.minLineLength = min_line_len_spin_->value();
-    tool.params.maxLineGap = max_line_gap_spin_->value();
-    tools::DetectionResult res = tool.run(src, cv_roi);
-    draw_lines_to_scene(res.lines);
-  } else if (current_tool_ == ToolType::Point) {
-    tools::PointTool tool;
-    tool.params.max_corners = point_max_corners_spin_->value();
-    tool.params.quality_level = point_quality_spin_->value();
-    tool.params.min_distance = point_min_distance_spin_->value();
-    tools::DetectionResult res = tool.run(src, cv_roi);
-    draw_points_to_scene(res.points);
-  } else if (current_tool_ == ToolType::Circle) {
-    tools::CircleTool tool;
-    tool.params.dp = circle_dp_spin_->value();
-    tool.params.minDist = circle_min_dist_spin_->value();
-    tool.params.param1 = circle_param1_spin_->value();
-    tool.params.param2 = circle_param2_spin_->value();
-    tool.params.minRadius = circle_min_radius_spin_->value();
-    tool.params.maxRadius = circle_max_radius_spin_->value();
-    tools::DetectionResult res = tool.run(src, cv_roi);
-    draw_circles_to_scene(res.circles);
+// 处理一次运行的结果（GUI线程）。被新运行取代的旧结果直接丢弃
+void MainWindow::handle_run_outcome(const tools::RunOutcome& outcome, bool live, ToolType kind) {
+  if (outcome.id != executor_->latest_id()) return;
+
+  progress_bar_->setVisible(false);
+  cancel_run_btn_->setEnabled(false);
+  if (!outcome.error.empty()) {
+    run_status_label_->setText(tr(u8"运行失败"));
+    QMessageBox::critical(this, tr(u8"错误"), QString::fromStdString(outcome.error));
+    return;
+  }
+  if (outcome.cancelled) {
+    run_status_label_->setText(tr(u8"已取消"));
+    return;
+  }
+  run_status_label_->setText(outcome.cached ? tr(u8"缓存命中 %1 ms").arg(outcome.elapsed_ms, 0, 'f', 1)
+                                            : tr(u8"耗时 %1 ms").arg(outcome.elapsed_ms, 0, 'f', 1));
+
+  const tools::DetectionResult& res = outcome.result;
+  if (live) {
+    // 预览图层原地替换，不累积历史、不弹窗
+    {
+      TRACE_SCOPE("draw_preview");
+      overlays_->Layer(QStringLiteral("preview"))->SetResult(res);
+    }
+    const qint64 total_ms = preview_latency_.isValid() ? preview_latency_.elapsed() : 0;
+    const int count = static_cast<int>(res.lines.size() + res.points.size() + res.circles.size());
+    run_status_label_->setText(tr(u8"预览 %1 个 | 运行 %2 ms | 端到端 %3 ms")
+      .arg(count).arg(outcome.elapsed_ms, 0, 'f', 1).arg(total_ms));
+    // 超出延迟目标时标红
+    run_status_label_->setStyleSheet(outcome.elapsed_ms > kPreviewLatencyTargetMs ? "color: #D4380D;" : "color: #389E0D;");
+    return;
   }
+  run_status_label_->setStyleSheet(QString());
+  // 正式执行的结果进入历史图层，预览图层随之清除
+  overlays_->RemoveLayer(QStringLiteral("preview"));
+  if (res.kind == tools::DetectionKind::Lines && kind == ToolType::Caliper) draw_caliper_result(res);
+  else if (res.kind == tools::DetectionKind::Lines) draw_lines_to_scene(res.lines);
+  else if (res.kind == tools::DetectionKind::Circles && kind == ToolType::CircleFit) draw_circle_fit_result(res);
+  else if (res.kind == tools::DetectionKind::Points) draw_points_to_scene(res.points);
+  else if (res.kind == tools::DetectionKind::Circles) draw_circles_to_scene(res.circles);
+}
+
+// 当前绘制的矩形保存为ROI，记录当前工具和参数
+void MainWindow::on_add_roi_clicked() {
+  if (!document_item_ || !view_->HasValidRect()) {
+    QMessageBox::warning(this, tr(u8"警告"), tr(u8"请先在图片上绘制矩形，再添加ROI！"));
+    return;
+  }
+  const tools::ToolSpec spec = current_tool_spec();
+  const int id = view_->AddRoi(view_->GetLastDrawRect());
+  roi_specs_[id] = spec;
+  view_->ClearRoi();
+  refresh_roi_list();
+}
+
+// 把当前参数应用到选中的ROI
+void MainWindow::on_apply_roi_params_clicked() {
+  QListWidgetItem* item = roi_list_->currentItem();
+  if (!item) return;
+  roi_specs_[item->data(Qt::UserRole).toInt()] = current_tool_spec();
+  refresh_roi_list();
+}
+
+void MainWindow::on_remove_roi_clicked() {
+  QListWidgetItem* item = roi_list_->currentItem();
+  if (!item) return;
+  const int id = item->data(Qt::UserRole).toInt();
+  roi_specs_.erase(id);
+  overlays_->RemoveLayer(QStringLiteral("roi-%1").arg(id));
+  view_->RemoveRoi(id);
+}
+
+// ROI列表与视图中的ROI保持一致（视图换图时会清空ROI）
+void MainWindow::refresh_roi_list() {
+  if (!roi_list_) return;
+  const QMap<int, QRectF> rois = view_->Rois();
+  for (auto it = roi_specs_.begin(); it != roi_specs_.end();) {
+    if (!rois.contains(it->first)) {
+      overlays_->RemoveLayer(QStringLiteral("roi-%1").arg(it->first));
+      it = roi_specs_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  const int current = roi_list_->currentRow();
+  roi_list_->clear();
+  for (auto it = rois.begin(); it != rois.end(); ++it) {
+    const QRectF& r = it.value();
+    auto spec = roi_specs_.find(it.key());
+    const QString kind = spec != roi_specs_.end() ? QString::fromLatin1(tools::tool_kind_name(spec->second.kind)) : QString();
+    QListWidgetItem* item = new QListWidgetItem(tr(u8"ROI %1  %2  (%3, %4, %5x%6)")
+      .arg(it.key()).arg(kind)
+      .arg(static_cast<int>(r.x())).arg(static_cast<int>(r.y()))
+      .arg(static_cast<int>(r.width())).arg(static_cast<int>(r.height())), roi_list_);
+    item->setData(Qt::UserRole, it.key());
+  }
+  if (current >= 0 && current < roi_list_->count()) roi_list_->setCurrentRow(current);
+}
+
+// 所有ROI作为一次运行提交：重叠ROI的预处理只计算一次，各ROI在线程池上并行检测
+void MainWindow::on_run_all_rois_clicked() {
+  if (!document_item_ || !document_) {
+    QMessageBox::warning(this, tr(u8"警告"), tr(u8"请先加载图片再执行工具！"));
+    return;
+  }
+  const QMap<int, QRectF> rois = view_->Rois();
+  if (rois.isEmpty()) {
+    QMessageBox::warning(this, tr(u8"警告"), tr(u8"请先添加ROI！"));
+    return;
+  }
+
+  std::vector<tools::RoiJob> jobs;
+  for (auto it = rois.begin(); it != rois.end(); ++it) {
+    auto spec = roi_specs_.find(it.key());
+    if (spec == roi_specs_.end()) continue;
+    const QRectF& r = it.value();
+    tools::RoiJob job;
+    job.roi_id = it.key();
+    job.roi = cv::Rect(static_cast<int>(r.x()), static_cast<int>(r.y()), static_cast<int>(r.width()), static_cast<int>(r.height()));
+    job.tool = tools::make_tool(spec->second);
+    jobs.push_back(std::move(job));
+  }
+
+  preview_timer_->stop();
+  progress_bar_->setValue(0);
+  progress_bar_->setVisible(true);
+  cancel_run_btn_->setEnabled(true);
+  run_status_label_->setText(tr(u8"运行中..."));
+  executor_->submit_batch(std::move(jobs), document_,
+    [this](const tools::RunOutcome& outcome) {
+      QMetaObject::invokeMethod(this, [this, outcome]() {
+        handle_batch_outcome(outcome);
+        update_trace_summary();
+      }, Qt::QueuedConnection);
+    },
+    [this](uint64_t id, int percent) {
+      QMetaObject::invokeMethod(this, [this, id, percent]() {
+        if (id == executor_->latest_id()) progress_bar_->setValue(percent);
+      }, Qt::QueuedConnection);
+    });
+}
+
+// 批量结果：每个ROI一个图层（"roi-<编号>"），再次执行时原地替换
+void MainWindow::handle_batch_outcome(const tools::RunOutcome& outcome) {
+  if (outcome.id != executor_->latest_id()) return;
+
+  progress_bar_->setVisible(false);
+  cancel_run_btn_->setEnabled(false);
+  run_status_label_->setStyleSheet(QString());
+  if (!outcome.error.empty()) {
+    run_status_label_->setText(tr(u8"运行失败"));
+    QMessageBox::critical(this, tr(u8"错误"), QString::fromStdString(outcome.error));
+    return;
+  }
+  if (outcome.cancelled) {
+    run_status_label_->setText(tr(u8"已取消"));
+    return;
+  }
+
+  overlays_->RemoveLayer(QStringLiteral("preview"));
+  size_t total = 0;
+  TRACE_SCOPE("draw_roi_layers");
+  for (const tools::DetectionResult& res : outcome.roi_results) {
+    if (res.roi_id < 0 || !roi_specs_.count(res.roi_id)) continue; // 运行期间被删除的ROI
+    overlays_->Layer(QStringLiteral("roi-%1").arg(res.roi_id))->SetResult(res);
+    total += res.lines.size() + res.points.size() + res.circles.size();
+  }
+  run_status_label_->setText(tr(u8"%1 个ROI | 共 %2 个结果 | 耗时 %3 ms")
+    .arg(outcome.roi_results.size()).arg(total).arg(outcome.elapsed_ms, 0, 'f', 1));
+}
+
+// 取出本次运行记录的事件：面板显示分阶段汇总，事件累计保留以便导出
+void MainWindow::update_trace_summary() {
+  if (!tools::trace::enabled()) return;
+  std::vector<tools::trace::Event> events = tools::trace::take_events();
+  if (events.empty()) return;
+
+  QString text = QStringLiteral("%1 %2 %3 %4 %5\n")
+    .arg(tr(u8"阶段"), -22).arg(tr(u8"次数"), 4).arg(QStringLiteral("total ms"), 9).arg(QStringLiteral("max ms"), 8).arg(QStringLiteral("MPix"), 7);
+  for (const tools::trace::StageSummary& s : tools::trace::summarize(events)) {
+    text += QStringLiteral("%1 %2 %3 %4 %5\n")
+      .arg(QString::fromStdString(s.name), -22).arg(s.count, 4)
+      .arg(s.total_ms, 9, 'f', 2).arg(s.max_ms, 8, 'f', 2).arg(s.pixels / 1e6, 7, 'f', 2);
+  }
+  trace_label_->setText(text.trimmed());
+
+  // 累计事件有上限，超出时丢弃最旧的
+  trace_events_.insert(trace_events_.end(), events.begin(), events.end());
+  if (trace_events_.size() > tools::trace::kMaxEvents) {
+    trace_events_.erase(trace_events_.begin(), trace_events_.end() - tools::trace::kMaxEvents);
+  }
+}
+
+void MainWindow::on_export_trace_clicked() {
+  update_trace_summary();
+  if (trace_events_.empty()) {
+    QMessageBox::information(this, tr(u8"提示"), tr(u8"没有追踪数据，请先勾选“性能追踪”并执行工具！"));
+    return;
+  }
+  const QString path = QFileDialog::getSaveFileName(this, tr(u8"导出追踪"), "trace.json", tr(u8"Chrome Trace (*.json)"));
+  if (path.isEmpty()) return;
+  std::string error;
+  if (!tools::trace::write_chrome_trace(path.toLocal8Bit().toStdString(), trace_events_, &error)) {
+    QMessageBox::critical(this, tr(u8"错误"), QString::fromStdString(error));
+    return;
+  }
+  run_status_label_->setText(tr(u8"已导出 %1 个事件").arg(trace_events_.size()));
 }
 
 // Note: on_execute_find_line_clicked was removed in favor of on_execute_tool_clicked
@@ -524,8 +1239,9 @@ void MainWindow::find_lines_with_opencv() {
     return;
   }
 
-  // 1. 将QPixmap转换为cv::Mat（原有逻辑不变）
-  cv::Mat src_mat = qpixmap_to_cvmat(pixmap_item_->pixmap());
+  // 1. 直接使用文档的灰度平面，不再从QPixmap转换
+  if (!document_) return;
+  const cv::Mat& src_mat = document_->gray();
   if (src_mat.empty()) {
     QMessageBox::critical(this, tr(u8"错误"), tr(u8"图片转换失败！"));
     return;
@@ -554,8 +1270,7 @@ void MainWindow::find_lines_with_opencv() {
 
   // 2. 预处理：仅对ROI区域做灰度+模糊+边缘检测（把src_mat换成roi_mat）
   cv::Mat gray_mat, edges_mat;
-  cv::cvtColor(roi_mat, gray_mat, cv::COLOR_BGR2GRAY);
-  cv::GaussianBlur(gray_mat, gray_mat, cv::Size(3, 3), 0); // 高斯模糊去噪
+  cv::GaussianBlur(roi_mat, gray_mat, cv::Size(3, 3), 0); // 高斯模糊去噪（roi_mat已是灰度）
   cv::Canny(gray_mat, edges_mat, 50, 150, 3); // Canny边缘检测
 
   // 3. 获取参数面板的配置值（原有逻辑不变）
@@ -581,15 +1296,6 @@ void MainWindow::find_lines_with_opencv() {
   draw_lines_to_scene(lines);
 }
 
-// ========== 新增：QPixmap 转 cv::Mat ==========
-cv::Mat MainWindow::qpixmap_to_cvmat(const QPixmap& pixmap) {
-  QImage img = pixmap.toImage();
-  img = img.convertToFormat(QImage::Format_RGB888);
-  cv::Mat mat(img.height(), img.width(), CV_8UC3, (void*)img.bits(), img.bytesPerLine());
-  cv::cvtColor(mat, mat, cv::COLOR_RGB2BGR); // Qt是RGB，OpenCV是BGR，需转换
-  return mat.clone(); // 返回深拷贝，避免内存问题
-}
-
 // ========== 新增：绘制直线到Qt场景 ==========
 void MainWindow::draw_lines_to_scene(const std::vector<cv::Vec4i>& lines) {
   if (lines.empty()) {
@@ -597,13 +1303,11 @@ void MainWindow::draw_lines_to_scene(const std::vector<cv::Vec4i>& lines) {
     return;
   }
 
-  // 遍历所有检测到的直线，创建QGraphicsLineItem绘制
-  QPen line_pen(Qt::green, 2); // 绿色直线，宽度2px
-  for (const auto& line : lines) {
-    int x1 = line[0], y1 = line[1], x2 = line[2], y2 = line[3];
-    QGraphicsLineItem* line_item = new QGraphicsLineItem(x1, y1, x2, y2);
-    line_item->setPen(line_pen);
-    scene_->addItem(line_item);
+  {
+    TRACE_SCOPE("draw_lines_to_scene");
+    // 所有直线放进一个运行结果图层（批量绘制图元）（绿色，宽度2px），图元数量与直线数量无关
+    DetectionOverlayItem* overlay = overlays_->NewRunLayer();
+    overlay->SetLines(lines);
   }
 
   QMessageBox::information(this, tr(u8"完成"), tr(u8"共检测到 %1 条直线！").arg(lines.size()));
@@ -617,26 +1321,234 @@ void MainWindow::open_image_file() {
   if (file_path.isEmpty()) {
     return;
   }
-
-  QPixmap pixmap(file_path);
-  if (pixmap.isNull()) {
+  stop_stream();
+
+  // 只解码一次：文档持有像素，工具与显示图元都直接使用文档像素（不拷贝）
+  QFile file(file_path);
+  std::shared_ptr<tools::ImageDocument> doc;
+  if (file.open(QIODevice::ReadOnly)) {
+    const QByteArray bytes = file.readAll();
+    doc = tools::ImageDocument::decode(reinterpret_cast<const uchar*>(bytes.constData()), static_cast<size_t>(bytes.size()));
+  }
+  if (!doc) {
     setWindowTitle(tr(u8"加载图片失败：") + file_path);
     return;
   }
+  // 旧图片上的运行结果与预处理缓存不再有意义
+  executor_->cancel_all();
+  overlays_->ClearAll();
+  if (document_) tools::StageCache::global().drop_image(document_->id());
+  document_ = std::move(doc);
 
-  if (pixmap_item_) {
-    scene_->removeItem(pixmap_item_);
-    delete pixmap_item_;
-    pixmap_item_ = nullptr;
-  }
+  remove_document_image();
+  remove_tiled_image();
 
-  pixmap_item_ = scene_->addPixmap(pixmap);
-  scene_->setSceneRect(pixmap.rect());
-  view_->SetPixmapItem(pixmap_item_);
+  document_item_ = new DocumentImageItem(document_);
+  scene_->addItem(document_item_);
+  scene_->setSceneRect(document_item_->boundingRect());
+  view_->SetImageItem(document_item_);
 
   setWindowTitle(tr(u8"已加载：") + file_path);
 }
 
+void MainWindow::open_video_file() {
+  const QString path = QFileDialog::getOpenFileName(
+    this, tr(u8"选择视频"), "", tr(u8"视频文件 (*.mp4 *.avi *.mkv *.mov);;所有文件 (*)"));
+  if (!path.isEmpty()) start_stream(path);
+}
+
+void MainWindow::open_image_sequence() {
+  const QString dir = QFileDialog::getExistingDirectory(this, tr(u8"选择图像序列目录"));
+  if (!dir.isEmpty()) start_stream(dir);
+}
+
+// 采集进程（frame_producer）写入的帧环：帧的 cv::Mat 直接指向共享内存，检测不拷贝，
+// 显示图元也直接绘制槽位中的像素；帧用完后槽位才会被生产者复用。
+// 读端异常退出时，生产者在租约心跳超时后回收它占用的槽位
+void MainWindow::open_shared_frames() {
+  bool ok = false;
+  const QString key = QInputDialog::getText(this, tr(u8"打开共享内存帧"), tr(u8"共享内存键："),
+                                            QLineEdit::Normal, shared_frames_key_, &ok);
+  if (!ok || key.isEmpty()) return;
+  shared_frames_key_ = key;
+
+  auto segment = std::make_shared<QSharedMemory>(key);
+  // 读端要更新槽位的引用计数，按读写方式附加
+  if (!segment->attach(QSharedMemory::ReadWrite)) {
+    QMessageBox::critical(this, tr(u8"错误"), tr(u8"无法附加共享内存：") + segment->errorString());
+    return;
+  }
+  std::string error;
+  std::unique_ptr<tools::FrameSource> source = tools::FrameRingSource::open(
+    segment->data(), static_cast<size_t>(segment->size()), segment, key.toStdString(), &error);
+  if (!source) {
+    QMessageBox::critical(this, tr(u8"错误"), tr(u8"无法打开：") + QString::fromStdString(error));
+    return;
+  }
+  start_stream(std::move(source), tr(u8"共享内存 ") + key);
+}
+
+// 开始流模式：解码 -> 检测 -> 渲染 三级流水线，检测跟不上时丢弃最旧的帧
+void MainWindow::start_stream(const QString& path) {
+  std::string error;
+  std::unique_ptr<tools::FrameSource> source = tools::open_frame_source(path.toUtf8().toStdString(), &error);
+  if (!source) {
+    QMessageBox::critical(this, tr(u8"错误"), tr(u8"无法打开：") + QString::fromStdString(error));
+    return;
+  }
+  start_stream(std::move(source), path);
+}
+
+void MainWindow::start_stream(std::unique_ptr<tools::FrameSource> source, const QString& title) {
+  std::shared_ptr<tools::ITool> tool = make_current_tool();
+  if (!tool) {
+    QMessageBox::warning(this, tr(u8"警告"), tr(u8"请先在元素工具中选择一个工具！"));
+    return;
+  }
+  stop_stream();
+
+  tools::StreamOptions options;
+  if (view_->HasValidRect()) {
+    const QRectF r = view_->GetLastDrawRect();
+    options.roi = cv::Rect(static_cast<int>(r.x()), static_cast<int>(r.y()), static_cast<int>(r.width()), static_cast<int>(r.height()));
+  }
+  // 图像序列没有帧率，按25fps播放，与视频一样在检测跟不上时丢帧
+  if (source->fps() <= 0) options.fps = 25.0;
+
+  // 旧图片上的运行结果与预处理缓存不再有意义
+  executor_->cancel_all();
+  overlays_->ClearAll();
+  if (document_) tools::StageCache::global().drop_image(document_->id());
+
+  remove_tiled_image();
+  stream_ = std::make_unique<tools::StreamPipeline>(std::move(source), tool, options);
+  stream_->start();
+  stream_timer_->start();
+  stop_stream_action_->setEnabled(true);
+  setWindowTitle(tr(u8"播放：") + title);
+}
+
+void MainWindow::stop_stream() {
+  if (!stream_) return;
+  stream_timer_->stop();
+  stream_->stop();
+  const tools::StreamStats st = stream_->stats();
+  statusBar()->showMessage(tr(u8"已停止：解码 %1 帧，检测 %2 帧，显示 %3 帧，丢弃 %4 帧")
+    .arg(st.decoded).arg(st.detected).arg(st.rendered).arg(st.dropped));
+  stream_.reset();
+  stop_stream_action_->setEnabled(false);
+}
+
+// 渲染阶段（GUI线程）：只显示最新一帧及其检测结果，沿用结果图层绘制
+void MainWindow::on_stream_tick() {
+  if (!stream_) return;
+  std::optional<tools::StreamResult> r = stream_->take_latest();
+  if (r && r->frame) {
+    TRACE_SCOPE_PX("stream.render", static_cast<int64_t>(r->frame->width()) * r->frame->height());
+    // 显示图元直接绘制帧像素（共享内存帧即槽位本身），不拷贝；图元持有当前帧，槽位在换帧后才释放
+    if (!document_item_) {
+      document_item_ = new DocumentImageItem(r->frame);
+      scene_->addItem(document_item_);
+      view_->SetImageItem(document_item_);
+    } else {
+      document_item_->SetDocument(r->frame);
+    }
+    if (scene_->sceneRect() != document_item_->boundingRect()) scene_->setSceneRect(document_item_->boundingRect());
+    // 停止后可以直接在最后一帧上执行工具
+    document_ = r->frame;
+    overlays_->Layer(QStringLiteral("stream"))->SetResult(r->result);
+    stream_->mark_rendered(*r);
+  }
+
+  const tools::StreamStats st = stream_->stats();
+  statusBar()->showMessage(tr(u8"帧 %1 | 解码 %2 fps | 检测 %3 fps (%4 ms) | 显示 %5 fps | 延迟 %6 ms (最大 %7) | 丢弃 %8")
+    .arg(r ? QString::number(r->index) : QStringLiteral("-"))
+    .arg(st.decode_fps, 0, 'f', 1).arg(st.detect_fps, 0, 'f', 1).arg(st.detect_ms, 0, 'f', 1)
+    .arg(st.render_fps, 0, 'f', 1).arg(st.latency_ms, 0, 'f', 1).arg(st.max_latency_ms, 0, 'f', 1)
+    .arg(st.dropped));
+  if (stream_->finished()) stop_stream();
+}
+
+void MainWindow::open_pyramid() {
+  const QString dir = QFileDialog::getExistingDirectory(this, tr(u8"选择金字塔目录（包含 pyramid.txt）"));
+  if (!dir.isEmpty()) open_pyramid_dir(dir);
+}
+
+// 打开分块金字塔：图元只引用瓦片库，可见瓦片按需解码，内存受缓存预算限制
+void MainWindow::open_pyramid_dir(const QString& dir) {
+  std::string error;
+  std::shared_ptr<tools::TileStore> store = tools::TileStore::open(dir.toUtf8().toStdString(), &error);
+  if (!store) {
+    QMessageBox::critical(this, tr(u8"错误"), tr(u8"无法打开金字塔：") + QString::fromStdString(error));
+    return;
+  }
+  stop_stream();
+  executor_->cancel_all();
+  overlays_->ClearAll();
+  if (document_) tools::StageCache::global().drop_image(document_->id());
+  document_.reset();
+  remove_document_image();
+  remove_tiled_image();
+
+  tile_store_ = std::move(store);
+  tiled_item_ = new TiledImageItem(tile_store_);
+  scene_->addItem(tiled_item_);
+  scene_->setSceneRect(tiled_item_->boundingRect());
+  view_->SetImageItem(tiled_item_);
+  view_->fitInView(tiled_item_->boundingRect(), Qt::KeepAspectRatio);
+
+  const tools::PyramidInfo& info = tile_store_->info();
+  setWindowTitle(tr(u8"已加载大图：%1（%2 x %3，%4 层）").arg(dir).arg(info.width).arg(info.height).arg(info.levels));
+}
+
+void MainWindow::remove_tiled_image() {
+  if (!tiled_item_) return;
+  scene_->removeItem(tiled_item_);
+  delete tiled_item_;
+  tiled_item_ = nullptr;
+  tile_store_.reset();
+}
+
+void MainWindow::remove_document_image() {
+  if (!document_item_) return;
+  scene_->removeItem(document_item_);
+  delete document_item_;
+  document_item_ = nullptr;
+}
+
+// 由普通图片生成分块金字塔（后台线程），完成后直接打开
+void MainWindow::build_pyramid() {
+  if (pyramid_build_.valid() && pyramid_build_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    QMessageBox::information(this, tr(u8"提示"), tr(u8"正在生成金字塔，请稍候！"));
+    return;
+  }
+  const QString image_path = QFileDialog::getOpenFileName(
+    this, tr(u8"选择图片"), "", tr(u8"图片文件 (*.png *.jpg *.jpeg *.bmp *.tif *.tiff)"));
+  if (image_path.isEmpty()) return;
+  const QString out_dir = QFileDialog::getExistingDirectory(this, tr(u8"选择输出目录"));
+  if (out_dir.isEmpty()) return;
+
+  statusBar()->showMessage(tr(u8"正在生成金字塔..."));
+  pyramid_build_ = tools::ThreadPool::global().submit([this, image_path, out_dir]() {
+    std::string error;
+    const bool ok = tools::build_pyramid(image_path.toUtf8().toStdString(), out_dir.toUtf8().toStdString(), 512, &error,
+      [this](int percent) {
+        QMetaObject::invokeMethod(this, [this, percent]() {
+          statusBar()->showMessage(tr(u8"正在生成金字塔... %1%").arg(percent));
+        }, Qt::QueuedConnection);
+      });
+    QMetaObject::invokeMethod(this, [this, ok, error, out_dir]() {
+      if (!ok) {
+        statusBar()->clearMessage();
+        QMessageBox::critical(this, tr(u8"错误"), tr(u8"生成金字塔失败：") + QString::fromStdString(error));
+        return;
+      }
+      statusBar()->showMessage(tr(u8"金字塔已生成：") + out_dir);
+      open_pyramid_dir(out_dir);
+    }, Qt::QueuedConnection);
+  });
+}
+
 void MainWindow::wheelEvent(QWheelEvent* event) {
   if (!view_) {
     return;
@@ -650,4 +1562,113 @@ void MainWindow::wheelEvent(QWheelEvent* event) {
   }
 
   view_->scale(scale_factor, scale_factor);
-}
\ No newline at end of file
+}
+
+qreal MainWindow::pick_radius() const {
+  const qreal scale = view_ ? std::abs(view_->transform().m11()) : 1.0;
+  return kPickRadiusPx / std::max(scale, 1e-6);
+}
+
+void MainWindow::on_view_hover(const QPointF& scene_pos) {
+  overlays_->Hover(scene_pos, pick_radius());
+}
+
+void MainWindow::on_view_clicked(const QPointF& scene_pos, Qt::KeyboardModifiers modifiers) {
+  overlays_->Select(scene_pos, pick_radius(), modifiers.testFlag(Qt::ControlModifier));
+  show_selection_measurement();
+}
+
+void MainWindow::on_selection_rect(const QRectF& rect) {
+  const int count = overlays_->SelectIn(rect);
+  statusBar()->showMessage(tr(u8"框选：%1 个元素").arg(count));
+}
+
+// 点到直线（无限延长）的垂直距离
+static double point_line_distance(const cv::Point2f& p, const cv::Vec4f& l) {
+  const double dx = l[2] - l[0], dy = l[3] - l[1];
+  const double len = std::hypot(dx, dy);
+  if (len < 1e-9) return std::hypot(p.x - l[0], p.y - l[1]);
+  return std::abs((p.x - l[0]) * dy - (p.y - l[1]) * dx) / len;
+}
+
+static double line_angle_deg(const cv::Vec4f& l) {
+  return std::atan2(l[3] - l[1], l[2] - l[0]) * 180.0 / CV_PI;
+}
+
+// 选中一个元素时显示其几何，两个时显示测量值
+void MainWindow::show_selection_measurement() {
+  using Type = tools::ResultIndex::Type;
+  auto selection = overlays_->Selection();
+  auto num = [](double v) { return QString::number(v, 'f', 2); };
+  if (selection.isEmpty()) {
+    statusBar()->clearMessage();
+    return;
+  }
+  if (selection.size() == 1) {
+    const auto& s = selection.front();
+    const tools::ResultIndex& index = s.item->Index();
+    switch (s.element.type) {
+    case Type::Line: {
+      const cv::Vec4f& l = index.line(s.element.index);
+      statusBar()->showMessage(tr(u8"直线 (%1, %2)-(%3, %4)  长度 %5  角度 %6°")
+        .arg(num(l[0]), num(l[1]), num(l[2]), num(l[3]))
+        .arg(num(std::hypot(l[2] - l[0], l[3] - l[1])), num(line_angle_deg(l))));
+      break;
+    }
+    case Type::Point: {
+      const cv::Point2f& p = index.point(s.element.index);
+      statusBar()->showMessage(tr(u8"点 (%1, %2)").arg(num(p.x), num(p.y)));
+      break;
+    }
+    case Type::Circle: {
+      const cv::Vec3f& c = index.circle(s.element.index);
+      statusBar()->showMessage(tr(u8"圆 圆心 (%1, %2)  半径 %3").arg(num(c[0]), num(c[1]), num(c[2])));
+      break;
+    }
+    }
+    return;
+  }
+  if (selection.size() > 2) {
+    statusBar()->showMessage(tr(u8"已选中 %1 个元素").arg(selection.size()));
+    return;
+  }
+
+  // 两个元素：按 点 < 直线 < 圆 排序后分情况测量
+  auto rank = [](Type t) { return t == Type::Point ? 0 : t == Type::Line ? 1 : 2; };
+  if (rank(selection[0].element.type) > rank(selection[1].element.type)) std::swap(selection[0], selection[1]);
+  const auto& a = selection[0];
+  const auto& b = selection[1];
+  const tools::ResultIndex& ia = a.item->Index();
+  const tools::ResultIndex& ib = b.item->Index();
+  const Type ta = a.element.type, tb = b.element.type;
+  QString text;
+  if (ta == Type::Point && tb == Type::Point) {
+    const cv::Point2f p = ia.point(a.element.index), q = ib.point(b.element.index);
+    text = tr(u8"点-点 距离 %1  (dx %2, dy %3)").arg(num(std::hypot(q.x - p.x, q.y - p.y)), num(q.x - p.x), num(q.y - p.y));
+  } else if (ta == Type::Point && tb == Type::Line) {
+    text = tr(u8"点-直线 垂直距离 %1").arg(num(point_line_distance(ia.point(a.element.index), ib.line(b.element.index))));
+  } else if (ta == Type::Point && tb == Type::Circle) {
+    const cv::Point2f p = ia.point(a.element.index);
+    const cv::Vec3f& c = ib.circle(b.element.index);
+    const double d = std::hypot(p.x - c[0], p.y - c[1]);
+    text = tr(u8"点-圆 到圆心 %1  到圆周 %2").arg(num(d), num(std::abs(d - c[2])));
+  } else if (ta == Type::Line && tb == Type::Line) {
+    const cv::Vec4f& l = ia.line(a.element.index);
+    const cv::Vec4f& m = ib.line(b.element.index);
+    double angle = std::abs(line_angle_deg(l) - line_angle_deg(m));
+    angle = std::fmod(angle, 180.0);
+    if (angle > 90.0) angle = 180.0 - angle;
+    const cv::Point2f mid((l[0] + l[2]) / 2, (l[1] + l[3]) / 2);
+    text = tr(u8"直线-直线 夹角 %1°  中点距离 %2").arg(num(angle), num(point_line_distance(mid, m)));
+  } else if (ta == Type::Line && tb == Type::Circle) {
+    const cv::Vec3f& c = ib.circle(b.element.index);
+    const double d = point_line_distance(cv::Point2f(c[0], c[1]), ia.line(a.element.index));
+    text = tr(u8"直线-圆 圆心到直线 %1  间隙 %2").arg(num(d), num(d - c[2]));
+  } else {
+    const cv::Vec3f& c = ia.circle(a.element.index);
+    const cv::Vec3f& e = ib.circle(b.element.index);
+    const double d = std::hypot(e[0] - c[0], e[1] - c[1]);
+    text = tr(u8"圆-圆 圆心距 %1  半径差 %2").arg(num(d), num(e[2] - c[2]));
+  }
+  statusBar()->showMessage(text);
+}
@@ -4,8 +4,14 @@
 #include <QWheelEvent>
 #include <QPointF>
 #include <QMouseEvent>
+#include <QElapsedTimer>
 #include <opencv2/core.hpp>      // cv::Vec4i
+#include <future>
+#include <map>
+#include <memory>
 #include <vector>     
+#include "tools/tool_spec.h"  // 每个ROI保存一份工具参数
+#include "tools/trace.h"      // 分阶段计时
 // 前向声明
 class QSplitter;
 class QWidget;
@@ -16,16 +22,29 @@ class QLabel;
 class QFrame;
 class QDoubleSpinBox;
 class QSpinBox;
+class QProgressBar;
+class QCheckBox;
+class QComboBox;
+class QTimer;
+class QListWidget;
 
 class QGraphicsScene;
-class QGraphicsPixmapItem;
 class CustomGraphicsView;
+class DocumentImageItem;
+class OverlayLayerManager;
+class TiledImageItem;
 class QStackedWidget;
 
 // 工具接口与结果
 namespace tools {
   class ITool;
   struct DetectionResult;
+  class ImageDocument;
+  class ToolExecutor;
+  class StreamPipeline;
+  class FrameSource;
+  class TileStore;
+  struct RunOutcome;
 }
 
 // 新增：OpenCV 前向声明（避免直接包含头文件）
@@ -50,11 +69,40 @@ private slots:
   void on_execute_tool_clicked(); // 执行当前工具逻辑
   void on_point_tool_clicked(); // 找点工具
   void on_circle_tool_clicked(); // 找圆工具
+  void on_caliper_tool_clicked(); // 卡尺找线工具
+  void on_circle_fit_tool_clicked(); // 拟合找圆工具
+  void on_cancel_run_clicked(); // 取消后台运行
+  void on_tool_param_changed(); // 参数变化（实时预览）
+  void on_live_preview_toggled(bool enabled);
+  void on_add_roi_clicked();      // 当前绘制的矩形保存为ROI（使用当前参数）
+  void on_apply_roi_params_clicked();
+  void on_remove_roi_clicked();
+  void on_run_all_rois_clicked(); // 所有ROI一次并行执行
+  void on_export_trace_clicked(); // 导出Chrome trace JSON
+  // 流模式：视频文件 / 图像序列目录，逐帧运行当前工具
+  void open_video_file();
+  void open_image_sequence();
+  void open_shared_frames();      // 采集进程写入的共享内存帧环（零拷贝）
+  void stop_stream();
+  void on_stream_tick();          // 渲染阶段：取最新检测结果并显示
+  // 超大图：打开分块金字塔目录 / 由图片生成金字塔
+  void open_pyramid();
+  void build_pyramid();
+  // 结果元素：悬停高亮、单击选择（Ctrl追加）、Shift框选，选中两个时测量
+  void on_view_hover(const QPointF& scene_pos);
+  void on_view_clicked(const QPointF& scene_pos, Qt::KeyboardModifiers modifiers);
+  void on_selection_rect(const QRectF& rect);
 
 private:
   QGraphicsScene* scene_ = nullptr;
   CustomGraphicsView* view_ = nullptr;
-  QGraphicsPixmapItem* pixmap_item_ = nullptr;
+  DocumentImageItem* document_item_ = nullptr;      // 图片或流的当前帧：直接绘制文档像素
+  // 当前图片文档：打开时解码一次，显示与工具共用同一份像素
+  std::shared_ptr<tools::ImageDocument> document_;
+  // 后台工具执行器（工作线程池，新运行取代旧运行）
+  std::unique_ptr<tools::ToolExecutor> executor_;
+  // 检测结果图层（图元复用，历史深度可配置）
+  std::unique_ptr<OverlayLayerManager> overlays_;
 
   // 新增：找线工具参数控件（方便后续访问参数值）
   QDoubleSpinBox* rho_spin_ = nullptr;       // 霍夫检测rho参数
@@ -62,10 +110,17 @@ private:
   QSpinBox* threshold_spin_ = nullptr;       // 阈值
   QDoubleSpinBox* min_line_len_spin_ = nullptr; // 最小线长
   QDoubleSpinBox* max_line_gap_spin_ = nullptr; // 最大线间隙
+  QCheckBox* line_tiled_check_ = nullptr;       // 分块并行检测
+  QCheckBox* line_fused_check_ = nullptr;       // 单遍边缘前端
+  QSpinBox* line_pyramid_spin_ = nullptr;       // 金字塔层数（0=关闭）
   // Point tool params
   QSpinBox* point_max_corners_spin_ = nullptr;
   QDoubleSpinBox* point_quality_spin_ = nullptr;
   QDoubleSpinBox* point_min_distance_spin_ = nullptr;
+  QCheckBox* point_grid_check_ = nullptr;       // 网格引擎（大量角点）
+  QSpinBox* point_cell_size_spin_ = nullptr;
+  QSpinBox* point_per_cell_spin_ = nullptr;
+  QCheckBox* point_subpix_check_ = nullptr;
   // Circle tool params
   QDoubleSpinBox* circle_dp_spin_ = nullptr;
   QDoubleSpinBox* circle_min_dist_spin_ = nullptr;
@@ -73,6 +128,22 @@ private:
   QDoubleSpinBox* circle_param2_spin_ = nullptr;
   QSpinBox* circle_min_radius_spin_ = nullptr;
   QSpinBox* circle_max_radius_spin_ = nullptr;
+  QSpinBox* circle_pyramid_spin_ = nullptr;
+  // 卡尺找线参数
+  QDoubleSpinBox* caliper_angle_spin_ = nullptr;
+  QSpinBox* caliper_count_spin_ = nullptr;
+  QSpinBox* caliper_width_spin_ = nullptr;
+  QDoubleSpinBox* caliper_sigma_spin_ = nullptr;
+  QDoubleSpinBox* caliper_min_gradient_spin_ = nullptr;
+  QComboBox* caliper_polarity_combo_ = nullptr;
+  QDoubleSpinBox* caliper_inlier_spin_ = nullptr;
+  // 拟合找圆参数
+  QDoubleSpinBox* circle_fit_radius_spin_ = nullptr;
+  QDoubleSpinBox* circle_fit_search_spin_ = nullptr;
+  QSpinBox* circle_fit_rays_spin_ = nullptr;
+  QDoubleSpinBox* circle_fit_min_gradient_spin_ = nullptr;
+  QComboBox* circle_fit_polarity_combo_ = nullptr;
+  QDoubleSpinBox* circle_fit_inlier_spin_ = nullptr;
   QWidget* param_panel_ = nullptr;           // 参数面板容器（控制显示/隐藏）
   // 新增：选项卡与页面引用，便于在槽函数中切换页面
   class QTabWidget* tabs_ = nullptr;
@@ -81,23 +152,66 @@ private:
   QStackedWidget* element_stack_ = nullptr;
   QWidget* element_list_page_ = nullptr;
   // 当前选中的工具
-  enum class ToolType { None, Line, Point, Circle };
+  enum class ToolType { None, Line, Point, Circle, Caliper, CircleFit };
   ToolType current_tool_ = ToolType::None;
   void show_param_for_tool(ToolType t);
   // parameter widget groups
   QWidget* line_param_widget_ = nullptr;
   QWidget* point_param_widget_ = nullptr;
   QWidget* circle_param_widget_ = nullptr;
+  QWidget* caliper_param_widget_ = nullptr;
+  QWidget* circle_fit_param_widget_ = nullptr;
   QPushButton* execute_btn_ = nullptr;
+  QProgressBar* progress_bar_ = nullptr;
+  QPushButton* cancel_run_btn_ = nullptr;
+  QLabel* run_status_label_ = nullptr;
+  // 实时预览
+  QCheckBox* live_preview_check_ = nullptr;
+  QTimer* preview_timer_ = nullptr;   // 防抖定时器
+  QElapsedTimer preview_latency_;     // 参数变化到结果显示的端到端计时
+  // 结果缓存：相同图像+ROI+参数直接返回上次结果；勾选时同时存盘，重启后仍有效
+  QCheckBox* result_cache_check_ = nullptr;
+  // 多ROI：列表 + 每个ROI各自的工具参数
+  QListWidget* roi_list_ = nullptr;
+  std::map<int, tools::ToolSpec> roi_specs_;
+  void refresh_roi_list();
+  // 性能追踪：开关、上次运行的分阶段汇总、累计事件（用于导出）
+  QCheckBox* trace_check_ = nullptr;
+  QLabel* trace_label_ = nullptr;
+  std::vector<tools::trace::Event> trace_events_;
+  void update_trace_summary();
+  // 流模式：解码/检测在后台流水线中运行，渲染由定时器在GUI线程完成
+  std::unique_ptr<tools::StreamPipeline> stream_;
+  QTimer* stream_timer_ = nullptr;
+  QAction* stop_stream_action_ = nullptr;
+  void start_stream(const QString& path);
+  void start_stream(std::unique_ptr<tools::FrameSource> source, const QString& title);
+  QString shared_frames_key_ = QStringLiteral("camera");
+  // 超大图：瓦片按需从磁盘读取，工具从同一瓦片库读取ROI像素
+  std::shared_ptr<tools::TileStore> tile_store_;
+  TiledImageItem* tiled_item_ = nullptr;
+  std::future<void> pyramid_build_;
+  void open_pyramid_dir(const QString& dir);
+  void remove_tiled_image();
+  void remove_document_image();
+  // 命中半径：屏幕上固定像素数换算到场景坐标
+  qreal pick_radius() const;
+  void show_selection_measurement();
 
   void init_ui();
   QWidget* create_tool_panel();
   // 新增：OpenCV 找线核心函数
   void find_lines_with_opencv();
-  // 新增：QPixmap 转 cv::Mat
-  cv::Mat qpixmap_to_cvmat(const QPixmap& pixmap);
   // 新增：绘制检测到的直线到场景
   void draw_lines_to_scene(const std::vector<cv::Vec4i>& lines);
   void draw_points_to_scene(const std::vector<cv::Point2f>& points);
   void draw_circles_to_scene(const std::vector<cv::Vec3f>& circles);
+  void draw_caliper_result(const tools::DetectionResult& result);
+  void draw_circle_fit_result(const tools::DetectionResult& result);
+  tools::ToolSpec current_tool_spec() const;
+  std::shared_ptr<tools::ITool> make_current_tool() const;
+  void submit_current_tool(bool live);
+  // kind：提交运行时的工具（结果到达时 current_tool_ 可能已切换）
+  void handle_run_outcome(const tools::RunOutcome& outcome, bool live, ToolType kind);
+  void handle_batch_outcome(const tools::RunOutcome& outcome);
 };
\ No newline at end of file
@@ -0,0 +1,175 @@
+﻿#include "overlay_layer_manager.h"
+#include "detection_overlay_item.h"
+#include <QGraphicsScene>
+#include <algorithm>
+
+namespace {
+// 对象池上限：超过的图元直接删除，避免长期占用大块几何缓冲
+const int kMaxPooledItems = 4;
+// 结果图层位于图片之上、ROI之下
+const qreal kOverlayZ = 1.0;
+}
+
+OverlayLayerManager::OverlayLayerManager(QGraphicsScene* scene) : scene_(scene) {}
+
+DetectionOverlayItem* OverlayLayerManager::Layer(const QString& name) {
+  auto it = layers_.find(name);
+  if (it != layers_.end()) return it.value();
+  DetectionOverlayItem* item = acquire();
+  layers_.insert(name, item);
+  return item;
+}
+
+DetectionOverlayItem* OverlayLayerManager::NewRunLayer(QString* name) {
+  const QString run_name = QStringLiteral("run-%1").arg(++run_counter_);
+  DetectionOverlayItem* item = Layer(run_name);
+  run_order_.append(run_name);
+  evict_runs();
+  if (name) *name = run_name;
+  return item;
+}
+
+void OverlayLayerManager::SetLayerVisible(const QString& name, bool visible) {
+  auto it = layers_.find(name);
+  if (it != layers_.end()) it.value()->setVisible(visible);
+}
+
+void OverlayLayerManager::RemoveLayer(const QString& name) {
+  auto it = layers_.find(name);
+  if (it == layers_.end()) return;
+  release(it.value());
+  layers_.erase(it);
+  run_order_.removeOne(name);
+}
+
+void OverlayLayerManager::ClearAll() {
+  for (DetectionOverlayItem* item : layers_) release(item);
+  layers_.clear();
+  run_order_.clear();
+}
+
+void OverlayLayerManager::SetHistoryDepth(int depth) {
+  history_depth_ = qMax(1, depth);
+  evict_runs();
+}
+
+void OverlayLayerManager::evict_runs() {
+  while (run_order_.size() > history_depth_) {
+    const QString oldest = run_order_.takeFirst();
+    auto it = layers_.find(oldest);
+    if (it != layers_.end()) {
+      release(it.value());
+      layers_.erase(it);
+    }
+  }
+}
+
+DetectionOverlayItem* OverlayLayerManager::HitTest(const QPointF& scene_pos, qreal radius, tools::ResultIndex::Hit* hit) const {
+  DetectionOverlayItem* best = nullptr;
+  tools::ResultIndex::Hit best_hit;
+  for (DetectionOverlayItem* item : layers_) {
+    if (!item->isVisible()) continue;
+    tools::ResultIndex::Hit h;
+    if (item->HitTest(scene_pos, radius, &h) && (!best || h.distance < best_hit.distance)) {
+      best = item;
+      best_hit = h;
+    }
+  }
+  if (best && hit) *hit = best_hit;
+  return best;
+}
+
+bool OverlayLayerManager::Hover(const QPointF& scene_pos, qreal radius) {
+  tools::ResultIndex::Hit hit;
+  DetectionOverlayItem* item = HitTest(scene_pos, radius, &hit);
+  const bool stale = hovered_.item && hovered_.item->Revision() != hovered_.revision;
+  if (hovered_.item && (hovered_.item != item || stale)) {
+    if (!stale) hovered_.item->SetHighlight(tools::ResultIndex::Element());
+    hovered_ = Selected();
+  }
+  if (!item) return false;
+  item->SetHighlight(hit.element);
+  hovered_ = Selected{ item, hit.element, item->Revision() };
+  return true;
+}
+
+void OverlayLayerManager::Select(const QPointF& scene_pos, qreal radius, bool add) {
+  prune_selection();
+  tools::ResultIndex::Hit hit;
+  DetectionOverlayItem* item = HitTest(scene_pos, radius, &hit);
+  if (!add) selection_.clear();
+  if (item) {
+    const Selected picked{ item, hit.element, item->Revision() };
+    auto same = [&](const Selected& s) { return s.item == picked.item && s.element == picked.element; };
+    auto it = std::find_if(selection_.begin(), selection_.end(), same);
+    if (it != selection_.end()) selection_.erase(it);
+    else selection_.append(picked);
+  }
+  apply_selection();
+}
+
+int OverlayLayerManager::SelectIn(const QRectF& scene_rect) {
+  prune_selection();
+  selection_.clear();
+  for (DetectionOverlayItem* item : layers_) {
+    if (!item->isVisible()) continue;
+    for (const auto& e : item->ElementsIn(scene_rect)) selection_.append(Selected{ item, e, item->Revision() });
+  }
+  apply_selection();
+  return selection_.size();
+}
+
+void OverlayLayerManager::ClearSelection() {
+  prune_selection();
+  selection_.clear();
+  apply_selection();
+}
+
+QVector<OverlayLayerManager::Selected> OverlayLayerManager::Selection() {
+  prune_selection();
+  return selection_;
+}
+
+// 图层内容被替换后（版本号变化）旧的元素编号不再有效
+void OverlayLayerManager::prune_selection() {
+  selection_.erase(std::remove_if(selection_.begin(), selection_.end(),
+                                  [](const Selected& s) { return s.item->Revision() != s.revision; }),
+                   selection_.end());
+}
+
+// 按图层分组下发选中元素；本次没有选中项的图层清空选中显示
+void OverlayLayerManager::apply_selection() {
+  QHash<DetectionOverlayItem*, std::vector<tools::ResultIndex::Element>> per_item;
+  for (const Selected& s : selection_) per_item[s.item].push_back(s.element);
+  for (DetectionOverlayItem* item : layers_) item->SetSelection(per_item.value(item));
+}
+
+DetectionOverlayItem* OverlayLayerManager::acquire() {
+  DetectionOverlayItem* item = nullptr;
+  if (!pool_.isEmpty()) {
+    item = pool_.takeLast();
+  } else {
+    item = new DetectionOverlayItem();
+    item->setZValue(kOverlayZ);
+    scene_->addItem(item);
+  }
+  item->setVisible(true);
+  return item;
+}
+
+// 回收：清空几何、隐藏并留在场景中，下次直接复用（无需重新插入场景索引）
+void OverlayLayerManager::release(DetectionOverlayItem* item) {
+  // 图元可能被删除，先丢掉指向它的悬停与选中项
+  if (hovered_.item == item) hovered_ = Selected();
+  selection_.erase(std::remove_if(selection_.begin(), selection_.end(),
+                                  [item](const Selected& s) { return s.item == item; }),
+                   selection_.end());
+  if (pool_.size() >= kMaxPooledItems) {
+    scene_->removeItem(item);
+    delete item;
+    return;
+  }
+  item->Clear();
+  item->setVisible(false);
+  pool_.append(item);
+}
@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+#include "tools/result_index.h"
+
+class QGraphicsScene;
+class DetectionOverlayItem;
+
+// 结果图层管理：每个命名图层对应一个 DetectionOverlayItem。
+// 图层可以替换、隐藏、清除；释放的图元放回对象池复用。
+// 运行结果图层按历史深度自动淘汰最旧的。
+// 悬停与选中状态也在这里维护：查询走各图层的网格索引，图层被回收或内容被替换后对应的选中项自动失效。
+class OverlayLayerManager {
+public:
+  // 选中的一个结果元素：所在图层图元 + 元素编号
+  struct Selected {
+    DetectionOverlayItem* item = nullptr;
+    tools::ResultIndex::Element element;
+    quint64 revision = 0;
+  };
+
+  // 图元归场景所有，管理器只记录引用
+  explicit OverlayLayerManager(QGraphicsScene* scene);
+
+  // 获取（不存在则创建）命名图层，调用方负责填充内容
+  DetectionOverlayItem* Layer(const QString& name);
+  // 新建一个运行结果图层（"run-N"），超过历史深度时淘汰最旧的运行
+  DetectionOverlayItem* NewRunLayer(QString* name = nullptr);
+
+  bool HasLayer(const QString& name) const { return layers_.contains(name); }
+  void SetLayerVisible(const QString& name, bool visible);
+  void RemoveLayer(const QString& name);
+  void ClearAll();
+
+  void SetHistoryDepth(int depth);
+  int HistoryDepth() const { return history_depth_; }
+  QStringList LayerNames() const { return layers_.keys(); }
+
+  // 所有可见图层中距 scene_pos 在 radius 以内且最近的元素
+  DetectionOverlayItem* HitTest(const QPointF& scene_pos, qreal radius, tools::ResultIndex::Hit* hit) const;
+  // 悬停高亮：命中的元素高亮，其余取消；返回是否命中
+  bool Hover(const QPointF& scene_pos, qreal radius);
+  // 点选：add 为 true 时追加（再次点击已选元素则取消选中），否则替换；空白处点击清空选择
+  void Select(const QPointF& scene_pos, qreal radius, bool add);
+  // 框选：所有可见图层中与矩形相交的元素，返回数量
+  int SelectIn(const QRectF& scene_rect);
+  void ClearSelection();
+  // 当前仍有效的选中项（按选中顺序）
+  QVector<Selected> Selection();
+
+private:
+  DetectionOverlayItem* acquire();
+  void release(DetectionOverlayItem* item);
+  void evict_runs();
+  void prune_selection();
+  void apply_selection();
+
+  QGraphicsScene* scene_ = nullptr;
+  QHash<QString, DetectionOverlayItem*> layers_;
+  QList<QString> run_order_;               // 运行图层，旧的在前
+  QVector<DetectionOverlayItem*> pool_;    // 已隐藏、可复用的图元
+  int history_depth_ = 5;
+  int run_counter_ = 0;
+  Selected hovered_;
+  QVector<Selected> selection_;
+};
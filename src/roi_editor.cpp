@@ -0,0 +1,189 @@
+﻿#include "roi_editor.h"
+#include <QPainter>
+#include <QtMath>
+#include <cmath>
+
+namespace {
+// 手柄边长、旋转手柄到上边的距离（屏幕像素）
+const qreal kHandlePx = 8.0;
+const qreal kRotateOffsetPx = 24.0;
+// 重绘条带在画笔之外的余量（抗锯齿）
+const qreal kDirtyMarginPx = 2.0;
+const qreal kRotateSnapDeg = 15.0;
+
+// 手柄在局部坐标（以中心为原点、未旋转）中的方向，与 Handle 的 TopLeft..Left 顺序一致
+const int kHandleSigns[8][2] = {
+  { -1, -1 }, { 0, -1 }, { 1, -1 }, { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }
+};
+
+QTransform rotation(qreal angle) {
+  QTransform t;
+  t.rotate(angle);
+  return t;
+}
+
+// 线段 p-q 两侧各 m 像素的条带
+QRegion segment_band(const QPointF& p, const QPointF& q, qreal m) {
+  const QPointF d = q - p;
+  const qreal len = std::hypot(d.x(), d.y());
+  if (len < 1e-6) return QRegion(QRectF(p.x() - m, p.y() - m, 2 * m, 2 * m).toAlignedRect());
+  const QPointF t = d * (m / len);
+  const QPointF n(-t.y(), t.x());
+  QPolygonF quad;
+  quad << p - t + n << q + t + n << q + t - n << p - t - n;
+  return QRegion(quad.toPolygon());
+}
+}
+
+RoiShape RoiShape::FromRect(const QRectF& rect) {
+  RoiShape s;
+  s.center = rect.center();
+  s.size = rect.size();
+  return s;
+}
+
+QPolygonF RoiShape::Polygon() const {
+  const qreal hw = size.width() / 2, hh = size.height() / 2;
+  const QTransform r = rotation(angle);
+  QPolygonF poly;
+  poly << center + r.map(QPointF(-hw, -hh)) << center + r.map(QPointF(hw, -hh))
+       << center + r.map(QPointF(hw, hh)) << center + r.map(QPointF(-hw, hh));
+  return poly;
+}
+
+QRectF RoiShape::BoundingRect() const {
+  if (!IsRotated()) return QRectF(center.x() - size.width() / 2, center.y() - size.height() / 2, size.width(), size.height());
+  return Polygon().boundingRect();
+}
+
+RoiEditor::RoiEditor(const QPen& pen, const QBrush& brush, bool handles)
+  : pen_(pen), brush_(brush), handles_(handles) {
+  pen_.setCosmetic(true);
+}
+
+// 8个缩放手柄 + 旋转手柄（最后一个）的场景坐标
+QPolygonF RoiEditor::handle_points(const RoiShape& shape, qreal view_scale) const {
+  const qreal hw = shape.size.width() / 2, hh = shape.size.height() / 2;
+  const QTransform r = rotation(shape.angle);
+  QPolygonF pts;
+  pts.reserve(9);
+  for (const auto& s : kHandleSigns) pts.append(shape.center + r.map(QPointF(s[0] * hw, s[1] * hh)));
+  pts.append(shape.center + r.map(QPointF(0, -hh - kRotateOffsetPx / view_scale)));
+  return pts;
+}
+
+// 形状占用的视口区域：轮廓条带、填充、手柄
+QRegion RoiEditor::region(const RoiShape& shape, const QTransform& to_view) const {
+  const QPolygonF poly = to_view.map(shape.Polygon());
+  const qreal m = pen_.widthF() / 2 + kDirtyMarginPx;
+  QRegion out;
+  for (int i = 0; i < 4; ++i) out += segment_band(poly[i], poly[(i + 1) % 4], m);
+  if (handles_) {
+    const QPolygonF pts = to_view.map(handle_points(shape, to_view.m11()));
+    const qreal hs = kHandlePx / 2 + kDirtyMarginPx;
+    for (const QPointF& p : pts) out += QRectF(p.x() - hs, p.y() - hs, 2 * hs, 2 * hs).toAlignedRect();
+    out += segment_band(to_view.map(shape.center + rotation(shape.angle).map(QPointF(0, -shape.size.height() / 2))), pts.back(), m);
+  }
+  return out;
+}
+
+QRegion RoiEditor::Apply(const RoiShape& shape, bool visible, const QTransform& to_view) {
+  const bool was_visible = IsVisible();
+  const RoiShape old = shape_;
+  shape_ = shape;
+  visible_ = visible;
+  const bool now_visible = IsVisible();
+
+  QRegion dirty;
+  if (was_visible) dirty += region(old, to_view);
+  if (now_visible) dirty += region(shape_, to_view);
+  // 填充只有新旧覆盖不同的部分需要重绘（缩放时是边上的窄条）
+  if (brush_.style() != Qt::NoBrush) {
+    const QRegion a = was_visible ? QRegion(to_view.map(old.Polygon()).toPolygon()) : QRegion();
+    const QRegion b = now_visible ? QRegion(to_view.map(shape_.Polygon()).toPolygon()) : QRegion();
+    dirty += a.xored(b);
+  }
+  return dirty;
+}
+
+RoiEditor::Handle RoiEditor::HitTest(const QPointF& scene_pos, qreal view_scale) const {
+  if (!IsVisible()) return Handle::None;
+  if (handles_) {
+    const QPolygonF pts = handle_points(shape_, view_scale);
+    const qreal reach = (kHandlePx / 2 + 2) / view_scale;
+    auto near = [&](const QPointF& p) {
+      return std::abs(p.x() - scene_pos.x()) <= reach && std::abs(p.y() - scene_pos.y()) <= reach;
+    };
+    if (near(pts.back())) return Handle::Rotate;
+    for (int i = 0; i < 8; ++i) {
+      if (near(pts[i])) return static_cast<Handle>(static_cast<int>(Handle::TopLeft) + i);
+    }
+  }
+  if (shape_.Polygon().containsPoint(scene_pos, Qt::OddEvenFill)) return Handle::Move;
+  return Handle::None;
+}
+
+void RoiEditor::BeginDrag(Handle handle, const QPointF& scene_pos) {
+  drag_handle_ = handle;
+  drag_start_shape_ = shape_;
+  drag_start_pos_ = scene_pos;
+}
+
+RoiShape RoiEditor::Dragged(const QPointF& scene_pos, bool snap) const {
+  const RoiShape& s0 = drag_start_shape_;
+  RoiShape s = s0;
+  switch (drag_handle_) {
+  case Handle::None:
+    return RoiShape::FromRect(QRectF(drag_start_pos_, scene_pos).normalized());
+  case Handle::Move:
+    s.center = s0.center + (scene_pos - drag_start_pos_);
+    return s;
+  case Handle::Rotate: {
+    // 旋转手柄在局部 -y 方向：鼠标方向角 + 90 度即ROI角度
+    const QPointF d = scene_pos - s0.center;
+    qreal angle = qRadiansToDegrees(std::atan2(d.y(), d.x())) + 90.0;
+    if (snap) angle = std::round(angle / kRotateSnapDeg) * kRotateSnapDeg;
+    angle = std::remainder(angle, 360.0);
+    s.angle = angle == -180.0 ? 180.0 : angle;
+    return s;
+  }
+  default: {
+    // 缩放：在未旋转的局部坐标中移动被拖动的边，对边保持不动
+    const int i = static_cast<int>(drag_handle_) - static_cast<int>(Handle::TopLeft);
+    const int sx = kHandleSigns[i][0], sy = kHandleSigns[i][1];
+    const QTransform r = rotation(s0.angle);
+    const QPointF local = r.inverted().map(scene_pos - s0.center);
+    const qreal hw = s0.size.width() / 2, hh = s0.size.height() / 2;
+    qreal left = -hw, right = hw, top = -hh, bottom = hh;
+    if (sx < 0) left = local.x();
+    if (sx > 0) right = local.x();
+    if (sy < 0) top = local.y();
+    if (sy > 0) bottom = local.y();
+    const QRectF box = QRectF(QPointF(left, top), QPointF(right, bottom)).normalized();
+    s.size = box.size();
+    s.center = s0.center + r.map(box.center());
+    return s;
+  }
+  }
+}
+
+void RoiEditor::Paint(QPainter* painter, qreal view_scale) const {
+  if (!IsVisible()) return;
+  painter->save();
+  painter->setPen(pen_);
+  painter->setBrush(brush_);
+  painter->drawPolygon(shape_.Polygon());
+  if (handles_) {
+    const QPolygonF pts = handle_points(shape_, view_scale);
+    const QTransform r = rotation(shape_.angle);
+    painter->drawLine(shape_.center + r.map(QPointF(0, -shape_.size.height() / 2)), pts.back());
+    QPen handle_pen(pen_.color(), 1);
+    handle_pen.setCosmetic(true);
+    painter->setPen(handle_pen);
+    painter->setBrush(Qt::white);
+    const qreal hs = kHandlePx / 2 / view_scale;
+    for (int i = 0; i < 8; ++i) painter->drawRect(QRectF(pts[i].x() - hs, pts[i].y() - hs, 2 * hs, 2 * hs));
+    painter->drawEllipse(pts.back(), hs, hs);
+  }
+  painter->restore();
+}
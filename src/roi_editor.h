@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <QBrush>
+#include <QPen>
+#include <QPointF>
+#include <QPolygonF>
+#include <QRectF>
+#include <QRegion>
+#include <QSizeF>
+#include <QTransform>
+
+class QPainter;
+
+// ROI几何：中心、尺寸、旋转角（度，图像坐标下顺时针为正，与 cv::RotatedRect 一致）
+struct RoiShape {
+  QPointF center;
+  QSizeF size;
+  qreal angle = 0.0;
+
+  static RoiShape FromRect(const QRectF& rect);
+  bool IsEmpty() const { return size.width() <= 0 || size.height() <= 0; }
+  bool IsRotated() const { return angle != 0.0; }
+  // 四个角点（场景坐标）：未旋转时依次为左上、右上、右下、左下
+  QPolygonF Polygon() const;
+  QRectF BoundingRect() const;
+};
+
+// 轻量ROI编辑器：不是场景图元，由视图在 drawForeground 中绘制。
+// 负责手柄命中测试、拖动（新建/移动/缩放/旋转）后的几何计算，
+// 以及几何变化时需要重绘的最小视口区域（新旧轮廓条带 + 填充差异 + 手柄）。
+// 画笔为 cosmetic，手柄大小固定为屏幕像素，与缩放无关。
+class RoiEditor {
+public:
+  enum class Handle {
+    None,       // 不在ROI上：拖动新建
+    Move,
+    Rotate,
+    TopLeft, Top, TopRight, Right, BottomRight, Bottom, BottomLeft, Left
+  };
+
+  RoiEditor(const QPen& pen, const QBrush& brush, bool handles);
+
+  const RoiShape& Shape() const { return shape_; }
+  bool IsVisible() const { return visible_ && !shape_.IsEmpty(); }
+  // 设置几何与可见性，返回需要重绘的视口区域（to_view：场景 -> 视口）
+  QRegion Apply(const RoiShape& shape, bool visible, const QTransform& to_view);
+
+  // 命中测试（场景坐标），view_scale 为场景到屏幕的缩放
+  Handle HitTest(const QPointF& scene_pos, qreal view_scale) const;
+  // 记录拖动起点；Dragged 按当前鼠标位置计算新几何，不修改当前几何。
+  // snap：旋转按15度取整
+  void BeginDrag(Handle handle, const QPointF& scene_pos);
+  RoiShape Dragged(const QPointF& scene_pos, bool snap) const;
+  Handle DragHandle() const { return drag_handle_; }
+
+  // painter 处于场景坐标
+  void Paint(QPainter* painter, qreal view_scale) const;
+
+private:
+  QRegion region(const RoiShape& shape, const QTransform& to_view) const;
+  QPolygonF handle_points(const RoiShape& shape, qreal view_scale) const;
+
+  QPen pen_;
+  QBrush brush_;
+  bool handles_ = false;
+  RoiShape shape_;
+  bool visible_ = false;
+
+  Handle drag_handle_ = Handle::None;
+  RoiShape drag_start_shape_;
+  QPointF drag_start_pos_;
+};
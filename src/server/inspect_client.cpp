@@ -0,0 +1,232 @@
+// Test client of inspection_server: sends one recipe for one image, optionally
+// many times with several requests in flight, and prints the responses and
+// the round-trip latency distribution.
+//
+//   inspect_client --recipe line.recipe --image D:/part.png [--set line.threshold=80]...
+//                  [--server inspection] [--format json|binary] [--repeat N] [--inflight K] [--quiet]
+//   inspect_client --recipe line.recipe --shm-image D:/part.png      (publishes it in shared memory)
+//   inspect_client --recipe line.recipe --shm KEY                    (segment written by someone else)
+//   inspect_client --stats [--server inspection]
+
+#include "tools/inspect_protocol.h"
+#include "tools/latency_histogram.h"
+#include "tools/result_io.h"
+#include "tools/tool_spec.h"
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+  std::string server = "inspection";
+  std::string recipe;
+  std::vector<std::string> sets;  // "key=value", applied after the recipe
+  std::string image;
+  std::string shm;
+  std::string shm_image;
+  std::string format = "json";
+  int repeat = 1;
+  int inflight = 1;
+  bool stats = false;
+  bool quiet = false;
+};
+
+using Clock = std::chrono::steady_clock;
+constexpr int kTimeoutMs = 30000;
+
+void print_usage() {
+  std::fprintf(stderr,
+    "usage: inspect_client --recipe FILE (--image PATH | --shm KEY | --shm-image PATH)\n"
+    "                      [--set key=value]... [--server NAME] [--format json|binary]\n"
+    "                      [--repeat N] [--inflight K] [--quiet]\n"
+    "       inspect_client --stats [--server NAME]\n");
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&](std::string& out) {
+      if (i + 1 >= argc) return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string v;
+    if (arg == "--server") { if (!value(opt.server)) return false; }
+    else if (arg == "--recipe") { if (!value(opt.recipe)) return false; }
+    else if (arg == "--set") { if (!value(v)) return false; opt.sets.push_back(v); }
+    else if (arg == "--image") { if (!value(opt.image)) return false; }
+    else if (arg == "--shm") { if (!value(opt.shm)) return false; }
+    else if (arg == "--shm-image") { if (!value(opt.shm_image)) return false; }
+    else if (arg == "--format") { if (!value(opt.format)) return false; }
+    else if (arg == "--repeat") { if (!value(v)) return false; opt.repeat = std::max(1, std::stoi(v)); }
+    else if (arg == "--inflight") { if (!value(v)) return false; opt.inflight = std::max(1, std::stoi(v)); }
+    else if (arg == "--stats") { opt.stats = true; }
+    else if (arg == "--quiet") { opt.quiet = true; }
+    else return false;
+  }
+  if (opt.stats) return true;
+  const int sources = !opt.image.empty() + !opt.shm.empty() + !opt.shm_image.empty();
+  return !opt.recipe.empty() && sources == 1 && (opt.format == "json" || opt.format == "binary");
+}
+
+cv::Mat decode_gray(const fs::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return cv::Mat();
+  std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (bytes.empty()) return cv::Mat();
+  return cv::imdecode(bytes, cv::IMREAD_GRAYSCALE);
+}
+
+// "id":"..." of a JSON response; ids sent by this client need no escaping
+std::string json_id(const std::string& json) {
+  const char key[] = "\"id\":\"";
+  const size_t b = json.find(key);
+  if (b == std::string::npos) return std::string();
+  const size_t s = b + sizeof(key) - 1;
+  return json.substr(s, json.find('"', s) - s);
+}
+
+bool send(QLocalSocket& socket, const std::string& payload) {
+  std::string frame;
+  tools::append_frame(frame, payload);
+  socket.write(frame.data(), static_cast<qint64>(frame.size()));
+  return socket.waitForBytesWritten(kTimeoutMs) || socket.bytesToWrite() == 0;
+}
+
+bool receive(QLocalSocket& socket, std::string& buffer, std::string& payload) {
+  std::string error;
+  while (!tools::take_frame(buffer, payload, &error)) {
+    if (!error.empty() || !socket.waitForReadyRead(kTimeoutMs)) return false;
+    const QByteArray data = socket.readAll();
+    buffer.append(data.constData(), static_cast<size_t>(data.size()));
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  Options opt;
+  try {
+    if (!parse_args(argc, argv, opt)) {
+      print_usage();
+      return 2;
+    }
+  } catch (const std::exception&) {
+    print_usage();
+    return 2;
+  }
+
+  tools::InspectRequest request;
+  request.stats = opt.stats;
+  request.binary = opt.format == "binary";
+  std::string error;
+  if (!opt.stats) {
+    if (!tools::load_recipe(opt.recipe, request.recipe, &error)) {
+      std::fprintf(stderr, "recipe: %s\n", error.c_str());
+      return 1;
+    }
+    for (const std::string& set : opt.sets) {
+      if (!tools::parse_recipe_line(request.recipe, set, &error)) {
+        std::fprintf(stderr, "--set %s: %s\n", set.c_str(), error.c_str());
+        return 1;
+      }
+    }
+    request.image = opt.image;
+    request.shm = opt.shm;
+  }
+
+  // --shm-image: publish the image ourselves; the segment lives until exit
+  QSharedMemory segment;
+  if (!opt.shm_image.empty()) {
+    const cv::Mat gray = decode_gray(fs::u8path(opt.shm_image));
+    if (gray.empty()) {
+      std::fprintf(stderr, "cannot decode %s\n", opt.shm_image.c_str());
+      return 1;
+    }
+    request.shm = "inspect_client_" + std::to_string(QCoreApplication::applicationPid());
+    segment.setKey(QString::fromStdString(request.shm));
+    if (!segment.create(static_cast<int>(tools::shared_image_bytes(gray)))) {
+      std::fprintf(stderr, "shared memory: %s\n", segment.errorString().toLocal8Bit().constData());
+      return 1;
+    }
+    segment.lock();
+    tools::write_shared_image(segment.data(), gray);
+    segment.unlock();
+  }
+
+  QLocalSocket socket;
+  socket.connectToServer(QString::fromStdString(opt.server));
+  if (!socket.waitForConnected(kTimeoutMs)) {
+    std::fprintf(stderr, "cannot connect to %s: %s\n", opt.server.c_str(),
+                 socket.errorString().toLocal8Bit().constData());
+    return 1;
+  }
+
+  const int total = opt.stats ? 1 : opt.repeat;
+  std::unordered_map<std::string, Clock::time_point> pending;
+  tools::LatencyHistogram latency;
+  std::string buffer, payload;
+  int sent = 0, received = 0, failed = 0;
+  const Clock::time_point t_start = Clock::now();
+  while (received < total) {
+    // keep up to --inflight requests pipelined on the connection
+    while (sent < total && sent - received < opt.inflight) {
+      request.id = std::to_string(++sent);
+      pending[request.id] = Clock::now();
+      if (!send(socket, tools::format_request(request))) {
+        std::fprintf(stderr, "send failed: %s\n", socket.errorString().toLocal8Bit().constData());
+        return 1;
+      }
+    }
+    if (!receive(socket, buffer, payload)) {
+      std::fprintf(stderr, "no response: %s\n", socket.errorString().toLocal8Bit().constData());
+      return 1;
+    }
+    ++received;
+
+    tools::InspectResponse response;
+    std::string line = payload;
+    if (request.binary && !opt.stats) {
+      if (!tools::decode_binary_response(payload, response, &error)) {
+        std::fprintf(stderr, "bad response: %s\n", error.c_str());
+        return 1;
+      }
+      line = response.ok ? tools::to_json(response.result) : "error: " + response.error;
+    } else {
+      response.id = json_id(payload);
+      response.ok = payload.find("\"ok\":true") != std::string::npos;
+    }
+    if (!response.ok) ++failed;
+    const auto it = pending.find(response.id);
+    if (it != pending.end()) {
+      latency.record(std::chrono::duration<double, std::milli>(Clock::now() - it->second).count());
+      pending.erase(it);
+    }
+    if (!opt.quiet) std::printf("%s\n", line.c_str());
+  }
+
+  if (!opt.stats) {
+    const double seconds = std::chrono::duration<double>(Clock::now() - t_start).count();
+    std::fprintf(stderr, "%d requests, %d failed, %.1f req/s, round trip %s\n", received, failed,
+                 seconds > 0.0 ? received / seconds : 0.0, latency.to_text().c_str());
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,255 @@
+#include "inspection_server.h"
+
+#include "tools/oriented_roi.h"
+#include "tools/stage_cache.h"
+#include "tools/tool_spec.h"
+#include "tools/trace.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// how long listen() waits for a server already using the name to answer
+constexpr int kProbeMs = 500;
+
+double ms_since(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+InspectionServer::InspectionServer(Options options, QObject* parent)
+  : QObject(parent),
+    options_(std::move(options)),
+    server_(new QLocalServer(this)),
+    pool_(std::make_unique<tools::ThreadPool>(options_.workers)) {
+  connect(server_, &QLocalServer::newConnection, this, &InspectionServer::on_new_connection);
+}
+
+InspectionServer::~InspectionServer() {
+  // join the workers before the sockets and the image cache go away; their
+  // queued deliveries are discarded with this object
+  pool_.reset();
+}
+
+bool InspectionServer::listen(QString* error) {
+  // a previous instance that crashed leaves its socket file behind (Unix);
+  // remove it only when nobody answers on it, never a live server's socket
+  QLocalSocket probe;
+  probe.connectToServer(options_.name);
+  if (probe.waitForConnected(kProbeMs)) {
+    probe.disconnectFromServer();
+    if (error) *error = QStringLiteral("another server is already running under this name");
+    return false;
+  }
+  QLocalServer::removeServer(options_.name);
+  if (server_->listen(options_.name)) return true;
+  if (error) *error = server_->errorString();
+  return false;
+}
+
+QString InspectionServer::full_server_name() const {
+  return server_->fullServerName();
+}
+
+void InspectionServer::on_new_connection() {
+  while (QLocalSocket* socket = server_->nextPendingConnection()) {
+    buffers_[socket];
+    ++connections_;
+    connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { on_ready_read(socket); });
+    connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+      buffers_.erase(socket);
+      --connections_;
+      socket->deleteLater();
+    });
+  }
+}
+
+void InspectionServer::on_ready_read(QLocalSocket* socket) {
+  auto it = buffers_.find(socket);
+  if (it == buffers_.end()) return;
+  std::string& buffer = it->second;
+  const QByteArray data = socket->readAll();
+  buffer.append(data.constData(), static_cast<size_t>(data.size()));
+
+  std::string payload, error;
+  while (tools::take_frame(buffer, payload, &error)) {
+    const Clock::time_point received = Clock::now();
+    QPointer<QLocalSocket> target(socket);
+    ++in_flight_;
+    pool_->post([this, target, payload = std::move(payload), received]() {
+      bool ok = false;
+      std::string frame = process(payload, received, ok);
+      QMetaObject::invokeMethod(this, [this, target, frame = std::move(frame), received, ok]() {
+        deliver(target, frame, received, ok);
+      }, Qt::QueuedConnection);
+    });
+    payload.clear();
+  }
+  if (!error.empty()) {
+    // the stream cannot be resynchronized after a bad length prefix
+    tools::InspectResponse response;
+    response.error = error;
+    std::string frame;
+    tools::append_frame(frame, tools::encode_response(response, false));
+    socket->write(frame.data(), static_cast<qint64>(frame.size()));
+    ++errors_;
+    socket->disconnectFromServer();
+  }
+}
+
+std::string InspectionServer::process(const std::string& payload, Clock::time_point received, bool& ok) {
+  TRACE_SCOPE("server.request");
+  tools::InspectRequest request;
+  tools::InspectResponse response;
+  std::string error;
+  if (!tools::parse_request(payload, request, &error)) {
+    response.error = error;
+  } else if (request.stats) {
+    response.id = request.id;
+    response.ok = true;
+    response.stats_json = stats_json();
+  } else {
+    response.id = request.id;
+    std::shared_ptr<const tools::ImageDocument> doc = request.image.empty()
+        ? load_shared(request.shm, error)
+        : load_path(request.image, error);
+    if (!doc) {
+      response.error = error;
+    } else {
+      try {
+        const std::shared_ptr<tools::ITool> tool = tools::make_tool(request.recipe.tool);
+        tools::RunContext ctx;
+        ctx.stage_cache = &tools::StageCache::global();
+        // fresh shared-memory documents would only fill the cache with planes
+        // nobody asks for again
+        ctx.image_id = request.image.empty() ? 0 : doc->id();
+        tool->set_context(&ctx);
+        const tools::Recipe& recipe = request.recipe;
+        const Clock::time_point t0 = Clock::now();
+        response.result = recipe.roi_angle != 0.0 && !recipe.roi.empty()
+            ? tool->run_oriented(doc->gray(), tools::oriented_region(recipe.roi, recipe.roi_angle))
+            : tool->run(doc->gray(), recipe.roi);
+        response.tool_ms = ms_since(t0);
+        response.ok = true;
+        tool_ms_.record(response.tool_ms);
+      } catch (const std::exception& e) {
+        response.error = e.what();
+      }
+    }
+  }
+  response.ms = ms_since(received);
+  ok = response.ok;
+
+  std::string frame;
+  tools::append_frame(frame, tools::encode_response(response, request.binary));
+  return frame;
+}
+
+void InspectionServer::deliver(QPointer<QLocalSocket> socket, const std::string& frame,
+                               Clock::time_point received, bool ok) {
+  --in_flight_;
+  ++served_;
+  if (!ok) ++errors_;
+  if (!socket || socket->state() != QLocalSocket::ConnectedState) return;
+  socket->write(frame.data(), static_cast<qint64>(frame.size()));
+  request_ms_.record(ms_since(received));
+}
+
+std::shared_ptr<const tools::ImageDocument> InspectionServer::load_path(const std::string& path, std::string& error) {
+  const fs::path file = fs::u8path(path);
+  std::error_code ec;
+  const uint64_t size = fs::file_size(file, ec);
+  const int64_t mtime = ec ? 0 : static_cast<int64_t>(fs::last_write_time(file, ec).time_since_epoch().count());
+  if (ec) {
+    error = "cannot open " + path;
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(images_mutex_);
+    for (auto it = images_.begin(); it != images_.end(); ++it) {
+      if (it->path != path) continue;
+      if (it->mtime == mtime && it->size == size) {
+        images_.splice(images_.begin(), images_, it);
+        return images_.front().doc;
+      }
+      // the file was rewritten: its planes are stale too
+      tools::StageCache::global().drop_image(it->doc->id());
+      images_.erase(it);
+      break;
+    }
+  }
+
+  TRACE_SCOPE("server.decode");
+  std::ifstream in(file, std::ios::binary);
+  std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::shared_ptr<const tools::ImageDocument> doc =
+      bytes.empty() ? nullptr : tools::ImageDocument::decode(bytes.data(), bytes.size());
+  if (!doc) {
+    error = "cannot decode " + path;
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(images_mutex_);
+  // two requests may have decoded the same file concurrently; keep one entry
+  for (auto it = images_.begin(); it != images_.end(); ++it) {
+    if (it->path == path) {
+      images_.erase(it);
+      break;
+    }
+  }
+  images_.push_front(CachedImage{ path, mtime, size, doc });
+  while (images_.size() > options_.cached_images) {
+    tools::StageCache::global().drop_image(images_.back().doc->id());
+    images_.pop_back();
+  }
+  return doc;
+}
+
+std::shared_ptr<const tools::ImageDocument> InspectionServer::load_shared(const std::string& key, std::string& error) {
+  TRACE_SCOPE("server.shm");
+  QSharedMemory segment(QString::fromStdString(key));
+  if (!segment.attach(QSharedMemory::ReadOnly)) {
+    error = "cannot attach shared memory " + key + ": " + segment.errorString().toStdString();
+    return nullptr;
+  }
+  cv::Mat pixels;
+  // copy under the lock: the producer may overwrite the segment afterwards
+  segment.lock();
+  const bool ok = tools::read_shared_image(segment.constData(), static_cast<size_t>(segment.size()), pixels, &error);
+  segment.unlock();
+  segment.detach();
+  if (!ok) return nullptr;
+  return tools::ImageDocument::from_mat(pixels);
+}
+
+std::string InspectionServer::stats_json() const {
+  size_t images = 0;
+  {
+    std::lock_guard<std::mutex> lock(images_mutex_);
+    images = images_.size();
+  }
+  return "{\"requests\":" + request_ms_.to_json() + ",\"tool\":" + tool_ms_.to_json() +
+         ",\"in_flight\":" + std::to_string(in_flight_.load()) +
+         ",\"served\":" + std::to_string(served_.load()) +
+         ",\"errors\":" + std::to_string(errors_.load()) +
+         ",\"connections\":" + std::to_string(connections_.load()) +
+         ",\"images_cached\":" + std::to_string(images) + '}';
+}
+
+std::string InspectionServer::stats_text() const {
+  return "requests " + request_ms_.to_text() + " | tool " + tool_ms_.to_text() +
+         " | errors " + std::to_string(errors_.load()) + ", in flight " + std::to_string(in_flight_.load());
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "tools/image_document.h"
+#include "tools/inspect_protocol.h"
+#include "tools/latency_histogram.h"
+#include "tools/thread_pool.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Inspection engine behind a local socket (named pipe on Windows, Unix
+// socket elsewhere) for line controllers that need one measurement per part
+// without starting a process each time. The wire format is in
+// tools/inspect_protocol.h.
+//
+// Sockets live on the thread that owns the server; requests run on a private
+// worker pool, several at once across and within connections. Decoded images
+// are kept per path (checked against mtime and size), so repeated requests on
+// the same file reuse both the decode and the preprocessed planes of the
+// global StageCache.
+class InspectionServer : public QObject {
+  Q_OBJECT
+
+public:
+  struct Options {
+    QString name = QStringLiteral("inspection");
+    unsigned workers = 0;       // 0 = hardware threads
+    size_t cached_images = 16;  // decoded path images kept warm
+  };
+
+  explicit InspectionServer(Options options, QObject* parent = nullptr);
+  // Waits for requests that are still running; their responses are dropped.
+  ~InspectionServer() override;
+
+  // Fails (with *error) when another server already answers on the name; a
+  // stale socket left by a crashed one is removed first.
+  bool listen(QString* error = nullptr);
+  // Platform name clients connect to (e.g. \\.\pipe\inspection).
+  QString full_server_name() const;
+
+  // {"requests":{histogram},"tool":{histogram},"in_flight":n,"served":n,
+  //  "errors":n,"connections":n,"images_cached":n}, see LatencyHistogram::to_json
+  std::string stats_json() const;
+  std::string stats_text() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct CachedImage {
+    std::string path;
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    std::shared_ptr<const tools::ImageDocument> doc;
+  };
+
+  void on_new_connection();
+  void on_ready_read(QLocalSocket* socket);
+  // Worker thread: parses and runs one request, returns the response frame.
+  std::string process(const std::string& payload, Clock::time_point received, bool& ok);
+  // Owner thread: writes a finished response if the client is still there.
+  void deliver(QPointer<QLocalSocket> socket, const std::string& frame, Clock::time_point received, bool ok);
+  // Path images come from (and go into) images_, so their id() is stable
+  // across requests; shared-memory images are always fresh documents.
+  std::shared_ptr<const tools::ImageDocument> load_path(const std::string& path, std::string& error);
+  std::shared_ptr<const tools::ImageDocument> load_shared(const std::string& key, std::string& error);
+
+  Options options_;
+  QLocalServer* server_ = nullptr;
+  std::unordered_map<QLocalSocket*, std::string> buffers_;
+  std::unique_ptr<tools::ThreadPool> pool_;
+
+  mutable std::mutex images_mutex_;
+  std::list<CachedImage> images_;  // most recently used first
+
+  tools::LatencyHistogram request_ms_;
+  tools::LatencyHistogram tool_ms_;
+  std::atomic<int> connections_{0};
+  std::atomic<int> in_flight_{0};
+  std::atomic<uint64_t> served_{0};
+  std::atomic<uint64_t> errors_{0};
+};
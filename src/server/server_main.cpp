@@ -0,0 +1,80 @@
+// Local inspection server: keeps the tools, decoded images and preprocessed
+// planes warm between requests from the line software.
+//
+//   inspection_server [--name inspection] [--workers N] [--images N] [--stats-interval S]
+//
+// Clients connect to the local socket `name` (see tools/inspect_protocol.h
+// for the request format, inspect_client for a test client).
+
+#include "inspection_server.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <cstdio>
+#include <exception>
+#include <string>
+
+namespace {
+
+struct Options {
+  InspectionServer::Options server;
+  int stats_interval = 10;  // seconds, 0 = quiet
+};
+
+void print_usage() {
+  std::fprintf(stderr,
+    "usage: inspection_server [--name NAME] [--workers N] [--images N] [--stats-interval S]\n");
+}
+
+bool parse_args(int argc, char* argv[], Options& opt) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&](std::string& out) {
+      if (i + 1 >= argc) return false;
+      out = argv[++i];
+      return true;
+    };
+    std::string v;
+    if (arg == "--name") { if (!value(v)) return false; opt.server.name = QString::fromStdString(v); }
+    else if (arg == "--workers") { if (!value(v)) return false; opt.server.workers = static_cast<unsigned>(std::stoul(v)); }
+    else if (arg == "--images") { if (!value(v)) return false; opt.server.cached_images = std::stoul(v); }
+    else if (arg == "--stats-interval") { if (!value(v)) return false; opt.stats_interval = std::stoi(v); }
+    else return false;
+  }
+  return !opt.server.name.isEmpty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  Options opt;
+  try {
+    if (!parse_args(argc, argv, opt)) {
+      print_usage();
+      return 2;
+    }
+  } catch (const std::exception&) {
+    print_usage();
+    return 2;
+  }
+
+  InspectionServer server(opt.server);
+  QString error;
+  if (!server.listen(&error)) {
+    std::fprintf(stderr, "cannot listen on %s: %s\n", opt.server.name.toLocal8Bit().constData(),
+                 error.toLocal8Bit().constData());
+    return 1;
+  }
+  std::fprintf(stderr, "listening on %s\n", server.full_server_name().toLocal8Bit().constData());
+
+  QTimer stats;
+  if (opt.stats_interval > 0) {
+    QObject::connect(&stats, &QTimer::timeout, [&server]() {
+      std::fprintf(stderr, "%s\n", server.stats_text().c_str());
+    });
+    stats.start(opt.stats_interval * 1000);
+  }
+  return app.exec();
+}
@@ -0,0 +1,96 @@
+﻿#include "tiled_image_item.h"
+#include "tools/tile_store.h"
+#include "tools/trace.h"
+#include <QImage>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QtMath>
+#include <algorithm>
+
+namespace {
+// cv::Mat 包装为 QImage（不拷贝，只在绘制期间使用）
+QImage mat_to_qimage(const cv::Mat& m) {
+  const QImage::Format fmt = m.channels() == 1 ? QImage::Format_Grayscale8 : QImage::Format_BGR888;
+  return QImage(m.data, m.cols, m.rows, static_cast<int>(m.step), fmt);
+}
+}
+
+TiledImageItem::TiledImageItem(std::shared_ptr<tools::TileStore> store, QGraphicsItem* parent)
+  : QGraphicsObject(parent), store_(std::move(store)) {
+  const tools::PyramidInfo& info = store_->info();
+  bounds_ = QRectF(0, 0, info.width, info.height);
+  // 需要 exposedRect 只绘制可见瓦片
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+  // 最粗层级（一个瓦片）先加载，放大/平移时总有替代图像可画
+  store_->request(tools::TileKey{ info.levels - 1, 0, 0 });
+  // 后台解码完成：回到GUI线程重绘该瓦片区域
+  store_->set_loaded_callback([this](const tools::TileKey& key) {
+    const QRectF r = tile_scene_rect(key);
+    QMetaObject::invokeMethod(this, [this, r]() { update(r); }, Qt::QueuedConnection);
+  });
+}
+
+// 析构前解除回调（返回后不会再有回调），排队的解码请求也不再需要
+TiledImageItem::~TiledImageItem() {
+  store_->set_loaded_callback({});
+  store_->cancel_requests();
+}
+
+QRectF TiledImageItem::boundingRect() const {
+  return bounds_;
+}
+
+QRectF TiledImageItem::tile_scene_rect(const tools::TileKey& key) const {
+  const cv::Rect r = store_->info().tile_rect(key.level, key.tx, key.ty);
+  const qreal scale = qreal(1 << key.level);
+  return QRectF(r.x * scale, r.y * scale, r.width * scale, r.height * scale) & bounds_;
+}
+
+void TiledImageItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
+  Q_UNUSED(widget);
+  TRACE_SCOPE("TiledImageItem::paint");
+  const tools::PyramidInfo& info = store_->info();
+
+  // 选择分辨率不低于屏幕的最粗层级：缩小一半时用第1层，以此类推
+  const qreal lod = option->levelOfDetailFromTransform(painter->worldTransform());
+  int level = 0;
+  while (level + 1 < info.levels && lod * (1 << (level + 1)) <= 1.0) ++level;
+
+  const QRectF exposed = option->exposedRect & bounds_;
+  if (exposed.isEmpty()) return;
+  const int t = info.tile_size;
+  const qreal scale = qreal(1 << level);
+  const int tx0 = std::max(0, static_cast<int>(exposed.left() / scale) / t);
+  const int ty0 = std::max(0, static_cast<int>(exposed.top() / scale) / t);
+  const int tx1 = std::min(info.tiles_x(level) - 1, static_cast<int>(qCeil(exposed.right() / scale) - 1) / t);
+  const int ty1 = std::min(info.tiles_y(level) - 1, static_cast<int>(qCeil(exposed.bottom() / scale) - 1) / t);
+
+  painter->setRenderHint(QPainter::SmoothPixmapTransform, lod < 1.0);
+  for (int ty = ty0; ty <= ty1; ++ty) {
+    for (int tx = tx0; tx <= tx1; ++tx) {
+      const tools::TileKey key{ level, tx, ty };
+      const QRectF target = tile_scene_rect(key);
+      cv::Mat tile;
+      if (store_->lookup(key, tile)) {
+        painter->drawImage(target, mat_to_qimage(tile));
+        continue;
+      }
+      store_->request(key);
+
+      // 解码完成前用已缓存的粗层级瓦片放大代替，没有则留灰
+      bool drawn = false;
+      for (int c = level + 1; c < info.levels && !drawn; ++c) {
+        const tools::TileKey coarse{ c, tx >> (c - level), ty >> (c - level) };
+        cv::Mat coarse_tile;
+        if (!store_->lookup(coarse, coarse_tile)) continue;
+        const QRectF coarse_rect = tile_scene_rect(coarse);
+        const qreal s = qreal(1 << c);
+        const QRectF source((target.left() - coarse_rect.left()) / s, (target.top() - coarse_rect.top()) / s,
+                            target.width() / s, target.height() / s);
+        painter->drawImage(target, mat_to_qimage(coarse_tile), source);
+        drawn = true;
+      }
+      if (!drawn) painter->fillRect(target, QColor(64, 64, 64));
+    }
+  }
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <QGraphicsObject>
+#include <QRectF>
+#include <memory>
+
+namespace tools {
+  class TileStore;
+  struct TileKey;
+}
+
+// 分块多分辨率图像图元（超大图）：只绘制可见区域，按缩放选择金字塔层级。
+// 未缓存的瓦片交给后台线程解码，先用已缓存的更粗层级代替，解码完成后局部重绘
+class TiledImageItem : public QGraphicsObject {
+  Q_OBJECT
+
+public:
+  explicit TiledImageItem(std::shared_ptr<tools::TileStore> store, QGraphicsItem* parent = nullptr);
+  ~TiledImageItem() override;
+
+  QRectF boundingRect() const override;
+  void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+  const std::shared_ptr<tools::TileStore>& Store() const { return store_; }
+
+private:
+  // 瓦片在图元坐标（全分辨率像素）中的矩形
+  QRectF tile_scene_rect(const tools::TileKey& key) const;
+
+  std::shared_ptr<tools::TileStore> store_;
+  QRectF bounds_;
+};
@@ -0,0 +1,183 @@
+#include "caliper_tool.h"
+#include "edge_profile.h"
+#include "preprocess.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace tools;
+
+namespace {
+
+// pair samples tried by RANSAC; fewer pairs than this are all tried
+constexpr int kRansacPairs = 300;
+
+float distance_to_line(const cv::Point2f& p, const cv::Point2f& origin, const cv::Point2f& dir) {
+  const cv::Point2f d = p - origin;
+  return std::abs(d.x * dir.y - d.y * dir.x);
+}
+
+} // namespace
+
+DetectionResult CaliperTool::run(const cv::Mat& image, const cv::Rect& roi) {
+  const cv::Rect r = stages::clamp_roi(image, roi);
+  if (image.empty() || r.empty()) {
+    DetectionResult res;
+    res.kind = DetectionKind::Lines;
+    return res;
+  }
+  const cv::Point2f center(r.x + (r.width - 1) * 0.5f, r.y + (r.height - 1) * 0.5f);
+  return run_oriented(image, cv::RotatedRect(center, cv::Size2f(static_cast<float>(r.width), static_cast<float>(r.height)), 0.f));
+}
+
+// The calipers already sample along the region's own axes, so nothing is
+// resampled: params.angle is taken relative to the region.
+DetectionResult CaliperTool::run_oriented(const cv::Mat& image, const cv::RotatedRect& region) {
+  const double a = params.angle * CV_PI / 180.0;
+  const bool along_x = std::abs(std::cos(a)) >= std::abs(std::sin(a));
+  const cv::Size2f size = along_x ? region.size : cv::Size2f(region.size.height, region.size.width);
+  return run_region(image, cv::RotatedRect(region.center, size, static_cast<float>(region.angle + params.angle)));
+}
+
+DetectionResult CaliperTool::run_region(const cv::Mat& image, const cv::RotatedRect& region) {
+  DetectionResult res;
+  res.kind = DetectionKind::Lines;
+  if (image.empty() || params.calipers < 1 || region.size.width <= 0 || region.size.height < 3) return res;
+
+  // only the pixels under the region are converted (and cached) when the input is color
+  const cv::Rect box = region.boundingRect() & cv::Rect(0, 0, image.cols, image.rows);
+  if (box.empty()) return res;
+  const cv::Mat gray = stages::gray(image, box, ctx_);
+  if (cancelled()) return res;
+
+  const double a = region.angle * CV_PI / 180.0;
+  const cv::Point2f along(static_cast<float>(std::cos(a)), static_cast<float>(std::sin(a)));
+  const cv::Point2f across(-along.y, along.x);
+  const cv::Point2f origin = region.center - cv::Point2f(static_cast<float>(box.x), static_cast<float>(box.y));
+
+  const int n = params.calipers;
+  const int width = std::max(1, params.width);
+  const int length = static_cast<int>(std::lround(region.size.height));
+
+  std::vector<cv::Point2f> edges;
+  edges.reserve(n);
+  {
+    TRACE_SCOPE_PX("caliper.profiles", static_cast<int64_t>(n) * width * length);
+    ProfileEdgeFinder finder(params.sigma, params.polarity, params.min_gradient);
+    std::vector<float> profile(length);
+    for (int i = 0; i < n; ++i) {
+      const float s = static_cast<float>(((i + 0.5) / n - 0.5) * region.size.width);
+      const cv::Point2f c = origin + along * s;
+      for (int k = 0; k < length; ++k) {
+        const cv::Point2f p = c + across * (k - (length - 1) * 0.5f);
+        float acc = 0.f;
+        for (int j = 0; j < width; ++j) {
+          const cv::Point2f q = p + along * (j - (width - 1) * 0.5f);
+          acc += sample_bilinear(gray, q.x, q.y);
+        }
+        profile[k] = acc / width;
+      }
+      const float pos = finder.find(profile);
+      if (pos >= 0) edges.push_back(c + across * (pos - (length - 1) * 0.5f));
+    }
+  }
+  report_progress(60);
+  if (cancelled()) return res;
+
+  for (auto& p : edges) p += cv::Point2f(static_cast<float>(box.x), static_cast<float>(box.y));
+  res.points = edges;
+  if (edges.size() < 2) {
+    report_progress(100);
+    return res;
+  }
+
+  TRACE_SCOPE("caliper.fit");
+  // RANSAC: the line through two peaks with the most peaks within the band
+  const float band = static_cast<float>(std::max(params.inlier_distance, 0.1));
+  const int m = static_cast<int>(edges.size());
+  const int all_pairs = m * (m - 1) / 2;
+  cv::RNG rng(0x5eed);
+  int best_count = 0;
+  float best_spread = 0.f;
+  cv::Point2f best_origin, best_dir;
+  for (int t = 0; t < std::min(all_pairs, kRansacPairs); ++t) {
+    int i0 = 0, i1 = 0;
+    if (all_pairs <= kRansacPairs) {
+      // t-th pair in (0,1), (0,2), (1,2), (0,3), ...
+      i1 = 1;
+      int first = t;
+      while (first >= i1) { first -= i1; ++i1; }
+      i0 = first;
+    } else {
+      i0 = rng.uniform(0, m);
+      i1 = rng.uniform(0, m - 1);
+      if (i1 >= i0) ++i1;
+    }
+    cv::Point2f dir = edges[i1] - edges[i0];
+    const float len = std::hypot(dir.x, dir.y);
+    if (len < 1e-3f) continue;
+    dir *= 1.f / len;
+    int count = 0;
+    float spread = 0.f;
+    for (const auto& p : edges) {
+      const float d = distance_to_line(p, edges[i0], dir);
+      if (d <= band) {
+        ++count;
+        spread += d;
+      }
+    }
+    if (count > best_count || (count == best_count && spread < best_spread)) {
+      best_count = count;
+      best_spread = spread;
+      best_origin = edges[i0];
+      best_dir = dir;
+    }
+  }
+  if (best_count < 2) {
+    report_progress(100);
+    return res;
+  }
+
+  // Huber refinement on the consensus set
+  std::vector<cv::Point2f> inliers;
+  for (const auto& p : edges) {
+    if (distance_to_line(p, best_origin, best_dir) <= band) inliers.push_back(p);
+  }
+  cv::Vec4f fitted;
+  cv::fitLine(inliers, fitted, cv::DIST_HUBER, 0, 0.01, 0.01);
+  cv::Point2f dir(fitted[0], fitted[1]);
+  if (dir.dot(along) < 0) dir = -dir;
+  const cv::Point2f p0(fitted[2], fitted[3]);
+
+  ShapeFit fit;
+  fit.samples = m;
+  double sq = 0.0;
+  float t_min = 0.f, t_max = 0.f;
+  res.residuals.reserve(edges.size());
+  for (const auto& p : edges) {
+    const cv::Point2f v = p - p0;
+    res.residuals.push_back(v.x * dir.y - v.y * dir.x);
+    const float d = distance_to_line(p, p0, dir);
+    if (d > band) continue;
+    const float t = (p - p0).dot(dir);
+    if (fit.inliers == 0 || t < t_min) t_min = t;
+    if (fit.inliers == 0 || t > t_max) t_max = t;
+    sq += static_cast<double>(d) * d;
+    ++fit.inliers;
+  }
+  if (fit.inliers < 2) {
+    res.residuals.clear();
+    report_progress(100);
+    return res;
+  }
+  fit.rms = static_cast<float>(std::sqrt(sq / fit.inliers));
+
+  const cv::Point2f e0 = p0 + dir * t_min;
+  const cv::Point2f e1 = p0 + dir * t_max;
+  res.subpixel_lines.push_back(cv::Vec4f(e0.x, e0.y, e1.x, e1.y));
+  res.lines.push_back(cv::Vec4i(cvRound(e0.x), cvRound(e0.y), cvRound(e1.x), cvRound(e1.y)));
+  res.line_fits.push_back(fit);
+  report_progress(100);
+  return res;
+}
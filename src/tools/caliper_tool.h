@@ -0,0 +1,41 @@
+#pragma once
+
+#include "itool.h"
+#include <opencv2/imgproc.hpp>
+
+namespace tools {
+
+// Finds one straight edge whose position and direction are roughly known.
+// `calipers` strips are laid across the search region; each one averages
+// `width` samples along the edge into a 1-D profile, smooths it and takes the
+// strongest gradient peak with sub-pixel interpolation. A line is fitted to
+// the peaks with RANSAC and refined with a Huber fit on the inliers. Cost is
+// calipers x width x search length samples, independent of the ROI area.
+//
+// The result holds the rounded line in `lines`, the measured line in
+// `subpixel_lines`, its fit quality in `line_fits`, every caliper peak in
+// `points` and their distances to the line in `residuals`.
+class CaliperTool : public ITool {
+public:
+  struct Params {
+    double angle = 0.0;           // edge direction in degrees, image coordinates (0 = horizontal)
+    int calipers = 10;
+    int width = 5;                // samples averaged along the edge per caliper
+    double sigma = 1.0;           // profile smoothing, 0 = none
+    double min_gradient = 10.0;   // weakest accepted edge, gray levels per pixel
+    int polarity = 0;             // +1 dark->light, -1 light->dark along the search direction, 0 either
+    double inlier_distance = 1.5; // RANSAC band around the line, pixels
+  } params;
+
+  // The ROI (empty = whole image) turned to the axis nearest to `angle` and
+  // then tilted to it: its side along the edge is the caliper span, the other
+  // one the search length.
+  DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) override;
+  // Same on a rotated ROI, with params.angle relative to region.angle.
+  DetectionResult run_oriented(const cv::Mat& image, const cv::RotatedRect& region) override;
+  // Same on an explicit region: width() is the span along the edge, height()
+  // the search length, region.angle the edge direction (params.angle unused).
+  DetectionResult run_region(const cv::Mat& image, const cv::RotatedRect& region);
+};
+
+} // namespace tools
@@ -0,0 +1,272 @@
+#include "circle_fit_tool.h"
+#include "edge_profile.h"
+#include "preprocess.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace tools;
+
+namespace {
+
+// point triples tried by RANSAC; fewer triples than this are all tried
+constexpr int kRansacTriples = 300;
+constexpr int kRefineIterations = 20;
+
+// Solves the 3x3 system a * x = b (Gaussian elimination, partial pivoting).
+bool solve3(double a[3][3], double b[3], double x[3]) {
+  for (int c = 0; c < 3; ++c) {
+    int pivot = c;
+    for (int r = c + 1; r < 3; ++r) {
+      if (std::abs(a[r][c]) > std::abs(a[pivot][c])) pivot = r;
+    }
+    if (std::abs(a[pivot][c]) < 1e-12) return false;
+    if (pivot != c) {
+      for (int k = 0; k < 3; ++k) std::swap(a[c][k], a[pivot][k]);
+      std::swap(b[c], b[pivot]);
+    }
+    for (int r = c + 1; r < 3; ++r) {
+      const double f = a[r][c] / a[c][c];
+      for (int k = c; k < 3; ++k) a[r][k] -= f * a[c][k];
+      b[r] -= f * b[c];
+    }
+  }
+  for (int r = 2; r >= 0; --r) {
+    double v = b[r];
+    for (int k = r + 1; k < 3; ++k) v -= a[r][k] * x[k];
+    x[r] = v / a[r][r];
+  }
+  return true;
+}
+
+// Circle through three points; false when they are (nearly) collinear.
+bool circumcircle(const cv::Point2f& p, const cv::Point2f& q, const cv::Point2f& s, cv::Vec3f& circle) {
+  const double ax = p.x, ay = p.y, bx = q.x, by = q.y, cx = s.x, cy = s.y;
+  const double d = 2.0 * (ax * (by - cy) + bx * (cy - ay) + cx * (ay - by));
+  if (std::abs(d) < 1e-9) return false;
+  const double a2 = ax * ax + ay * ay, b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+  const double ux = (a2 * (by - cy) + b2 * (cy - ay) + c2 * (ay - by)) / d;
+  const double uy = (a2 * (cx - bx) + b2 * (ax - cx) + c2 * (bx - ax)) / d;
+  circle = cv::Vec3f(static_cast<float>(ux), static_cast<float>(uy), static_cast<float>(std::hypot(ax - ux, ay - uy)));
+  return true;
+}
+
+float radial_residual(const cv::Point2f& p, const cv::Vec3f& c) {
+  return static_cast<float>(std::hypot(p.x - c[0], p.y - c[1]) - c[2]);
+}
+
+} // namespace
+
+bool tools::fit_circle(const std::vector<cv::Point2f>& points, cv::Vec3f& circle) {
+  const size_t n = points.size();
+  if (n < 3) return false;
+  // centered coordinates keep the normal equations well conditioned
+  double mx = 0.0, my = 0.0;
+  for (const auto& p : points) {
+    mx += p.x;
+    my += p.y;
+  }
+  mx /= n;
+  my /= n;
+
+  // Kasa: minimize sum (u^2 + v^2 + D u + E v + F)^2, linear in D, E, F
+  double a[3][3] = {};
+  double b[3] = {};
+  for (const auto& p : points) {
+    const double u = p.x - mx, v = p.y - my, w = u * u + v * v;
+    const double row[3] = { u, v, 1.0 };
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) a[i][j] += row[i] * row[j];
+      b[i] -= row[i] * w;
+    }
+  }
+  double def[3];
+  if (!solve3(a, b, def)) return false;
+  double cx = -def[0] / 2, cy = -def[1] / 2;
+  const double r2 = cx * cx + cy * cy - def[2];
+  if (r2 <= 0) return false;
+  double r = std::sqrt(r2);
+
+  // geometric refinement: Gauss-Newton on sum (|p - c| - r)^2
+  for (int it = 0; it < kRefineIterations; ++it) {
+    double jtj[3][3] = {};
+    double jte[3] = {};
+    for (const auto& p : points) {
+      const double dx = p.x - mx - cx, dy = p.y - my - cy;
+      const double d = std::hypot(dx, dy);
+      if (d < 1e-12) continue;
+      const double e = d - r;
+      const double j[3] = { -dx / d, -dy / d, -1.0 };
+      for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 3; ++k) jtj[i][k] += j[i] * j[k];
+        jte[i] -= j[i] * e;
+      }
+    }
+    double step[3];
+    if (!solve3(jtj, jte, step)) break;
+    cx += step[0];
+    cy += step[1];
+    r += step[2];
+    if (std::abs(step[0]) + std::abs(step[1]) + std::abs(step[2]) < 1e-7) break;
+  }
+  if (!(r > 0)) return false;
+  circle = cv::Vec3f(static_cast<float>(cx + mx), static_cast<float>(cy + my), static_cast<float>(r));
+  return true;
+}
+
+DetectionResult CircleFitTool::run(const cv::Mat& image, const cv::Rect& roi) {
+  const cv::Rect r = stages::clamp_roi(image, roi);
+  if (image.empty() || r.empty()) {
+    DetectionResult res;
+    res.kind = DetectionKind::Circles;
+    return res;
+  }
+  const cv::Point2f center(r.x + (r.width - 1) * 0.5f, r.y + (r.height - 1) * 0.5f);
+  return run_oriented(image, cv::RotatedRect(center, cv::Size2f(static_cast<float>(r.width), static_cast<float>(r.height)), 0.f));
+}
+
+// Rays are cast from the region center, so the rotation only matters for the
+// inscribed radius, which it does not change.
+DetectionResult CircleFitTool::run_oriented(const cv::Mat& image, const cv::RotatedRect& region) {
+  if (params.radius > 0) {
+    const double half = std::max(params.search, 2.0) / 2;
+    return run_annulus(image, region.center, std::max(0.0, params.radius - half), params.radius + half);
+  }
+  const double inscribed = std::min(region.size.width, region.size.height) / 2.0;
+  return run_annulus(image, region.center, inscribed / 4, inscribed);
+}
+
+DetectionResult CircleFitTool::run_annulus(const cv::Mat& image, const cv::Point2f& center,
+                                           double inner_radius, double outer_radius) {
+  DetectionResult res;
+  res.kind = DetectionKind::Circles;
+  if (image.empty() || params.rays < 3 || outer_radius - inner_radius < 2) return res;
+
+  // only the pixels under the annulus are converted (and cached) when the input is color
+  const int reach = static_cast<int>(std::ceil(outer_radius)) + 1;
+  const cv::Rect box = cv::Rect(static_cast<int>(std::floor(center.x)) - reach, static_cast<int>(std::floor(center.y)) - reach,
+                                2 * reach + 1, 2 * reach + 1) & cv::Rect(0, 0, image.cols, image.rows);
+  if (box.empty()) return res;
+  const cv::Mat gray = stages::gray(image, box, ctx_);
+  if (cancelled()) return res;
+
+  const cv::Point2f origin = center - cv::Point2f(static_cast<float>(box.x), static_cast<float>(box.y));
+  const int n = params.rays;
+  const int width = std::max(1, params.width);
+  const int length = static_cast<int>(outer_radius - inner_radius) + 1;
+
+  std::vector<cv::Point2f> edges;
+  edges.reserve(n);
+  {
+    TRACE_SCOPE_PX("circle_fit.profiles", static_cast<int64_t>(n) * width * length);
+    ProfileEdgeFinder finder(params.sigma, params.polarity, params.min_gradient);
+    std::vector<float> profile(length);
+    for (int i = 0; i < n; ++i) {
+      const double theta = 2.0 * CV_PI * i / n;
+      const cv::Point2f out(static_cast<float>(std::cos(theta)), static_cast<float>(std::sin(theta)));
+      const cv::Point2f tangent(-out.y, out.x);
+      for (int k = 0; k < length; ++k) {
+        const cv::Point2f p = origin + out * static_cast<float>(inner_radius + k);
+        float acc = 0.f;
+        for (int j = 0; j < width; ++j) {
+          const cv::Point2f q = p + tangent * (j - (width - 1) * 0.5f);
+          acc += sample_bilinear(gray, q.x, q.y);
+        }
+        profile[k] = acc / width;
+      }
+      const float pos = finder.find(profile);
+      if (pos >= 0) edges.push_back(center + out * static_cast<float>(inner_radius + pos));
+    }
+  }
+  report_progress(60);
+  if (cancelled()) return res;
+
+  res.points = edges;
+  const int m = static_cast<int>(edges.size());
+  if (m < 3) {
+    report_progress(100);
+    return res;
+  }
+
+  TRACE_SCOPE("circle_fit.fit");
+  // RANSAC: the circle through three edge points with the most points within
+  // the band; radii outside the annulus are not the circle we look for
+  const float band = static_cast<float>(std::max(params.inlier_distance, 0.1));
+  int best_count = 0;
+  float best_spread = 0.f;
+  cv::Vec3f best;
+  auto try_triple = [&](int i, int j, int k) {
+    cv::Vec3f c;
+    if (!circumcircle(edges[i], edges[j], edges[k], c)) return;
+    if (c[2] < inner_radius - band || c[2] > outer_radius + band) return;
+    int count = 0;
+    float spread = 0.f;
+    for (const auto& p : edges) {
+      const float d = std::abs(radial_residual(p, c));
+      if (d <= band) {
+        ++count;
+        spread += d;
+      }
+    }
+    if (count > best_count || (count == best_count && spread < best_spread)) {
+      best_count = count;
+      best_spread = spread;
+      best = c;
+    }
+  };
+  const long long all_triples = static_cast<long long>(m) * (m - 1) * (m - 2) / 6;
+  if (all_triples <= kRansacTriples) {
+    for (int i = 0; i < m; ++i)
+      for (int j = i + 1; j < m; ++j)
+        for (int k = j + 1; k < m; ++k) try_triple(i, j, k);
+  } else {
+    cv::RNG rng(0x5eed);
+    for (int t = 0; t < kRansacTriples; ++t) {
+      const int i = rng.uniform(0, m);
+      int j = rng.uniform(0, m - 1);
+      if (j >= i) ++j;
+      int k = rng.uniform(0, m - 2);
+      if (k >= std::min(i, j)) ++k;
+      if (k >= std::max(i, j)) ++k;
+      try_triple(i, j, k);
+    }
+  }
+  if (best_count < 3) {
+    report_progress(100);
+    return res;
+  }
+
+  std::vector<cv::Point2f> inliers;
+  for (const auto& p : edges) {
+    if (std::abs(radial_residual(p, best)) <= band) inliers.push_back(p);
+  }
+  cv::Vec3f circle;
+  if (!fit_circle(inliers, circle)) {
+    report_progress(100);
+    return res;
+  }
+
+  ShapeFit fit;
+  fit.samples = m;
+  double sq = 0.0;
+  res.residuals.reserve(edges.size());
+  for (const auto& p : edges) {
+    const float d = radial_residual(p, circle);
+    res.residuals.push_back(d);
+    if (std::abs(d) > band) continue;
+    sq += static_cast<double>(d) * d;
+    ++fit.inliers;
+  }
+  if (fit.inliers < 3) {
+    res.residuals.clear();
+    report_progress(100);
+    return res;
+  }
+  fit.rms = static_cast<float>(std::sqrt(sq / fit.inliers));
+
+  res.circles.push_back(circle);
+  res.circle_fits.push_back(fit);
+  report_progress(100);
+  return res;
+}
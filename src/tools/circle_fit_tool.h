@@ -0,0 +1,44 @@
+#pragma once
+
+#include "itool.h"
+#include <opencv2/imgproc.hpp>
+
+namespace tools {
+
+// Measures one circle (a hole, a bore) whose center and radius are roughly
+// known. `rays` radial profiles are sampled across an annulus around the
+// nominal circle, the strongest edge of each is located to sub-pixel
+// precision, and a circle is fitted to the edge points: RANSAC on point
+// triples rejects outliers, an algebraic (Kasa) fit on the consensus set
+// gives the start for a geometric least-squares refinement. Cost is
+// rays x width x annulus width samples, independent of the ROI area.
+//
+// The result holds the circle in `circles`, its fit in `circle_fits`, the
+// edge points in `points` and their radial residuals in `residuals`.
+class CircleFitTool : public ITool {
+public:
+  struct Params {
+    double radius = 0.0;          // nominal radius; 0 = search from a quarter of the ROI's inscribed radius to its edge
+    double search = 20.0;         // annulus width around the nominal radius, pixels
+    int rays = 36;
+    int width = 3;                // samples averaged across each ray (along the circle)
+    double sigma = 1.0;           // profile smoothing, 0 = none
+    double min_gradient = 10.0;   // weakest accepted edge, gray levels per pixel
+    int polarity = 0;             // +1 dark->light going outward, -1 light->dark, 0 either
+    double inlier_distance = 1.5; // RANSAC band around the circle, pixels
+  } params;
+
+  // Nominal center is the ROI center (empty ROI = whole image).
+  DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) override;
+  // Nominal center is the rotated region's center.
+  DetectionResult run_oriented(const cv::Mat& image, const cv::RotatedRect& region) override;
+  // Same on an explicit annulus around `center`.
+  DetectionResult run_annulus(const cv::Mat& image, const cv::Point2f& center, double inner_radius, double outer_radius);
+};
+
+// Least-squares circle through `points`: Kasa algebraic fit, refined by
+// Gauss-Newton on the geometric distance. False with fewer than 3 points or
+// collinear ones.
+bool fit_circle(const std::vector<cv::Point2f>& points, cv::Vec3f& circle);
+
+} // namespace tools
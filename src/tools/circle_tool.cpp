@@ -1,33 +1,126 @@
 #include "circle_tool.h"
+#include "circle_fit_tool.h"
+#include "preprocess.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
 
 using namespace tools;
 
+namespace {
+
+// ROIs whose coarse level would be smaller than this run at full resolution
+constexpr int kMinCoarseSide = 64;
+// profile spacing along the circle, full-resolution pixels
+constexpr double kRaySpacing = 4.0;
+constexpr int kMinRays = 16;
+constexpr int kMaxRays = 360;
+
+bool use_pyramid(const CircleTool::Params& p, const cv::Rect& r) {
+  return p.pyramid_levels > 0 && std::min(r.width, r.height) >> p.pyramid_levels >= kMinCoarseSide;
+}
+
+} // namespace
+
 DetectionResult CircleTool::run(const cv::Mat& image, const cv::Rect& roi) {
   DetectionResult res;
   res.kind = DetectionKind::Circles;
 
   if (image.empty()) return res;
 
-  cv::Mat src = image;
-  if (roi.width > 0 && roi.height > 0) {
-    cv::Rect r = roi & cv::Rect(0,0, image.cols, image.rows);
-    src = image(r);
-  }
+  const cv::Rect r = stages::clamp_roi(image, roi);
+  if (r.empty()) return res;
+  if (use_pyramid(params, r)) return run_pyramid(image, r);
 
-  cv::Mat gray;
-  if (src.channels() == 3) cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
-  else gray = src;
-  cv::GaussianBlur(gray, gray, cv::Size(9,9), 2, 2);
+  // memoized gray -> blur planes, shared with other runs on the same image/ROI
+  const cv::Mat blurred = stages::gaussian(image, r, cv::Size(9,9), 2, ctx_);
+  if (cancelled()) return res;
+  report_progress(30);
 
   std::vector<cv::Vec3f> circles;
-  cv::HoughCircles(gray, circles, cv::HOUGH_GRADIENT, params.dp, params.minDist, params.param1, params.param2, params.minRadius, params.maxRadius);
+  TRACE_SCOPE_PX("HoughCircles", blurred.total());
+  cv::HoughCircles(blurred, circles, cv::HOUGH_GRADIENT, params.dp, params.minDist, params.param1, params.param2, params.minRadius, params.maxRadius);
+
+  for (auto& c : circles) {
+    c[0] += r.x; c[1] += r.y;
+  }
+
+  res.circles = std::move(circles);
+  report_progress(100);
+  return res;
+}
+
+DetectionResult CircleTool::run_pyramid(const cv::Mat& image, const cv::Rect& r) {
+  DetectionResult res;
+  res.kind = DetectionKind::Circles;
+  const int levels = params.pyramid_levels;
+  const double scale = static_cast<double>(1 << levels);
+
+  // the 9x9 / sigma 2 blur of the full-resolution path, shrunk with the image
+  const cv::Mat coarse = stages::pyramid(image, r, levels, ctx_);
+  if (cancelled()) return res;
+  cv::Mat blurred;
+  {
+    TRACE_SCOPE_PX("GaussianBlur.coarse", coarse.total());
+    const double sigma = std::max(0.8, 2.0 / scale);
+    cv::GaussianBlur(coarse, blurred, cv::Size(), sigma, sigma);
+  }
+  report_progress(20);
 
-  if (roi.width > 0 && roi.height > 0) {
-    for (auto& c : circles) {
-      c[0] += roi.x; c[1] += roi.y;
-    }
+  // accumulator votes grow with the circumference, so the threshold shrinks
+  // with the radii; dp and the Canny threshold are scale free
+  std::vector<cv::Vec3f> candidates;
+  {
+    TRACE_SCOPE_PX("HoughCircles.coarse", blurred.total());
+    const int min_radius = static_cast<int>(std::floor(params.minRadius / scale));
+    const int max_radius = params.maxRadius > 0 ? static_cast<int>(std::ceil(params.maxRadius / scale)) : 0;
+    cv::HoughCircles(blurred, candidates, cv::HOUGH_GRADIENT, params.dp, params.minDist / scale,
+                     params.param1, std::max(1.0, params.param2 / scale), min_radius, max_radius);
   }
+  if (cancelled()) return res;
+  report_progress(50);
 
+  // Re-fit each candidate from radial edge profiles in an annulus of
+  // +-window around it, on the gray ROI (memoized, a view for gray input).
+  // A fit that leaves the window keeps the coarse circle.
+  const cv::Mat gray = stages::gray(image, r, ctx_);
+  const double window = std::max(1.0, params.refine_window > 0 ? params.refine_window : 2 * scale);
+  std::vector<cv::Vec3f> circles(candidates.size());
+  {
+    TRACE_SCOPE("CircleTool.refine");
+    ThreadPool::global().parallel_for(0, candidates.size(), [&](size_t i) {
+      const cv::Vec3f& c = candidates[i];
+      const cv::Point2f center(static_cast<float>(c[0] * scale), static_cast<float>(c[1] * scale));
+      const double radius = c[2] * scale;
+      circles[i] = cv::Vec3f(center.x, center.y, static_cast<float>(radius));
+      if (cancelled()) return;
+      CircleFitTool fitter;  // no context: per-candidate annuli are not worth caching
+      fitter.params.rays = std::min(kMaxRays, std::max(kMinRays, static_cast<int>(2 * CV_PI * radius / kRaySpacing)));
+      const DetectionResult fit = fitter.run_annulus(gray, center, std::max(0.0, radius - window), radius + window);
+      if (fit.circles.empty()) return;
+      const cv::Vec3f& f = fit.circles.front();
+      if (std::hypot(f[0] - center.x, f[1] - center.y) > window || std::abs(f[2] - radius) > window) return;
+      circles[i] = f;
+    });
+  }
+  if (cancelled()) return res;
+
+  for (auto& c : circles) {
+    c[0] += r.x; c[1] += r.y;
+  }
   res.circles = std::move(circles);
+  report_progress(100);
   return res;
 }
+
+void CircleTool::prepare(const cv::Mat& image, const cv::Rect& region) {
+  if (image.empty()) return;
+  const cv::Rect r = stages::clamp_roi(image, region);
+  if (use_pyramid(params, r)) {
+    stages::pyramid(image, r, params.pyramid_levels, ctx_);
+    return;
+  }
+  stages::gaussian(image, r, cv::Size(9,9), 2, ctx_);
+}
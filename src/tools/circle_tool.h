@@ -14,9 +14,19 @@ public:
     double param2 = 30.0;  // accumulator threshold
     int minRadius = 0;
     int maxRadius = 0;
+    // coarse-to-fine: HoughCircles on the ROI reduced 2^pyramid_levels times
+    // (distances, radii and the vote threshold scaled to match), then each
+    // candidate is re-fitted at full resolution from edge profiles within
+    // refine_window pixels of it (see CircleFitTool). 0 = off.
+    int pyramid_levels = 0;
+    double refine_window = 0.0;   // 0 = two coarse pixels
   } params;
 
   DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) override;
+  void prepare(const cv::Mat& image, const cv::Rect& region) override;
+
+private:
+  DetectionResult run_pyramid(const cv::Mat& image, const cv::Rect& r);
 };
 
 } // namespace tools
@@ -13,14 +13,47 @@ enum class DetectionKind {
   Mixed
 };
 
+// Fit quality of a measured line or circle: edge samples found, how many of
+// them the fit kept and their RMS distance to the shape (pixels).
+struct ShapeFit {
+  int samples = 0;
+  int inliers = 0;
+  float rms = 0.f;
+};
+
 struct DetectionResult {
   DetectionKind kind = DetectionKind::None;
+  // ROI the result belongs to in a multi-ROI run, -1 otherwise
+  int roi_id = -1;
   // Lines: Vec4i = (x1,y1,x2,y2)
   std::vector<cv::Vec4i> lines;
+  // Measuring tools only: the same lines at sub-pixel precision and their fits
+  std::vector<cv::Vec4f> subpixel_lines;
+  std::vector<ShapeFit> line_fits;
   // Points: 2D points
   std::vector<cv::Point2f> points;
   // Circles: Vec3f = (x,y,r)
   std::vector<cv::Vec3f> circles;
+  // Measuring tools only: fits of `circles`, and per entry of `points` (the
+  // edge samples) its signed distance to the fitted shape
+  std::vector<ShapeFit> circle_fits;
+  std::vector<float> residuals;
 };
 
+// Moves every element by `offset`, e.g. from ROI-local to image coordinates.
+inline void translate(DetectionResult& result, const cv::Point& offset) {
+  for (auto& l : result.lines) {
+    l[0] += offset.x; l[1] += offset.y; l[2] += offset.x; l[3] += offset.y;
+  }
+  for (auto& l : result.subpixel_lines) {
+    l[0] += offset.x; l[1] += offset.y; l[2] += offset.x; l[3] += offset.y;
+  }
+  for (auto& p : result.points) {
+    p.x += offset.x; p.y += offset.y;
+  }
+  for (auto& c : result.circles) {
+    c[0] += offset.x; c[1] += offset.y;
+  }
+}
+
 } // namespace tools
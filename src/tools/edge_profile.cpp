@@ -0,0 +1,74 @@
+#include "edge_profile.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace tools;
+
+float tools::sample_bilinear(const cv::Mat& gray, float x, float y) {
+  x = std::min(std::max(x, 0.f), static_cast<float>(gray.cols - 1));
+  y = std::min(std::max(y, 0.f), static_cast<float>(gray.rows - 1));
+  const int x0 = static_cast<int>(x);
+  const int y0 = static_cast<int>(y);
+  const int x1 = std::min(x0 + 1, gray.cols - 1);
+  const int y1 = std::min(y0 + 1, gray.rows - 1);
+  const float fx = x - x0;
+  const float fy = y - y0;
+  const uchar* r0 = gray.ptr<uchar>(y0);
+  const uchar* r1 = gray.ptr<uchar>(y1);
+  const float top = r0[x0] + fx * (r0[x1] - r0[x0]);
+  const float bottom = r1[x0] + fx * (r1[x1] - r1[x0]);
+  return top + fy * (bottom - top);
+}
+
+ProfileEdgeFinder::ProfileEdgeFinder(double sigma, int polarity, double min_gradient)
+  : polarity_(polarity), min_gradient_(static_cast<float>(min_gradient)) {
+  if (sigma <= 0) {
+    kernel_ = { 1.f };
+    return;
+  }
+  const int radius = std::max(1, static_cast<int>(std::ceil(3 * sigma)));
+  kernel_.resize(2 * radius + 1);
+  float sum = 0.f;
+  for (int i = -radius; i <= radius; ++i) {
+    kernel_[i + radius] = static_cast<float>(std::exp(-0.5 * i * i / (sigma * sigma)));
+    sum += kernel_[i + radius];
+  }
+  for (float& v : kernel_) v /= sum;
+}
+
+float ProfileEdgeFinder::find(const std::vector<float>& profile) {
+  const int n = static_cast<int>(profile.size());
+  const int radius = static_cast<int>(kernel_.size()) / 2;
+  smooth_.assign(n, 0.f);
+  for (int i = 0; i < n; ++i) {
+    float acc = 0.f;
+    for (int j = -radius; j <= radius; ++j) acc += kernel_[j + radius] * profile[std::min(std::max(i + j, 0), n - 1)];
+    smooth_[i] = acc;
+  }
+  grad_.assign(n, 0.f);
+  for (int i = 1; i + 1 < n; ++i) grad_[i] = 0.5f * (smooth_[i + 1] - smooth_[i - 1]);
+
+  int best = -1;
+  float best_mag = min_gradient_;
+  for (int i = 1; i + 1 < n; ++i) {
+    const float g = grad_[i];
+    if ((polarity_ > 0 && g <= 0) || (polarity_ < 0 && g >= 0)) continue;
+    if (std::abs(g) >= best_mag) {
+      best_mag = std::abs(g);
+      best = i;
+    }
+  }
+  if (best < 0) return -1.f;
+
+  // parabola through the peak and its neighbours
+  float offset = 0.f;
+  if (best >= 2 && best + 2 < n) {
+    const float a = std::abs(grad_[best - 1]);
+    const float b = std::abs(grad_[best]);
+    const float c = std::abs(grad_[best + 1]);
+    const float denom = a - 2 * b + c;
+    if (denom < 0) offset = std::min(std::max(0.5f * (a - c) / denom, -0.5f), 0.5f);
+  }
+  return best + offset;
+}
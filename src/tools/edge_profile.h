@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Bilinear sample of an 8-bit single-channel plane, coordinates clamped to it.
+float sample_bilinear(const cv::Mat& gray, float x, float y);
+
+// Strongest step edge along 1-D intensity profiles (calipers, radial rays).
+// The profile is Gaussian-smoothed, differentiated with central differences
+// and the peak gradient of the wanted sign is interpolated with a parabola.
+// Keeps its scratch buffers: one finder per thread.
+class ProfileEdgeFinder {
+public:
+  // polarity: +1 dark->light along the profile, -1 light->dark, 0 either.
+  // min_gradient: weakest accepted edge, gray levels per sample.
+  ProfileEdgeFinder(double sigma, int polarity, double min_gradient);
+
+  // Sub-pixel index of the edge in `profile`, or -1 when there is none.
+  float find(const std::vector<float>& profile);
+
+private:
+  std::vector<float> kernel_;
+  int polarity_ = 0;
+  float min_gradient_ = 0.f;
+  std::vector<float> smooth_;
+  std::vector<float> grad_;
+};
+
+} // namespace tools
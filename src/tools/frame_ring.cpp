@@ -0,0 +1,369 @@
+#include "frame_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace tools;
+
+// the counters are shared between processes: they must not hide a lock
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "frame ring needs lock-free 32/64-bit atomics");
+
+namespace {
+
+constexpr size_t kAlign = 64;  // cache line: header, slot headers and rows do not share lines
+
+constexpr size_t align_up(size_t n) { return (n + kAlign - 1) / kAlign * kAlign; }
+
+constexpr size_t kHeaderBytes = align_up(sizeof(FrameRingHeader));
+constexpr size_t kSlotHeaderBytes = align_up(sizeof(FrameSlotHeader));
+
+uchar* slot_pixels(FrameSlotHeader* slot) {
+  return reinterpret_cast<uchar*>(slot) + kSlotHeaderBytes;
+}
+
+FrameSlotHeader* slot_at(FrameRingHeader* header, uint32_t i) {
+  return reinterpret_cast<FrameSlotHeader*>(reinterpret_cast<uchar*>(header) + kHeaderBytes + i * header->slot_stride);
+}
+
+constexpr uint64_t kReclaiming = UINT64_MAX;  // lease owner while its pins are cleared
+constexpr int64_t kNsPerMs = 1000000;
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t current_process_id() {
+#ifdef _WIN32
+  return static_cast<uint64_t>(_getpid());
+#else
+  return static_cast<uint64_t>(getpid());
+#endif
+}
+
+// A pin word is the lease epoch the pins were counted under (high half) and
+// their count (low half). Pins left behind by an earlier epoch of the lease
+// hold nothing.
+constexpr uint32_t pin_epoch(uint64_t word) { return static_cast<uint32_t>(word >> 32); }
+constexpr uint32_t pin_count(uint64_t word) { return static_cast<uint32_t>(word); }
+
+bool pinned(const FrameRingHeader* header, const FrameSlotHeader* slot) {
+  for (int r = 0; r < kFrameRingReaders; ++r) {
+    const uint64_t word = slot->pins[r].load();
+    if (pin_count(word) != 0 && pin_epoch(word) == static_cast<uint32_t>(header->leases[r].epoch.load())) return true;
+  }
+  return false;
+}
+
+bool lease_stale(const FrameReaderLease& lease, int64_t now) {
+  return now - lease.heartbeat_ns.load() > kFrameLeaseTimeoutMs * kNsPerMs;
+}
+
+// Takes lease r from `owner`: of the producer and attaching readers that
+// find the same stale lease, only the one whose exchange succeeds clears it.
+bool expire_lease(FrameRingHeader* header, int r, uint64_t owner) {
+  FrameReaderLease& lease = header->leases[r];
+  if (!lease.owner.compare_exchange_strong(owner, kReclaiming)) return false;
+  lease.epoch.fetch_add(1);
+  for (uint32_t i = 0; i < header->slot_count; ++i) slot_at(header, i)->pins[r].store(0);
+  lease.owner.store(0);
+  header->expired.fetch_add(1);
+  return true;
+}
+
+void expire_stale_leases(FrameRingHeader* header, int64_t now) {
+  for (int r = 0; r < kFrameRingReaders; ++r) {
+    const uint64_t owner = header->leases[r].owner.load();
+    if (owner != 0 && owner != kReclaiming && lease_stale(header->leases[r], now)) expire_lease(header, r, owner);
+  }
+}
+
+void set_error(std::string* error, const std::string& message) {
+  if (error) *error = message;
+}
+
+} // namespace
+
+// The reader's lease: beats from its own thread while the source or any of
+// its frames is alive, and is handed back when the last of them is gone.
+class tools::FrameRingLease {
+public:
+  FrameRingLease(FrameRingHeader* header, int index, uint64_t owner, std::shared_ptr<void> mapping)
+    : header_(header), index_(index), owner_(owner), epoch_(header->leases[index].epoch.load()),
+      mapping_(std::move(mapping)), thread_([this]() { beat(); }) {}
+
+  ~FrameRingLease() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+    // every pin is gone by now; an expired lease is no longer ours to free
+    FrameReaderLease& lease = header_->leases[index_];
+    uint64_t owner = owner_;
+    if (lease.epoch.load() == epoch_ && lease.owner.compare_exchange_strong(owner, kReclaiming)) {
+      lease.epoch.fetch_add(1);
+      lease.owner.store(0);
+    }
+  }
+
+  // False once the producer expired the lease (this process stalled past
+  // the timeout): the pin counters belong to the next reader then.
+  bool valid() const { return header_->leases[index_].epoch.load() == epoch_; }
+
+  // Counts one pin on `slot` under this lease's epoch, replacing a count left
+  // by an earlier epoch. False (nothing counted) once the lease is expired.
+  bool pin(FrameSlotHeader* slot) const {
+    std::atomic<uint64_t>& word = slot->pins[index_];
+    const uint32_t tag = static_cast<uint32_t>(epoch_);
+    uint64_t w = word.load();
+    do {
+      if (!valid()) return false;
+    } while (!word.compare_exchange_weak(w, pin_epoch(w) == tag ? w + 1 : (static_cast<uint64_t>(tag) << 32 | 1)));
+    return true;
+  }
+
+  // Takes one pin back: never below zero, and a count of another epoch (the
+  // lease was expired, and maybe claimed again, meanwhile) is left alone.
+  void unpin(FrameSlotHeader* slot) const {
+    std::atomic<uint64_t>& word = slot->pins[index_];
+    const uint32_t tag = static_cast<uint32_t>(epoch_);
+    uint64_t w = word.load();
+    while (pin_epoch(w) == tag && pin_count(w) != 0 && !word.compare_exchange_weak(w, w - 1)) {}
+  }
+
+private:
+  void beat() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      header_->leases[index_].heartbeat_ns.store(now_ns());
+      wake_.wait_for(lock, std::chrono::milliseconds(kFrameLeaseHeartbeatMs));
+    }
+  }
+
+  FrameRingHeader* header_;
+  int index_;
+  uint64_t owner_;
+  uint64_t epoch_;
+  std::shared_ptr<void> mapping_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::thread thread_;  // last: starts once the members above exist
+};
+
+namespace {
+
+// Frame::owner of a ring frame: holds the pin, the lease and the mapping
+struct SlotPin {
+  SlotPin(FrameSlotHeader* s, std::shared_ptr<FrameRingLease> l) : slot(s), lease(std::move(l)) {}
+  ~SlotPin() { lease->unpin(slot); }
+  FrameSlotHeader* slot;
+  std::shared_ptr<FrameRingLease> lease;
+};
+
+} // namespace
+
+size_t tools::frame_ring_bytes(int slots, size_t max_frame_bytes) {
+  return kHeaderBytes + static_cast<size_t>(slots) * (kSlotHeaderBytes + align_up(max_frame_bytes));
+}
+
+FrameRingWriter::FrameRingWriter(void* base, size_t size, int slots, size_t max_frame_bytes, double fps) {
+  CV_Assert(slots > 0 && size >= frame_ring_bytes(slots, max_frame_bytes));
+  header_ = new (base) FrameRingHeader();
+  header_->slot_count = static_cast<uint32_t>(slots);
+  header_->slot_stride = kSlotHeaderBytes + align_up(max_frame_bytes);
+  header_->max_frame_bytes = max_frame_bytes;
+  header_->fps = fps;
+  for (int i = 0; i < slots; ++i) new (slot_at(header_, static_cast<uint32_t>(i))) FrameSlotHeader();
+  // readers check the magic first: write it last
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = kFrameRingMagic;
+}
+
+bool FrameRingWriter::write(const cv::Mat& image) {
+  const bool type_ok = image.type() == CV_8UC1 || image.type() == CV_8UC3;
+  const size_t row_bytes = image.cols * image.elemSize();
+  if (image.empty() || !type_ok || row_bytes * image.rows > header_->max_frame_bytes) {
+    header_->dropped.fetch_add(1);
+    return false;
+  }
+
+  const int64_t now = now_ns();
+  if (now - last_sweep_ns_ >= kFrameLeaseHeartbeatMs * kNsPerMs) {
+    last_sweep_ns_ = now;
+    expire_stale_leases(header_, now);
+  }
+
+  // oldest frames first; a slot being read is left alone
+  std::vector<std::pair<uint64_t, uint32_t>> order;
+  order.reserve(header_->slot_count);
+  for (uint32_t i = 0; i < header_->slot_count; ++i) order.emplace_back(slot_at(header_, i)->sequence.load(), i);
+  std::sort(order.begin(), order.end());
+
+  for (const auto& candidate : order) {
+    FrameSlotHeader* s = slot_at(header_, candidate.second);
+    if (pinned(header_, s)) continue;
+    // seqlock enter, then look for a reader that pinned the slot meanwhile;
+    // a reader pins before it re-checks version, so one of the two sees the
+    // other (both sides are sequentially consistent)
+    const uint64_t v = s->version.load();
+    s->version.store(v + 1);
+    if (pinned(header_, s)) {
+      s->version.store(v + 2);
+      continue;
+    }
+    s->type = image.type();
+    s->width = image.cols;
+    s->height = image.rows;
+    s->step = static_cast<int64_t>(row_bytes);
+    s->captured_ns = now_ns();
+    uchar* dst = slot_pixels(s);
+    if (image.isContinuous()) {
+      std::memcpy(dst, image.data, row_bytes * image.rows);
+    } else {
+      for (int y = 0; y < image.rows; ++y) std::memcpy(dst + y * row_bytes, image.ptr(y), row_bytes);
+    }
+    s->sequence.store(++sequence_);
+    s->version.store(v + 2);
+    header_->published.store(sequence_);
+    return true;
+  }
+  header_->dropped.fetch_add(1);
+  return false;
+}
+
+void FrameRingWriter::close() {
+  header_->closed.store(1);
+}
+
+uint64_t FrameRingWriter::dropped() const {
+  return header_->dropped.load();
+}
+
+uint64_t FrameRingWriter::expired() const {
+  return header_->expired.load();
+}
+
+std::unique_ptr<FrameRingSource> FrameRingSource::open(void* base, size_t size, std::shared_ptr<void> mapping,
+                                                       std::string description, std::string* error) {
+  if (!base || size < kHeaderBytes) {
+    set_error(error, "segment too small for a frame ring");
+    return nullptr;
+  }
+  FrameRingHeader* header = static_cast<FrameRingHeader*>(base);
+  if (header->magic != kFrameRingMagic) {
+    set_error(error, "no frame ring in the segment");
+    return nullptr;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header->slot_count == 0 ||
+      header->slot_stride < kSlotHeaderBytes + header->max_frame_bytes ||
+      size < kHeaderBytes + header->slot_count * header->slot_stride) {
+    set_error(error, "invalid frame ring header");
+    return nullptr;
+  }
+
+  // claim a free lease; a stale one is cleared first, so a reader restarted
+  // after a crash gets its slots back without waiting for the producer
+  const uint64_t pid = current_process_id();
+  const int64_t now = now_ns();
+  for (int r = 0; r < kFrameRingReaders; ++r) {
+    FrameReaderLease& lease = header->leases[r];
+    uint64_t owner = lease.owner.load();
+    if (owner != 0 && owner != kReclaiming && lease_stale(lease, now) && expire_lease(header, r, owner)) owner = 0;
+    if (owner != 0) continue;
+    // fresh before it is ours, or the producer could expire it right away
+    lease.heartbeat_ns.store(now);
+    if (!lease.owner.compare_exchange_strong(owner, pid)) continue;
+    // a reader expired mid-pin can leave a count behind: start from zero
+    for (uint32_t i = 0; i < header->slot_count; ++i) slot_at(header, i)->pins[r].store(0);
+    auto claimed = std::make_shared<FrameRingLease>(header, r, pid, std::move(mapping));
+    return std::unique_ptr<FrameRingSource>(new FrameRingSource(header, std::move(claimed), std::move(description)));
+  }
+  set_error(error, "every reader lease of the frame ring is taken");
+  return nullptr;
+}
+
+FrameRingSource::FrameRingSource(FrameRingHeader* header, std::shared_ptr<FrameRingLease> lease,
+                                 std::string description)
+  : header_(header), lease_(std::move(lease)), description_(std::move(description)) {}
+
+FrameSlotHeader* FrameRingSource::slot(uint32_t i) const {
+  return slot_at(header_, i);
+}
+
+bool FrameRingSource::try_read(Frame& frame) {
+  if (header_->published.load() < next_ || !lease_->valid()) return false;
+
+  // the oldest frame at or after next_ that is still in the ring
+  uint32_t best = header_->slot_count;
+  uint64_t best_seq = UINT64_MAX;
+  for (uint32_t i = 0; i < header_->slot_count; ++i) {
+    FrameSlotHeader* s = slot(i);
+    if (s->version.load() & 1) continue;
+    const uint64_t seq = s->sequence.load();
+    if (seq >= next_ && seq < best_seq) {
+      best = i;
+      best_seq = seq;
+    }
+  }
+  if (best == header_->slot_count) return false;
+
+  FrameSlotHeader* s = slot(best);
+  const uint64_t v = s->version.load();
+  if (v & 1) return false;
+  if (!lease_->pin(s)) return false;
+  auto pin = std::make_shared<SlotPin>(s, lease_);
+  // rewritten between the scan and the pin: look again
+  if (s->version.load() != v || s->sequence.load() != best_seq || !lease_->valid()) return false;
+
+  skipped_.fetch_add(best_seq - next_);
+  next_ = best_seq + 1;
+  const bool type_ok = s->type == CV_8UC1 || s->type == CV_8UC3;
+  const int64_t row_bytes = static_cast<int64_t>(s->width) * (s->type == CV_8UC3 ? 3 : 1);
+  if (!type_ok || s->width <= 0 || s->height <= 0 || s->step < row_bytes ||
+      static_cast<uint64_t>(s->step * (s->height - 1) + row_bytes) > header_->max_frame_bytes) {
+    return false;  // corrupt slot: skip the frame
+  }
+
+  frame.index = best_seq - 1;
+  frame.pixels = cv::Mat(s->height, s->width, s->type, slot_pixels(s), static_cast<size_t>(s->step));
+  frame.owner = std::move(pin);
+  frame.captured = std::chrono::steady_clock::time_point(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(s->captured_ns)));
+  return true;
+}
+
+bool FrameRingSource::read(Frame& frame) {
+  auto idle_since = std::chrono::steady_clock::now();
+  while (!interrupted_.load()) {
+    if (try_read(frame)) return true;
+    if (header_->closed.load() && header_->published.load() < next_) return false;
+    // the producer expired our lease: the slots are no longer held for us
+    if (!lease_->valid()) return false;
+    // no cross-process wake-up: yield right after a miss, then poll every half
+    // millisecond so an idle ring does not burn a core
+    if (std::chrono::steady_clock::now() - idle_since < std::chrono::microseconds(200)) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  }
+  return false;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+constexpr int kFrameRingReaders = 8;  // reader processes attached at the same time
+
+// Ring of frames in a block of shared memory, written by one producer
+// process and read by consumers without copying: a consumer pins the slot it
+// reads, the frame's cv::Mat points straight into the segment, and the
+// producer skips pinned slots until the last owner of the frame lets go.
+// The GUI paints the displayed frame straight from its slot as well, so
+// neither detection nor display copies the pixels.
+//
+// Layout: FrameRingHeader, then slot_count slots of slot_stride bytes, each a
+// FrameSlotHeader followed by the pixels. Every slot is a seqlock: version is
+// odd while the producer writes it. The segment itself (QSharedMemory, a
+// mapped file...) is the caller's business; these classes only see memory.
+//
+// Pins are counted per reader lease, so a reader that dies cannot hold slots
+// forever: an attached reader owns one of the header's leases and refreshes
+// its heartbeat from a thread of its own. A lease whose heartbeat is older
+// than kFrameLeaseTimeoutMs is expired by the producer (or by a reader that
+// attaches): its pins are cleared and the lease is free again. Each pin
+// counter carries the lease epoch it was counted under, so a late unpin from
+// an expired reader cannot touch the count of the reader that came next.
+constexpr int64_t kFrameLeaseHeartbeatMs = 100;
+constexpr int64_t kFrameLeaseTimeoutMs = 2000;
+
+struct FrameReaderLease {
+  std::atomic<uint64_t> owner{0};         // process id of the reader, 0 = free
+  std::atomic<uint64_t> epoch{0};         // bumped on every release / expiry
+  std::atomic<int64_t> heartbeat_ns{0};   // steady_clock, see captured_ns
+};
+
+struct FrameRingHeader {
+  uint32_t magic = 0;
+  uint32_t slot_count = 0;
+  uint64_t slot_stride = 0;
+  uint64_t max_frame_bytes = 0;
+  double fps = 0.0;                     // producer's nominal rate, 0 = unknown
+  std::atomic<uint64_t> published{0};   // sequence of the newest frame, 0 = none yet
+  std::atomic<uint64_t> dropped{0};     // frames the producer found no free slot for
+  std::atomic<uint32_t> closed{0};      // producer finished; read what is left
+  std::atomic<uint64_t> expired{0};     // leases taken from readers that stopped beating
+  FrameReaderLease leases[kFrameRingReaders];
+};
+
+struct FrameSlotHeader {
+  std::atomic<uint64_t> version{0};
+  std::atomic<uint64_t> sequence{0};    // 1-based frame number, 0 = empty
+  std::atomic<uint64_t> pins[kFrameRingReaders] = {};  // per lease: epoch << 32 | count
+  int32_t type = 0;                     // CV_8UC1 or CV_8UC3 (BGR)
+  int32_t width = 0;
+  int32_t height = 0;
+  int64_t step = 0;
+  // std::chrono::steady_clock, which is system-wide on the hosts we run on
+  // (QueryPerformanceCounter / CLOCK_MONOTONIC): capture time across processes
+  int64_t captured_ns = 0;
+};
+
+constexpr uint32_t kFrameRingMagic = 0x33475246;  // "FRG3"
+
+size_t frame_ring_bytes(int slots, size_t max_frame_bytes);
+
+// Producer side. Not thread-safe: one writer per ring.
+class FrameRingWriter {
+public:
+  // Formats `base` (size bytes, see frame_ring_bytes) as an empty ring.
+  FrameRingWriter(void* base, size_t size, int slots, size_t max_frame_bytes, double fps = 0.0);
+
+  // Copies `image` (8UC1 / 8UC3) into the oldest unpinned slot and publishes
+  // it. False when it does not fit a slot or every slot is pinned; the frame
+  // is dropped (and counted) then. Expires dead readers' leases first.
+  bool write(const cv::Mat& image);
+  // Tells the readers there will be no more frames.
+  void close();
+
+  uint64_t written() const { return sequence_; }
+  uint64_t dropped() const;
+  uint64_t expired() const;
+
+private:
+  FrameRingHeader* header_ = nullptr;
+  uint64_t sequence_ = 0;
+  int64_t last_sweep_ns_ = 0;
+};
+
+class FrameRingLease;  // a reader's claim on one of the header's leases (frame_ring.cpp)
+
+// Consumer side: the ring as a FrameSource. Frames come in order; when the
+// reader falls behind by more than the ring holds it resumes at the oldest
+// frame still there (skipped() counts the gap). Each Frame pins its slot
+// through Frame::owner, so the pixels stay valid exactly as long as the frame
+// (or an ImageDocument made from it) is alive. The reader's lease (and its
+// heartbeat thread) lives until the source and its last frame are gone.
+class FrameRingSource : public FrameSource {
+public:
+  // `mapping` keeps the memory at `base` mapped (e.g. owns the shared-memory
+  // handle); every frame shares it. nullptr (and *error) if there is no ring
+  // or every lease is taken.
+  static std::unique_ptr<FrameRingSource> open(void* base, size_t size, std::shared_ptr<void> mapping,
+                                               std::string description, std::string* error = nullptr);
+
+  // Waits for the next frame; false once the producer closed the ring and
+  // every frame was read, or after interrupt().
+  bool read(Frame& frame) override;
+  void interrupt() override { interrupted_.store(true); }
+  double fps() const override { return header_->fps; }
+  std::string description() const override { return description_; }
+
+  uint64_t skipped() const { return skipped_.load(); }
+
+private:
+  FrameRingSource(FrameRingHeader* header, std::shared_ptr<FrameRingLease> lease, std::string description);
+  FrameSlotHeader* slot(uint32_t i) const;
+  bool try_read(Frame& frame);
+
+  FrameRingHeader* header_ = nullptr;
+  std::shared_ptr<FrameRingLease> lease_;  // holds the mapping; shared with every frame
+  std::string description_;
+  uint64_t next_ = 1;
+  std::atomic<uint64_t> skipped_{0};
+  std::atomic<bool> interrupted_{false};
+};
+
+} // namespace tools
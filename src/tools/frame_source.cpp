@@ -0,0 +1,78 @@
+#include "frame_source.h"
+#include "image_files.h"
+#include "trace.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <opencv2/imgcodecs.hpp>
+
+namespace fs = std::filesystem;
+using namespace tools;
+
+VideoFrameSource::VideoFrameSource(const std::string& path) : path_(path) {
+  capture_.open(path);
+}
+
+bool VideoFrameSource::is_open() const {
+  return capture_.isOpened();
+}
+
+bool VideoFrameSource::read(Frame& frame) {
+  if (!capture_.isOpened()) return false;
+  frame.captured = std::chrono::steady_clock::now();
+  TRACE_SCOPE("VideoCapture::read");
+  // a fresh Mat per frame: the previous one may still be in use downstream
+  cv::Mat pixels;
+  if (!capture_.read(pixels) || pixels.empty()) return false;
+  frame.index = next_index_++;
+  frame.pixels = pixels;
+  return true;
+}
+
+double VideoFrameSource::fps() const {
+  const double fps = capture_.get(cv::CAP_PROP_FPS);
+  return fps > 0 ? fps : 0.0;
+}
+
+long long VideoFrameSource::frame_count() const {
+  const double n = capture_.get(cv::CAP_PROP_FRAME_COUNT);
+  return n > 0 ? static_cast<long long>(n) : -1;
+}
+
+ImageSequenceSource::ImageSequenceSource(const std::string& directory, double fps)
+  : directory_(directory), fps_(fps) {
+  // numbered frames in numeric order: frame2 before frame10
+  std::error_code ec;
+  for (const fs::path& p : list_image_files(fs::u8path(directory), false, ec)) files_.push_back(p.u8string());
+}
+
+bool ImageSequenceSource::read(Frame& frame) {
+  while (next_ < files_.size()) {
+    const size_t idx = next_++;
+    frame.captured = std::chrono::steady_clock::now();
+    TRACE_SCOPE("imdecode");
+    std::ifstream in(fs::u8path(files_[idx]), std::ios::binary);
+    std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    cv::Mat pixels = bytes.empty() ? cv::Mat() : cv::imdecode(bytes, cv::IMREAD_ANYCOLOR);
+    if (pixels.empty() || pixels.depth() != CV_8U) continue;  // skip unreadable files
+    frame.index = idx;
+    frame.pixels = pixels;
+    return true;
+  }
+  return false;
+}
+
+std::unique_ptr<FrameSource> tools::open_frame_source(const std::string& path, std::string* error) {
+  std::error_code ec;
+  if (fs::is_directory(fs::u8path(path), ec)) {
+    auto seq = std::make_unique<ImageSequenceSource>(path);
+    if (seq->frame_count() > 0) return seq;
+    if (error) *error = "no images in " + path;
+    return nullptr;
+  }
+  auto video = std::make_unique<VideoFrameSource>(path);
+  if (video->is_open()) return video;
+  if (error) *error = "cannot open " + path;
+  return nullptr;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace tools {
+
+// One decoded frame of a sequence.
+struct Frame {
+  uint64_t index = 0;
+  cv::Mat pixels;  // 8UC1 or 8UC3 (BGR), owned by the frame or by `owner`
+  std::chrono::steady_clock::time_point captured;  // when decoding started
+  // Keeps memory the pixels point into valid (e.g. a pinned shared-memory
+  // slot, see FrameRingSource); null when the Mat owns its buffer.
+  std::shared_ptr<void> owner;
+};
+
+// Source of consecutive frames (video file, image sequence, ...).
+// read() is only called from one thread at a time; interrupt() may be called
+// from any thread.
+class FrameSource {
+public:
+  virtual ~FrameSource() = default;
+  // Next frame; false at the end of the sequence or on a read error.
+  virtual bool read(Frame& frame) = 0;
+  // Sources whose read() waits for frames (live input) return from it, and
+  // from every later call, with false. Called by StreamPipeline::stop().
+  virtual void interrupt() {}
+  // Nominal frame rate, 0 if the source has none.
+  virtual double fps() const { return 0.0; }
+  // Number of frames if known, -1 otherwise.
+  virtual long long frame_count() const { return -1; }
+  virtual std::string description() const = 0;
+};
+
+// Video file, or a printf-style image pattern such as "frame_%04d.png",
+// through cv::VideoCapture.
+class VideoFrameSource : public FrameSource {
+public:
+  explicit VideoFrameSource(const std::string& path);
+  bool is_open() const;
+  bool read(Frame& frame) override;
+  double fps() const override;
+  long long frame_count() const override;
+  std::string description() const override { return path_; }
+
+private:
+  std::string path_;
+  cv::VideoCapture capture_;
+  uint64_t next_index_ = 0;
+};
+
+// Every image file of a directory, in file name order.
+class ImageSequenceSource : public FrameSource {
+public:
+  ImageSequenceSource(const std::string& directory, double fps = 0.0);
+  bool read(Frame& frame) override;
+  double fps() const override { return fps_; }
+  long long frame_count() const override { return static_cast<long long>(files_.size()); }
+  std::string description() const override { return directory_; }
+
+private:
+  std::string directory_;
+  std::vector<std::string> files_;
+  size_t next_ = 0;
+  double fps_ = 0.0;
+};
+
+// Directory -> ImageSequenceSource, anything else -> VideoFrameSource.
+// nullptr (and *error) if nothing can be read.
+std::unique_ptr<FrameSource> open_frame_source(const std::string& path, std::string* error = nullptr);
+
+} // namespace tools
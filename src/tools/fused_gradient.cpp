@@ -0,0 +1,237 @@
+#include "fused_gradient.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+
+// output rows per band: a band's working rows stay in L2 for images up to
+// ~10k px wide, and there are enough bands to keep every worker busy
+constexpr int kBandRows = 32;
+
+inline int reflect101(int i, int n) {
+  if (n == 1) return 0;
+  if (i < 0) return -i;
+  if (i >= n) return 2 * n - 2 - i;
+  return i;
+}
+
+inline int clamp_row(int i, int n) { return std::min(std::max(i, 0), n - 1); }
+
+// v[x] = a[x] + 2 b[x] + c[x]
+void vertical_121(const uchar* a, const uchar* b, const uchar* c, ushort* v, int w) {
+  int x = 0;
+#if CV_SIMD
+  const int n = cv::VTraits<cv::v_uint16>::vlanes();
+  for (; x <= w - n; x += n) {
+    const cv::v_uint16 s = cv::v_add(cv::v_add(cv::v_load_expand(a + x), cv::v_load_expand(c + x)),
+                                     cv::v_shl<1>(cv::v_load_expand(b + x)));
+    cv::v_store(v + x, s);
+  }
+#endif
+  for (; x < w; ++x) v[x] = static_cast<ushort>(a[x] + 2 * b[x] + c[x]);
+}
+
+// out[x] = (v[x-1] + 2 v[x] + v[x+1] + 8) >> 4, v padded by one element on
+// both sides (v[-1] and v[w] valid)
+void horizontal_121(const ushort* v, uchar* out, int w) {
+  int x = 0;
+#if CV_SIMD
+  const int n = cv::VTraits<cv::v_uint16>::vlanes();
+  const cv::v_uint16 round = cv::v_setall_u16(8);
+  for (; x <= w - n; x += n) {
+    const cv::v_uint16 s = cv::v_add(cv::v_add(cv::v_load(v + x - 1), cv::v_load(v + x + 1)),
+                                     cv::v_add(cv::v_shl<1>(cv::v_load(v + x)), round));
+    cv::v_pack_store(out + x, cv::v_shr<4>(s));
+  }
+#endif
+  for (; x < w; ++x) out[x] = static_cast<uchar>((v[x - 1] + 2 * v[x] + v[x + 1] + 8) >> 4);
+}
+
+// 3x3 Sobel of three consecutive rows, each padded by one element on both
+// sides
+void sobel_3x3(const uchar* r0, const uchar* r1, const uchar* r2, short* dx, short* dy, int w) {
+  int x = 0;
+#if CV_SIMD
+  using cv::v_int16;
+  const int n = cv::VTraits<v_int16>::vlanes();
+  auto load = [](const uchar* p) { return cv::v_reinterpret_as_s16(cv::v_load_expand(p)); };
+  for (; x <= w - n; x += n) {
+    const v_int16 l0 = load(r0 + x - 1), m0 = load(r0 + x), q0 = load(r0 + x + 1);
+    const v_int16 l1 = load(r1 + x - 1), q1 = load(r1 + x + 1);
+    const v_int16 l2 = load(r2 + x - 1), m2 = load(r2 + x), q2 = load(r2 + x + 1);
+    const v_int16 gx = cv::v_add(cv::v_add(cv::v_sub(q0, l0), cv::v_sub(q2, l2)), cv::v_shl<1>(cv::v_sub(q1, l1)));
+    const v_int16 gy = cv::v_sub(cv::v_add(cv::v_add(l2, q2), cv::v_shl<1>(m2)),
+                                 cv::v_add(cv::v_add(l0, q0), cv::v_shl<1>(m0)));
+    cv::v_store(dx + x, gx);
+    cv::v_store(dy + x, gy);
+  }
+#endif
+  for (; x < w; ++x) {
+    dx[x] = static_cast<short>((r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]));
+    dy[x] = static_cast<short>((r2[x - 1] + 2 * r2[x] + r2[x + 1]) - (r0[x - 1] + 2 * r0[x] + r0[x + 1]));
+  }
+}
+
+// Non-maximum suppression of cv::Canny, in its fixed point: tan(22.5 deg)
+// << kCannyShift
+constexpr int kCannyShift = 15;
+constexpr int kTg22 = static_cast<int>(0.4142135623730950488016887242097 * (1 << kCannyShift) + 0.5);
+
+// edge map values until hysteresis has run
+constexpr uchar kNotEdge = 0;
+constexpr uchar kWeak = 1;    // local maximum above low
+constexpr uchar kStrong = 2;  // above high, or connected to such a pixel
+
+// Edge map rows [y0, y1). Needs the gradient of rows y0-1 .. y1 (zero
+// outside src), so blurred rows y0-2 .. y1+1 (replicated at the edges), so
+// gray rows y0-3 .. y1+2 (reflected). Every stage keeps three rows in a
+// ring: rows are visited in order, so three slots hold y-1, y, y+1. Strong
+// pixels are appended to `strong` for hysteresis.
+void run_band(const cv::Mat& src, cv::Mat& edges, int y0, int y1, int low, int high,
+              std::vector<cv::Point>& strong) {
+  const int w = src.cols, h = src.rows;
+  const bool bgr = src.channels() == 3;
+
+  std::vector<uchar> gray(bgr ? 3 * static_cast<size_t>(w) : 0);
+  int gray_tag[3] = { -1, -1, -1 };
+  auto gray_row = [&](int y) -> const uchar* {
+    if (!bgr) return src.ptr<uchar>(y);
+    uchar* row = &gray[static_cast<size_t>(y % 3) * w];
+    if (gray_tag[y % 3] != y) {
+      cv::Mat dst(1, w, CV_8UC1, row);
+      cv::cvtColor(src.row(y), dst, cv::COLOR_BGR2GRAY);
+      gray_tag[y % 3] = y;
+    }
+    return row;
+  };
+
+  // blurred rows, padded by one replicated pixel on both sides
+  const int stride = w + 2;
+  std::vector<ushort> vsum(stride);
+  std::vector<uchar> blurred(3 * static_cast<size_t>(stride));
+  int blurred_tag[3] = { -1, -1, -1 };
+  auto blurred_row = [&](int j) -> const uchar* {
+    uchar* row = &blurred[static_cast<size_t>(j % 3) * stride];
+    if (blurred_tag[j % 3] == j) return row + 1;
+    ushort* v = vsum.data() + 1;
+    vertical_121(gray_row(reflect101(j - 1, h)), gray_row(j), gray_row(reflect101(j + 1, h)), v, w);
+    v[-1] = v[reflect101(-1, w)];
+    v[w] = v[reflect101(w, w)];
+    horizontal_121(v, row + 1, w);
+    row[0] = row[1];
+    row[w + 1] = row[w];
+    blurred_tag[j % 3] = j;
+    return row + 1;
+  };
+
+  // dx, dy and |dx| + |dy| per row; the magnitude is padded by a zero on
+  // both sides and rows outside src read as zeros, as in cv::Canny
+  std::vector<short> dxy(6 * static_cast<size_t>(w));
+  std::vector<int> mag(4 * static_cast<size_t>(stride), 0);  // 3 slots + the zero row
+  const int* zero_row = &mag[3 * static_cast<size_t>(stride)] + 1;
+  int grad_tag[3] = { -1, -1, -1 };
+  auto gradient_row = [&](int k) -> int {
+    const int s = k % 3;
+    if (grad_tag[s] == k) return s;
+    short* dx = &dxy[static_cast<size_t>(2 * s) * w];
+    short* dy = dx + w;
+    const uchar* r0 = blurred_row(clamp_row(k - 1, h));
+    const uchar* r1 = blurred_row(k);
+    const uchar* r2 = blurred_row(clamp_row(k + 1, h));
+    sobel_3x3(r0, r1, r2, dx, dy, w);
+    int* m = &mag[static_cast<size_t>(s) * stride] + 1;
+    for (int x = 0; x < w; ++x) m[x] = std::abs(dx[x]) + std::abs(dy[x]);
+    m[-1] = m[w] = 0;
+    grad_tag[s] = k;
+    return s;
+  };
+  auto mag_row = [&](int k) -> const int* {
+    if (k < 0 || k >= h) return zero_row;
+    return &mag[static_cast<size_t>(gradient_row(k)) * stride] + 1;
+  };
+
+  for (int y = y0; y < y1; ++y) {
+    const int* mp = mag_row(y - 1);
+    const int* ma = mag_row(y);
+    const int* mn = mag_row(y + 1);
+    const short* dx = &dxy[static_cast<size_t>(2 * (y % 3)) * w];
+    const short* dy = dx + w;
+    uchar* out = edges.ptr<uchar>(y);
+    for (int x = 0; x < w; ++x) {
+      const int m = ma[x];
+      uchar v = kNotEdge;
+      if (m > low) {
+        const int xs = dx[x], ys = dy[x];
+        const int ax = std::abs(xs), ay = std::abs(ys) << kCannyShift;
+        const int tg22x = ax * kTg22;
+        bool peak;
+        if (ay < tg22x) {
+          peak = m > ma[x - 1] && m >= ma[x + 1];
+        } else if (ay > tg22x + (ax << (kCannyShift + 1))) {
+          peak = m > mp[x] && m >= mn[x];
+        } else {
+          const int s = (xs ^ ys) < 0 ? -1 : 1;
+          peak = m > mp[x - s] && m > mn[x + s];
+        }
+        if (peak) {
+          v = m > high ? kStrong : kWeak;
+          if (v == kStrong) strong.emplace_back(x, y);
+        }
+      }
+      out[x] = v;
+    }
+  }
+}
+
+// Grows the strong pixels of `stack` into their 8-connected weak neighbours.
+void hysteresis(cv::Mat& edges, std::vector<cv::Point>& stack) {
+  const int w = edges.cols, h = edges.rows;
+  while (!stack.empty()) {
+    const cv::Point p = stack.back();
+    stack.pop_back();
+    for (int y = std::max(p.y - 1, 0); y <= std::min(p.y + 1, h - 1); ++y) {
+      uchar* row = edges.ptr<uchar>(y);
+      for (int x = std::max(p.x - 1, 0); x <= std::min(p.x + 1, w - 1); ++x) {
+        if (row[x] != kWeak) continue;
+        row[x] = kStrong;
+        stack.emplace_back(x, y);
+      }
+    }
+  }
+}
+
+} // namespace
+
+void tools::fused_edges(const cv::Mat& src, cv::Mat& edges, double low, double high, const RunContext* ctx) {
+  CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3));
+  edges.create(src.size(), CV_8UC1);
+  if (src.empty()) return;
+  if (low > high) std::swap(low, high);
+  const int low_i = cvFloor(low), high_i = cvFloor(high);
+
+  const size_t bands = static_cast<size_t>((src.rows + kBandRows - 1) / kBandRows);
+  std::vector<std::vector<cv::Point>> strong(bands);
+  {
+    TRACE_SCOPE_PX("fused_edges", static_cast<int64_t>(src.total()));
+    ThreadPool::global().parallel_for(0, bands, [&](size_t b) {
+      if (ctx && ctx->cancelled()) return;
+      const int y0 = static_cast<int>(b) * kBandRows;
+      run_band(src, edges, y0, std::min(src.rows, y0 + kBandRows), low_i, high_i, strong[b]);
+    });
+  }
+  if (ctx && ctx->cancelled()) return;
+
+  // the one pass over the whole map: weak pixels reached from a strong one
+  // become edges, everything else is cleared
+  TRACE_SCOPE_PX("fused_edges.hysteresis", static_cast<int64_t>(src.total()));
+  for (std::vector<cv::Point>& stack : strong) hysteresis(edges, stack);
+  cv::compare(edges, kStrong, edges, cv::CMP_EQ);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "run_context.h"
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Fused edge front end: BGR (or gray) -> gray -> 3x3 Gaussian -> 3x3 Sobel
+// -> gradient magnitude -> non-maximum suppression in one streaming pass.
+// Rows are processed in bands that stay in cache, bands run in parallel on
+// the global pool, and every intermediate plane (gray, blurred, dx/dy,
+// magnitude) only ever exists as a ring of three rows per band: the only
+// full-size write is the 8-bit edge map itself. Hysteresis then follows the
+// strong pixels the bands collected and a last pass over the map turns it
+// into 0 / 255.
+//
+// The result matches cv::Canny(dx, dy, edges, low, high) (L1 gradient) with
+// dx/dy the Sobel of cvtColor + GaussianBlur(3x3, sigma 0) of src as a
+// separate image: BORDER_REFLECT_101 for the blur, BORDER_REPLICATE for the
+// gradient. Pixels outside src are never read. src is 8UC1 or 8UC3 (BGR),
+// typically a ROI view. When ctx is cancelled during the pass, edges is
+// incomplete.
+void fused_edges(const cv::Mat& src, cv::Mat& edges, double low, double high, const RunContext* ctx = nullptr);
+
+} // namespace tools
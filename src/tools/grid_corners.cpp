@@ -0,0 +1,176 @@
+#include "grid_corners.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+
+// corners refined per cornerSubPix task
+constexpr size_t kSubpixChunk = 256;
+// smallest bucket edge: a tiny min_distance would otherwise mean one bucket
+// (one std::vector) per pixel of the image
+constexpr int kMinBucket = 8;
+
+struct Candidate {
+  float response = 0.f;
+  int x = 0;
+  int y = 0;
+  int cell = 0;
+};
+
+// goodFeaturesToTrack's order: ties go to the later pixel (it sorts
+// pointers into the response plane, higher address first)
+bool stronger(const Candidate& a, const Candidate& b) {
+  if (a.response != b.response) return a.response > b.response;
+  if (a.y != b.y) return a.y > b.y;
+  return a.x > b.x;
+}
+
+// Kept corners hashed into buckets of at least min_distance (and at least
+// kMinBucket) pixels: everything closer than min_distance to a new corner
+// lies in the 3x3 buckets around it.
+class BucketGrid {
+public:
+  BucketGrid(const cv::Size& area, double min_dist)
+    : size_(std::max(kMinBucket, static_cast<int>(std::ceil(min_dist)))),
+      nx_((area.width + size_ - 1) / size_),
+      ny_((area.height + size_ - 1) / size_),
+      min_dist2_(min_dist * min_dist),
+      buckets_(static_cast<size_t>(nx_) * ny_) {}
+
+  bool free(int x, int y) const {
+    const int bx = x / size_, by = y / size_;
+    for (int ny = std::max(0, by - 1); ny <= std::min(ny_ - 1, by + 1); ++ny) {
+      for (int nx = std::max(0, bx - 1); nx <= std::min(nx_ - 1, bx + 1); ++nx) {
+        for (const cv::Point& p : buckets_[static_cast<size_t>(ny) * nx_ + nx]) {
+          const double dx = x - p.x, dy = y - p.y;
+          if (dx * dx + dy * dy < min_dist2_) return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void add(int x, int y) {
+    buckets_[static_cast<size_t>(y / size_) * nx_ + x / size_].push_back(cv::Point(x, y));
+  }
+
+private:
+  int size_;
+  int nx_;
+  int ny_;
+  double min_dist2_;
+  std::vector<std::vector<cv::Point>> buckets_;
+};
+
+bool is_local_max(const cv::Mat& response, int x, int y, float v) {
+  for (int dy = -1; dy <= 1; ++dy) {
+    const float* row = response.ptr<float>(y + dy);
+    for (int dx = -1; dx <= 1; ++dx) {
+      if (row[x + dx] > v) return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+std::vector<cv::Point2f> tools::grid_corners(const cv::Mat& response, const cv::Mat& gray,
+                                             const GridCornerOptions& options, ThreadPool& pool,
+                                             const RunContext* ctx) {
+  std::vector<cv::Point2f> corners;
+  if (response.empty() || response.type() != CV_32FC1 || response.cols < 3 || response.rows < 3) return corners;
+
+  double max_response = 0.0;
+  cv::minMaxLoc(response, nullptr, &max_response);
+  if (max_response <= 0) return corners;
+  const float threshold = static_cast<float>(max_response * options.quality_level);
+
+  const int cell = std::max(1, options.cell_size);
+  const int cells_x = (response.cols + cell - 1) / cell;
+  const int cells_y = (response.rows + cell - 1) / cell;
+  // distinct pixels are at least 1 apart: smaller distances suppress nothing
+  const double min_dist = options.min_distance;
+  const bool suppress = min_dist > 1.0;
+
+  // 1. thresholded local maxima per cell; one task per row of cells. No
+  // suppression here: a corner dropped for a stronger one of its cell could
+  // outlive it, when stage 2 drops that one for a neighbour in another cell
+  std::vector<std::vector<Candidate>> candidates(cells_y);
+  {
+    TRACE_SCOPE_PX("grid_corners.candidates", response.total());
+    pool.parallel_for(0, cells_y, [&](size_t cy) {
+      if (ctx && ctx->cancelled()) return;
+      std::vector<Candidate>& found = candidates[cy];
+      const int y0 = std::max(1, static_cast<int>(cy) * cell);
+      const int y1 = std::min(response.rows - 1, static_cast<int>(cy + 1) * cell);
+      for (int cx = 0; cx < cells_x; ++cx) {
+        const int x0 = std::max(1, cx * cell);
+        const int x1 = std::min(response.cols - 1, (cx + 1) * cell);
+        for (int y = y0; y < y1; ++y) {
+          const float* row = response.ptr<float>(y);
+          for (int x = x0; x < x1; ++x) {
+            const float v = row[x];
+            if (v > threshold && is_local_max(response, x, y, v)) {
+              found.push_back(Candidate{ v, x, y, static_cast<int>(cy) * cells_x + cx });
+            }
+          }
+        }
+      }
+    });
+  }
+  if (ctx && ctx->cancelled()) return corners;
+
+  // 2. candidates strongest first against the kept corners nearby
+  std::vector<Candidate> all;
+  {
+    size_t total = 0;
+    for (const auto& s : candidates) total += s.size();
+    all.reserve(total);
+    for (auto& s : candidates) {
+      all.insert(all.end(), s.begin(), s.end());
+      std::vector<Candidate>().swap(s);
+    }
+  }
+  {
+    TRACE_SCOPE_PX("grid_corners.suppress", static_cast<int64_t>(all.size()));
+    std::sort(all.begin(), all.end(), stronger);
+
+    BucketGrid accepted(suppress ? response.size() : cv::Size(1, 1), suppress ? min_dist : 1.0);
+    std::vector<int> per_cell(options.per_cell > 0 ? static_cast<size_t>(cells_x) * cells_y : 0, 0);
+    const size_t limit = options.max_corners > 0 ? static_cast<size_t>(options.max_corners) : all.size();
+    corners.reserve(std::min(limit, all.size()));
+
+    for (const Candidate& c : all) {
+      if (corners.size() >= limit) break;
+      if (!per_cell.empty() && per_cell[c.cell] >= options.per_cell) continue;
+      if (suppress) {
+        if (!accepted.free(c.x, c.y)) continue;
+        accepted.add(c.x, c.y);
+      }
+      if (!per_cell.empty()) ++per_cell[c.cell];
+      corners.push_back(cv::Point2f(static_cast<float>(c.x), static_cast<float>(c.y)));
+    }
+  }
+
+  // 3. sub-pixel refinement, independent per corner
+  if (options.subpix && !corners.empty() && !gray.empty() && !(ctx && ctx->cancelled())) {
+    TRACE_SCOPE_PX("cornerSubPix", static_cast<int64_t>(corners.size()));
+    const cv::Size window(options.subpix_window, options.subpix_window);
+    const cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 20, 0.03);
+    const size_t chunks = (corners.size() + kSubpixChunk - 1) / kSubpixChunk;
+    pool.parallel_for(0, chunks, [&](size_t i) {
+      if (ctx && ctx->cancelled()) return;
+      const size_t begin = i * kSubpixChunk;
+      const size_t end = std::min(corners.size(), begin + kSubpixChunk);
+      std::vector<cv::Point2f> chunk(corners.begin() + begin, corners.begin() + end);
+      cv::cornerSubPix(gray, chunk, window, cv::Size(-1, -1), criteria);
+      std::copy(chunk.begin(), chunk.end(), corners.begin() + begin);
+    });
+  }
+  return corners;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "run_context.h"
+#include "thread_pool.h"
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+struct GridCornerOptions {
+  int max_corners = 0;          // strongest N are kept, 0 = no limit
+  double quality_level = 0.01;  // fraction of the strongest response a corner needs
+  double min_distance = 10.0;   // between kept corners, pixels
+  int cell_size = 32;           // grid cell for the quota and the parallel pass
+  int per_cell = 0;             // corners kept per cell, 0 = no quota
+  bool subpix = false;          // refine with cornerSubPix
+  int subpix_window = 5;        // cornerSubPix half window
+};
+
+// goodFeaturesToTrack on a precomputed response plane, with grid buckets
+// instead of pairwise distance checks:
+//  1. per grid cell (in parallel): 3x3 local maxima above the quality
+//     threshold;
+//  2. all of them, strongest first, against the kept corners in the
+//     neighbouring min_distance buckets, honouring the per-cell quota and
+//     max_corners. Without a quota the corners (and their order) are those
+//     of goodFeaturesToTrack on the same response, for an integer
+//     min_distance (it buckets by cvRound(min_distance) and misses some
+//     closer neighbours otherwise);
+//  3. optionally cornerSubPix on `gray`, in chunks on the pool.
+// Cost is linear in the pixels plus (candidates log candidates), so large
+// max_corners stay cheap. Corners are returned strongest first.
+std::vector<cv::Point2f> grid_corners(const cv::Mat& response, const cv::Mat& gray,
+                                      const GridCornerOptions& options, ThreadPool& pool,
+                                      const RunContext* ctx = nullptr);
+
+} // namespace tools
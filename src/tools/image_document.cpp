@@ -0,0 +1,87 @@
+#include "image_document.h"
+#include "trace.h"
+
+#include <atomic>
+#include <cstring>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+std::atomic<uint64_t> g_next_document_id{1};
+
+inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+// MurmurHash3-style 64-bit word mixing, row by row (ROI views included)
+uint64_t hash_plane(const cv::Mat& m) {
+  uint64_t h = 0x9e3779b97f4a7c15ull;
+  auto mix = [&h](uint64_t w) {
+    w *= 0x87c37b91114253d5ull;
+    w = rotl(w, 31);
+    w *= 0x4cf5ad432745937full;
+    h ^= w;
+    h = rotl(h, 27) * 5 + 0x52dce729;
+  };
+  mix(static_cast<uint64_t>(m.rows));
+  mix(static_cast<uint64_t>(m.cols));
+  mix(static_cast<uint64_t>(m.type()));
+  const size_t row_bytes = m.cols * m.elemSize();
+  for (int y = 0; y < m.rows; ++y) {
+    const uchar* p = m.ptr<uchar>(y);
+    size_t i = 0;
+    for (; i + 8 <= row_bytes; i += 8) {
+      uint64_t w;
+      std::memcpy(&w, p + i, 8);
+      mix(w);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, row_bytes - i);
+    mix(tail);
+  }
+  // final avalanche
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace
+
+ImageDocument::ImageDocument(cv::Mat pixels, std::shared_ptr<void> owner)
+  : id_(g_next_document_id.fetch_add(1)), owner_(std::move(owner)), pixels_(std::move(pixels)) {}
+
+std::shared_ptr<ImageDocument> ImageDocument::from_mat(cv::Mat pixels, std::shared_ptr<void> owner) {
+  if (pixels.empty() || pixels.depth() != CV_8U) return nullptr;
+  if (pixels.channels() != 1 && pixels.channels() != 3) return nullptr;
+  return std::shared_ptr<ImageDocument>(new ImageDocument(std::move(pixels), std::move(owner)));
+}
+
+std::shared_ptr<ImageDocument> ImageDocument::decode(const uchar* data, size_t size) {
+  if (!data || size == 0) return nullptr;
+  TRACE_SCOPE("imdecode");
+  const cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uchar*>(data));
+  // ANYCOLOR keeps gray files single-channel (no 3x BGR expansion)
+  cv::Mat pixels = cv::imdecode(encoded, cv::IMREAD_ANYCOLOR);
+  return from_mat(std::move(pixels));
+}
+
+const cv::Mat& ImageDocument::gray() const {
+  std::call_once(gray_once_, [this]() {
+    TRACE_SCOPE_PX("document.gray", static_cast<int64_t>(pixels_.total()));
+    if (pixels_.channels() == 1) gray_ = pixels_;
+    else cv::cvtColor(pixels_, gray_, cv::COLOR_BGR2GRAY);
+  });
+  return gray_;
+}
+
+uint64_t ImageDocument::content_hash() const {
+  std::call_once(hash_once_, [this]() {
+    const cv::Mat& g = gray();
+    TRACE_SCOPE_PX("document.hash", static_cast<int64_t>(g.total()));
+    hash_ = hash_plane(g);
+  });
+  return hash_;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Decoded image shared by the view and the tools.
+// Pixels are decoded once (8UC1 gray or 8UC3 BGR); the grayscale plane the
+// tools work on is built on first use and reused by every later run.
+class ImageDocument {
+public:
+  // Takes an 8UC1 / 8UC3(BGR) matrix without copying it. `owner` keeps
+  // memory the matrix does not own alive as long as the document (a frame
+  // in shared memory, see FrameRingSource).
+  static std::shared_ptr<ImageDocument> from_mat(cv::Mat pixels, std::shared_ptr<void> owner = nullptr);
+  // Decodes an encoded file buffer (png/jpg/bmp...), nullptr on failure.
+  static std::shared_ptr<ImageDocument> decode(const uchar* data, size_t size);
+
+  // Unique per document, never reused within a process.
+  uint64_t id() const { return id_; }
+  int width() const { return pixels_.cols; }
+  int height() const { return pixels_.rows; }
+  bool empty() const { return pixels_.empty(); }
+
+  // Decoded pixels, 8UC1 or 8UC3 (BGR). Read-only for everyone.
+  const cv::Mat& pixels() const { return pixels_; }
+  // Grayscale plane (8UC1). Same buffer as pixels() for gray sources.
+  // Thread-safe; built lazily on the first call.
+  const cv::Mat& gray() const;
+  // 64-bit hash of the grayscale plane (size and pixels): equal for equal
+  // content in any document or process, unlike id(). Key of the result
+  // cache. Thread-safe; computed on the first call.
+  uint64_t content_hash() const;
+
+private:
+  ImageDocument(cv::Mat pixels, std::shared_ptr<void> owner);
+
+  uint64_t id_ = 0;
+  std::shared_ptr<void> owner_;  // declared first: released after every view of it
+  cv::Mat pixels_;
+  mutable std::once_flag gray_once_;
+  mutable cv::Mat gray_;
+  mutable std::once_flag hash_once_;
+  mutable uint64_t hash_ = 0;
+};
+
+} // namespace tools
@@ -0,0 +1,158 @@
+#include "image_files.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+using namespace tools;
+
+namespace {
+
+bool is_digit(char c) {
+  return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+uint64_t read_uint(const unsigned char* p, int bytes, bool little) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v |= static_cast<uint64_t>(p[little ? i : bytes - 1 - i]) << (8 * i);
+  return v;
+}
+
+bool read_at(std::ifstream& in, uint64_t offset, unsigned char* out, size_t n) {
+  in.clear();
+  in.seekg(static_cast<std::streamoff>(offset));
+  in.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(n));
+  return static_cast<size_t>(in.gcount()) == n;
+}
+
+// walks the marker segments up to the first frame header (SOFn)
+bool jpeg_size(std::ifstream& in, int64_t& width, int64_t& height) {
+  unsigned char m[9];
+  uint64_t pos = 2;
+  while (read_at(in, pos, m, 4)) {
+    if (m[0] != 0xFF) return false;
+    const unsigned char marker = m[1];
+    if (marker == 0xFF) {  // fill byte
+      ++pos;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {  // no length
+      pos += 2;
+      continue;
+    }
+    if (marker == 0xD9 || marker == 0xDA) return false;  // image data before any frame header
+    const bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+    if (sof) {
+      if (!read_at(in, pos + 4, m, 5)) return false;
+      height = static_cast<int64_t>(read_uint(m + 1, 2, false));
+      width = static_cast<int64_t>(read_uint(m + 3, 2, false));
+      return true;
+    }
+    pos += 2 + read_uint(m + 2, 2, false);
+  }
+  return false;
+}
+
+// ImageWidth (256) and ImageLength (257) of the first directory
+bool tiff_size(std::ifstream& in, const unsigned char* head, int64_t& width, int64_t& height) {
+  const bool little = head[0] == 'I';
+  const uint64_t version = read_uint(head + 2, 2, little);
+  if (version != 42 && version != 43) return false;
+  const bool big = version == 43;
+  const uint64_t ifd = big ? read_uint(head + 8, 8, little) : read_uint(head + 4, 4, little);
+  const int count_bytes = big ? 8 : 2, entry_bytes = big ? 20 : 12, value_at = big ? 12 : 8;
+  unsigned char e[20];
+  if (!read_at(in, ifd, e, count_bytes)) return false;
+  const uint64_t count = std::min<uint64_t>(read_uint(e, count_bytes, little), 4096);
+  width = height = 0;
+  for (uint64_t i = 0; i < count && (width == 0 || height == 0); ++i) {
+    if (!read_at(in, ifd + count_bytes + i * entry_bytes, e, entry_bytes)) return false;
+    const uint64_t tag = read_uint(e, 2, little), type = read_uint(e + 2, 2, little);
+    if (tag != 256 && tag != 257) continue;
+    const int size = type == 3 ? 2 : type == 4 ? 4 : type == 16 ? 8 : 0;  // SHORT, LONG, LONG8
+    if (size == 0) return false;
+    (tag == 256 ? width : height) = static_cast<int64_t>(read_uint(e + value_at, size, little));
+  }
+  return width > 0 && height > 0;
+}
+
+} // namespace
+
+bool tools::is_image_file(const fs::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tif" || ext == ".tiff";
+}
+
+bool tools::read_image_size(const fs::path& path, int64_t& width, int64_t& height) {
+  std::ifstream in(path, std::ios::binary);
+  unsigned char h[26];
+  if (!in || !read_at(in, 0, h, sizeof(h))) return false;
+  static const unsigned char png[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (std::memcmp(h, png, 8) == 0 && std::memcmp(h + 12, "IHDR", 4) == 0) {
+    width = static_cast<int64_t>(read_uint(h + 16, 4, false));
+    height = static_cast<int64_t>(read_uint(h + 20, 4, false));
+    return true;
+  }
+  if (h[0] == 0xFF && h[1] == 0xD8) return jpeg_size(in, width, height);
+  if (h[0] == 'B' && h[1] == 'M') {
+    if (read_uint(h + 14, 4, true) == 12) {  // BITMAPCOREHEADER
+      width = static_cast<int64_t>(read_uint(h + 18, 2, true));
+      height = static_cast<int64_t>(read_uint(h + 20, 2, true));
+    } else {  // BITMAPINFOHEADER and later; negative height = top-down
+      width = static_cast<int32_t>(read_uint(h + 18, 4, true));
+      height = std::llabs(static_cast<int32_t>(read_uint(h + 22, 4, true)));
+    }
+    return true;
+  }
+  if ((h[0] == 'I' && h[1] == 'I') || (h[0] == 'M' && h[1] == 'M')) return tiff_size(in, h, width, height);
+  return false;
+}
+
+bool tools::natural_less(const std::string& a, const std::string& b) {
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (!is_digit(a[i]) || !is_digit(b[j])) {
+      if (a[i] != b[j]) return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[j]);
+      ++i;
+      ++j;
+      continue;
+    }
+    // digit runs without leading zeros: the shorter one is the smaller number
+    size_t ie = i, je = j;
+    while (ie < a.size() && is_digit(a[ie])) ++ie;
+    while (je < b.size() && is_digit(b[je])) ++je;
+    while (i + 1 < ie && a[i] == '0') ++i;
+    while (j + 1 < je && b[j] == '0') ++j;
+    if (ie - i != je - j) return ie - i < je - j;
+    const int c = a.compare(i, ie - i, b, j, je - j);
+    if (c != 0) return c < 0;
+    i = ie;
+    j = je;
+  }
+  if (i < a.size() || j < b.size()) return i == a.size();
+  return a < b;  // equal up to leading zeros ("01" / "1"): still a strict order
+}
+
+std::vector<fs::path> tools::list_image_files(const fs::path& dir, bool recursive, std::error_code& ec) {
+  std::vector<fs::path> files;
+  ec.clear();
+  auto take = [&files](const fs::directory_entry& e) {
+    std::error_code type_ec;
+    if (e.is_regular_file(type_ec) && is_image_file(e.path())) files.push_back(e.path());
+  };
+  if (recursive) {
+    for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) take(*it);
+  } else {
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) take(*it);
+  }
+  std::vector<std::pair<std::string, fs::path>> keyed;
+  keyed.reserve(files.size());
+  for (fs::path& p : files) keyed.emplace_back(p.u8string(), std::move(p));
+  std::sort(keyed.begin(), keyed.end(), [](const auto& x, const auto& y) { return natural_less(x.first, y.first); });
+  for (size_t k = 0; k < keyed.size(); ++k) files[k] = std::move(keyed[k].second);
+  return files;
+}
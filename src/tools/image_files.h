@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace tools {
+
+// Image files the tools read (by extension, case-insensitive):
+// png, jpg/jpeg, bmp, tif/tiff.
+bool is_image_file(const std::filesystem::path& path);
+
+// Pixel size of an image file read from its header, without decoding
+// (PNG, JPEG, BMP, TIFF / BigTIFF: the first page). False if the file cannot
+// be read or its header is not one of these.
+bool read_image_size(const std::filesystem::path& path, int64_t& width, int64_t& height);
+
+// Order of numbered file names: runs of digits compare by value, so
+// "frame2" < "frame10"; everything else compares byte by byte.
+bool natural_less(const std::string& a, const std::string& b);
+
+// Image files in `dir` (and its subdirectories if `recursive`), in natural
+// order of their UTF-8 paths. On an error `ec` is set and the files found
+// so far are returned.
+std::vector<std::filesystem::path> list_image_files(const std::filesystem::path& dir, bool recursive,
+                                                    std::error_code& ec);
+
+} // namespace tools
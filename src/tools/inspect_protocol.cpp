@@ -0,0 +1,214 @@
+#include "inspect_protocol.h"
+#include "result_io.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+using namespace tools;
+
+namespace {
+
+const char kBinaryMagic[4] = { 'I', 'R', 'S', '1' };
+
+void set_error(std::string* error, const std::string& message) {
+  if (error) *error = message;
+}
+
+std::string trim(const std::string& s) {
+  const size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == std::string::npos) return std::string();
+  const size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e - b + 1);
+}
+
+std::string num(double v) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.4f", v);
+  return buf;
+}
+
+template <class T> void put(std::string& out, const T& v) {
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void put_string(std::string& out, const std::string& s) {
+  put(out, static_cast<uint32_t>(s.size()));
+  out += s;
+}
+
+template <class T> bool get(std::istream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+bool get_string(std::istream& in, std::string& s) {
+  uint32_t n = 0;
+  if (!get(in, n) || n > kMaxFrameBytes) return false;
+  s.resize(n);
+  return n == 0 || static_cast<bool>(in.read(&s[0], n));
+}
+
+} // namespace
+
+void tools::append_frame(std::string& out, const std::string& payload) {
+  const uint32_t n = static_cast<uint32_t>(payload.size());
+  const unsigned char len[4] = { static_cast<unsigned char>(n), static_cast<unsigned char>(n >> 8),
+                                 static_cast<unsigned char>(n >> 16), static_cast<unsigned char>(n >> 24) };
+  out.append(reinterpret_cast<const char*>(len), 4);
+  out += payload;
+}
+
+bool tools::take_frame(std::string& buffer, std::string& payload, std::string* error) {
+  if (buffer.size() < 4) return false;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer.data());
+  const uint32_t n = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+  if (n > kMaxFrameBytes) {
+    set_error(error, "frame of " + std::to_string(n) + " bytes exceeds the limit");
+    return false;
+  }
+  if (buffer.size() < 4 + static_cast<size_t>(n)) return false;
+  payload.assign(buffer, 4, n);
+  buffer.erase(0, 4 + static_cast<size_t>(n));
+  return true;
+}
+
+bool tools::parse_request(const std::string& text, InspectRequest& request, std::string* error) {
+  std::istringstream in(text);
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t eq = line.find('=');
+    const std::string key = eq == std::string::npos ? std::string() : trim(line.substr(0, eq));
+    const std::string value = eq == std::string::npos ? std::string() : trim(line.substr(eq + 1));
+    if (key == "id") request.id = value;
+    else if (key == "image") request.image = value;
+    else if (key == "shm") request.shm = value;
+    else if (key == "format") {
+      if (value != "json" && value != "binary") {
+        set_error(error, "format must be json or binary: " + value);
+        return false;
+      }
+      request.binary = value == "binary";
+    } else if (key == "command") {
+      if (value != "stats") {
+        set_error(error, "unknown command: " + value);
+        return false;
+      }
+      request.stats = true;
+    } else if (!parse_recipe_line(request.recipe, line, error)) {
+      return false;
+    }
+  }
+  if (!request.stats && request.image.empty() == request.shm.empty()) {
+    set_error(error, "request needs exactly one of image and shm");
+    return false;
+  }
+  return true;
+}
+
+std::string tools::format_request(const InspectRequest& request) {
+  std::string s;
+  if (!request.id.empty()) s += "id = " + request.id + '\n';
+  if (request.stats) return s + "command = stats\n";
+  if (!request.image.empty()) s += "image = " + request.image + '\n';
+  if (!request.shm.empty()) s += "shm = " + request.shm + '\n';
+  if (request.binary) s += "format = binary\n";
+  // to_string() is "tool=line;line.rho=1;...": one key per line
+  std::istringstream spec(to_string(request.recipe.tool));
+  std::string item;
+  while (std::getline(spec, item, ';')) s += item + '\n';
+  const cv::Rect& r = request.recipe.roi;
+  if (!r.empty()) {
+    s += "roi = " + std::to_string(r.x) + ',' + std::to_string(r.y) + ',' + std::to_string(r.width) + ',' +
+         std::to_string(r.height) + '\n';
+  }
+  if (request.recipe.roi_angle != 0.0) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "roi_angle = %.17g\n", request.recipe.roi_angle);
+    s += buf;
+  }
+  return s;
+}
+
+std::string tools::encode_response(const InspectResponse& response, bool binary) {
+  if (!binary || !response.stats_json.empty()) {
+    std::string s = "{\"id\":\"" + json_escape(response.id) + "\",\"ok\":" + (response.ok ? "true" : "false");
+    if (!response.ok) return s + ",\"error\":\"" + json_escape(response.error) + "\"}";
+    if (!response.stats_json.empty()) return s + ",\"stats\":" + response.stats_json + '}';
+    return s + ",\"ms\":" + num(response.ms) + ",\"tool_ms\":" + num(response.tool_ms) +
+           ",\"result\":" + to_json(response.result) + '}';
+  }
+  std::string s(kBinaryMagic, sizeof(kBinaryMagic));
+  const uint8_t flags[4] = { static_cast<uint8_t>(response.ok ? 1 : 0), 0, 0, 0 };
+  s.append(reinterpret_cast<const char*>(flags), sizeof(flags));
+  put(s, response.ms);
+  put(s, response.tool_ms);
+  put_string(s, response.id);
+  put_string(s, response.error);
+  if (response.ok) {
+    std::ostringstream result;
+    write_binary(result, response.result);
+    s += result.str();
+  }
+  return s;
+}
+
+bool tools::decode_binary_response(const std::string& payload, InspectResponse& response, std::string* error) {
+  if (payload.size() < 8 || std::memcmp(payload.data(), kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+    set_error(error, "not a binary response");
+    return false;
+  }
+  std::istringstream in(payload);
+  in.seekg(sizeof(kBinaryMagic));
+  uint8_t flags[4] = {};
+  InspectResponse r;
+  if (!in.read(reinterpret_cast<char*>(flags), sizeof(flags)) || !get(in, r.ms) || !get(in, r.tool_ms) ||
+      !get_string(in, r.id) || !get_string(in, r.error)) {
+    set_error(error, "truncated response");
+    return false;
+  }
+  r.ok = flags[0] != 0;
+  if (r.ok && !read_binary(in, r.result)) {
+    set_error(error, "truncated result");
+    return false;
+  }
+  response = std::move(r);
+  return true;
+}
+
+size_t tools::shared_image_bytes(const cv::Mat& image) {
+  return sizeof(SharedImageHeader) + image.total() * image.elemSize();
+}
+
+void tools::write_shared_image(void* dst, const cv::Mat& image) {
+  SharedImageHeader h;
+  h.magic = kSharedImageMagic;
+  h.width = image.cols;
+  h.height = image.rows;
+  h.type = image.type();
+  h.step = static_cast<int64_t>(image.cols * image.elemSize());
+  h.offset = sizeof(SharedImageHeader);
+  std::memcpy(dst, &h, sizeof(h));
+  uchar* pixels = static_cast<uchar*>(dst) + h.offset;
+  for (int y = 0; y < image.rows; ++y) std::memcpy(pixels + y * h.step, image.ptr(y), static_cast<size_t>(h.step));
+}
+
+bool tools::read_shared_image(const void* src, size_t size, cv::Mat& image, std::string* error) {
+  SharedImageHeader h;
+  if (size < sizeof(h)) {
+    set_error(error, "shared image segment too small");
+    return false;
+  }
+  std::memcpy(&h, src, sizeof(h));
+  const bool type_ok = h.type == CV_8UC1 || h.type == CV_8UC3;
+  const int64_t row_bytes = static_cast<int64_t>(h.width) * (h.type == CV_8UC3 ? 3 : 1);
+  if (h.magic != kSharedImageMagic || !type_ok || h.width <= 0 || h.height <= 0 || h.step < row_bytes ||
+      h.offset < static_cast<int64_t>(sizeof(h)) ||
+      h.offset + h.step * (h.height - 1) + row_bytes > static_cast<int64_t>(size)) {
+    set_error(error, "invalid shared image header");
+    return false;
+  }
+  const cv::Mat view(h.height, h.width, h.type,
+                     const_cast<uchar*>(static_cast<const uchar*>(src) + h.offset), static_cast<size_t>(h.step));
+  image = view.clone();
+  return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "detection_result.h"
+#include "tool_spec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Wire format of the local inspection server (src/server). Every message in
+// both directions is one frame: a uint32 little-endian payload length, then
+// the payload. Requests may be pipelined; responses come back in completion
+// order and carry the request id.
+constexpr uint32_t kMaxFrameBytes = 64u << 20;
+
+void append_frame(std::string& out, const std::string& payload);
+// Moves the first complete frame of `buffer` into `payload`. False when the
+// frame is not complete yet, or (with *error set) when it is oversized.
+bool take_frame(std::string& buffer, std::string& payload, std::string* error = nullptr);
+
+// Request payload: "key = value" lines, the recipe syntax (tool, <tool>.<param>,
+// roi, roi_angle) plus:
+//   id = text          echoed in the response
+//   image = path       UTF-8 path of an encoded image, or
+//   shm = key          shared-memory image (SharedImageHeader layout)
+//   format = binary    binary response instead of JSON
+//   command = stats    latency statistics of the server instead of a run
+struct InspectRequest {
+  std::string id;
+  std::string image;
+  std::string shm;
+  bool binary = false;
+  bool stats = false;
+  Recipe recipe;
+};
+
+bool parse_request(const std::string& text, InspectRequest& request, std::string* error = nullptr);
+std::string format_request(const InspectRequest& request);
+
+// JSON response (no trailing newline):
+//   {"id":"..","ok":true,"ms":..,"tool_ms":..,"result":{...to_json...}}
+//   {"id":"..","ok":false,"error":".."}
+//   {"id":"..","ok":true,"stats":{...}}                 (command = stats)
+// Binary response, native byte order (little-endian on the x86/x64 hosts
+// this runs on): "IRS1", uint8 ok, 3 zero bytes, double ms, double tool_ms,
+// uint32 length + id, uint32 length + error, then write_binary(result) when ok.
+struct InspectResponse {
+  std::string id;
+  bool ok = false;
+  std::string error;
+  double ms = 0.0;       // request received -> response ready, server side
+  double tool_ms = 0.0;  // the tool run alone
+  DetectionResult result;
+  std::string stats_json;  // command = stats (JSON only)
+};
+
+std::string encode_response(const InspectResponse& response, bool binary);
+// Binary responses only; JSON ones are meant to be read as JSON.
+bool decode_binary_response(const std::string& payload, InspectResponse& response, std::string* error = nullptr);
+
+// Image in a shared-memory segment: this header, then rows of `step` bytes
+// starting `offset` bytes into the segment. type is CV_8UC1 or CV_8UC3 (BGR).
+struct SharedImageHeader {
+  uint32_t magic = 0;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t type = 0;
+  int64_t step = 0;
+  int64_t offset = 0;
+};
+constexpr uint32_t kSharedImageMagic = 0x31474d49;  // "IMG1"
+
+size_t shared_image_bytes(const cv::Mat& image);
+// dst must hold shared_image_bytes(image) bytes.
+void write_shared_image(void* dst, const cv::Mat& image);
+// Copies the image out of the segment (the segment may change after unlock).
+bool read_shared_image(const void* src, size_t size, cv::Mat& image, std::string* error = nullptr);
+
+} // namespace tools
@@ -0,0 +1,34 @@
+#include "itool.h"
+#include "oriented_roi.h"
+#include "trace.h"
+
+using namespace tools;
+
+DetectionResult ITool::run_oriented(const cv::Mat& image, const cv::RotatedRect& region) {
+  cv::Rect rect;
+  if (axis_aligned_rect(region, rect)) return run(image, rect);
+
+  OrientedPatch patch;
+  {
+    TRACE_SCOPE_PX("extract_oriented", static_cast<int64_t>(region.size.area()));
+    patch = extract_oriented(image, region);
+  }
+  // The patch is not the image ctx_->image_id names, so it runs without the
+  // stage cache; cancellation and progress still reach the caller.
+  RunContext* outer = ctx_;
+  RunContext local;
+  if (outer) {
+    local.parent = outer;
+    local.on_progress = outer->on_progress;
+  }
+  struct Restore {
+    ITool* tool;
+    RunContext* ctx;
+    ~Restore() { tool->ctx_ = ctx; }
+  } restore{ this, outer };
+  ctx_ = outer ? &local : nullptr;
+
+  DetectionResult res = run(patch.pixels, cv::Rect());
+  map_to_image(res, patch.to_image);
+  return res;
+}
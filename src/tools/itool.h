@@ -1,6 +1,7 @@
 #pragma once
 
 #include "detection_result.h"
+#include "run_context.h"
 #include <opencv2/core.hpp>
 
 namespace tools {
@@ -10,6 +11,25 @@ public:
   virtual ~ITool() = default;
   // ͼ񼰿ѡROI DetectionResult
   virtual DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) = 0;
+
+  // Computes (and caches through the context) the preprocessing planes run()
+  // would need for `region`, so runs on ROIs inside it can share them.
+  virtual void prepare(const cv::Mat& image, const cv::Rect& region) { (void)image; (void)region; }
+
+  // Oriented ROI: only the rotated region is resampled (bilinear) into an
+  // upright buffer of its size, run() processes that buffer and the result is
+  // mapped back to image coordinates. Multiples of 90 degrees run on the
+  // plain rectangle. Tools that measure along the region override this.
+  virtual DetectionResult run_oriented(const cv::Mat& image, const cv::RotatedRect& region);
+
+  // Optional: lets a caller cancel the run and observe progress (may be null).
+  void set_context(RunContext* ctx) { ctx_ = ctx; }
+
+protected:
+  bool cancelled() const { return ctx_ && ctx_->cancelled(); }
+  void report_progress(int percent) const { if (ctx_) ctx_->report_progress(percent); }
+
+  RunContext* ctx_ = nullptr;
 };
 
 } // namespace tools
@@ -0,0 +1,89 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace tools;
+
+int LatencyHistogram::bucket_for(double ms) {
+  if (!(ms > kMinMs)) return 0;
+  const int b = static_cast<int>(std::ceil(std::log2(ms / kMinMs) * kBucketsPerOctave));
+  return std::min(b, kBuckets - 1);
+}
+
+double LatencyHistogram::upper_bound(int bucket) {
+  return kMinMs * std::exp2(static_cast<double>(bucket) / kBucketsPerOctave);
+}
+
+void LatencyHistogram::record(double ms) {
+  ms = std::max(0.0, ms);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++counts_[bucket_for(ms)];
+  min_ms_ = count_ ? std::min(min_ms_, ms) : ms;
+  max_ms_ = count_ ? std::max(max_ms_, ms) : ms;
+  ++count_;
+  sum_ms_ += ms;
+}
+
+void LatencyHistogram::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  counts_.fill(0);
+  count_ = 0;
+  sum_ms_ = min_ms_ = max_ms_ = 0.0;
+}
+
+double LatencyHistogram::percentile_locked(double p) const {
+  if (count_ == 0) return 0.0;
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * count_)));
+  uint64_t seen = 0;
+  for (int b = 0; b < kBuckets; ++b) {
+    seen += counts_[b];
+    if (seen >= rank) return std::min(upper_bound(b), max_ms_);
+  }
+  return max_ms_;
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Summary s;
+  s.count = count_;
+  if (count_ == 0) return s;
+  s.mean_ms = sum_ms_ / count_;
+  s.min_ms = min_ms_;
+  s.max_ms = max_ms_;
+  s.p50_ms = percentile_locked(0.50);
+  s.p90_ms = percentile_locked(0.90);
+  s.p99_ms = percentile_locked(0.99);
+  s.p999_ms = percentile_locked(0.999);
+  return s;
+}
+
+std::string LatencyHistogram::to_json() const {
+  const Summary s = summary();
+  char buf[320];
+  std::snprintf(buf, sizeof(buf),
+                "{\"count\":%llu,\"mean_ms\":%.4f,\"min_ms\":%.4f,\"max_ms\":%.4f,\"p50_ms\":%.4f,"
+                "\"p90_ms\":%.4f,\"p99_ms\":%.4f,\"p999_ms\":%.4f,\"buckets\":[",
+                static_cast<unsigned long long>(s.count), s.mean_ms, s.min_ms, s.max_ms,
+                s.p50_ms, s.p90_ms, s.p99_ms, s.p999_ms);
+  std::string out = buf;
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool first = true;
+  for (int b = 0; b < kBuckets; ++b) {
+    if (!counts_[b]) continue;
+    std::snprintf(buf, sizeof(buf), "%s[%.4g,%llu]", first ? "" : ",", upper_bound(b),
+                  static_cast<unsigned long long>(counts_[b]));
+    out += buf;
+    first = false;
+  }
+  return out + "]}";
+}
+
+std::string LatencyHistogram::to_text() const {
+  const Summary s = summary();
+  char buf[192];
+  std::snprintf(buf, sizeof(buf), "n=%llu mean=%.2f p50=%.2f p90=%.2f p99=%.2f max=%.2f ms",
+                static_cast<unsigned long long>(s.count), s.mean_ms, s.p50_ms, s.p90_ms, s.p99_ms, s.max_ms);
+  return buf;
+}
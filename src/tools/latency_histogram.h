@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace tools {
+
+// Latency distribution with log-spaced buckets (four per octave, 10 us to
+// about 100 s), so percentiles stay within ~19% at any scale with constant
+// memory. Thread-safe.
+class LatencyHistogram {
+public:
+  struct Summary {
+    uint64_t count = 0;
+    double mean_ms = 0.0;
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double p999_ms = 0.0;
+  };
+
+  void record(double ms);
+  void reset();
+
+  // Percentiles are bucket upper bounds, capped at the largest sample.
+  Summary summary() const;
+  // {"count":n,"mean_ms":..,"min_ms":..,"max_ms":..,"p50_ms":..,"p90_ms":..,
+  //  "p99_ms":..,"p999_ms":..,"buckets":[[upper_ms,count],...]} (non-empty buckets only)
+  std::string to_json() const;
+  // One line: "n=.. mean=.. p50=.. p90=.. p99=.. max=.. ms"
+  std::string to_text() const;
+
+private:
+  static constexpr int kBucketsPerOctave = 4;
+  static constexpr int kBuckets = 96;
+  static constexpr double kMinMs = 0.01;
+
+  static int bucket_for(double ms);
+  static double upper_bound(int bucket);
+  double percentile_locked(double p) const;
+
+  mutable std::mutex mutex_;
+  std::array<uint64_t, kBuckets> counts_{};
+  uint64_t count_ = 0;
+  double sum_ms_ = 0.0;
+  double min_ms_ = 0.0;
+  double max_ms_ = 0.0;
+};
+
+} // namespace tools
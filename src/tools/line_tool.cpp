@@ -1,35 +1,152 @@
 #include "line_tool.h"
+#include "caliper_tool.h"
+#include "preprocess.h"
+#include "thread_pool.h"
+#include "tiled_hough.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
 
 using namespace tools;
 
+namespace {
+
+// ROIs whose coarse level would be smaller than this run at full resolution
+constexpr int kMinCoarseSide = 64;
+// caliper spacing along a candidate, full-resolution pixels
+constexpr double kCaliperSpacing = 2.0;
+constexpr int kMaxCalipers = 512;
+
+float distance_to_line(const cv::Point2f& p, const cv::Point2f& a, const cv::Point2f& b) {
+  const cv::Point2f d = b - a;
+  const float len = std::hypot(d.x, d.y);
+  if (len < 1e-6f) return std::hypot(p.x - a.x, p.y - a.y);
+  return std::abs((p.x - a.x) * d.y - (p.y - a.y) * d.x) / len;
+}
+
+} // namespace
+
 DetectionResult LineTool::run(const cv::Mat& image, const cv::Rect& roi) {
   DetectionResult res;
   res.kind = DetectionKind::Lines;
 
   if (image.empty()) return res;
 
-  cv::Mat src = image;
-  if (roi.width > 0 && roi.height > 0) {
-    cv::Rect r = roi & cv::Rect(0,0, image.cols, image.rows);
-    src = image(r);
+  const cv::Rect r = stages::clamp_roi(image, roi);
+  if (r.empty()) return res;
+
+  if (params.pyramid_levels > 0 && std::min(r.width, r.height) >> params.pyramid_levels >= kMinCoarseSide) {
+    return run_pyramid(image, r);
   }
 
-  cv::Mat gray, edges;
-  if (src.channels() == 3) cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
-  else gray = src;
-  cv::GaussianBlur(gray, gray, cv::Size(3,3), 0);
-  cv::Canny(gray, edges, 50, 150, 3);
+  // gray -> blur -> Canny, each plane memoized per (image, ROI, params):
+  // changing only the Hough parameters re-runs only HoughLinesP
+  const cv::Mat edges = params.fused ? stages::fused_canny(image, r, 50, 150, ctx_)
+                                     : stages::canny(image, r, cv::Size(3,3), 0, 50, 150, 3, ctx_);
+  if (cancelled()) return res;
+  report_progress(40);
 
   std::vector<cv::Vec4i> lines;
-  cv::HoughLinesP(edges, lines, params.rho, params.theta, params.threshold, params.minLineLength, params.maxLineGap);
+  if (params.tiled && (edges.cols > params.tile_size || edges.rows > params.tile_size)) {
+    TiledHoughOptions opt;
+    opt.tile_size = params.tile_size;
+    opt.overlap = params.tile_overlap;
+    lines = tiled_hough_lines_p(edges, params.rho, params.theta, params.threshold,
+                                params.minLineLength, params.maxLineGap, opt, ThreadPool::global(), ctx_);
+  } else {
+    TRACE_SCOPE_PX("HoughLinesP", edges.total());
+    cv::HoughLinesP(edges, lines, params.rho, params.theta, params.threshold, params.minLineLength, params.maxLineGap);
+  }
+  if (cancelled()) return res;
 
   // ROIҪ
-  if (roi.width > 0 && roi.height > 0) {
-    for (auto& l : lines) {
-      l[0] += roi.x; l[1] += roi.y; l[2] += roi.x; l[3] += roi.y;
-    }
+  for (auto& l : lines) {
+    l[0] += r.x; l[1] += r.y; l[2] += r.x; l[3] += r.y;
   }
 
   res.lines = std::move(lines);
+  report_progress(100);
   return res;
 }
+
+DetectionResult LineTool::run_pyramid(const cv::Mat& image, const cv::Rect& r) {
+  DetectionResult res;
+  res.kind = DetectionKind::Lines;
+  const int levels = params.pyramid_levels;
+  const double scale = static_cast<double>(1 << levels);
+
+  // pyrDown already low-passes, so the coarse level only gets the 3x3 blur
+  // of the full-resolution path
+  const cv::Mat coarse = stages::pyramid(image, r, levels, ctx_);
+  if (cancelled()) return res;
+  cv::Mat edges;
+  {
+    TRACE_SCOPE_PX("Canny.coarse", coarse.total());
+    cv::Mat blurred;
+    cv::GaussianBlur(coarse, blurred, cv::Size(3,3), 0);
+    cv::Canny(blurred, edges, 50, 150, 3);
+  }
+  if (cancelled()) return res;
+  report_progress(30);
+
+  // votes and lengths shrink with the image; rho and theta stay in coarse units
+  std::vector<cv::Vec4i> candidates;
+  {
+    TRACE_SCOPE_PX("HoughLinesP.coarse", edges.total());
+    cv::HoughLinesP(edges, candidates, params.rho, params.theta, std::max(1, cvRound(params.threshold / scale)),
+                    params.minLineLength / scale, params.maxLineGap / scale);
+  }
+  if (cancelled()) return res;
+  report_progress(50);
+
+  // Refine on the gray ROI (memoized, a view for gray input): one caliper
+  // region per candidate, extended by a coarse pixel at both ends so the true
+  // end points are inside it. A refinement that leaves the window keeps the
+  // coarse segment.
+  const cv::Mat gray = stages::gray(image, r, ctx_);
+  const float window = static_cast<float>(params.refine_window > 0 ? params.refine_window : 2 * scale);
+  std::vector<cv::Vec4i> lines(candidates.size());
+  {
+    TRACE_SCOPE("LineTool.refine");
+    ThreadPool::global().parallel_for(0, candidates.size(), [&](size_t i) {
+      const cv::Vec4i& c = candidates[i];
+      const cv::Point2f a(static_cast<float>(c[0] * scale), static_cast<float>(c[1] * scale));
+      const cv::Point2f b(static_cast<float>(c[2] * scale), static_cast<float>(c[3] * scale));
+      lines[i] = cv::Vec4i(cvRound(a.x), cvRound(a.y), cvRound(b.x), cvRound(b.y));
+      if (cancelled()) return;
+      const float length = std::hypot(b.x - a.x, b.y - a.y) + 2 * static_cast<float>(scale);
+      CaliperTool caliper;  // no context: per-candidate regions are not worth caching
+      caliper.params.calipers = std::min(kMaxCalipers, std::max(4, static_cast<int>(length / kCaliperSpacing)));
+      caliper.params.width = 3;
+      caliper.params.inlier_distance = 1.5;
+      const float angle = static_cast<float>(std::atan2(b.y - a.y, b.x - a.x) * 180.0 / CV_PI);
+      const cv::RotatedRect region((a + b) * 0.5f, cv::Size2f(length, 2 * window + 1), angle);
+      const DetectionResult fit = caliper.run_region(gray, region);
+      if (fit.subpixel_lines.empty()) return;
+      const cv::Vec4f& l = fit.subpixel_lines.front();
+      const cv::Point2f e0(l[0], l[1]), e1(l[2], l[3]);
+      if (distance_to_line(e0, a, b) > window || distance_to_line(e1, a, b) > window) return;
+      lines[i] = cv::Vec4i(cvRound(e0.x), cvRound(e0.y), cvRound(e1.x), cvRound(e1.y));
+    });
+  }
+  if (cancelled()) return res;
+
+  for (auto& l : lines) {
+    l[0] += r.x; l[1] += r.y; l[2] += r.x; l[3] += r.y;
+  }
+  res.lines = std::move(lines);
+  report_progress(100);
+  return res;
+}
+
+void LineTool::prepare(const cv::Mat& image, const cv::Rect& region) {
+  if (image.empty()) return;
+  const cv::Rect r = stages::clamp_roi(image, region);
+  if (params.pyramid_levels > 0 && std::min(r.width, r.height) >> params.pyramid_levels >= kMinCoarseSide) {
+    stages::pyramid(image, r, params.pyramid_levels, ctx_);
+    return;
+  }
+  if (params.fused) stages::fused_canny(image, r, 50, 150, ctx_);
+  else stages::canny(image, r, cv::Size(3,3), 0, 50, 150, 3, ctx_);
+}
@@ -13,9 +13,26 @@ public:
     int threshold = 50;
     double minLineLength = 20.0;
     double maxLineGap = 10.0;
+    // tile-parallel HoughLinesP (see tiled_hough.h), used for ROIs larger than one tile
+    bool tiled = false;
+    int tile_size = 512;
+    int tile_overlap = 32;
+    // gray + blur + gradient + NMS in one banded SIMD pass (stages::fused_canny)
+    // instead of three full-plane OpenCV passes; same edges on BGR input
+    bool fused = false;
+    // coarse-to-fine: HoughLinesP on the ROI reduced 2^pyramid_levels times
+    // (threshold and lengths scaled to match), then each candidate is
+    // re-measured at full resolution by calipers within refine_window pixels
+    // of it. 0 = off; tiled is ignored when on.
+    int pyramid_levels = 0;
+    double refine_window = 0.0;   // 0 = two coarse pixels
   } params;
 
   DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) override;
+  void prepare(const cv::Mat& image, const cv::Rect& region) override;
+
+private:
+  DetectionResult run_pyramid(const cv::Mat& image, const cv::Rect& r);
 };
 
 } // namespace tools
@@ -0,0 +1,66 @@
+#include "oriented_roi.h"
+
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+
+cv::Point2f apply(const cv::Matx23d& m, float x, float y) {
+  return cv::Point2f(static_cast<float>(m(0, 0) * x + m(0, 1) * y + m(0, 2)),
+                     static_cast<float>(m(1, 0) * x + m(1, 1) * y + m(1, 2)));
+}
+
+} // namespace
+
+OrientedPatch tools::extract_oriented(const cv::Mat& image, const cv::RotatedRect& region) {
+  OrientedPatch patch;
+  const int w = std::max(1, cvRound(region.size.width));
+  const int h = std::max(1, cvRound(region.size.height));
+  const double a = region.angle * CV_PI / 180.0;
+  const double c = std::cos(a), s = std::sin(a);
+  const double hx = (w - 1) * 0.5, hy = (h - 1) * 0.5;
+  // buffer -> image: rotate about the buffer center, then move it to the region center
+  patch.to_image = cv::Matx23d(c, -s, region.center.x - c * hx + s * hy,
+                               s, c, region.center.y - s * hx - c * hy);
+  if (image.empty()) return patch;
+  cv::warpAffine(image, patch.pixels, cv::Mat(patch.to_image), cv::Size(w, h),
+                 cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+  return patch;
+}
+
+void tools::map_to_image(DetectionResult& result, const cv::Matx23d& to_image) {
+  for (auto& l : result.lines) {
+    const cv::Point2f p = apply(to_image, static_cast<float>(l[0]), static_cast<float>(l[1]));
+    const cv::Point2f q = apply(to_image, static_cast<float>(l[2]), static_cast<float>(l[3]));
+    l = cv::Vec4i(cvRound(p.x), cvRound(p.y), cvRound(q.x), cvRound(q.y));
+  }
+  for (auto& l : result.subpixel_lines) {
+    const cv::Point2f p = apply(to_image, l[0], l[1]);
+    const cv::Point2f q = apply(to_image, l[2], l[3]);
+    l = cv::Vec4f(p.x, p.y, q.x, q.y);
+  }
+  for (auto& p : result.points) p = apply(to_image, p.x, p.y);
+  for (auto& c : result.circles) {
+    const cv::Point2f p = apply(to_image, c[0], c[1]);
+    c[0] = p.x;
+    c[1] = p.y;
+  }
+}
+
+bool tools::axis_aligned_rect(const cv::RotatedRect& region, cv::Rect& rect) {
+  const double quarter = region.angle / 90.0;
+  if (std::abs(quarter - std::round(quarter)) > 1e-6) return false;
+  const bool swapped = (static_cast<long long>(std::round(quarter)) & 1) != 0;
+  const double w = swapped ? region.size.height : region.size.width;
+  const double h = swapped ? region.size.width : region.size.height;
+  rect = cv::Rect(cvRound(region.center.x - (w - 1) * 0.5), cvRound(region.center.y - (h - 1) * 0.5), cvRound(w), cvRound(h));
+  return true;
+}
+
+cv::RotatedRect tools::oriented_region(const cv::Rect& rect, double angle) {
+  return cv::RotatedRect(cv::Point2f(rect.x + (rect.width - 1) * 0.5f, rect.y + (rect.height - 1) * 0.5f),
+                         cv::Size2f(static_cast<float>(rect.width), static_cast<float>(rect.height)),
+                         static_cast<float>(angle));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "detection_result.h"
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Upright copy of a rotated region: pixel (u, v) of `pixels` samples the
+// image at to_image * (u, v, 1). The buffer has the region's size, so the
+// cost of everything run on it follows the region's area rather than that of
+// its bounding box. Samples outside the image replicate the border.
+struct OrientedPatch {
+  cv::Mat pixels;
+  cv::Matx23d to_image;
+};
+
+OrientedPatch extract_oriented(const cv::Mat& image, const cv::RotatedRect& region);
+
+// Moves a result computed on OrientedPatch::pixels back to image coordinates.
+// Radii and residuals are distances and stay as they are.
+void map_to_image(DetectionResult& result, const cv::Matx23d& to_image);
+
+// The rectangle covered by `region` when its angle is a multiple of 90
+// degrees (no resampling needed); false otherwise.
+bool axis_aligned_rect(const cv::RotatedRect& region, cv::Rect& rect);
+
+// `rect` (pixel columns x .. x+width-1) turned by `angle` degrees about its
+// center, clockwise in image coordinates.
+cv::RotatedRect oriented_region(const cv::Rect& rect, double angle);
+
+} // namespace tools
@@ -0,0 +1,263 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+Pipeline::Pipeline(ThreadPool& pool) : pool_(pool) {
+  // node 0: the run() argument, set directly by run()
+  add("input", {}, nullptr);
+}
+
+Pipeline::~Pipeline() {
+  std::unique_lock<std::mutex> lock(barrier_.mutex);
+  barrier_.cv.wait(lock, [this]() { return barrier_.helpers == 0; });
+}
+
+void Pipeline::check_id(NodeId id) const {
+  if (id < 0 || id >= static_cast<NodeId>(nodes_.size())) {
+    throw std::out_of_range("pipeline: unknown node " + std::to_string(id));
+  }
+}
+
+Pipeline::NodeId Pipeline::add(const std::string& name, const std::vector<NodeId>& inputs, NodeFn fn) {
+  auto node = std::make_unique<Node>();
+  node->name = name;
+  node->inputs = inputs;
+  node->fn = std::move(fn);
+  for (NodeId in : inputs) {
+    check_id(in);
+    node->depth = std::max(node->depth, nodes_[in]->depth + 1);
+  }
+  nodes_.push_back(std::move(node));
+  relink();
+  return static_cast<NodeId>(nodes_.size() - 1);
+}
+
+// Input pointers and the level schedule are rebuilt while the graph is
+// edited, never during run().
+void Pipeline::relink() {
+  levels_.clear();
+  for (auto& node : nodes_) {
+    node->input_values.clear();
+    for (NodeId in : node->inputs) node->input_values.push_back(&nodes_[in]->out);
+    if (!node->fn) continue;
+    if (levels_.size() <= static_cast<size_t>(node->depth)) levels_.resize(node->depth + 1);
+    levels_[node->depth].push_back(node.get());
+  }
+}
+
+Pipeline::NodeId Pipeline::add_node(const std::string& name, const std::vector<NodeId>& inputs, NodeFn fn) {
+  if (!fn) throw std::invalid_argument("pipeline: node '" + name + "' has no function");
+  return add(name, inputs, std::move(fn));
+}
+
+Pipeline::NodeId Pipeline::add_gray(NodeId image) {
+  return add("gray", { image }, [](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    const cv::Mat& src = in[0]->image;
+    if (src.channels() == 1) out.image = src;  // shares the buffer, no copy
+    else cv::cvtColor(src, out.image, cv::COLOR_BGR2GRAY);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_gaussian(NodeId image, const cv::Size& ksize, double sigma) {
+  return add("gaussian", { image }, [ksize, sigma](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    cv::GaussianBlur(in[0]->image, out.image, ksize, sigma, sigma);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_canny(NodeId image, double low, double high, int aperture) {
+  return add("canny", { image }, [low, high, aperture](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    cv::Canny(in[0]->image, out.image, low, high, aperture);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_tool(std::shared_ptr<ITool> tool, NodeId image, NodeId roi) {
+  if (!tool) throw std::invalid_argument("pipeline: null tool");
+  std::vector<NodeId> inputs{ image };
+  if (roi != kNone) inputs.push_back(roi);
+  // Planes the tool caches are keyed by image id, which only identifies
+  // the pipeline input, not an intermediate image.
+  const bool on_input = image == input();
+  auto local = std::make_shared<RunContext>();
+  return add("tool", inputs, [tool, local, on_input](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext* ctx) {
+    if (in.size() > 1 && in[1]->roi.empty()) {
+      const DetectionKind kind = out.result.kind;
+      out.result = DetectionResult();
+      out.result.kind = kind;
+      return;
+    }
+    local->parent = ctx;
+    local->image_id = on_input && ctx ? ctx->image_id : 0;
+    local->stage_cache = on_input && ctx ? ctx->stage_cache : nullptr;
+    tool->set_context(local.get());
+    try {
+      out.result = tool->run(in[0]->image, in.size() > 1 ? in[1]->roi : cv::Rect());
+    } catch (...) {
+      tool->set_context(nullptr);
+      throw;
+    }
+    tool->set_context(nullptr);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_fixed_roi(const cv::Rect& roi) {
+  return add("roi", { input() }, [roi](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    out.roi = roi & cv::Rect(0, 0, in[0]->image.cols, in[0]->image.rows);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_roi(NodeId result, RoiFn derive) {
+  if (!derive) throw std::invalid_argument("pipeline: null ROI function");
+  return add("roi", { result, input() }, [derive](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    const cv::Size size = in[1]->image.size();
+    out.roi = derive(in[0]->result, size) & cv::Rect(0, 0, size.width, size.height);
+  });
+}
+
+Pipeline::NodeId Pipeline::add_line_intersections(NodeId lines) {
+  return add("intersections", { lines, input() }, [](const std::vector<const PipelineValue*>& in, PipelineValue& out, const RunContext*) {
+    const std::vector<cv::Vec4i>& ls = in[0]->result.lines;
+    const cv::Size size = in[1]->image.size();
+    out.result.kind = DetectionKind::Points;
+    out.result.points.clear();  // keeps its capacity across runs
+    for (size_t i = 0; i < ls.size(); ++i) {
+      for (size_t j = i + 1; j < ls.size(); ++j) {
+        const double x1 = ls[i][0], y1 = ls[i][1], dx1 = ls[i][2] - x1, dy1 = ls[i][3] - y1;
+        const double x2 = ls[j][0], y2 = ls[j][1], dx2 = ls[j][2] - x2, dy2 = ls[j][3] - y2;
+        const double den = dx1 * dy2 - dy1 * dx2;
+        // nearly parallel lines meet far away or nowhere
+        if (std::abs(den) < 1e-6 * std::hypot(dx1, dy1) * std::hypot(dx2, dy2)) continue;
+        const double t = ((x2 - x1) * dy2 - (y2 - y1) * dx2) / den;
+        const double x = x1 + t * dx1, y = y1 + t * dy1;
+        if (x < 0 || y < 0 || x >= size.width || y >= size.height) continue;
+        out.result.points.emplace_back(static_cast<float>(x), static_cast<float>(y));
+      }
+    }
+  });
+}
+
+bool Pipeline::run(const cv::Mat& image, const RunContext* ctx) {
+  nodes_[0]->out.image = image;
+  const size_t total = levels_.size();
+  for (size_t l = 0; l < total; ++l) {
+    if (ctx && ctx->cancelled()) return false;
+    run_level(levels_[l], ctx);
+    if (ctx) ctx->report_progress(static_cast<int>((l + 1) * 100 / total));
+  }
+  return !(ctx && ctx->cancelled());
+}
+
+// Same contract as ThreadPool::parallel_for (the caller takes part, waits
+// only for items that are running, rethrows the first exception), without
+// its per-call state: the barrier is reused and a helper task is a
+// std::function holding only `this`, which fits its small buffer.
+void Pipeline::run_level(const std::vector<Node*>& level, const RunContext* ctx) {
+  const size_t n = level.size();
+  if (n == 0) return;
+  if (n == 1 || pool_.size() <= 1) {
+    for (Node* node : level) {
+      if (ctx && ctx->cancelled()) return;
+      node->fn(node->input_values, node->out, ctx);
+    }
+    return;
+  }
+
+  // Close the previous level's word first: a late helper may still hold it
+  // (its index = the old count) and would otherwise pass the new, larger
+  // count and claim an item of this level with a stale exchange. Only then
+  // publish the level and open the new generation at item 0.
+  const uint64_t generation = static_cast<uint64_t>(++generation_) << 32;
+  barrier_.claim.store(generation | kClosed);
+  barrier_.level = &level;
+  barrier_.ctx = ctx;
+  barrier_.count.store(n);
+  barrier_.done.store(0);
+  barrier_.claim.store(generation);
+
+  const size_t helpers = std::min(n - 1, static_cast<size_t>(pool_.size()));
+  {
+    std::lock_guard<std::mutex> lock(barrier_.mutex);
+    barrier_.helpers += helpers;
+  }
+  for (size_t h = 0; h < helpers; ++h) pool_.post([this]() { help(); });
+  drain();
+
+  std::unique_lock<std::mutex> lock(barrier_.mutex);
+  barrier_.cv.wait(lock, [&]() { return barrier_.done.load() == n; });
+  if (barrier_.error) {
+    std::exception_ptr error = barrier_.error;
+    barrier_.error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void Pipeline::drain() {
+  for (;;) {
+    // the word of an earlier level is replaced by a closed one before that
+    // level's count changes, so an exchange on a stale word fails and a
+    // successful one always claims an item of the current level
+    uint64_t word = barrier_.claim.load();
+    size_t i = 0;
+    do {
+      i = static_cast<uint32_t>(word);
+      if (i >= barrier_.count.load()) return;
+    } while (!barrier_.claim.compare_exchange_weak(word, word + 1));
+
+    Node* node = (*barrier_.level)[i];
+    const RunContext* ctx = barrier_.ctx;
+    if (!(ctx && ctx->cancelled())) {
+      try {
+        node->fn(node->input_values, node->out, ctx);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(barrier_.mutex);
+        if (!barrier_.error) barrier_.error = std::current_exception();
+      }
+    }
+    if (barrier_.done.fetch_add(1) + 1 == barrier_.count.load()) {
+      std::lock_guard<std::mutex> lock(barrier_.mutex);
+      barrier_.cv.notify_all();
+    }
+  }
+}
+
+void Pipeline::help() {
+  drain();
+  std::lock_guard<std::mutex> lock(barrier_.mutex);
+  if (--barrier_.helpers == 0) barrier_.cv.notify_all();
+}
+
+const PipelineValue& Pipeline::value(NodeId id) const {
+  check_id(id);
+  return nodes_[id]->out;
+}
+
+const std::string& Pipeline::name(NodeId id) const {
+  check_id(id);
+  return nodes_[id]->name;
+}
+
+cv::Rect tools::result_bounds(const DetectionResult& result, int margin) {
+  cv::Rect box;
+  bool any = false;
+  auto grow = [&](const cv::Rect& r) {
+    box = any ? (box | r) : r;
+    any = true;
+  };
+  for (const auto& l : result.lines) {
+    grow(cv::Rect(l[0], l[1], 1, 1));
+    grow(cv::Rect(l[2], l[3], 1, 1));
+  }
+  for (const auto& p : result.points) {
+    grow(cv::Rect(cvFloor(p.x), cvFloor(p.y), 1, 1));
+  }
+  for (const auto& c : result.circles) {
+    const int r = cvCeil(c[2]);
+    grow(cv::Rect(cvFloor(c[0]) - r, cvFloor(c[1]) - r, 2 * r + 1, 2 * r + 1));
+  }
+  if (!any) return cv::Rect();
+  return cv::Rect(box.x - margin, box.y - margin, box.width + 2 * margin, box.height + 2 * margin);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "detection_result.h"
+#include "itool.h"
+#include "run_context.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// What flows along a pipeline edge. A node fills the part that matches its
+// kind: preprocessing nodes an image, ROI nodes a rect, tool nodes a result.
+// Values live in the node and are overwritten in place by every run, so
+// image buffers are allocated on the first run and reused afterwards.
+struct PipelineValue {
+  cv::Mat image;
+  cv::Rect roi;  // full-image coordinates; empty = nothing found
+  DetectionResult result;
+};
+
+// Small DAG of tools and preprocessing steps, e.g.
+//   circles = find circles; ring = ROI around them; lines = find lines in ring
+// Nodes may only consume earlier nodes, so the graph is acyclic by
+// construction. Nodes of the same depth are independent and run in
+// parallel on the pool, through a fork/join barrier owned by the pipeline:
+// run() itself allocates nothing once the node values have their buffers
+// (tool_bench reports allocations per run; tools allocate their own
+// results, and the pool's task queue may grow a block now and then).
+class Pipeline {
+public:
+  using NodeId = int;
+  static constexpr NodeId kNone = -1;
+
+  using NodeFn = std::function<void(const std::vector<const PipelineValue*>& inputs,
+                                    PipelineValue& out, const RunContext* ctx)>;
+  using RoiFn = std::function<cv::Rect(const DetectionResult& result, const cv::Size& image_size)>;
+
+  explicit Pipeline(ThreadPool& pool = ThreadPool::global());
+  // Waits for helpers of the last run that are still queued on the pool.
+  ~Pipeline();
+
+  Pipeline(const Pipeline&) = delete;
+  Pipeline& operator=(const Pipeline&) = delete;
+
+  // The image passed to run() (full image, 8UC1 or 8UC3).
+  NodeId input() const { return 0; }
+
+  // Preprocessing of a whole image plane.
+  NodeId add_gray(NodeId image);
+  NodeId add_gaussian(NodeId image, const cv::Size& ksize, double sigma);
+  NodeId add_canny(NodeId image, double low, double high, int aperture = 3);
+
+  // Runs the tool on `image`, restricted to the ROI produced by `roi` if
+  // given. A connected ROI that came out empty skips the tool (empty result).
+  NodeId add_tool(std::shared_ptr<ITool> tool, NodeId image, NodeId roi = kNone);
+
+  NodeId add_fixed_roi(const cv::Rect& roi);
+  // ROI derived from a tool result, clamped to the input image.
+  NodeId add_roi(NodeId result, RoiFn derive);
+  // Pairwise intersections of the lines of a result, as result points.
+  NodeId add_line_intersections(NodeId lines);
+
+  // Anything else: fn reads its inputs and fills `out`.
+  NodeId add_node(const std::string& name, const std::vector<NodeId>& inputs, NodeFn fn);
+
+  // Executes every node. Returns false if ctx was cancelled; values of the
+  // nodes that had not run yet are then stale. Not reentrant.
+  bool run(const cv::Mat& image, const RunContext* ctx = nullptr);
+
+  const PipelineValue& value(NodeId id) const;
+  const std::string& name(NodeId id) const;
+  size_t size() const { return nodes_.size(); }
+
+private:
+  struct Node {
+    std::string name;
+    std::vector<NodeId> inputs;
+    NodeFn fn;
+    int depth = 0;
+    // filled once when the node is added; run() only reads it
+    std::vector<const PipelineValue*> input_values;
+    PipelineValue out;
+  };
+
+  // Fork/join state of the level being run. Items are claimed with one
+  // atomic word, generation << 32 | next item, so a helper posted for an
+  // earlier level that starts late finds nothing of its own to claim and
+  // either helps with the current level or returns. Between two levels the
+  // word is closed (index kClosed), so no exchange succeeds while the level
+  // and its count are being replaced.
+  static constexpr uint64_t kClosed = 0xFFFFFFFFu;
+  struct Barrier {
+    std::atomic<uint64_t> claim{0};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> done{0};
+    const std::vector<Node*>* level = nullptr;  // published by the claim store
+    const RunContext* ctx = nullptr;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+    size_t helpers = 0;  // posted and not yet returned (under mutex)
+  };
+
+  NodeId add(const std::string& name, const std::vector<NodeId>& inputs, NodeFn fn);
+  void check_id(NodeId id) const;
+  void relink();
+  void run_level(const std::vector<Node*>& level, const RunContext* ctx);
+  void drain();
+  void help();
+
+  ThreadPool& pool_;
+  std::vector<std::unique_ptr<Node>> nodes_;  // stable addresses for input_values
+  std::vector<std::vector<Node*>> levels_;    // nodes grouped by depth
+  Barrier barrier_;
+  uint32_t generation_ = 0;
+};
+
+// Bounding box of everything in the result grown by margin (circles
+// include their radius). Empty if the result is empty.
+cv::Rect result_bounds(const DetectionResult& result, int margin = 0);
+
+} // namespace tools
@@ -1,4 +1,8 @@
 #include "point_tool.h"
+#include "grid_corners.h"
+#include "preprocess.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 using namespace tools;
 
@@ -8,26 +12,44 @@ DetectionResult PointTool::run(const cv::Mat& image, const cv::Rect& roi) {
 
   if (image.empty()) return res;
 
-  cv::Mat src = image;
-  if (roi.width > 0 && roi.height > 0) {
-    cv::Rect r = roi & cv::Rect(0,0, image.cols, image.rows);
-    src = image(r);
-  }
+  const cv::Rect r = stages::clamp_roi(image, roi);
+  if (r.empty()) return res;
 
-  cv::Mat gray;
-  if (src.channels() == 3) cv::cvtColor(src, gray, cv::COLOR_BGR2GRAY);
-  else gray = src;
+  const cv::Mat gray = stages::gray(image, r, ctx_);
+  if (cancelled()) return res;
+  report_progress(20);
 
   std::vector<cv::Point2f> corners;
-  cv::goodFeaturesToTrack(gray, corners, params.max_corners, params.quality_level, params.min_distance);
+  if (params.grid) {
+    const cv::Mat response = stages::corner_response(image, r, 3, ctx_);
+    if (cancelled()) return res;
+    report_progress(50);
+    GridCornerOptions opt;
+    opt.max_corners = static_cast<int>(params.max_corners);
+    opt.quality_level = params.quality_level;
+    opt.min_distance = params.min_distance;
+    opt.cell_size = params.cell_size;
+    opt.per_cell = params.per_cell;
+    opt.subpix = params.subpix;
+    corners = grid_corners(response, gray, opt, ThreadPool::global(), ctx_);
+    if (cancelled()) return res;
+  } else {
+    TRACE_SCOPE_PX("goodFeaturesToTrack", gray.total());
+    cv::goodFeaturesToTrack(gray, corners, params.max_corners, params.quality_level, params.min_distance);
+  }
 
   // ROIҪ
-  if (roi.width > 0 && roi.height > 0) {
-    for (auto& p : corners) {
-      p.x += roi.x; p.y += roi.y;
-    }
+  for (auto& p : corners) {
+    p.x += r.x; p.y += r.y;
   }
 
   res.points = std::move(corners);
+  report_progress(100);
   return res;
 }
+
+void PointTool::prepare(const cv::Mat& image, const cv::Rect& region) {
+  if (image.empty()) return;
+  if (params.grid) stages::corner_response(image, stages::clamp_roi(image, region), 3, ctx_);
+  else stages::gray(image, stages::clamp_roi(image, region), ctx_);
+}
@@ -11,9 +11,16 @@ public:
     double max_corners = 500;
     double quality_level = 0.01;
     double min_distance = 10.0;
+    // grid engine (see grid_corners.h): response computed once and cached,
+    // grid suppression, optional per-cell quota and sub-pixel refinement
+    bool grid = false;
+    int cell_size = 32;
+    int per_cell = 0;   // 0 = no quota
+    bool subpix = false;
   } params;
 
   DetectionResult run(const cv::Mat& image, const cv::Rect& roi = cv::Rect()) override;
+  void prepare(const cv::Mat& image, const cv::Rect& region) override;
 };
 
 } // namespace tools
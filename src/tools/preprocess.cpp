@@ -0,0 +1,182 @@
+#include "preprocess.h"
+#include "fused_gradient.h"
+#include "stage_cache.h"
+#include "trace.h"
+
+#include <cstdio>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+
+bool cache_enabled(const RunContext* ctx) {
+  return ctx && ctx->stage_cache && ctx->image_id != 0;
+}
+
+StageKey make_key(const RunContext* ctx, const cv::Rect& r, Stage stage, const char* params) {
+  StageKey key;
+  key.image_id = ctx->image_id;
+  key.roi = r;
+  key.stage = stage;
+  key.params = params;
+  return key;
+}
+
+// cv::pyrDown output size after `levels` reductions
+int reduced(int n, int levels) {
+  for (int i = 0; i < levels; ++i) n = (n + 1) / 2;
+  return n;
+}
+
+// Level `levels` of the prepared region (RunContext::prepared_region), cut
+// down to key.roi. Only when the ROI starts on that level's pixel grid, so
+// the coarse pixels sample the same positions a pyramid of the ROI would.
+bool prepared_pyramid_view(const RunContext* ctx, const StageKey& key, int levels, cv::Mat& out) {
+  const cv::Rect& p = ctx->prepared_region;
+  if (p.empty() || p == key.roi || (p & key.roi) != key.roi) return false;
+  const int step = 1 << levels;
+  const cv::Point offset = key.roi.tl() - p.tl();
+  if (offset.x % step != 0 || offset.y % step != 0) return false;
+  StageKey outer = key;
+  outer.roi = p;
+  cv::Mat plane;
+  if (!ctx->stage_cache->lookup(outer, plane)) return false;
+  const cv::Rect coarse(offset.x / step, offset.y / step, reduced(key.roi.width, levels), reduced(key.roi.height, levels));
+  if ((coarse & cv::Rect(0, 0, plane.cols, plane.rows)) != coarse) return false;
+  out = plane(coarse);
+  return true;
+}
+
+} // namespace
+
+cv::Rect stages::clamp_roi(const cv::Mat& image, const cv::Rect& roi) {
+  const cv::Rect full(0, 0, image.cols, image.rows);
+  if (roi.width <= 0 || roi.height <= 0) return full;
+  return roi & full;
+}
+
+cv::Mat stages::gray(const cv::Mat& image, const cv::Rect& roi, const RunContext* ctx) {
+  const cv::Rect r = clamp_roi(image, roi);
+  // already gray: a view, nothing to compute or cache
+  if (image.channels() == 1) return image(r);
+
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    key = make_key(ctx, r, Stage::Gray, "");
+    cv::Mat hit;
+    if (ctx->stage_cache->lookup(key, hit, ctx->prepared_region)) return hit;
+  }
+  cv::Mat out;
+  {
+    TRACE_SCOPE_PX("cvtColor", r.area());
+    cv::cvtColor(image(r), out, cv::COLOR_BGR2GRAY);
+  }
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
+
+cv::Mat stages::gaussian(const cv::Mat& image, const cv::Rect& roi,
+                         const cv::Size& ksize, double sigma, const RunContext* ctx) {
+  const cv::Rect r = clamp_roi(image, roi);
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    char params[64];
+    std::snprintf(params, sizeof(params), "k%dx%d s%g", ksize.width, ksize.height, sigma);
+    key = make_key(ctx, r, Stage::Blur, params);
+    cv::Mat hit;
+    if (ctx->stage_cache->lookup(key, hit, ctx->prepared_region)) return hit;
+  }
+  const cv::Mat g = gray(image, roi, ctx);
+  cv::Mat out;
+  {
+    TRACE_SCOPE_PX("GaussianBlur", r.area());
+    cv::GaussianBlur(g, out, ksize, sigma, sigma);
+  }
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
+
+cv::Mat stages::canny(const cv::Mat& image, const cv::Rect& roi,
+                      const cv::Size& ksize, double sigma,
+                      double low, double high, int aperture, const RunContext* ctx) {
+  const cv::Rect r = clamp_roi(image, roi);
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    char params[96];
+    std::snprintf(params, sizeof(params), "k%dx%d s%g l%g h%g a%d",
+                  ksize.width, ksize.height, sigma, low, high, aperture);
+    key = make_key(ctx, r, Stage::Edges, params);
+    cv::Mat hit;
+    if (ctx->stage_cache->lookup(key, hit, ctx->prepared_region)) return hit;
+  }
+  const cv::Mat blurred = gaussian(image, roi, ksize, sigma, ctx);
+  cv::Mat out;
+  {
+    TRACE_SCOPE_PX("Canny", r.area());
+    cv::Canny(blurred, out, low, high, aperture);
+  }
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
+
+cv::Mat stages::fused_canny(const cv::Mat& image, const cv::Rect& roi, double low, double high, const RunContext* ctx) {
+  const cv::Rect r = clamp_roi(image, roi);
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    char params[64];
+    std::snprintf(params, sizeof(params), "fused l%g h%g", low, high);
+    key = make_key(ctx, r, Stage::Edges, params);
+    cv::Mat hit;
+    if (ctx->stage_cache->lookup(key, hit, ctx->prepared_region)) return hit;
+  }
+  cv::Mat out;
+  fused_edges(image(r), out, low, high, ctx);
+  // bands skipped on cancellation leave the map incomplete: never cache it
+  if (ctx && ctx->cancelled()) return cv::Mat();
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
+
+cv::Mat stages::corner_response(const cv::Mat& image, const cv::Rect& roi, int block_size, const RunContext* ctx) {
+  const cv::Rect r = clamp_roi(image, roi);
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    char params[32];
+    std::snprintf(params, sizeof(params), "b%d", block_size);
+    key = make_key(ctx, r, Stage::CornerResponse, params);
+    cv::Mat hit;
+    if (ctx->stage_cache->lookup(key, hit, ctx->prepared_region)) return hit;
+  }
+  const cv::Mat g = gray(image, roi, ctx);
+  cv::Mat out;
+  {
+    TRACE_SCOPE_PX("cornerMinEigenVal", r.area());
+    cv::cornerMinEigenVal(g, out, block_size, 3);
+  }
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
+
+cv::Mat stages::pyramid(const cv::Mat& image, const cv::Rect& roi, int levels, const RunContext* ctx) {
+  if (levels <= 0) return gray(image, roi, ctx);
+  const cv::Rect r = clamp_roi(image, roi);
+  StageKey key;
+  if (cache_enabled(ctx)) {
+    char params[16];
+    std::snprintf(params, sizeof(params), "l%d", levels);
+    key = make_key(ctx, r, Stage::Pyramid, params);
+    cv::Mat hit;
+    // planes are in level coordinates: no generic sub-views (supports_sub_views)
+    if (ctx->stage_cache->lookup(key, hit) || prepared_pyramid_view(ctx, key, levels, hit)) return hit;
+  }
+  // each level is built from the (memoized) level below it
+  const cv::Mat finer = pyramid(image, roi, levels - 1, ctx);
+  cv::Mat out;
+  {
+    TRACE_SCOPE_PX("pyrDown", finer.total());
+    cv::pyrDown(finer, out);
+  }
+  if (cache_enabled(ctx)) ctx->stage_cache->insert(key, out);
+  return out;
+}
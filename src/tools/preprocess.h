@@ -0,0 +1,35 @@
+#pragma once
+
+#include "run_context.h"
+#include <opencv2/core.hpp>
+
+namespace tools {
+namespace stages {
+
+// roi clamped to the image; an empty roi means the whole image.
+cv::Rect clamp_roi(const cv::Mat& image, const cv::Rect& roi);
+
+// Front-end stages shared by the tools. Each stage works on the clamped
+// ROI of image and is memoized through ctx->stage_cache when the context
+// carries an image id. Returned planes may be shared: never write into them.
+cv::Mat gray(const cv::Mat& image, const cv::Rect& roi, const RunContext* ctx);
+cv::Mat gaussian(const cv::Mat& image, const cv::Rect& roi,
+                 const cv::Size& ksize, double sigma, const RunContext* ctx);
+cv::Mat canny(const cv::Mat& image, const cv::Rect& roi,
+              const cv::Size& ksize, double sigma,
+              double low, double high, int aperture, const RunContext* ctx);
+// Same edges as canny(image, roi, 3x3, 0, low, high, 3) on a BGR image,
+// but gray, blur, gradient and non-maximum suppression run in one fused
+// pass (fused_gradient.h) and only the edge map is materialized. Gray input
+// matches except at the ROI border, where the fused pass never looks outside
+// the ROI.
+// Empty when ctx is cancelled during the pass.
+cv::Mat fused_canny(const cv::Mat& image, const cv::Rect& roi, double low, double high, const RunContext* ctx);
+// Minimum-eigenvalue corner response (CV_32F), as used by goodFeaturesToTrack.
+cv::Mat corner_response(const cv::Mat& image, const cv::Rect& roi, int block_size, const RunContext* ctx);
+// Gray ROI reduced `levels` times by cv::pyrDown: pixel (x, y) of the result
+// sits at (x, y) * 2^levels in the ROI. Level 0 is gray().
+cv::Mat pyramid(const cv::Mat& image, const cv::Rect& roi, int levels, const RunContext* ctx);
+
+} // namespace stages
+} // namespace tools
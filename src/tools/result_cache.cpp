@@ -0,0 +1,297 @@
+#include "result_cache.h"
+#include "result_io.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <tuple>
+#include <vector>
+
+using namespace tools;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+inline void hash_combine(size_t& seed, size_t v) {
+  seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+// file header; bump the version when the key or write_binary() changes
+const char kFileMagic[4] = { 'T', 'R', 'C', '1' };
+
+std::atomic<uint64_t> g_temp_counter{0};
+
+template <class T> void put(std::ostream& out, const T& v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <class T> bool get(std::istream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+void write_key(std::ostream& out, const ResultKey& key) {
+  out.write(kFileMagic, sizeof(kFileMagic));
+  put(out, key.image_hash);
+  put(out, key.region.center.x);
+  put(out, key.region.center.y);
+  put(out, key.region.size.width);
+  put(out, key.region.size.height);
+  put(out, key.region.angle);
+  put(out, static_cast<uint32_t>(key.params.size()));
+  out.write(key.params.data(), static_cast<std::streamsize>(key.params.size()));
+}
+
+// The file name is only a hash of the key: the stored key must match too.
+bool read_key_matches(std::istream& in, const ResultKey& key) {
+  char magic[sizeof(kFileMagic)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kFileMagic, sizeof(magic)) != 0) return false;
+  ResultKey stored;
+  uint32_t n = 0;
+  if (!get(in, stored.image_hash) || !get(in, stored.region.center.x) || !get(in, stored.region.center.y) ||
+      !get(in, stored.region.size.width) || !get(in, stored.region.size.height) ||
+      !get(in, stored.region.angle) || !get(in, n) || n != key.params.size()) {
+    return false;
+  }
+  stored.params.resize(n);
+  if (n && !in.read(&stored.params[0], n)) return false;
+  return stored == key;
+}
+
+fs::path file_for(const std::string& dir, const ResultKey& key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.res", static_cast<unsigned long long>(ResultKeyHash()(key)));
+  return fs::u8path(dir) / name;
+}
+
+size_t approx_bytes(const ResultKey& key, const DetectionResult& r) {
+  return sizeof(ResultKey) + key.params.size() + sizeof(DetectionResult) +
+         r.lines.size() * sizeof(cv::Vec4i) + r.subpixel_lines.size() * sizeof(cv::Vec4f) +
+         (r.line_fits.size() + r.circle_fits.size()) * sizeof(ShapeFit) +
+         r.points.size() * sizeof(cv::Point2f) + r.circles.size() * sizeof(cv::Vec3f) +
+         r.residuals.size() * sizeof(float);
+}
+
+// Deletes the oldest result files of `dir` while they take more than
+// `budget` bytes, then down to 3/4 of it so the next writes do not rescan
+// right away. Returns the bytes left.
+size_t trim_directory(const std::string& dir, size_t budget) {
+  TRACE_SCOPE("result_cache.trim");
+  std::vector<std::tuple<fs::file_time_type, uintmax_t, fs::path>> files;
+  uintmax_t total = 0;
+  std::error_code ec;
+  for (fs::directory_iterator it(fs::u8path(dir), ec), end; !ec && it != end; it.increment(ec)) {
+    if (it->path().extension() != ".res") continue;
+    const uintmax_t size = it->file_size(ec);
+    if (ec) { ec.clear(); continue; }
+    const fs::file_time_type time = it->last_write_time(ec);
+    if (ec) { ec.clear(); continue; }
+    files.emplace_back(time, size, it->path());
+    total += size;
+  }
+  if (total <= budget) return static_cast<size_t>(total);
+
+  std::sort(files.begin(), files.end());
+  const uintmax_t target = budget / 4 * 3;
+  for (const auto& file : files) {
+    if (total <= target) break;
+    if (fs::remove(std::get<2>(file), ec)) total -= std::get<1>(file);
+  }
+  return static_cast<size_t>(total);
+}
+
+} // namespace
+
+size_t ResultKeyHash::operator()(const ResultKey& k) const {
+  size_t h = std::hash<uint64_t>()(k.image_hash);
+  hash_combine(h, std::hash<float>()(k.region.center.x));
+  hash_combine(h, std::hash<float>()(k.region.center.y));
+  hash_combine(h, std::hash<float>()(k.region.size.width));
+  hash_combine(h, std::hash<float>()(k.region.size.height));
+  hash_combine(h, std::hash<float>()(k.region.angle));
+  hash_combine(h, std::hash<std::string>()(k.params));
+  return h;
+}
+
+ResultCache::ResultCache(size_t budget_bytes, size_t disk_budget_bytes)
+  : budget_(budget_bytes), disk_budget_(disk_budget_bytes) {}
+
+ResultCache& ResultCache::global() {
+  static ResultCache cache;
+  return cache;
+}
+
+bool ResultCache::lookup(const ResultKey& key, DetectionResult& out) {
+  std::string dir;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      out = it->second->result;
+      ++hits_;
+      return true;
+    }
+    dir = dir_;
+  }
+
+  if (!dir.empty()) {
+    TRACE_SCOPE("result_cache.read");
+    std::ifstream in(file_for(dir, key), std::ios::binary);
+    DetectionResult stored;
+    if (in && read_key_matches(in, key) && read_binary(in, stored)) {
+      insert_memory(key, stored);
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++hits_;
+      ++disk_hits_;
+      out = std::move(stored);
+      return true;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++misses_;
+  return false;
+}
+
+void ResultCache::insert(const ResultKey& key, const DetectionResult& result) {
+  insert_memory(key, result);
+  const std::string dir = directory();
+  if (dir.empty()) return;
+
+  TRACE_SCOPE("result_cache.write");
+  std::error_code ec;
+  fs::create_directories(fs::u8path(dir), ec);
+  // written under a unique name and renamed, so a concurrent lookup never
+  // sees a partial file
+  const fs::path path = file_for(dir, key);
+  fs::path tmp = path;
+  tmp += ".tmp" + std::to_string(g_temp_counter.fetch_add(1));
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) return;
+    write_key(out, key);
+    write_binary(out, result);
+    if (!out.flush()) {
+      out.close();
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  const uintmax_t written = fs::file_size(tmp, ec);
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return;
+  }
+  account_disk(dir, static_cast<size_t>(written));
+}
+
+// The running total only grows (an overwritten file is counted twice); the
+// scan in trim_directory puts it right when the budget is reached.
+void ResultCache::account_disk(const std::string& dir, size_t written) {
+  size_t budget = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dir != dir_) return;
+    if (disk_used_known_) {
+      disk_used_ += written;
+      if (disk_used_ <= disk_budget_) return;
+    }
+    budget = disk_budget_;
+  }
+  const size_t used = trim_directory(dir, budget);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (dir != dir_) return;
+  disk_used_ = used;
+  disk_used_known_ = true;
+}
+
+void ResultCache::insert_memory(const ResultKey& key, const DetectionResult& result) {
+  const size_t bytes = approx_bytes(key, result);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > budget_) return;
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    used_ -= it->second->bytes;
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_.push_front(Entry{key, result, bytes});
+  index_.emplace(key, lru_.begin());
+  used_ += bytes;
+  evict_locked();
+}
+
+void ResultCache::evict_locked() {
+  while (used_ > budget_ && !lru_.empty()) {
+    const Entry& victim = lru_.back();
+    used_ -= victim.bytes;
+    index_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+void ResultCache::set_directory(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dir_ = dir;
+  disk_used_known_ = false;
+}
+
+std::string ResultCache::directory() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dir_;
+}
+
+void ResultCache::set_budget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = budget_bytes;
+  evict_locked();
+}
+
+size_t ResultCache::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_;
+}
+
+void ResultCache::set_disk_budget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  disk_budget_ = budget_bytes;
+  disk_used_known_ = false;  // the next write checks the directory
+}
+
+size_t ResultCache::disk_budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return disk_budget_;
+}
+
+size_t ResultCache::bytes_used() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
+
+void ResultCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  used_ = 0;
+}
+
+uint64_t ResultCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t ResultCache::disk_hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return disk_hits_;
+}
+
+uint64_t ResultCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
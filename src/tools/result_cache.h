@@ -0,0 +1,95 @@
+#pragma once
+
+#include "detection_result.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// (image content, ROI, tool parameters). region is the ROI as it was run:
+// axis-aligned ROIs are stored with angle 0 (oriented_region(rect, 0)).
+// params is the canonical tool spec text, to_string(ToolSpec).
+struct ResultKey {
+  uint64_t image_hash = 0;  // ImageDocument::content_hash()
+  cv::RotatedRect region;
+  std::string params;
+
+  bool operator==(const ResultKey& o) const {
+    return image_hash == o.image_hash && region.center == o.region.center &&
+           region.size == o.region.size && region.angle == o.region.angle && params == o.params;
+  }
+};
+
+struct ResultKeyHash {
+  size_t operator()(const ResultKey& k) const;
+};
+
+// Memoized tool results: an LRU of whole results with a memory budget,
+// optionally backed by a directory with one small binary file per result,
+// so identical requests are answered without running the tool, also after
+// a restart. The directory has its own byte budget: past it the oldest
+// files are deleted. Thread-safe; file I/O happens outside the lock.
+class ResultCache {
+public:
+  explicit ResultCache(size_t budget_bytes = size_t(64) << 20, size_t disk_budget_bytes = size_t(256) << 20);
+
+  // Cache used by the GUI executor.
+  static ResultCache& global();
+
+  // Memory first, then the directory; a result read from disk is kept in
+  // memory for the next lookup.
+  bool lookup(const ResultKey& key, DetectionResult& out);
+  // Stores in memory and, with a directory set, on disk.
+  void insert(const ResultKey& key, const DetectionResult& result);
+
+  // UTF-8 path; empty = memory only. Created on the first write.
+  void set_directory(const std::string& dir);
+  std::string directory() const;
+
+  void set_budget(size_t budget_bytes);
+  size_t budget() const;
+  size_t bytes_used() const;
+  // Bytes of result files kept in the directory; when a write goes past it
+  // the oldest files (by write time) are removed down to 3/4 of the budget.
+  void set_disk_budget(size_t budget_bytes);
+  size_t disk_budget() const;
+  // Memory only; files in the directory are kept.
+  void clear();
+
+  uint64_t hits() const;       // memory and disk
+  uint64_t disk_hits() const;
+  uint64_t misses() const;
+
+private:
+  struct Entry {
+    ResultKey key;
+    DetectionResult result;
+    size_t bytes = 0;
+  };
+  using List = std::list<Entry>;
+
+  void insert_memory(const ResultKey& key, const DetectionResult& result);
+  void evict_locked();
+  void account_disk(const std::string& dir, size_t written);
+
+  mutable std::mutex mutex_;
+  List lru_;  // most recently used at the front
+  std::unordered_map<ResultKey, List::iterator, ResultKeyHash> index_;
+  std::string dir_;
+  size_t budget_ = 0;
+  size_t used_ = 0;
+  size_t disk_budget_ = 0;
+  size_t disk_used_ = 0;
+  bool disk_used_known_ = false;  // scanned since the directory or budget changed
+  uint64_t hits_ = 0;
+  uint64_t disk_hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+} // namespace tools
@@ -0,0 +1,266 @@
+#include "result_index.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace tools;
+
+namespace {
+
+// upper bound on grid cells; sparse results over huge images get coarser cells
+constexpr size_t kMaxCells = size_t(1) << 22;
+constexpr int kTypeShift = 30;
+constexpr uint32_t kIndexMask = (uint32_t(1) << kTypeShift) - 1;
+
+uint32_t encode(ResultIndex::Type type, int index) {
+  return (static_cast<uint32_t>(type) << kTypeShift) | static_cast<uint32_t>(index);
+}
+
+ResultIndex::Element decode(uint32_t entry) {
+  ResultIndex::Element e;
+  e.type = static_cast<ResultIndex::Type>(entry >> kTypeShift);
+  e.index = static_cast<int>(entry & kIndexMask);
+  return e;
+}
+
+double point_segment_distance(const cv::Point2f& p, const cv::Vec4f& l) {
+  const double ax = l[0], ay = l[1], bx = l[2], by = l[3];
+  const double dx = bx - ax, dy = by - ay;
+  const double len2 = dx * dx + dy * dy;
+  double t = len2 > 0 ? ((p.x - ax) * dx + (p.y - ay) * dy) / len2 : 0.0;
+  t = std::min(1.0, std::max(0.0, t));
+  return std::hypot(p.x - (ax + t * dx), p.y - (ay + t * dy));
+}
+
+// Nearest and farthest distance from c to the points of [x0,x1] x [y0,y1].
+void rect_distances(double cx, double cy, double x0, double y0, double x1, double y1, double& nearest, double& farthest) {
+  const double nx = std::max(x0 - cx, std::max(0.0, cx - x1));
+  const double ny = std::max(y0 - cy, std::max(0.0, cy - y1));
+  nearest = std::hypot(nx, ny);
+  const double fx = std::max(std::abs(cx - x0), std::abs(cx - x1));
+  const double fy = std::max(std::abs(cy - y0), std::abs(cy - y1));
+  farthest = std::hypot(fx, fy);
+}
+
+// Liang-Barsky: does the segment cross [x0,x1] x [y0,y1]?
+bool segment_touches_rect(const cv::Vec4f& l, double x0, double y0, double x1, double y1) {
+  const double dx = l[2] - l[0], dy = l[3] - l[1];
+  const double p[4] = { -dx, dx, -dy, dy };
+  const double q[4] = { l[0] - x0, x1 - l[0], l[1] - y0, y1 - l[1] };
+  double t0 = 0.0, t1 = 1.0;
+  for (int i = 0; i < 4; ++i) {
+    if (p[i] == 0) {
+      if (q[i] < 0) return false;
+      continue;
+    }
+    const double t = q[i] / p[i];
+    if (p[i] < 0) t0 = std::max(t0, t);
+    else t1 = std::min(t1, t);
+    if (t0 > t1) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+void ResultIndex::clear() {
+  lines_.clear();
+  points_.clear();
+  circles_.clear();
+  starts_.clear();
+  entries_.clear();
+  nx_ = ny_ = 0;
+}
+
+void ResultIndex::build(const DetectionResult& result, double cell_size) {
+  build(result.lines, result.points, result.circles, cell_size);
+}
+
+void ResultIndex::build(const std::vector<cv::Vec4i>& lines, const std::vector<cv::Point2f>& points,
+                        const std::vector<cv::Vec3f>& circles, double cell_size) {
+  TRACE_SCOPE_PX("ResultIndex::build", static_cast<int64_t>(lines.size() + points.size() + circles.size()));
+  clear();
+  lines_.reserve(lines.size());
+  for (const auto& l : lines) lines_.push_back(cv::Vec4f(static_cast<float>(l[0]), static_cast<float>(l[1]),
+                                                         static_cast<float>(l[2]), static_cast<float>(l[3])));
+  points_ = points;
+  circles_ = circles;
+  if (empty()) return;
+
+  float min_x = std::numeric_limits<float>::max(), min_y = min_x;
+  float max_x = std::numeric_limits<float>::lowest(), max_y = max_x;
+  auto grow = [&](float x0, float y0, float x1, float y1) {
+    min_x = std::min(min_x, x0); min_y = std::min(min_y, y0);
+    max_x = std::max(max_x, x1); max_y = std::max(max_y, y1);
+  };
+  for (const auto& l : lines_) grow(std::min(l[0], l[2]), std::min(l[1], l[3]), std::max(l[0], l[2]), std::max(l[1], l[3]));
+  for (const auto& p : points_) grow(p.x, p.y, p.x, p.y);
+  for (const auto& c : circles_) grow(c[0] - c[2], c[1] - c[2], c[0] + c[2], c[1] + c[2]);
+
+  const double w = std::max(1.0, static_cast<double>(max_x - min_x));
+  const double h = std::max(1.0, static_cast<double>(max_y - min_y));
+  // about two elements per cell when they are spread evenly
+  double cell = cell_size > 0 ? cell_size : std::max(4.0, std::sqrt(w * h / size()) * 1.5);
+  while ((std::floor(w / cell) + 1) * (std::floor(h / cell) + 1) > static_cast<double>(kMaxCells)) cell *= 2;
+  cell_ = static_cast<float>(cell);
+  origin_ = cv::Point2f(min_x, min_y);
+  nx_ = static_cast<int>(w / cell) + 1;
+  ny_ = static_cast<int>(h / cell) + 1;
+
+  // two passes: count per cell, then fill the compressed rows
+  std::vector<uint32_t> counts(static_cast<size_t>(nx_) * ny_ + 1, 0);
+  auto count = [&](int cx, int cy) { ++counts[static_cast<size_t>(cy) * nx_ + cx]; };
+  for (const auto& l : lines_) for_line_cells(l, count);
+  for (const auto& p : points_) {
+    count(std::min(nx_ - 1, static_cast<int>((p.x - origin_.x) / cell_)), std::min(ny_ - 1, static_cast<int>((p.y - origin_.y) / cell_)));
+  }
+  for (const auto& c : circles_) for_circle_cells(c, count);
+
+  starts_.assign(counts.size(), 0);
+  for (size_t i = 1; i < counts.size(); ++i) starts_[i] = starts_[i - 1] + counts[i - 1];
+  entries_.resize(starts_.back());
+  std::vector<uint32_t> cursor(starts_.begin(), starts_.end() - 1);
+  uint32_t entry = 0;
+  auto fill = [&](int cx, int cy) { entries_[cursor[static_cast<size_t>(cy) * nx_ + cx]++] = entry; };
+  for (size_t i = 0; i < lines_.size(); ++i) {
+    entry = encode(Type::Line, static_cast<int>(i));
+    for_line_cells(lines_[i], fill);
+  }
+  for (size_t i = 0; i < points_.size(); ++i) {
+    entry = encode(Type::Point, static_cast<int>(i));
+    fill(std::min(nx_ - 1, static_cast<int>((points_[i].x - origin_.x) / cell_)),
+         std::min(ny_ - 1, static_cast<int>((points_[i].y - origin_.y) / cell_)));
+  }
+  for (size_t i = 0; i < circles_.size(); ++i) {
+    entry = encode(Type::Circle, static_cast<int>(i));
+    for_circle_cells(circles_[i], fill);
+  }
+}
+
+// Cells crossed by the segment (grid traversal, Amanatides & Woo).
+template <class Visit>
+void ResultIndex::for_line_cells(const cv::Vec4f& l, Visit visit) const {
+  const double x0 = (l[0] - origin_.x) / cell_, y0 = (l[1] - origin_.y) / cell_;
+  const double x1 = (l[2] - origin_.x) / cell_, y1 = (l[3] - origin_.y) / cell_;
+  int cx = std::min(nx_ - 1, std::max(0, static_cast<int>(std::floor(x0))));
+  int cy = std::min(ny_ - 1, std::max(0, static_cast<int>(std::floor(y0))));
+  const int ex = std::min(nx_ - 1, std::max(0, static_cast<int>(std::floor(x1))));
+  const int ey = std::min(ny_ - 1, std::max(0, static_cast<int>(std::floor(y1))));
+  visit(cx, cy);
+
+  const double dx = x1 - x0, dy = y1 - y0;
+  const int sx = dx > 0 ? 1 : -1, sy = dy > 0 ? 1 : -1;
+  const double inf = std::numeric_limits<double>::infinity();
+  const double t_dx = dx != 0 ? std::abs(1.0 / dx) : inf;
+  const double t_dy = dy != 0 ? std::abs(1.0 / dy) : inf;
+  double t_x = dx != 0 ? (dx > 0 ? std::floor(x0) + 1 - x0 : x0 - std::floor(x0)) * t_dx : inf;
+  double t_y = dy != 0 ? (dy > 0 ? std::floor(y0) + 1 - y0 : y0 - std::floor(y0)) * t_dy : inf;
+  for (int steps = std::abs(ex - cx) + std::abs(ey - cy); steps > 0; --steps) {
+    if ((t_x < t_y && cx != ex) || cy == ey) {
+      t_x += t_dx;
+      cx += sx;
+    } else {
+      t_y += t_dy;
+      cy += sy;
+    }
+    visit(cx, cy);
+  }
+}
+
+// Cells of the bounding box that the outline passes through.
+template <class Visit>
+void ResultIndex::for_circle_cells(const cv::Vec3f& c, Visit visit) const {
+  int x0, y0, x1, y1;
+  if (!cell_range(cv::Rect2f(c[0] - c[2], c[1] - c[2], 2 * c[2], 2 * c[2]), x0, y0, x1, y1)) return;
+  for (int cy = y0; cy <= y1; ++cy) {
+    for (int cx = x0; cx <= x1; ++cx) {
+      const double left = origin_.x + static_cast<double>(cx) * cell_, top = origin_.y + static_cast<double>(cy) * cell_;
+      double nearest = 0, farthest = 0;
+      rect_distances(c[0], c[1], left, top, left + cell_, top + cell_, nearest, farthest);
+      if (nearest <= c[2] && farthest >= c[2]) visit(cx, cy);
+    }
+  }
+}
+
+bool ResultIndex::cell_range(const cv::Rect2f& rect, int& x0, int& y0, int& x1, int& y1) const {
+  if (nx_ == 0 || ny_ == 0) return false;
+  const double fx0 = std::floor((rect.x - origin_.x) / cell_), fy0 = std::floor((rect.y - origin_.y) / cell_);
+  const double fx1 = std::floor((rect.x + rect.width - origin_.x) / cell_), fy1 = std::floor((rect.y + rect.height - origin_.y) / cell_);
+  if (fx1 < 0 || fy1 < 0 || fx0 >= nx_ || fy0 >= ny_) return false;
+  x0 = static_cast<int>(std::max(0.0, fx0));
+  y0 = static_cast<int>(std::max(0.0, fy0));
+  x1 = static_cast<int>(std::min<double>(nx_ - 1, fx1));
+  y1 = static_cast<int>(std::min<double>(ny_ - 1, fy1));
+  return true;
+}
+
+double ResultIndex::distance(const cv::Point2f& p, const Element& e) const {
+  switch (e.type) {
+  case Type::Line: return point_segment_distance(p, lines_[e.index]);
+  case Type::Point: return std::hypot(p.x - points_[e.index].x, p.y - points_[e.index].y);
+  case Type::Circle: {
+    const cv::Vec3f& c = circles_[e.index];
+    return std::abs(std::hypot(p.x - c[0], p.y - c[1]) - c[2]);
+  }
+  }
+  return std::numeric_limits<double>::infinity();
+}
+
+bool ResultIndex::nearest(const cv::Point2f& p, double radius, Hit& hit) const {
+  int x0, y0, x1, y1;
+  const float r = static_cast<float>(radius);
+  if (!cell_range(cv::Rect2f(p.x - r, p.y - r, 2 * r, 2 * r), x0, y0, x1, y1)) return false;
+  bool found = false;
+  for (int cy = y0; cy <= y1; ++cy) {
+    const size_t row = static_cast<size_t>(cy) * nx_;
+    for (size_t i = starts_[row + x0]; i < starts_[row + x1 + 1]; ++i) {
+      const Element e = decode(entries_[i]);
+      const double d = distance(p, e);
+      if (d <= radius && (!found || d < hit.distance)) {
+        hit.element = e;
+        hit.distance = d;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+bool ResultIndex::touches(const Element& e, const cv::Rect2f& rect) const {
+  const double x0 = rect.x, y0 = rect.y, x1 = rect.x + rect.width, y1 = rect.y + rect.height;
+  switch (e.type) {
+  case Type::Line: return segment_touches_rect(lines_[e.index], x0, y0, x1, y1);
+  case Type::Point: {
+    const cv::Point2f& p = points_[e.index];
+    return p.x >= x0 && p.x <= x1 && p.y >= y0 && p.y <= y1;
+  }
+  case Type::Circle: {
+    const cv::Vec3f& c = circles_[e.index];
+    double nearest = 0, farthest = 0;
+    rect_distances(c[0], c[1], x0, y0, x1, y1, nearest, farthest);
+    return nearest <= c[2] && farthest >= c[2];
+  }
+  }
+  return false;
+}
+
+std::vector<ResultIndex::Element> ResultIndex::query(const cv::Rect2f& rect) const {
+  std::vector<Element> out;
+  int x0, y0, x1, y1;
+  if (!cell_range(rect, x0, y0, x1, y1)) return out;
+  std::vector<uint32_t> seen;
+  for (int cy = y0; cy <= y1; ++cy) {
+    const size_t row = static_cast<size_t>(cy) * nx_;
+    seen.insert(seen.end(), entries_.begin() + starts_[row + x0], entries_.begin() + starts_[row + x1 + 1]);
+  }
+  // lines and circles span several cells
+  std::sort(seen.begin(), seen.end());
+  seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+  for (uint32_t entry : seen) {
+    const Element e = decode(entry);
+    if (touches(e, rect)) out.push_back(e);
+  }
+  return out;
+}
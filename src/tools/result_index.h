@@ -0,0 +1,75 @@
+#pragma once
+
+#include "detection_result.h"
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Uniform grid over the elements of a detection result, for "what is under
+// the cursor" and "what is inside this box" without visiting every element.
+// Lines are entered into the cells they cross, circles into the cells their
+// outline crosses, points into one cell. Built once per result; queries are
+// const and may run concurrently.
+class ResultIndex {
+public:
+  enum class Type : uint8_t { Line, Point, Circle };
+
+  // Element of the indexed result: index into lines / points / circles.
+  struct Element {
+    Type type = Type::Point;
+    int index = -1;
+    bool valid() const { return index >= 0; }
+    bool operator==(const Element& o) const { return type == o.type && index == o.index; }
+    bool operator!=(const Element& o) const { return !(*this == o); }
+  };
+
+  struct Hit {
+    Element element;
+    double distance = 0.0;  // from the query point to the element
+  };
+
+  // cell_size <= 0 picks one from the element density.
+  void build(const std::vector<cv::Vec4i>& lines, const std::vector<cv::Point2f>& points,
+             const std::vector<cv::Vec3f>& circles, double cell_size = 0.0);
+  void build(const DetectionResult& result, double cell_size = 0.0);
+  void clear();
+
+  size_t size() const { return lines_.size() + points_.size() + circles_.size(); }
+  bool empty() const { return size() == 0; }
+
+  // Closest element within `radius` of p (distance to the segment, the
+  // point, or the circle outline).
+  bool nearest(const cv::Point2f& p, double radius, Hit& hit) const;
+  // Elements touching `rect`: lines crossing it, points inside, circles
+  // whose outline crosses it. Sorted by type, then index.
+  std::vector<Element> query(const cv::Rect2f& rect) const;
+
+  double distance(const cv::Point2f& p, const Element& e) const;
+  // Geometry of an element, for highlighting and measuring.
+  const cv::Vec4f& line(int i) const { return lines_[i]; }
+  const cv::Point2f& point(int i) const { return points_[i]; }
+  const cv::Vec3f& circle(int i) const { return circles_[i]; }
+
+private:
+  bool cell_range(const cv::Rect2f& rect, int& x0, int& y0, int& x1, int& y1) const;
+  template <class Visit> void for_line_cells(const cv::Vec4f& l, Visit visit) const;
+  template <class Visit> void for_circle_cells(const cv::Vec3f& c, Visit visit) const;
+  bool touches(const Element& e, const cv::Rect2f& rect) const;
+
+  std::vector<cv::Vec4f> lines_;
+  std::vector<cv::Point2f> points_;
+  std::vector<cv::Vec3f> circles_;
+
+  cv::Point2f origin_;
+  float cell_ = 1.f;
+  int nx_ = 0;
+  int ny_ = 0;
+  // compressed rows: elements of cell c are entries_[starts_[c] .. starts_[c + 1])
+  std::vector<uint32_t> starts_;
+  std::vector<uint32_t> entries_;  // type in the top 2 bits, index below
+};
+
+} // namespace tools
@@ -0,0 +1,198 @@
+#include "result_io.h"
+
+#include <cstdint>
+#include <cstdio>
+
+using namespace tools;
+
+namespace {
+
+// CSV field quoting only when needed (file names may contain commas)
+std::string csv_field(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos) return s;
+  std::string q = "\"";
+  for (char c : s) {
+    if (c == '"') q += '"';
+    q += c;
+  }
+  q += '"';
+  return q;
+}
+
+std::string num(double v, int digits = 6) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.*g", digits, v);
+  return buf;
+}
+
+std::string fits_json(const std::vector<ShapeFit>& fits) {
+  std::string s = "[";
+  for (size_t i = 0; i < fits.size(); ++i) {
+    const auto& f = fits[i];
+    if (i) s += ',';
+    s += "{\"samples\":" + std::to_string(f.samples) + ",\"inliers\":" + std::to_string(f.inliers) + ",\"rms\":" + num(f.rms) + '}';
+  }
+  return s + ']';
+}
+
+// binary records: a count, then the elements' raw bytes
+static_assert(sizeof(cv::Vec4i) == 16 && sizeof(cv::Vec4f) == 16 && sizeof(cv::Vec3f) == 12 &&
+              sizeof(cv::Point2f) == 8 && sizeof(ShapeFit) == 12, "unexpected padding in result types");
+
+// more elements than any tool produces: the record is corrupt
+const uint32_t kMaxBinaryElements = 1u << 24;
+
+template <class T> void put(std::ostream& out, const T& v) {
+  out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <class T> bool get(std::istream& in, T& v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+template <class T> void put_vector(std::ostream& out, const std::vector<T>& v) {
+  put(out, static_cast<uint32_t>(v.size()));
+  if (!v.empty()) out.write(reinterpret_cast<const char*>(v.data()), static_cast<std::streamsize>(v.size() * sizeof(T)));
+}
+
+template <class T> bool get_vector(std::istream& in, std::vector<T>& v) {
+  uint32_t n = 0;
+  if (!get(in, n) || n > kMaxBinaryElements) return false;
+  v.resize(n);
+  return n == 0 || static_cast<bool>(in.read(reinterpret_cast<char*>(v.data()), static_cast<std::streamsize>(n * sizeof(T))));
+}
+
+} // namespace
+
+const char* tools::detection_kind_name(DetectionKind kind) {
+  switch (kind) {
+  case DetectionKind::None: return "none";
+  case DetectionKind::Lines: return "lines";
+  case DetectionKind::Points: return "points";
+  case DetectionKind::Circles: return "circles";
+  case DetectionKind::Mixed: return "mixed";
+  }
+  return "none";
+}
+
+void tools::write_csv_header(std::ostream& out) {
+  out << "image,type,x1,y1,x2,y2,radius\n";
+}
+
+void tools::write_csv(std::ostream& out, const std::string& image, const DetectionResult& result) {
+  const std::string name = csv_field(image);
+  for (const auto& l : result.lines) {
+    out << name << ",line," << l[0] << ',' << l[1] << ',' << l[2] << ',' << l[3] << ",\n";
+  }
+  for (const auto& p : result.points) {
+    out << name << ",point," << num(p.x) << ',' << num(p.y) << ",,,\n";
+  }
+  for (const auto& c : result.circles) {
+    out << name << ",circle," << num(c[0]) << ',' << num(c[1]) << ",,," << num(c[2]) << '\n';
+  }
+}
+
+std::string tools::json_escape(const std::string& s) {
+  std::string out;
+  out.reserve(s.size() + 2);
+  for (char c : s) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out;
+}
+
+std::string tools::to_json(const DetectionResult& result) {
+  std::string s = "{\"kind\":\"";
+  s += detection_kind_name(result.kind);
+  s += '"';
+  if (result.roi_id >= 0) s += ",\"roi_id\":" + std::to_string(result.roi_id);
+  s += ",\"lines\":[";
+  for (size_t i = 0; i < result.lines.size(); ++i) {
+    const auto& l = result.lines[i];
+    if (i) s += ',';
+    s += '[' + std::to_string(l[0]) + ',' + std::to_string(l[1]) + ',' + std::to_string(l[2]) + ',' + std::to_string(l[3]) + ']';
+  }
+  s += ']';
+  if (!result.subpixel_lines.empty()) {
+    s += ",\"subpixel_lines\":[";
+    for (size_t i = 0; i < result.subpixel_lines.size(); ++i) {
+      const auto& l = result.subpixel_lines[i];
+      if (i) s += ',';
+      // sub-pixel coordinates keep 1/1000 px on large images
+      s += '[' + num(l[0], 9) + ',' + num(l[1], 9) + ',' + num(l[2], 9) + ',' + num(l[3], 9) + ']';
+    }
+    s += "],\"line_fits\":" + fits_json(result.line_fits);
+  }
+  s += ",\"points\":[";
+  for (size_t i = 0; i < result.points.size(); ++i) {
+    const auto& p = result.points[i];
+    if (i) s += ',';
+    s += '[' + num(p.x) + ',' + num(p.y) + ']';
+  }
+  s += "],\"circles\":[";
+  const int circle_digits = result.circle_fits.empty() ? 6 : 9;
+  for (size_t i = 0; i < result.circles.size(); ++i) {
+    const auto& c = result.circles[i];
+    if (i) s += ',';
+    s += '[' + num(c[0], circle_digits) + ',' + num(c[1], circle_digits) + ',' + num(c[2], circle_digits) + ']';
+  }
+  s += ']';
+  if (!result.circle_fits.empty()) s += ",\"circle_fits\":" + fits_json(result.circle_fits);
+  if (!result.residuals.empty()) {
+    s += ",\"residuals\":[";
+    for (size_t i = 0; i < result.residuals.size(); ++i) {
+      if (i) s += ',';
+      s += num(result.residuals[i], 4);
+    }
+    s += ']';
+  }
+  s += '}';
+  return s;
+}
+
+void tools::write_jsonl(std::ostream& out, const std::string& image, const DetectionResult& result, double elapsed_ms) {
+  out << "{\"image\":\"" << json_escape(image) << "\",\"ms\":" << num(elapsed_ms)
+      << ",\"result\":" << to_json(result) << "}\n";
+}
+
+void tools::write_binary(std::ostream& out, const DetectionResult& result) {
+  put(out, static_cast<int32_t>(result.kind));
+  put(out, static_cast<int32_t>(result.roi_id));
+  put_vector(out, result.lines);
+  put_vector(out, result.subpixel_lines);
+  put_vector(out, result.line_fits);
+  put_vector(out, result.points);
+  put_vector(out, result.circles);
+  put_vector(out, result.circle_fits);
+  put_vector(out, result.residuals);
+}
+
+bool tools::read_binary(std::istream& in, DetectionResult& result) {
+  int32_t kind = 0, roi_id = -1;
+  if (!get(in, kind) || !get(in, roi_id)) return false;
+  if (kind < static_cast<int32_t>(DetectionKind::None) || kind > static_cast<int32_t>(DetectionKind::Mixed)) return false;
+  DetectionResult r;
+  r.kind = static_cast<DetectionKind>(kind);
+  r.roi_id = roi_id;
+  if (!get_vector(in, r.lines) || !get_vector(in, r.subpixel_lines) || !get_vector(in, r.line_fits) ||
+      !get_vector(in, r.points) || !get_vector(in, r.circles) || !get_vector(in, r.circle_fits) ||
+      !get_vector(in, r.residuals)) {
+    return false;
+  }
+  result = std::move(r);
+  return true;
+}
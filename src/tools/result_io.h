@@ -0,0 +1,36 @@
+#pragma once
+
+#include "detection_result.h"
+#include <istream>
+#include <ostream>
+#include <string>
+
+namespace tools {
+
+const char* detection_kind_name(DetectionKind kind);
+
+// CSV: one row per detection.
+//   image,type,x1,y1,x2,y2,radius
+// Lines fill x1..y2, points x1,y1, circles x1,y1 (center) and radius.
+void write_csv_header(std::ostream& out);
+void write_csv(std::ostream& out, const std::string& image, const DetectionResult& result);
+
+// One JSON object for the whole result (no trailing newline):
+//   {"kind":"lines","lines":[[x1,y1,x2,y2],...],"points":[[x,y],...],"circles":[[x,y,r],...]}
+// Measured lines add "subpixel_lines":[[x1,y1,x2,y2],...] and
+// "line_fits":[{"samples":n,"inliers":n,"rms":d},...] after "lines";
+// measured circles add "circle_fits" after "circles", and the edge samples'
+// distances to the fitted shape follow as "residuals":[d,...].
+std::string to_json(const DetectionResult& result);
+// One JSONL record: {"image":...,"ms":...,"result":{...}}
+void write_jsonl(std::ostream& out, const std::string& image, const DetectionResult& result, double elapsed_ms);
+
+std::string json_escape(const std::string& s);
+
+// Compact binary form of a whole result, every field included, in native
+// byte order (caches on the same machine, not interchange). read_binary()
+// fails on a truncated or implausible record.
+void write_binary(std::ostream& out, const DetectionResult& result);
+bool read_binary(std::istream& in, DetectionResult& result);
+
+} // namespace tools
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+class StageCache;
+
+// Per-run state shared between the caller and a running tool.
+// Tools poll cancelled() between stages; a single OpenCV call is not interruptible.
+struct RunContext {
+  std::atomic<bool> cancel_requested{false};
+  // Called from the worker thread with a percentage in [0, 100].
+  std::function<void(int)> on_progress;
+  // Identity of the image being processed (ImageDocument::id), 0 if unknown.
+  // Together with stage_cache it lets tools reuse preprocessed planes.
+  uint64_t image_id = 0;
+  StageCache* stage_cache = nullptr;
+  // Region the stages were prepared on for this run (ITool::prepare on the
+  // union of overlapping batch ROIs), empty otherwise. Only then may a stage
+  // answer from a sub-view of that plane instead of computing its own ROI.
+  cv::Rect prepared_region;
+  // Enclosing run (e.g. a pipeline around a tool step); cancelling it
+  // cancels this context too.
+  const RunContext* parent = nullptr;
+
+  void cancel() { cancel_requested.store(true); }
+  bool cancelled() const {
+    return cancel_requested.load(std::memory_order_relaxed) || (parent && parent->cancelled());
+  }
+  void report_progress(int percent) const {
+    if (on_progress) on_progress(percent);
+  }
+};
+
+} // namespace tools
@@ -0,0 +1,136 @@
+#include "stage_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace tools;
+
+namespace {
+// dropped image ids remembered; in-flight runs only ever hold recent ones
+constexpr size_t kDroppedIds = 64;
+
+inline void hash_combine(size_t& seed, size_t v) {
+  seed ^= v + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+}
+
+size_t StageKeyHash::operator()(const StageKey& k) const {
+  size_t h = std::hash<uint64_t>()(k.image_id);
+  hash_combine(h, std::hash<int>()(k.roi.x));
+  hash_combine(h, std::hash<int>()(k.roi.y));
+  hash_combine(h, std::hash<int>()(k.roi.width));
+  hash_combine(h, std::hash<int>()(k.roi.height));
+  hash_combine(h, std::hash<int>()(static_cast<int>(k.stage)));
+  hash_combine(h, std::hash<std::string>()(k.params));
+  return h;
+}
+
+bool tools::supports_sub_views(Stage stage) {
+  return stage != Stage::Pyramid;
+}
+
+StageCache::StageCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+StageCache& StageCache::global() {
+  static StageCache cache;
+  return cache;
+}
+
+bool StageCache::lookup(const StageKey& key, cv::Mat& out, const cv::Rect& prepared) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    out = it->second->plane;
+    ++hits_;
+    return true;
+  }
+  if (!prepared.empty() && prepared != key.roi && (prepared & key.roi) == key.roi &&
+      supports_sub_views(key.stage)) {
+    StageKey outer = key;
+    outer.roi = prepared;
+    it = index_.find(outer);
+    if (it != index_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      out = it->second->plane(key.roi - prepared.tl());
+      ++hits_;
+      return true;
+    }
+  }
+  ++misses_;
+  return false;
+}
+
+void StageCache::insert(const StageKey& key, const cv::Mat& plane) {
+  const size_t bytes = plane.total() * plane.elemSize();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > budget_) return;  // would evict everything else for one plane
+  if (std::find(dropped_.begin(), dropped_.end(), key.image_id) != dropped_.end()) return;
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    used_ -= it->second->bytes;
+    lru_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_.push_front(Entry{key, plane, bytes});
+  index_.emplace(key, lru_.begin());
+  used_ += bytes;
+  evict_locked();
+}
+
+void StageCache::evict_locked() {
+  while (used_ > budget_ && !lru_.empty()) {
+    const Entry& victim = lru_.back();
+    used_ -= victim.bytes;
+    index_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+void StageCache::set_budget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = budget_bytes;
+  evict_locked();
+}
+
+size_t StageCache::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_;
+}
+
+size_t StageCache::bytes_used() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
+
+void StageCache::drop_image(uint64_t image_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dropped_.push_back(image_id);
+  if (dropped_.size() > kDroppedIds) dropped_.pop_front();
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    if (it->key.image_id == image_id) {
+      used_ -= it->bytes;
+      index_.erase(it->key);
+      it = lru_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void StageCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  used_ = 0;
+}
+
+uint64_t StageCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+uint64_t StageCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Preprocessing stages whose output planes are memoized.
+enum class Stage {
+  Gray,
+  Blur,
+  Edges,
+  CornerResponse,
+  Pyramid
+};
+
+// Whether a plane of a larger region, cut down to a ROI, may stand in for
+// the plane of that ROI. False for stages whose output geometry is not the
+// ROI's (Pyramid).
+bool supports_sub_views(Stage stage);
+
+// (image id, ROI, stage, stage params). params is a short canonical string
+// of everything the stage output depends on, e.g. "k3x3 s0".
+struct StageKey {
+  uint64_t image_id = 0;
+  cv::Rect roi;
+  Stage stage = Stage::Gray;
+  std::string params;
+
+  bool operator==(const StageKey& o) const {
+    return image_id == o.image_id && roi == o.roi && stage == o.stage && params == o.params;
+  }
+};
+
+struct StageKeyHash {
+  size_t operator()(const StageKey& k) const;
+};
+
+// LRU cache of preprocessed planes with a memory budget.
+// Cached matrices are shared and must be treated as read-only.
+class StageCache {
+public:
+  explicit StageCache(size_t budget_bytes = size_t(512) << 20);
+
+  // Cache used by the GUI and the executors.
+  static StageCache& global();
+
+  // Exact match first. With a non-empty `prepared` region containing
+  // key.roi (RunContext::prepared_region) and a stage that supports sub
+  // views, the plane cached for exactly that region is returned cut down to
+  // key.roi. Both are hash lookups.
+  bool lookup(const StageKey& key, cv::Mat& out, const cv::Rect& prepared = cv::Rect());
+  void insert(const StageKey& key, const cv::Mat& plane);
+
+  void set_budget(size_t budget_bytes);
+  size_t budget() const;
+  size_t bytes_used() const;
+  // Drops every plane derived from the given image. Image ids are never
+  // reused, so later inserts for a recently dropped id (a run that was still
+  // in flight) are ignored instead of pinning planes nobody will look up.
+  void drop_image(uint64_t image_id);
+  void clear();
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+private:
+  struct Entry {
+    StageKey key;
+    cv::Mat plane;
+    size_t bytes = 0;
+  };
+  using List = std::list<Entry>;
+
+  void evict_locked();
+
+  mutable std::mutex mutex_;
+  List lru_;  // most recently used at the front
+  std::unordered_map<StageKey, List::iterator, StageKeyHash> index_;
+  std::deque<uint64_t> dropped_;  // most recently dropped image ids, newest last
+  size_t budget_ = 0;
+  size_t used_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+} // namespace tools
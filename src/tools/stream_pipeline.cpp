@@ -0,0 +1,151 @@
+#include "stream_pipeline.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace tools;
+
+namespace {
+// weight of the newest sample in the smoothed counters
+constexpr double kSmoothing = 0.1;
+
+double smooth(double current, double sample) {
+  return current > 0.0 ? current + kSmoothing * (sample - current) : sample;
+}
+}
+
+StreamPipeline::StreamPipeline(std::unique_ptr<FrameSource> source, std::shared_ptr<ITool> tool,
+                               const StreamOptions& options)
+  : source_(std::move(source)),
+    tool_(std::move(tool)),
+    options_(options),
+    frames_(options.decode_queue),
+    results_(options.result_queue) {
+  pace_fps_ = options_.fps < 0 ? (source_ ? source_->fps() : 0.0) : options_.fps;
+}
+
+StreamPipeline::~StreamPipeline() {
+  stop();
+}
+
+void StreamPipeline::start() {
+  if (decode_thread_.joinable() || !source_ || !tool_) return;
+  decode_thread_ = std::thread([this]() { decode_loop(); });
+  detect_thread_ = std::thread([this]() { detect_loop(); });
+}
+
+void StreamPipeline::stop() {
+  stop_.store(true);
+  if (source_) source_->interrupt();
+  ctx_.cancel();
+  frames_.close();
+  results_.close();
+  if (decode_thread_.joinable()) decode_thread_.join();
+  if (detect_thread_.joinable()) detect_thread_.join();
+  detect_done_.store(true);
+}
+
+bool StreamPipeline::finished() const {
+  return detect_done_.load() && results_.size() == 0;
+}
+
+void StreamPipeline::tick(double& fps, Clock::time_point& last) {
+  const Clock::time_point now = Clock::now();
+  if (last != Clock::time_point()) {
+    const double dt = std::chrono::duration<double>(now - last).count();
+    if (dt > 0) fps = smooth(fps, 1.0 / dt);
+  }
+  last = now;
+}
+
+void StreamPipeline::decode_loop() {
+  const bool paced = pace_fps_ > 0;
+  const auto period = paced ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / pace_fps_))
+                            : Clock::duration::zero();
+  Clock::time_point next = Clock::now();
+  while (!stop_.load()) {
+    if (paced) {
+      std::this_thread::sleep_until(next);
+      next += period;
+    }
+    Frame frame;
+    try {
+      if (!source_->read(frame)) break;
+    } catch (const std::exception&) {
+      break;
+    }
+    size_t dropped = 0;
+    if (paced && options_.drop_oldest) {
+      dropped = frames_.push_drop_oldest(std::move(frame));
+    } else if (!frames_.push(std::move(frame))) {
+      break;
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++stats_.decoded;
+    stats_.dropped += dropped;
+    tick(stats_.decode_fps, last_decode_);
+  }
+  frames_.close();
+}
+
+void StreamPipeline::detect_loop() {
+  tool_->set_context(&ctx_);
+  while (auto frame = frames_.pop()) {
+    if (stop_.load()) break;
+    StreamResult r;
+    r.index = frame->index;
+    r.captured = frame->captured;
+    r.frame = ImageDocument::from_mat(std::move(frame->pixels), std::move(frame->owner));
+    const Clock::time_point t0 = Clock::now();
+    if (!r.frame) {
+      r.error = "unsupported frame format";
+    } else {
+      TRACE_SCOPE("stream.detect");
+      try {
+        r.result = tool_->run(r.frame->gray(), options_.roi);
+      } catch (const std::exception& e) {
+        r.error = e.what();
+      }
+    }
+    if (ctx_.cancelled()) break;
+    r.detect_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    const double detect_ms = r.detect_ms;
+    const size_t dropped = results_.push_drop_oldest(std::move(r));
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++stats_.detected;
+    stats_.dropped += dropped;
+    stats_.detect_ms = smooth(stats_.detect_ms, detect_ms);
+    tick(stats_.detect_fps, last_detect_);
+  }
+  tool_->set_context(nullptr);
+  detect_done_.store(true);
+}
+
+std::optional<StreamResult> StreamPipeline::take_latest() {
+  std::optional<StreamResult> latest;
+  size_t taken = 0;
+  while (auto r = results_.try_pop()) {
+    latest = std::move(r);
+    ++taken;
+  }
+  if (taken > 1) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.dropped += taken - 1;
+  }
+  return latest;
+}
+
+void StreamPipeline::mark_rendered(const StreamResult& r) {
+  const double latency = std::chrono::duration<double, std::milli>(Clock::now() - r.captured).count();
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  ++stats_.rendered;
+  stats_.latency_ms = smooth(stats_.latency_ms, latency);
+  stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency);
+  tick(stats_.render_fps, last_render_);
+}
+
+StreamStats StreamPipeline::stats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_;
+}
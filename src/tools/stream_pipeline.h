@@ -0,0 +1,109 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "detection_result.h"
+#include "frame_source.h"
+#include "image_document.h"
+#include "itool.h"
+#include "run_context.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace tools {
+
+struct StreamOptions {
+  cv::Rect roi;              // empty = whole frame
+  size_t decode_queue = 2;   // decoded frames waiting for detection
+  size_t result_queue = 2;   // detected frames waiting for render
+  // Playback rate: < 0 uses the source rate, 0 decodes as fast as possible.
+  double fps = -1.0;
+  // When paced, a frame that finds the queue full replaces the oldest one
+  // instead of waiting, so a slow detector skips frames rather than lag.
+  // Unpaced sources always wait (every frame is processed).
+  bool drop_oldest = true;
+};
+
+// A frame that went through detection, ready to be drawn.
+struct StreamResult {
+  uint64_t index = 0;
+  std::shared_ptr<ImageDocument> frame;
+  DetectionResult result;
+  std::string error;
+  std::chrono::steady_clock::time_point captured;
+  double detect_ms = 0.0;
+};
+
+struct StreamStats {
+  double decode_fps = 0.0;
+  double detect_fps = 0.0;
+  double render_fps = 0.0;
+  double latency_ms = 0.0;      // capture -> render, smoothed
+  double max_latency_ms = 0.0;
+  double detect_ms = 0.0;       // smoothed
+  uint64_t decoded = 0;
+  uint64_t detected = 0;
+  uint64_t rendered = 0;
+  uint64_t dropped = 0;         // skipped by drop-oldest, before or after detection
+};
+
+// decode -> detect -> render as overlapped stages. Decode and detect run on
+// their own threads, connected by bounded queues; render is whoever calls
+// take_latest() (the GUI timer) and reports back with mark_rendered().
+class StreamPipeline {
+public:
+  StreamPipeline(std::unique_ptr<FrameSource> source, std::shared_ptr<ITool> tool,
+                 const StreamOptions& options = StreamOptions());
+  // Stops and joins the stage threads.
+  ~StreamPipeline();
+
+  StreamPipeline(const StreamPipeline&) = delete;
+  StreamPipeline& operator=(const StreamPipeline&) = delete;
+
+  void start();
+  // Stops decoding, cancels the detection in progress and joins the threads.
+  void stop();
+  // True once the source is exhausted (or stopped) and every result was taken.
+  bool finished() const;
+
+  // Newest detected frame, never blocks. Older waiting results are dropped
+  // (counted in StreamStats::dropped): render always shows the latest state.
+  std::optional<StreamResult> take_latest();
+  // Render stage done with `r` (updates render fps and latency).
+  void mark_rendered(const StreamResult& r);
+
+  StreamStats stats() const;
+  const FrameSource& source() const { return *source_; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  void decode_loop();
+  void detect_loop();
+  void tick(double& fps, Clock::time_point& last);
+
+  std::unique_ptr<FrameSource> source_;
+  std::shared_ptr<ITool> tool_;
+  StreamOptions options_;
+  double pace_fps_ = 0.0;
+
+  BoundedQueue<Frame> frames_;
+  BoundedQueue<StreamResult> results_;
+  RunContext ctx_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> detect_done_{false};
+  std::thread decode_thread_;
+  std::thread detect_thread_;
+
+  mutable std::mutex stats_mutex_;
+  StreamStats stats_;
+  Clock::time_point last_decode_, last_detect_, last_render_;
+};
+
+} // namespace tools
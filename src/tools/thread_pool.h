@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tools {
+
+// Fixed-size worker pool shared by the tool engines.
+class ThreadPool {
+public:
+  // threads == 0 -> std::thread::hardware_concurrency()
+  explicit ThreadPool(unsigned threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Process-wide pool, created on first use.
+  static ThreadPool& global();
+
+  unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+  // Fire-and-forget task.
+  void post(std::function<void()> task);
+
+  // Task with a result.
+  template <class F>
+  auto submit(F&& f) -> std::future<std::invoke_result_t<F>> {
+    using R = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> fut = task->get_future();
+    post([task]() { (*task)(); });
+    return fut;
+  }
+
+  // Runs body(i) for i in [begin, end). The calling thread takes part, so it
+  // is safe to call from inside a pool task without starving the pool.
+  void parallel_for(size_t begin, size_t end, const std::function<void(size_t)>& body);
+
+private:
+  void worker_loop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+} // namespace tools
@@ -0,0 +1,421 @@
+#include "tile_store.h"
+#include "image_files.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace fs = std::filesystem;
+using namespace tools;
+
+namespace {
+
+// queued background loads beyond this are dropped, oldest first
+constexpr size_t kMaxQueuedTiles = 256;
+
+// OpenCV's decoder limits (CV_IO_MAX_IMAGE_PIXELS / _WIDTH / _HEIGHT
+// defaults): build_pyramid decodes the source in one piece
+constexpr int64_t kMaxSourcePixels = int64_t{1} << 30;
+constexpr int64_t kMaxSourceSide = int64_t{1} << 20;
+
+std::string trim(const std::string& s) {
+  const size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == std::string::npos) return std::string();
+  const size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e - b + 1);
+}
+
+fs::path tile_file(const std::string& dir, const PyramidInfo& info, int level, int tx, int ty) {
+  return fs::u8path(dir) / std::to_string(level) / (std::to_string(ty) + "_" + std::to_string(tx) + "." + info.format);
+}
+
+cv::Mat read_image_file(const fs::path& path, int flags) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return cv::Mat();
+  std::vector<uchar> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (bytes.empty()) return cv::Mat();
+  return cv::imdecode(bytes, flags);
+}
+
+bool write_image_file(const fs::path& path, const cv::Mat& image) {
+  std::vector<uchar> bytes;
+  if (!cv::imencode(path.extension().string(), image, bytes)) return false;
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  return static_cast<bool>(out);
+}
+
+int levels_for(int width, int height, int tile) {
+  int levels = 1;
+  while (std::max(width, height) > tile) {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    ++levels;
+  }
+  return levels;
+}
+
+} // namespace
+
+cv::Size PyramidInfo::level_size(int level) const {
+  int w = width, h = height;
+  for (int l = 0; l < level; ++l) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+  return cv::Size(w, h);
+}
+
+int PyramidInfo::tiles_x(int level) const {
+  return (level_size(level).width + tile_size - 1) / tile_size;
+}
+
+int PyramidInfo::tiles_y(int level) const {
+  return (level_size(level).height + tile_size - 1) / tile_size;
+}
+
+cv::Rect PyramidInfo::tile_rect(int level, int tx, int ty) const {
+  const cv::Size s = level_size(level);
+  return cv::Rect(tx * tile_size, ty * tile_size, tile_size, tile_size) & cv::Rect(0, 0, s.width, s.height);
+}
+
+bool tools::read_manifest(const std::string& dir, PyramidInfo& info, std::string* error) {
+  std::ifstream in(fs::u8path(dir) / "pyramid.txt");
+  if (!in) {
+    if (error) *error = "no pyramid.txt in " + dir;
+    return false;
+  }
+  PyramidInfo out;
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    const size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    line = trim(line);
+    if (line.empty()) continue;
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      if (error) *error = "pyramid.txt:" + std::to_string(line_no) + ": expected key = value";
+      return false;
+    }
+    const std::string key = trim(line.substr(0, eq));
+    const std::string value = trim(line.substr(eq + 1));
+    try {
+      if (key == "width") out.width = std::stoi(value);
+      else if (key == "height") out.height = std::stoi(value);
+      else if (key == "tile") out.tile_size = std::stoi(value);
+      else if (key == "levels") out.levels = std::stoi(value);
+      else if (key == "channels") out.channels = std::stoi(value);
+      else if (key == "format") out.format = value;
+      else {
+        if (error) *error = "pyramid.txt:" + std::to_string(line_no) + ": unknown key '" + key + "'";
+        return false;
+      }
+    } catch (const std::exception&) {
+      if (error) *error = "pyramid.txt:" + std::to_string(line_no) + ": bad value for " + key;
+      return false;
+    }
+  }
+  if (out.width <= 0 || out.height <= 0 || out.tile_size <= 0 || out.levels <= 0 ||
+      (out.channels != 1 && out.channels != 3)) {
+    if (error) *error = "pyramid.txt: invalid size, tile, levels or channels";
+    return false;
+  }
+  info = out;
+  return true;
+}
+
+bool tools::write_manifest(const std::string& dir, const PyramidInfo& info, std::string* error) {
+  std::ofstream out(fs::u8path(dir) / "pyramid.txt");
+  out << "width = " << info.width << "\n"
+      << "height = " << info.height << "\n"
+      << "tile = " << info.tile_size << "\n"
+      << "levels = " << info.levels << "\n"
+      << "channels = " << info.channels << "\n"
+      << "format = " << info.format << "\n";
+  if (!out) {
+    if (error) *error = "cannot write pyramid.txt in " + dir;
+    return false;
+  }
+  return true;
+}
+
+bool tools::build_pyramid(const std::string& image_path, const std::string& out_dir, int tile_size,
+                          std::string* error, const std::function<void(int)>& progress) {
+  if (tile_size < 16) {
+    if (error) *error = "tile size too small";
+    return false;
+  }
+  // refuse what the decoder would refuse before reading gigabytes
+  int64_t width = 0, height = 0;
+  if (read_image_size(fs::u8path(image_path), width, height) &&
+      (width * height > kMaxSourcePixels || width > kMaxSourceSide || height > kMaxSourceSide)) {
+    if (error) {
+      *error = image_path + " is " + std::to_string(width) + " x " + std::to_string(height) +
+               " pixels, more than one decode allows (2^30 pixels, 2^20 per side); write its level-0 tiles"
+               " and pyramid.txt directly and call build_pyramid_levels()";
+    }
+    return false;
+  }
+  cv::Mat image;
+  {
+    TRACE_SCOPE("pyramid.decode");
+    image = read_image_file(fs::u8path(image_path), cv::IMREAD_ANYCOLOR);
+  }
+  if (image.empty()) {
+    if (error) *error = "cannot decode " + image_path + ": unreadable, corrupt or not a PNG/JPEG/BMP/TIFF image";
+    return false;
+  }
+  if (image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+    if (error) *error = image_path + " is not an 8-bit gray or color image";
+    return false;
+  }
+
+  PyramidInfo info;
+  info.width = image.cols;
+  info.height = image.rows;
+  info.tile_size = tile_size;
+  info.channels = image.channels();
+  info.levels = 1;
+  std::error_code ec;
+  fs::create_directories(fs::u8path(out_dir) / "0", ec);
+  if (ec) {
+    if (error) *error = "cannot create " + out_dir + ": " + ec.message();
+    return false;
+  }
+
+  const int tx_count = info.tiles_x(0), ty_count = info.tiles_y(0);
+  std::atomic<bool> ok{true};
+  std::atomic<int> written{0};
+  ThreadPool::global().parallel_for(0, static_cast<size_t>(tx_count) * ty_count, [&](size_t i) {
+    const int tx = static_cast<int>(i % tx_count), ty = static_cast<int>(i / tx_count);
+    if (!write_image_file(tile_file(out_dir, info, 0, tx, ty), image(info.tile_rect(0, tx, ty)))) ok = false;
+    if (progress) progress(written.fetch_add(1) * 50 / (tx_count * ty_count));
+  });
+  if (!ok) {
+    if (error) *error = "cannot write tiles to " + out_dir;
+    return false;
+  }
+  image.release();
+  if (!write_manifest(out_dir, info, error)) return false;
+  return build_pyramid_levels(out_dir, error, [&](int p) { if (progress) progress(50 + p / 2); });
+}
+
+bool tools::build_pyramid_levels(const std::string& dir, std::string* error, const std::function<void(int)>& progress) {
+  PyramidInfo info;
+  if (!read_manifest(dir, info, error)) return false;
+  info.levels = levels_for(info.width, info.height, info.tile_size);
+  const int flags = info.channels == 1 ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+  const int type = info.channels == 1 ? CV_8UC1 : CV_8UC3;
+
+  for (int level = 1; level < info.levels; ++level) {
+    std::error_code ec;
+    fs::create_directories(fs::u8path(dir) / std::to_string(level), ec);
+    const int tx_count = info.tiles_x(level), ty_count = info.tiles_y(level);
+    std::atomic<bool> ok{true};
+    ThreadPool::global().parallel_for(0, static_cast<size_t>(tx_count) * ty_count, [&](size_t i) {
+      const int tx = static_cast<int>(i % tx_count), ty = static_cast<int>(i / tx_count);
+      // the 2x2 child tiles of the previous level, assembled then halved
+      cv::Rect parent = info.tile_rect(level - 1, 2 * tx, 2 * ty);
+      for (int d = 1; d < 4; ++d) {
+        const cv::Rect r = info.tile_rect(level - 1, 2 * tx + d % 2, 2 * ty + d / 2);
+        if (!r.empty()) parent |= r;
+      }
+      cv::Mat block(parent.size(), type, cv::Scalar::all(0));
+      for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+          const cv::Rect r = info.tile_rect(level - 1, 2 * tx + dx, 2 * ty + dy);
+          if (r.empty()) continue;
+          const cv::Mat child = read_image_file(tile_file(dir, info, level - 1, 2 * tx + dx, 2 * ty + dy), flags);
+          if (child.size() != r.size()) { ok = false; return; }
+          child.copyTo(block(r - parent.tl()));
+        }
+      }
+      cv::Mat half;
+      cv::resize(block, half, info.tile_rect(level, tx, ty).size(), 0, 0, cv::INTER_AREA);
+      if (!write_image_file(tile_file(dir, info, level, tx, ty), half)) ok = false;
+    });
+    if (!ok) {
+      if (error) *error = "missing or unreadable tiles at level " + std::to_string(level - 1);
+      return false;
+    }
+    if (progress) progress(level * 100 / info.levels);
+  }
+  if (!write_manifest(dir, info, error)) return false;
+  if (progress) progress(100);
+  return true;
+}
+
+size_t TileKeyHash::operator()(const TileKey& k) const {
+  size_t h = std::hash<int>()(k.level);
+  h ^= std::hash<int>()(k.tx) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  h ^= std::hash<int>()(k.ty) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  return h;
+}
+
+std::shared_ptr<TileStore> TileStore::open(const std::string& dir, std::string* error,
+                                           size_t budget_bytes, unsigned loader_threads) {
+  PyramidInfo info;
+  if (!read_manifest(dir, info, error)) return nullptr;
+  return std::shared_ptr<TileStore>(new TileStore(dir, info, budget_bytes, loader_threads));
+}
+
+TileStore::TileStore(const std::string& dir, const PyramidInfo& info, size_t budget_bytes, unsigned loader_threads)
+  : dir_(dir), info_(info), budget_(budget_bytes) {
+  for (unsigned i = 0; i < std::max(1u, loader_threads); ++i) {
+    loaders_.emplace_back([this]() { loader_loop(); });
+  }
+}
+
+TileStore::~TileStore() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto& t : loaders_) t.join();
+}
+
+cv::Mat TileStore::read_tile_file(const TileKey& key) const {
+  TRACE_SCOPE("tile.decode");
+  const int flags = info_.channels == 1 ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+  cv::Mat tile = read_image_file(tile_file(dir_, info_, key.level, key.tx, key.ty), flags);
+  if (tile.size() != info_.tile_rect(key.level, key.tx, key.ty).size()) return cv::Mat();
+  return tile;
+}
+
+bool TileStore::lookup(const TileKey& key, cv::Mat& tile) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return false;
+  lru_.splice(lru_.begin(), lru_, it->second);
+  tile = it->second->tile;
+  return true;
+}
+
+cv::Mat TileStore::load(const TileKey& key) {
+  cv::Mat tile;
+  if (lookup(key, tile)) return tile;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_.count(key)) return cv::Mat();
+  }
+  tile = read_tile_file(key);
+  insert(key, tile);
+  return tile;
+}
+
+void TileStore::insert(const TileKey& key, const cv::Mat& tile) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tile.empty()) {
+    failed_.insert(key);
+    return;
+  }
+  if (index_.count(key)) return;  // loaded twice concurrently
+  const size_t bytes = tile.total() * tile.elemSize();
+  lru_.push_front(Entry{ key, tile, bytes });
+  index_.emplace(key, lru_.begin());
+  used_ += bytes;
+  evict_locked();
+}
+
+void TileStore::evict_locked() {
+  // the front entry (just used) always stays, even over budget
+  while (used_ > budget_ && lru_.size() > 1) {
+    const Entry& victim = lru_.back();
+    used_ -= victim.bytes;
+    index_.erase(victim.key);
+    lru_.pop_back();
+  }
+}
+
+void TileStore::request(const TileKey& key) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index_.count(key) || failed_.count(key)) return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (!queued_.insert(key).second) return;
+    queue_.push_back(key);
+    if (queue_.size() > kMaxQueuedTiles) {
+      queued_.erase(queue_.front());
+      queue_.pop_front();
+    }
+  }
+  queue_cv_.notify_one();
+}
+
+void TileStore::cancel_requests() {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_.clear();
+  queued_.clear();
+}
+
+void TileStore::set_loaded_callback(LoadedCallback callback) {
+  std::lock_guard<std::mutex> lock(callback_mutex_);
+  on_loaded_ = std::move(callback);
+}
+
+void TileStore::loader_loop() {
+  for (;;) {
+    TileKey key;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (stop_) return;
+      key = queue_.back();  // newest request first: what the view shows now
+      queue_.pop_back();
+    }
+    cv::Mat tile;
+    if (!lookup(key, tile)) {
+      tile = read_tile_file(key);
+      insert(key, tile);
+    }
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      queued_.erase(key);
+    }
+    if (tile.empty()) continue;
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (on_loaded_) on_loaded_(key);
+  }
+}
+
+cv::Mat TileStore::read_region(const cv::Rect& rect, int level) {
+  const cv::Size s = info_.level_size(level);
+  const cv::Rect r = rect & cv::Rect(0, 0, s.width, s.height);
+  if (r.empty()) return cv::Mat();
+  TRACE_SCOPE_PX("tile.read_region", r.area());
+  cv::Mat out(r.size(), info_.channels == 1 ? CV_8UC1 : CV_8UC3, cv::Scalar::all(0));
+  const int t = info_.tile_size;
+  for (int ty = r.y / t; ty <= (r.y + r.height - 1) / t; ++ty) {
+    for (int tx = r.x / t; tx <= (r.x + r.width - 1) / t; ++tx) {
+      const cv::Mat tile = load(TileKey{ level, tx, ty });
+      if (tile.empty()) continue;
+      const cv::Rect tr = info_.tile_rect(level, tx, ty);
+      const cv::Rect part = tr & r;
+      tile(part - tr.tl()).copyTo(out(part - r.tl()));
+    }
+  }
+  return out;
+}
+
+void TileStore::set_budget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_ = budget_bytes;
+  evict_locked();
+}
+
+size_t TileStore::bytes_used() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+// Layout of an on-disk image pyramid:
+//   <dir>/pyramid.txt                  this manifest ("key = value" lines)
+//   <dir>/<level>/<ty>_<tx>.<format>   tile_size x tile_size tiles (smaller at the edges)
+// Level 0 is full resolution, every next level halves both sides, the last
+// level fits in one tile.
+struct PyramidInfo {
+  int width = 0;
+  int height = 0;
+  int tile_size = 512;
+  int levels = 1;
+  int channels = 1;
+  std::string format = "png";
+
+  cv::Size level_size(int level) const;
+  int tiles_x(int level) const;
+  int tiles_y(int level) const;
+  // Tile rectangle in the coordinates of its level.
+  cv::Rect tile_rect(int level, int tx, int ty) const;
+};
+
+bool read_manifest(const std::string& dir, PyramidInfo& info, std::string* error = nullptr);
+bool write_manifest(const std::string& dir, const PyramidInfo& info, std::string* error = nullptr);
+
+// Cuts an image file into level-0 tiles, then builds each coarser level
+// from the tiles of the previous one (2x2 tiles -> 1, read back from disk),
+// so only the source decode needs the whole image in memory. Sources over
+// the decoder's limit (2^30 pixels) are refused before anything is read;
+// scanners (or a strip-wise converter) that deliver tiles write level 0 and
+// the manifest and call build_pyramid_levels(). progress gets [0, 100].
+bool build_pyramid(const std::string& image_path, const std::string& out_dir, int tile_size,
+                   std::string* error = nullptr, const std::function<void(int)>& progress = {});
+bool build_pyramid_levels(const std::string& dir, std::string* error = nullptr,
+                          const std::function<void(int)>& progress = {});
+
+struct TileKey {
+  int level = 0;
+  int tx = 0;
+  int ty = 0;
+  bool operator==(const TileKey& o) const { return level == o.level && tx == o.tx && ty == o.ty; }
+};
+
+struct TileKeyHash {
+  size_t operator()(const TileKey& k) const;
+};
+
+// Tiles of one pyramid, paged in from disk on demand and kept in an LRU
+// cache with a memory budget. Missing tiles can be loaded synchronously or
+// requested from background loader threads.
+class TileStore {
+public:
+  using LoadedCallback = std::function<void(const TileKey&)>;
+
+  static std::shared_ptr<TileStore> open(const std::string& dir, std::string* error = nullptr,
+                                         size_t budget_bytes = size_t(256) << 20,
+                                         unsigned loader_threads = 2);
+  ~TileStore();
+
+  TileStore(const TileStore&) = delete;
+  TileStore& operator=(const TileStore&) = delete;
+
+  const PyramidInfo& info() const { return info_; }
+
+  // Cached tile only, no I/O.
+  bool lookup(const TileKey& key, cv::Mat& tile);
+  // Cached tile or read from disk on the calling thread; empty on failure.
+  cv::Mat load(const TileKey& key);
+  // Queues a background load unless cached or already queued. The newest
+  // requests are served first; the queue is capped, old requests fall off.
+  void request(const TileKey& key);
+  // Forgets queued requests (e.g. after the view jumped elsewhere).
+  void cancel_requests();
+  // Called on a loader thread after a requested tile entered the cache.
+  // Once set_loaded_callback({}) returns the old callback is never called again.
+  void set_loaded_callback(LoadedCallback callback);
+
+  // Pixels of `rect` (coordinates of `level`) assembled from tiles, loading
+  // what is missing. Blocking; this is what tools read ROIs from.
+  cv::Mat read_region(const cv::Rect& rect, int level = 0);
+
+  void set_budget(size_t budget_bytes);
+  size_t bytes_used() const;
+
+private:
+  TileStore(const std::string& dir, const PyramidInfo& info, size_t budget_bytes, unsigned loader_threads);
+
+  cv::Mat read_tile_file(const TileKey& key) const;
+  void insert(const TileKey& key, const cv::Mat& tile);
+  void evict_locked();
+  void loader_loop();
+
+  struct Entry {
+    TileKey key;
+    cv::Mat tile;
+    size_t bytes = 0;
+  };
+
+  const std::string dir_;
+  const PyramidInfo info_;
+
+  mutable std::mutex mutex_;
+  std::list<Entry> lru_;  // most recently used at the front
+  std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> index_;
+  std::unordered_set<TileKey, TileKeyHash> failed_;  // unreadable, not retried
+  size_t budget_ = 0;
+  size_t used_ = 0;
+
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<TileKey> queue_;  // newest at the back
+  std::unordered_set<TileKey, TileKeyHash> queued_;
+  // held while the callback runs, so clearing it waits for a running call
+  std::mutex callback_mutex_;
+  LoadedCallback on_loaded_;
+  bool stop_ = false;
+  std::vector<std::thread> loaders_;
+};
+
+} // namespace tools
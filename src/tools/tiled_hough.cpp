@@ -0,0 +1,175 @@
+#include "tiled_hough.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <opencv2/imgproc.hpp>
+
+using namespace tools;
+
+namespace {
+
+struct Seg {
+  cv::Point2d a, b;
+  cv::Point2d dir;   // unit direction, angle in [0, pi)
+  double angle = 0;  // [0, pi)
+  double length = 0;
+};
+
+Seg make_seg(const cv::Vec4i& v) {
+  Seg s;
+  s.a = cv::Point2d(v[0], v[1]);
+  s.b = cv::Point2d(v[2], v[3]);
+  cv::Point2d d = s.b - s.a;
+  s.length = std::sqrt(d.x * d.x + d.y * d.y);
+  if (s.length > 0) d = d / s.length;
+  else d = cv::Point2d(1, 0);
+  // canonical direction so that angle is in [0, pi)
+  if (d.y < 0 || (d.y == 0 && d.x < 0)) d = -d;
+  s.dir = d;
+  s.angle = std::atan2(d.y, d.x);
+  if (s.angle >= CV_PI) s.angle -= CV_PI;
+  return s;
+}
+
+// union-find with path halving
+int find_root(std::vector<int>& parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// Same line (angle + perpendicular distance) and touching along it.
+bool mergeable(const Seg& s, const Seg& t, double angle_tol, double dist_tol, double max_gap) {
+  double da = std::fabs(s.angle - t.angle);
+  da = std::min(da, CV_PI - da);
+  if (da > angle_tol) return false;
+
+  // perpendicular distance of t's endpoints to the longer segment's line
+  const Seg& ref = s.length >= t.length ? s : t;
+  const Seg& other = s.length >= t.length ? t : s;
+  const cv::Point2d n(-ref.dir.y, ref.dir.x);
+  const double da_perp = std::fabs((other.a - ref.a).dot(n));
+  const double db_perp = std::fabs((other.b - ref.a).dot(n));
+  if (da_perp > dist_tol || db_perp > dist_tol) return false;
+
+  // 1-D intervals along ref direction
+  const double r0 = 0.0, r1 = (ref.b - ref.a).dot(ref.dir);
+  const double o0 = (other.a - ref.a).dot(ref.dir), o1 = (other.b - ref.a).dot(ref.dir);
+  const double rlo = std::min(r0, r1), rhi = std::max(r0, r1);
+  const double olo = std::min(o0, o1), ohi = std::max(o0, o1);
+  const double gap = std::max(olo - rhi, rlo - ohi);
+  return gap <= max_gap;
+}
+
+} // namespace
+
+std::vector<cv::Vec4i> tools::merge_collinear_segments(const std::vector<cv::Vec4i>& segments,
+                                                       double angle_tol_deg, double distance_tol,
+                                                       double max_gap) {
+  const int n = static_cast<int>(segments.size());
+  if (n < 2) return segments;
+
+  std::vector<Seg> segs(n);
+  for (int i = 0; i < n; ++i) segs[i] = make_seg(segments[i]);
+  const double angle_tol = angle_tol_deg * CV_PI / 180.0;
+
+  // sweep in angle order; only pairs within angle_tol are tested
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int i, int j) { return segs[i].angle < segs[j].angle; });
+
+  std::vector<int> parent(n);
+  std::iota(parent.begin(), parent.end(), 0);
+  auto try_union = [&](int i, int j) {
+    const int ri = find_root(parent, i), rj = find_root(parent, j);
+    if (ri != rj && mergeable(segs[i], segs[j], angle_tol, distance_tol, max_gap)) parent[rj] = ri;
+  };
+  for (int k = 0; k < n; ++k) {
+    for (int m = k + 1; m < n && segs[order[m]].angle - segs[order[k]].angle <= angle_tol; ++m) {
+      try_union(order[k], order[m]);
+    }
+  }
+  // wrap-around: angles near pi are the same direction as angles near 0
+  for (int k = n - 1; k >= 0 && segs[order[k]].angle >= CV_PI - angle_tol; --k) {
+    for (int m = 0; m < n && segs[order[m]].angle <= angle_tol - (CV_PI - segs[order[k]].angle); ++m) {
+      if (order[m] != order[k]) try_union(order[k], order[m]);
+    }
+  }
+
+  // every group becomes one segment on the line of its longest member,
+  // spanning the projections of all member endpoints
+  std::vector<int> longest(n, -1);
+  for (int i = 0; i < n; ++i) {
+    const int r = find_root(parent, i);
+    if (longest[r] < 0 || segs[i].length > segs[longest[r]].length) longest[r] = i;
+  }
+  std::vector<double> lo(n, 1e300), hi(n, -1e300);
+  for (int i = 0; i < n; ++i) {
+    const int r = find_root(parent, i);
+    const Seg& ref = segs[longest[r]];
+    for (const cv::Point2d& p : { segs[i].a, segs[i].b }) {
+      const double t = (p - ref.a).dot(ref.dir);
+      lo[r] = std::min(lo[r], t);
+      hi[r] = std::max(hi[r], t);
+    }
+  }
+  std::vector<cv::Vec4i> merged;
+  for (int i = 0; i < n; ++i) {
+    if (find_root(parent, i) != i) continue;
+    const Seg& ref = segs[longest[i]];
+    const cv::Point2d p0 = ref.a + ref.dir * lo[i];
+    const cv::Point2d p1 = ref.a + ref.dir * hi[i];
+    merged.emplace_back(cvRound(p0.x), cvRound(p0.y), cvRound(p1.x), cvRound(p1.y));
+  }
+  return merged;
+}
+
+std::vector<cv::Vec4i> tools::tiled_hough_lines_p(const cv::Mat& edges,
+                                                  double rho, double theta, int threshold,
+                                                  double min_line_length, double max_line_gap,
+                                                  const TiledHoughOptions& options,
+                                                  ThreadPool& pool,
+                                                  const RunContext* ctx) {
+  std::vector<cv::Vec4i> out;
+  if (edges.empty()) return out;
+
+  const int tile = std::max(64, options.tile_size);
+  const int overlap = std::max(0, options.overlap);
+  const int tiles_x = (edges.cols + tile - 1) / tile;
+  const int tiles_y = (edges.rows + tile - 1) / tile;
+  const cv::Rect bounds(0, 0, edges.cols, edges.rows);
+
+  // Pieces of a long line that fall into a tile can be shorter than
+  // min_line_length; keep them per tile and filter after the merge.
+  const double tile_min_length = std::min(min_line_length, static_cast<double>(overlap));
+
+  std::vector<std::vector<cv::Vec4i>> per_tile(static_cast<size_t>(tiles_x) * tiles_y);
+  pool.parallel_for(0, per_tile.size(), [&](size_t i) {
+    if (ctx && ctx->cancelled()) return;
+    const int tx = static_cast<int>(i) % tiles_x;
+    const int ty = static_cast<int>(i) / tiles_x;
+    const cv::Rect r = cv::Rect(tx * tile - overlap, ty * tile - overlap, tile + 2 * overlap, tile + 2 * overlap) & bounds;
+    std::vector<cv::Vec4i>& lines = per_tile[i];
+    TRACE_SCOPE_PX("HoughLinesP.tile", r.area());
+    cv::HoughLinesP(edges(r), lines, rho, theta, threshold, tile_min_length, max_line_gap);
+    for (auto& l : lines) {
+      l[0] += r.x; l[1] += r.y; l[2] += r.x; l[3] += r.y;
+    }
+  });
+  if (ctx && ctx->cancelled()) return out;
+
+  TRACE_SCOPE("merge_collinear_segments");
+  for (auto& lines : per_tile) out.insert(out.end(), lines.begin(), lines.end());
+  out = merge_collinear_segments(out, options.angle_tol_deg, options.distance_tol, std::max(1.0, max_line_gap));
+
+  const double min_len2 = min_line_length * min_line_length;
+  out.erase(std::remove_if(out.begin(), out.end(), [&](const cv::Vec4i& l) {
+    const double dx = l[2] - l[0], dy = l[3] - l[1];
+    return dx * dx + dy * dy < min_len2;
+  }), out.end());
+  return out;
+}
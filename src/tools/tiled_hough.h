@@ -0,0 +1,34 @@
+#pragma once
+
+#include "run_context.h"
+#include "thread_pool.h"
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+struct TiledHoughOptions {
+  int tile_size = 512;       // tile stride in pixels
+  int overlap = 32;          // extra border read around every tile
+  double angle_tol_deg = 2.0; // segments closer than this in angle may merge
+  double distance_tol = 2.0;  // max perpendicular distance between merged segments
+};
+
+// HoughLinesP over overlapping tiles on the pool, then segments cut at the
+// seams (or found twice in an overlap) are merged back together.
+// Results match a single HoughLinesP pass within the merge tolerances.
+std::vector<cv::Vec4i> tiled_hough_lines_p(const cv::Mat& edges,
+                                           double rho, double theta, int threshold,
+                                           double min_line_length, double max_line_gap,
+                                           const TiledHoughOptions& options,
+                                           ThreadPool& pool,
+                                           const RunContext* ctx = nullptr);
+
+// Merges nearly collinear segments that overlap or are separated by at most
+// max_gap along their common direction. Merged segments span all members.
+std::vector<cv::Vec4i> merge_collinear_segments(const std::vector<cv::Vec4i>& segments,
+                                                double angle_tol_deg, double distance_tol,
+                                                double max_gap);
+
+} // namespace tools
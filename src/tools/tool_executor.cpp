@@ -0,0 +1,298 @@
+#include "tool_executor.h"
+#include "oriented_roi.h"
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+
+using namespace tools;
+
+namespace {
+
+// ROIs whose preprocessing is computed once on a shared region.
+struct RoiCluster {
+  cv::Rect region;
+  std::vector<size_t> members;
+};
+
+// Groups overlapping ROIs. A group is only kept when its bounding region is
+// not much larger than its ROIs together; otherwise sharing would compute
+// more pixels than it saves.
+std::vector<RoiCluster> cluster_overlapping_rois(const std::vector<RoiJob>& jobs) {
+  const size_t n = jobs.size();
+  std::vector<size_t> parent(n);
+  for (size_t i = 0; i < n; ++i) parent[i] = i;
+  auto root = [&](size_t i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = i + 1; j < n; ++j) {
+      if (!jobs[i].tool || !jobs[j].tool) continue;
+      if ((jobs[i].roi & jobs[j].roi).area() > 0) parent[root(j)] = root(i);
+    }
+  }
+
+  std::vector<RoiCluster> clusters;
+  std::vector<long long> roi_area;
+  std::vector<int> slot(n, -1);
+  for (size_t i = 0; i < n; ++i) {
+    if (!jobs[i].tool) continue;
+    const size_t r = root(i);
+    if (slot[r] < 0) {
+      slot[r] = static_cast<int>(clusters.size());
+      clusters.push_back(RoiCluster{ jobs[i].roi, {} });
+      roi_area.push_back(0);
+    }
+    RoiCluster& c = clusters[slot[r]];
+    c.region |= jobs[i].roi;
+    c.members.push_back(i);
+    roi_area[slot[r]] += jobs[i].roi.area();
+  }
+
+  std::vector<RoiCluster> shared;
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    if (clusters[c].members.size() < 2) continue;
+    if (static_cast<double>(clusters[c].region.area()) > 1.5 * static_cast<double>(roi_area[c])) continue;
+    shared.push_back(std::move(clusters[c]));
+  }
+  return shared;
+}
+
+} // namespace
+
+ToolExecutor::ToolExecutor(ThreadPool& pool, StageCache* stage_cache, ResultCache* result_cache)
+  : pool_(pool), stage_cache_(stage_cache), result_cache_(result_cache) {}
+
+ToolExecutor::~ToolExecutor() {
+  cancel_all();
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this]() { return running_.empty(); });
+}
+
+std::shared_ptr<RunContext> ToolExecutor::begin_run(const ImageDocument* doc, uint64_t& id) {
+  auto ctx = std::make_shared<RunContext>();
+  ctx->image_id = doc ? doc->id() : 0;
+  ctx->stage_cache = stage_cache_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // newer run supersedes everything still in flight
+  for (auto& kv : running_) kv.second->cancel();
+  id = next_id_++;
+  latest_id_ = id;
+  running_.emplace(id, ctx);
+  return ctx;
+}
+
+uint64_t ToolExecutor::submit(std::shared_ptr<ITool> tool,
+                              std::shared_ptr<const ImageDocument> doc,
+                              const cv::Rect& roi,
+                              DoneCallback on_done,
+                              ProgressCallback on_progress,
+                              std::string cache_params) {
+  RunBody body = [roi](ITool& t, const cv::Mat& gray) { return t.run(gray, roi); };
+  ResultKey key;
+  key.region = oriented_region(roi, 0.0);
+  key.params = std::move(cache_params);
+  return post(std::move(tool), std::move(doc), std::move(body), std::move(key), std::move(on_done), std::move(on_progress));
+}
+
+uint64_t ToolExecutor::submit(std::shared_ptr<ITool> tool,
+                              std::shared_ptr<const ImageDocument> doc,
+                              const cv::RotatedRect& region,
+                              DoneCallback on_done,
+                              ProgressCallback on_progress,
+                              std::string cache_params) {
+  RunBody body = [region](ITool& t, const cv::Mat& gray) { return t.run_oriented(gray, region); };
+  ResultKey key;
+  key.region = region;
+  key.params = std::move(cache_params);
+  return post(std::move(tool), std::move(doc), std::move(body), std::move(key), std::move(on_done), std::move(on_progress));
+}
+
+uint64_t ToolExecutor::post(std::shared_ptr<ITool> tool, std::shared_ptr<const ImageDocument> doc,
+                            RunBody body, ResultKey key, DoneCallback on_done, ProgressCallback on_progress) {
+  uint64_t id = 0;
+  auto ctx = begin_run(doc.get(), id);
+  if (on_progress) {
+    ctx->on_progress = [on_progress, id](int percent) { on_progress(id, percent); };
+  }
+
+  pool_.post([this, id, ctx, tool, doc, body, key = std::move(key), on_done]() {
+    run_job(id, ctx, tool, doc, body, key, on_done, std::chrono::steady_clock::now());
+  });
+  return id;
+}
+
+uint64_t ToolExecutor::submit_lazy(std::shared_ptr<ITool> tool,
+                                   DocumentLoader load,
+                                   const cv::Rect& roi,
+                                   DoneCallback on_done,
+                                   ProgressCallback on_progress) {
+  RunBody body = [roi](ITool& t, const cv::Mat& gray) { return t.run(gray, roi); };
+  return post_lazy(std::move(tool), std::move(load), std::move(body), std::move(on_done), std::move(on_progress));
+}
+
+uint64_t ToolExecutor::submit_lazy(std::shared_ptr<ITool> tool,
+                                   DocumentLoader load,
+                                   const cv::RotatedRect& region,
+                                   DoneCallback on_done,
+                                   ProgressCallback on_progress) {
+  RunBody body = [region](ITool& t, const cv::Mat& gray) { return t.run_oriented(gray, region); };
+  return post_lazy(std::move(tool), std::move(load), std::move(body), std::move(on_done), std::move(on_progress));
+}
+
+uint64_t ToolExecutor::post_lazy(std::shared_ptr<ITool> tool, DocumentLoader load,
+                                 RunBody body, DoneCallback on_done, ProgressCallback on_progress) {
+  uint64_t id = 0;
+  // loaded documents are one-off: image_id stays 0, nothing is cached for them
+  auto ctx = begin_run(nullptr, id);
+  if (on_progress) {
+    ctx->on_progress = [on_progress, id](int percent) { on_progress(id, percent); };
+  }
+
+  pool_.post([this, id, ctx, tool, load, body, on_done]() {
+    const auto t0 = std::chrono::steady_clock::now();
+    std::shared_ptr<const ImageDocument> doc;
+    std::string error;
+    if (!ctx->cancelled() && load) {
+      try {
+        doc = load();
+        if (!doc) error = "document could not be loaded";
+      } catch (const std::exception& e) {
+        error = e.what();
+      }
+    }
+    if (!error.empty()) {
+      RunOutcome out;
+      out.id = id;
+      out.error = error;
+      out.cancelled = ctx->cancelled();
+      if (on_done) on_done(out);
+      finish(id);
+      return;
+    }
+    // documents read from a TileStore are one-off: not cached
+    run_job(id, ctx, tool, doc, body, ResultKey(), on_done, t0);
+  });
+  return id;
+}
+
+void ToolExecutor::run_job(uint64_t id, const std::shared_ptr<RunContext>& ctx,
+                           const std::shared_ptr<ITool>& tool,
+                           const std::shared_ptr<const ImageDocument>& doc,
+                           const RunBody& body, ResultKey key, const DoneCallback& on_done,
+                           std::chrono::steady_clock::time_point t0) {
+  RunOutcome out;
+  out.id = id;
+  const bool use_cache = result_cache_ && !key.params.empty();
+  if (!ctx->cancelled() && tool && doc) {
+    if (use_cache) {
+      key.image_hash = doc->content_hash();
+      out.cached = result_cache_->lookup(key, out.result);
+    }
+    if (!out.cached) {
+      tool->set_context(ctx.get());
+      try {
+        TRACE_SCOPE("tool.run");
+        out.result = body(*tool, doc->gray());
+      } catch (const std::exception& e) {
+        out.error = e.what();
+      }
+      tool->set_context(nullptr);
+      // a cancelled run may have stopped early: its result is not the answer
+      if (use_cache && out.error.empty() && !ctx->cancelled()) result_cache_->insert(key, out.result);
+    }
+  }
+  out.cancelled = ctx->cancelled();
+  out.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  if (on_done) on_done(out);
+  finish(id);
+}
+
+uint64_t ToolExecutor::submit_batch(std::vector<RoiJob> jobs,
+                                    std::shared_ptr<const ImageDocument> doc,
+                                    DoneCallback on_done,
+                                    ProgressCallback on_progress) {
+  uint64_t id = 0;
+  // tools share the context for cancellation and the stage cache; progress
+  // is reported per finished ROI instead of per tool stage
+  auto ctx = begin_run(doc.get(), id);
+
+  pool_.post([this, id, ctx, jobs = std::move(jobs), doc, on_done, on_progress]() {
+    const auto t0 = std::chrono::steady_clock::now();
+    RunOutcome out;
+    out.id = id;
+    out.roi_results.resize(jobs.size());
+    if (!ctx->cancelled() && doc) {
+      const cv::Mat& gray = doc->gray();
+      // one child context per job (cancelled with the run): a job in a
+      // cluster carries the cluster region, the only plane its stages may
+      // reuse as a sub-view
+      std::unique_ptr<RunContext[]> job_ctx(new RunContext[jobs.size()]);
+      for (size_t j = 0; j < jobs.size(); ++j) {
+        job_ctx[j].parent = ctx.get();
+        job_ctx[j].image_id = ctx->image_id;
+        job_ctx[j].stage_cache = ctx->stage_cache;
+        if (jobs[j].tool) jobs[j].tool->set_context(&job_ctx[j]);
+      }
+      try {
+        // shared preprocessing for clusters of overlapping ROIs
+        if (ctx->stage_cache) {
+          const std::vector<RoiCluster> clusters = cluster_overlapping_rois(jobs);
+          for (const RoiCluster& cluster : clusters) {
+            for (size_t j : cluster.members) job_ctx[j].prepared_region = cluster.region;
+          }
+          pool_.parallel_for(0, clusters.size(), [&](size_t c) {
+            if (ctx->cancelled()) return;
+            TRACE_SCOPE_PX("batch.prepare", clusters[c].region.area());
+            for (size_t j : clusters[c].members) {
+              // prepare() of the same stage params hits the cache after the first tool
+              jobs[j].tool->prepare(gray, clusters[c].region);
+            }
+          });
+        }
+        std::atomic<size_t> finished{0};
+        pool_.parallel_for(0, jobs.size(), [&](size_t j) {
+          if (ctx->cancelled() || !jobs[j].tool) return;
+          TRACE_SCOPE_PX("batch.roi", jobs[j].roi.area());
+          out.roi_results[j] = jobs[j].tool->run(gray, jobs[j].roi);
+          out.roi_results[j].roi_id = jobs[j].roi_id;
+          const size_t n = finished.fetch_add(1) + 1;
+          if (on_progress) on_progress(id, static_cast<int>(n * 100 / jobs.size()));
+        });
+      } catch (const std::exception& e) {
+        out.error = e.what();
+      }
+      for (const RoiJob& job : jobs) {
+        if (job.tool) job.tool->set_context(nullptr);
+      }
+    }
+    out.cancelled = ctx->cancelled();
+    out.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (on_done) on_done(out);
+    finish(id);
+  });
+  return id;
+}
+
+void ToolExecutor::finish(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  running_.erase(id);
+  if (running_.empty()) idle_cv_.notify_all();
+}
+
+void ToolExecutor::cancel_all() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& kv : running_) kv.second->cancel();
+}
+
+uint64_t ToolExecutor::latest_id() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return latest_id_;
+}
+
+bool ToolExecutor::busy() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !running_.empty();
+}
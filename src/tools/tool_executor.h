@@ -0,0 +1,134 @@
+#pragma once
+
+#include "detection_result.h"
+#include "itool.h"
+#include "image_document.h"
+#include "result_cache.h"
+#include "run_context.h"
+#include "stage_cache.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tools {
+
+// Result of one asynchronous tool run.
+struct RunOutcome {
+  uint64_t id = 0;
+  DetectionResult result;
+  // Multi-ROI runs (submit_batch): one result per ROI, tagged with roi_id.
+  std::vector<DetectionResult> roi_results;
+  bool cancelled = false;  // cancelled or superseded before it finished
+  bool cached = false;     // result came from the result cache, the tool did not run
+  std::string error;       // non-empty if the tool threw
+  double elapsed_ms = 0.0;
+};
+
+// One ROI of a multi-ROI run.
+struct RoiJob {
+  int roi_id = -1;
+  cv::Rect roi;
+  std::shared_ptr<ITool> tool;
+};
+
+// Runs tools on a worker pool. Every submit() supersedes (cancels) the runs
+// that are still in flight, so only the newest request produces a result.
+class ToolExecutor {
+public:
+  using DoneCallback = std::function<void(const RunOutcome&)>;
+  using ProgressCallback = std::function<void(uint64_t id, int percent)>;
+
+  // stage_cache may be null to disable preprocessing reuse, result_cache to
+  // disable result memoization.
+  explicit ToolExecutor(ThreadPool& pool = ThreadPool::global(),
+                        StageCache* stage_cache = &StageCache::global(),
+                        ResultCache* result_cache = nullptr);
+  // Cancels outstanding runs and waits for them, callbacks included.
+  ~ToolExecutor();
+
+  ToolExecutor(const ToolExecutor&) = delete;
+  ToolExecutor& operator=(const ToolExecutor&) = delete;
+
+  // Runs tool->run(doc->gray(), roi) on the pool. Callbacks are invoked on
+  // the worker thread; on_done is always called exactly once per run.
+  // A non-empty cache_params (the tool's canonical parameters, see
+  // to_string(ToolSpec)) looks the run up in the result cache first and
+  // stores a completed result there.
+  uint64_t submit(std::shared_ptr<ITool> tool,
+                  std::shared_ptr<const ImageDocument> doc,
+                  const cv::Rect& roi,
+                  DoneCallback on_done,
+                  ProgressCallback on_progress = {},
+                  std::string cache_params = {});
+  // Same with a rotated ROI: tool->run_oriented(doc->gray(), region).
+  uint64_t submit(std::shared_ptr<ITool> tool,
+                  std::shared_ptr<const ImageDocument> doc,
+                  const cv::RotatedRect& region,
+                  DoneCallback on_done,
+                  ProgressCallback on_progress = {},
+                  std::string cache_params = {});
+
+  // Like submit(), but the document is produced on the worker first (e.g.
+  // a ROI read from a TileStore), so slow I/O stays off the caller's thread.
+  using DocumentLoader = std::function<std::shared_ptr<const ImageDocument>()>;
+  uint64_t submit_lazy(std::shared_ptr<ITool> tool,
+                       DocumentLoader load,
+                       const cv::Rect& roi,
+                       DoneCallback on_done,
+                       ProgressCallback on_progress = {});
+  uint64_t submit_lazy(std::shared_ptr<ITool> tool,
+                       DocumentLoader load,
+                       const cv::RotatedRect& region,
+                       DoneCallback on_done,
+                       ProgressCallback on_progress = {});
+
+  // Runs every job concurrently over the same document as one run (same
+  // supersede/cancel rules). Overlapping ROIs first get their preprocessing
+  // computed once on the union (ITool::prepare), so it is not duplicated.
+  // on_done receives RunOutcome::roi_results in job order.
+  uint64_t submit_batch(std::vector<RoiJob> jobs,
+                        std::shared_ptr<const ImageDocument> doc,
+                        DoneCallback on_done,
+                        ProgressCallback on_progress = {});
+
+  void cancel_all();
+  // Id of the newest submitted run (0 before the first submit).
+  uint64_t latest_id() const;
+  bool busy() const;
+
+private:
+  // What a single-tool run does with the document's gray image.
+  using RunBody = std::function<DetectionResult(ITool&, const cv::Mat&)>;
+
+  std::shared_ptr<RunContext> begin_run(const ImageDocument* doc, uint64_t& id);
+  // key.params empty = not cached; key.image_hash is filled in on the worker
+  uint64_t post(std::shared_ptr<ITool> tool, std::shared_ptr<const ImageDocument> doc,
+                RunBody body, ResultKey key, DoneCallback on_done, ProgressCallback on_progress);
+  uint64_t post_lazy(std::shared_ptr<ITool> tool, DocumentLoader load,
+                     RunBody body, DoneCallback on_done, ProgressCallback on_progress);
+  void run_job(uint64_t id, const std::shared_ptr<RunContext>& ctx,
+               const std::shared_ptr<ITool>& tool,
+               const std::shared_ptr<const ImageDocument>& doc,
+               const RunBody& body, ResultKey key, const DoneCallback& on_done,
+               std::chrono::steady_clock::time_point t0);
+  void finish(uint64_t id);
+
+  ThreadPool& pool_;
+  StageCache* stage_cache_ = nullptr;
+  ResultCache* result_cache_ = nullptr;
+  mutable std::mutex mutex_;
+  std::condition_variable idle_cv_;
+  uint64_t next_id_ = 1;
+  uint64_t latest_id_ = 0;
+  std::unordered_map<uint64_t, std::shared_ptr<RunContext>> running_;
+};
+
+} // namespace tools
@@ -0,0 +1,264 @@
+#include "tool_spec.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace tools;
+
+namespace {
+
+std::string trim(const std::string& s) {
+  const size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == std::string::npos) return std::string();
+  const size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e - b + 1);
+}
+
+bool to_double(const std::string& text, double& out) {
+  try {
+    size_t used = 0;
+    out = std::stod(text, &used);
+    return used == text.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+void set_error(std::string* error, const std::string& msg) {
+  if (error) *error = msg;
+}
+
+std::string fmt(const char* key, double v) {
+  char buf[96];
+  std::snprintf(buf, sizeof(buf), ";%s=%.17g", key, v);
+  return buf;
+}
+
+} // namespace
+
+std::shared_ptr<ITool> tools::make_tool(const ToolSpec& spec) {
+  switch (spec.kind) {
+  case ToolKind::Line: {
+    auto tool = std::make_shared<LineTool>();
+    tool->params = spec.line;
+    return tool;
+  }
+  case ToolKind::Point: {
+    auto tool = std::make_shared<PointTool>();
+    tool->params = spec.point;
+    return tool;
+  }
+  case ToolKind::Circle: {
+    auto tool = std::make_shared<CircleTool>();
+    tool->params = spec.circle;
+    return tool;
+  }
+  case ToolKind::Caliper: {
+    auto tool = std::make_shared<CaliperTool>();
+    tool->params = spec.caliper;
+    return tool;
+  }
+  case ToolKind::CircleFit: {
+    auto tool = std::make_shared<CircleFitTool>();
+    tool->params = spec.circle_fit;
+    return tool;
+  }
+  }
+  return nullptr;
+}
+
+const char* tools::tool_kind_name(ToolKind kind) {
+  switch (kind) {
+  case ToolKind::Line: return "line";
+  case ToolKind::Point: return "point";
+  case ToolKind::Circle: return "circle";
+  case ToolKind::Caliper: return "caliper";
+  case ToolKind::CircleFit: return "circle_fit";
+  }
+  return "unknown";
+}
+
+bool tools::parse_tool_kind(const std::string& name, ToolKind& kind) {
+  if (name == "line") kind = ToolKind::Line;
+  else if (name == "point") kind = ToolKind::Point;
+  else if (name == "circle") kind = ToolKind::Circle;
+  else if (name == "caliper") kind = ToolKind::Caliper;
+  else if (name == "circle_fit") kind = ToolKind::CircleFit;
+  else return false;
+  return true;
+}
+
+bool tools::set_param(ToolSpec& spec, const std::string& key, const std::string& value, std::string* error) {
+  if (key == "tool") {
+    if (!parse_tool_kind(value, spec.kind)) {
+      set_error(error, "unknown tool '" + value + "'");
+      return false;
+    }
+    return true;
+  }
+
+  double v = 0.0;
+  if (!to_double(value, v)) {
+    set_error(error, "bad number for '" + key + "': " + value);
+    return false;
+  }
+
+  if (key == "line.rho") spec.line.rho = v;
+  else if (key == "line.theta") spec.line.theta = v;
+  else if (key == "line.threshold") spec.line.threshold = static_cast<int>(v);
+  else if (key == "line.min_line_length") spec.line.minLineLength = v;
+  else if (key == "line.max_line_gap") spec.line.maxLineGap = v;
+  else if (key == "line.tiled") spec.line.tiled = v != 0.0;
+  else if (key == "line.tile_size") spec.line.tile_size = static_cast<int>(v);
+  else if (key == "line.tile_overlap") spec.line.tile_overlap = static_cast<int>(v);
+  else if (key == "line.fused") spec.line.fused = v != 0.0;
+  else if (key == "line.pyramid_levels") spec.line.pyramid_levels = static_cast<int>(v);
+  else if (key == "line.refine_window") spec.line.refine_window = v;
+  else if (key == "point.max_corners") spec.point.max_corners = v;
+  else if (key == "point.quality_level") spec.point.quality_level = v;
+  else if (key == "point.min_distance") spec.point.min_distance = v;
+  else if (key == "point.grid") spec.point.grid = v != 0.0;
+  else if (key == "point.cell_size") spec.point.cell_size = static_cast<int>(v);
+  else if (key == "point.per_cell") spec.point.per_cell = static_cast<int>(v);
+  else if (key == "point.subpix") spec.point.subpix = v != 0.0;
+  else if (key == "circle.dp") spec.circle.dp = v;
+  else if (key == "circle.min_dist") spec.circle.minDist = v;
+  else if (key == "circle.param1") spec.circle.param1 = v;
+  else if (key == "circle.param2") spec.circle.param2 = v;
+  else if (key == "circle.min_radius") spec.circle.minRadius = static_cast<int>(v);
+  else if (key == "circle.max_radius") spec.circle.maxRadius = static_cast<int>(v);
+  else if (key == "circle.pyramid_levels") spec.circle.pyramid_levels = static_cast<int>(v);
+  else if (key == "circle.refine_window") spec.circle.refine_window = v;
+  else if (key == "caliper.angle") spec.caliper.angle = v;
+  else if (key == "caliper.calipers") spec.caliper.calipers = static_cast<int>(v);
+  else if (key == "caliper.width") spec.caliper.width = static_cast<int>(v);
+  else if (key == "caliper.sigma") spec.caliper.sigma = v;
+  else if (key == "caliper.min_gradient") spec.caliper.min_gradient = v;
+  else if (key == "caliper.polarity") spec.caliper.polarity = static_cast<int>(v);
+  else if (key == "caliper.inlier_distance") spec.caliper.inlier_distance = v;
+  else if (key == "circle_fit.radius") spec.circle_fit.radius = v;
+  else if (key == "circle_fit.search") spec.circle_fit.search = v;
+  else if (key == "circle_fit.rays") spec.circle_fit.rays = static_cast<int>(v);
+  else if (key == "circle_fit.width") spec.circle_fit.width = static_cast<int>(v);
+  else if (key == "circle_fit.sigma") spec.circle_fit.sigma = v;
+  else if (key == "circle_fit.min_gradient") spec.circle_fit.min_gradient = v;
+  else if (key == "circle_fit.polarity") spec.circle_fit.polarity = static_cast<int>(v);
+  else if (key == "circle_fit.inlier_distance") spec.circle_fit.inlier_distance = v;
+  else {
+    set_error(error, "unknown parameter '" + key + "'");
+    return false;
+  }
+  return true;
+}
+
+std::string tools::to_string(const ToolSpec& spec) {
+  std::string s = std::string("tool=") + tool_kind_name(spec.kind);
+  switch (spec.kind) {
+  case ToolKind::Line:
+    s += fmt("line.rho", spec.line.rho);
+    s += fmt("line.theta", spec.line.theta);
+    s += fmt("line.threshold", spec.line.threshold);
+    s += fmt("line.min_line_length", spec.line.minLineLength);
+    s += fmt("line.max_line_gap", spec.line.maxLineGap);
+    s += fmt("line.tiled", spec.line.tiled ? 1 : 0);
+    s += fmt("line.tile_size", spec.line.tile_size);
+    s += fmt("line.tile_overlap", spec.line.tile_overlap);
+    s += fmt("line.fused", spec.line.fused ? 1 : 0);
+    s += fmt("line.pyramid_levels", spec.line.pyramid_levels);
+    s += fmt("line.refine_window", spec.line.refine_window);
+    break;
+  case ToolKind::Point:
+    s += fmt("point.max_corners", spec.point.max_corners);
+    s += fmt("point.quality_level", spec.point.quality_level);
+    s += fmt("point.min_distance", spec.point.min_distance);
+    s += fmt("point.grid", spec.point.grid ? 1 : 0);
+    s += fmt("point.cell_size", spec.point.cell_size);
+    s += fmt("point.per_cell", spec.point.per_cell);
+    s += fmt("point.subpix", spec.point.subpix ? 1 : 0);
+    break;
+  case ToolKind::Circle:
+    s += fmt("circle.dp", spec.circle.dp);
+    s += fmt("circle.min_dist", spec.circle.minDist);
+    s += fmt("circle.param1", spec.circle.param1);
+    s += fmt("circle.param2", spec.circle.param2);
+    s += fmt("circle.min_radius", spec.circle.minRadius);
+    s += fmt("circle.max_radius", spec.circle.maxRadius);
+    s += fmt("circle.pyramid_levels", spec.circle.pyramid_levels);
+    s += fmt("circle.refine_window", spec.circle.refine_window);
+    break;
+  case ToolKind::Caliper:
+    s += fmt("caliper.angle", spec.caliper.angle);
+    s += fmt("caliper.calipers", spec.caliper.calipers);
+    s += fmt("caliper.width", spec.caliper.width);
+    s += fmt("caliper.sigma", spec.caliper.sigma);
+    s += fmt("caliper.min_gradient", spec.caliper.min_gradient);
+    s += fmt("caliper.polarity", spec.caliper.polarity);
+    s += fmt("caliper.inlier_distance", spec.caliper.inlier_distance);
+    break;
+  case ToolKind::CircleFit:
+    s += fmt("circle_fit.radius", spec.circle_fit.radius);
+    s += fmt("circle_fit.search", spec.circle_fit.search);
+    s += fmt("circle_fit.rays", spec.circle_fit.rays);
+    s += fmt("circle_fit.width", spec.circle_fit.width);
+    s += fmt("circle_fit.sigma", spec.circle_fit.sigma);
+    s += fmt("circle_fit.min_gradient", spec.circle_fit.min_gradient);
+    s += fmt("circle_fit.polarity", spec.circle_fit.polarity);
+    s += fmt("circle_fit.inlier_distance", spec.circle_fit.inlier_distance);
+    break;
+  }
+  return s;
+}
+
+bool tools::parse_recipe_line(Recipe& recipe, const std::string& raw, std::string* error) {
+  std::string line = raw;
+  const size_t hash = line.find('#');
+  if (hash != std::string::npos) line.resize(hash);
+  line = trim(line);
+  if (line.empty()) return true;
+
+  const size_t eq = line.find('=');
+  if (eq == std::string::npos) {
+    set_error(error, "expected 'key = value': " + raw);
+    return false;
+  }
+  const std::string key = trim(line.substr(0, eq));
+  const std::string value = trim(line.substr(eq + 1));
+
+  if (key == "roi") {
+    int x = 0, y = 0, w = 0, h = 0;
+    char tail = 0;
+    if (std::sscanf(value.c_str(), "%d ,%d ,%d ,%d %c", &x, &y, &w, &h, &tail) != 4) {
+      set_error(error, "roi must be x,y,w,h: " + value);
+      return false;
+    }
+    recipe.roi = cv::Rect(x, y, w, h);
+    return true;
+  }
+  if (key == "roi_angle") {
+    if (!to_double(value, recipe.roi_angle)) {
+      set_error(error, "roi_angle must be a number: " + value);
+      return false;
+    }
+    return true;
+  }
+  return set_param(recipe.tool, key, value, error);
+}
+
+bool tools::load_recipe(const std::string& path, Recipe& recipe, std::string* error) {
+  std::ifstream in(path);
+  if (!in) {
+    set_error(error, "cannot open recipe " + path);
+    return false;
+  }
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    std::string line_error;
+    if (!parse_recipe_line(recipe, line, &line_error)) {
+      set_error(error, path + ":" + std::to_string(line_no) + ": " + line_error);
+      return false;
+    }
+  }
+  return true;
+}
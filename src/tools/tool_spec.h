@@ -0,0 +1,58 @@
+#pragma once
+
+#include "itool.h"
+#include "line_tool.h"
+#include "point_tool.h"
+#include "circle_tool.h"
+#include "caliper_tool.h"
+#include "circle_fit_tool.h"
+
+#include <memory>
+#include <string>
+#include <opencv2/core.hpp>
+
+namespace tools {
+
+enum class ToolKind {
+  Line,
+  Point,
+  Circle,
+  Caliper,
+  CircleFit
+};
+
+// Tool type plus the parameters of every tool, so a spec can be edited,
+// stored and turned into a tool without knowing the concrete class.
+struct ToolSpec {
+  ToolKind kind = ToolKind::Line;
+  LineTool::Params line;
+  PointTool::Params point;
+  CircleTool::Params circle;
+  CaliperTool::Params caliper;
+  CircleFitTool::Params circle_fit;
+};
+
+// What a headless run needs: the tool and the ROI (empty = whole image).
+struct Recipe {
+  ToolSpec tool;
+  cv::Rect roi;
+  double roi_angle = 0.0;  // degrees, rotates `roi` about its center
+};
+
+std::shared_ptr<ITool> make_tool(const ToolSpec& spec);
+
+const char* tool_kind_name(ToolKind kind);
+bool parse_tool_kind(const std::string& name, ToolKind& kind);
+
+// key is "tool" or "<tool>.<param>", e.g. "line.rho", "circle.param2".
+bool set_param(ToolSpec& spec, const std::string& key, const std::string& value, std::string* error = nullptr);
+
+// Canonical "tool=line;line.rho=1;..." text with the active tool's params only.
+std::string to_string(const ToolSpec& spec);
+
+// Recipe file: one "key = value" per line, '#' starts a comment.
+// Besides the ToolSpec keys it accepts "roi = x,y,w,h" and "roi_angle = deg".
+bool load_recipe(const std::string& path, Recipe& recipe, std::string* error = nullptr);
+bool parse_recipe_line(Recipe& recipe, const std::string& line, std::string* error = nullptr);
+
+} // namespace tools
@@ -0,0 +1,113 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+
+using namespace tools;
+
+std::atomic<bool> trace::detail::g_enabled{false};
+
+namespace {
+
+std::mutex g_mutex;
+std::deque<trace::Event> g_events;
+std::atomic<uint32_t> g_next_thread{1};
+
+const std::chrono::steady_clock::time_point& epoch() {
+  static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  return t0;
+}
+
+uint32_t thread_number() {
+  thread_local const uint32_t n = g_next_thread.fetch_add(1);
+  return n;
+}
+
+std::string escape(const char* s) {
+  std::string out;
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') out += '\\';
+    out += *s;
+  }
+  return out;
+}
+
+} // namespace
+
+uint64_t trace::detail::now_ns() {
+  // +1 keeps 0 free to mean "not recording"
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch()).count()) + 1;
+}
+
+void trace::detail::record(const char* name, uint64_t start_ns, uint64_t end_ns, int64_t pixels) {
+  Event e;
+  e.name = name;
+  e.start_ns = start_ns;
+  e.dur_ns = end_ns - start_ns;
+  e.thread = thread_number();
+  e.pixels = pixels;
+  std::lock_guard<std::mutex> lock(g_mutex);
+  if (g_events.size() >= kMaxEvents) g_events.pop_front();
+  g_events.push_back(e);
+}
+
+void trace::set_enabled(bool on) {
+  epoch();
+  detail::g_enabled.store(on);
+}
+
+std::vector<trace::Event> trace::take_events() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  std::vector<Event> out(g_events.begin(), g_events.end());
+  g_events.clear();
+  return out;
+}
+
+std::vector<trace::StageSummary> trace::summarize(const std::vector<Event>& events) {
+  std::vector<StageSummary> out;
+  for (const Event& e : events) {
+    StageSummary* s = nullptr;
+    for (auto& existing : out) {
+      if (existing.name == e.name) { s = &existing; break; }
+    }
+    if (!s) {
+      out.emplace_back();
+      s = &out.back();
+      s->name = e.name;
+    }
+    const double ms = e.dur_ns / 1e6;
+    ++s->count;
+    s->total_ms += ms;
+    if (ms > s->max_ms) s->max_ms = ms;
+    s->pixels += e.pixels;
+  }
+  return out;
+}
+
+bool trace::write_chrome_trace(const std::string& path, const std::vector<Event>& events, std::string* error) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    if (error) *error = "cannot write " + path;
+    return false;
+  }
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  char buf[160];
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& e = events[i];
+    std::snprintf(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                  e.thread, e.start_ns / 1e3, e.dur_ns / 1e3);
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << escape(e.name) << buf;
+    if (e.pixels) out << ",\"args\":{\"pixels\":" << e.pixels << '}';
+    out << '}';
+  }
+  out << "\n]}\n";
+  if (!out) {
+    if (error) *error = "write failed: " + path;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tools {
+namespace trace {
+
+// One timed scope. name must be a string literal (only the pointer is kept).
+struct Event {
+  const char* name = "";
+  uint64_t start_ns = 0;  // since the first use of the tracer
+  uint64_t dur_ns = 0;
+  uint32_t thread = 0;    // small per-process thread number
+  int64_t pixels = 0;     // pixels the stage processed, 0 if not applicable
+};
+
+namespace detail {
+extern std::atomic<bool> g_enabled;
+uint64_t now_ns();
+void record(const char* name, uint64_t start_ns, uint64_t end_ns, int64_t pixels);
+}
+
+// Off by default. While off, a TRACE_SCOPE costs one relaxed atomic load.
+inline bool enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+void set_enabled(bool on);
+
+// Removes and returns everything recorded so far, oldest first.
+// At most kMaxEvents are kept between two calls; older ones are dropped.
+constexpr size_t kMaxEvents = size_t(1) << 18;
+std::vector<Event> take_events();
+
+// Per-name totals, in order of first appearance.
+struct StageSummary {
+  std::string name;
+  int count = 0;
+  double total_ms = 0.0;
+  double max_ms = 0.0;
+  int64_t pixels = 0;
+};
+std::vector<StageSummary> summarize(const std::vector<Event>& events);
+
+// Chrome trace-event JSON ("X" complete events), viewable in
+// chrome://tracing or Perfetto.
+bool write_chrome_trace(const std::string& path, const std::vector<Event>& events, std::string* error = nullptr);
+
+// RAII timer; records on destruction if tracing was on at construction.
+class Scope {
+public:
+  explicit Scope(const char* name, int64_t pixels = 0)
+    : name_(name), pixels_(pixels), start_ns_(enabled() ? detail::now_ns() : 0) {}
+  ~Scope() {
+    if (start_ns_) detail::record(name_, start_ns_, detail::now_ns(), pixels_);
+  }
+  void set_pixels(int64_t pixels) { pixels_ = pixels; }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  const char* name_;
+  int64_t pixels_;
+  uint64_t start_ns_;
+};
+
+} // namespace trace
+} // namespace tools
+
+#define TOOLS_TRACE_CONCAT2(a, b) a##b
+#define TOOLS_TRACE_CONCAT(a, b) TOOLS_TRACE_CONCAT2(a, b)
+// Times the rest of the enclosing block under `name` (a string literal).
+#define TRACE_SCOPE(name) ::tools::trace::Scope TOOLS_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_PX(name, pixels) ::tools::trace::Scope TOOLS_TRACE_CONCAT(trace_scope_, __LINE__)(name, pixels)